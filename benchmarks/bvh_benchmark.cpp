@@ -0,0 +1,226 @@
+// Times SceneBVH queries (frustum, ray casts, sphere overlaps) against brute force loops over every object and
+// triangle, on a generated scene of noisy spheres, and checks that both give the same answers.
+// usage: bvh_benchmark [objects] (defaults to 512)
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/bvh.h>
+#include <learnopengl/frustum.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock benchmark_clock;
+
+// best of a few runs, in milliseconds
+double timeKernel(const std::function<void()> &kernel, int runs = 7)
+{
+    double best = 1e30;
+    for (int i = 0; i < runs; i++)
+    {
+        benchmark_clock::time_point start = benchmark_clock::now();
+        kernel();
+        best = std::min(best, std::chrono::duration<double, std::milli>(benchmark_clock::now() - start).count());
+    }
+    return best;
+}
+
+float random01()
+{
+    return (float)rand() / (float)RAND_MAX;
+}
+
+// a unit sphere with radial noise, rings * segments * 2 triangles
+void noisySphere(int rings, int segments, std::vector<glm::vec3> &positions, std::vector<uint32_t> &indices)
+{
+    for (int ring = 0; ring <= rings; ring++)
+        for (int segment = 0; segment <= segments; segment++)
+        {
+            float theta = 3.14159265f * ring / rings, phi = 6.2831853f * segment / segments;
+            float radius = 0.8f + 0.2f * random01();
+            positions.push_back(radius * glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+        }
+    for (int ring = 0; ring < rings; ring++)
+        for (int segment = 0; segment < segments; segment++)
+        {
+            uint32_t a = ring * (segments + 1) + segment, b = a + segments + 1;
+            uint32_t quad[6] = {a, b, a + 1, a + 1, b, b + 1};
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+}
+
+struct BruteObject {
+    glm::mat4 inverse;
+    float inverseScale;
+    BVHBounds bounds;
+};
+
+int main(int argc, char **argv)
+{
+    size_t objectCount = argc > 1 ? (size_t)atoi(argv[1]) : 512;
+    srand(1);
+
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    noisySphere(16, 32, positions, indices);
+    std::shared_ptr<const TriangleBVH> mesh = std::make_shared<const TriangleBVH>(positions.data(), indices.data(), indices.size());
+    std::vector<std::shared_ptr<const TriangleBVH>> meshes(1, mesh);
+
+    SceneBVH bvh;
+    std::vector<BruteObject> brute(objectCount);
+    std::vector<glm::mat4> transforms(objectCount);
+    double insertTime = timeKernel([&]() {
+        for (size_t i = 0; i < objectCount; i++)
+            bvh.Remove(i);
+        srand(2);
+        for (size_t i = 0; i < objectCount; i++)
+        {
+            glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(random01() * 200.0f - 100.0f, random01() * 10.0f, random01() * 200.0f - 100.0f));
+            transform = glm::rotate(transform, random01() * 6.28f, glm::vec3(0.0f, 1.0f, 0.0f));
+            transform = glm::scale(transform, glm::vec3(0.5f + random01() * 2.0f));
+            transforms[i] = transform;
+            bvh.Insert(i, meshes, transform);
+        }
+    }, 3);
+    for (size_t i = 0; i < objectCount; i++)
+    {
+        brute[i].inverse = glm::inverse(transforms[i]);
+        glm::mat3 linear(brute[i].inverse);
+        brute[i].inverseScale = std::max(glm::length(linear[0]), std::max(glm::length(linear[1]), glm::length(linear[2])));
+        brute[i].bounds = mesh->Bounds().Transformed(transforms[i]);
+    }
+    SceneBVH::Stats stats = bvh.Statistics();
+    std::cout << objectCount << " objects, " << mesh->TriangleCount() << " triangles each (" << mesh->NodeCount()
+              << " nodes), top level " << stats.nodes << " nodes, depth " << stats.depth << std::endl;
+
+    const int queries = 256;
+    std::vector<glm::vec3> origins(queries), directions(queries), centers(queries);
+    std::vector<Frustum> frustums(queries);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+    for (int i = 0; i < queries; i++)
+    {
+        origins[i] = glm::vec3(random01() * 200.0f - 100.0f, 2.0f + random01() * 5.0f, random01() * 200.0f - 100.0f);
+        directions[i] = glm::normalize(glm::vec3(random01() - 0.5f, (random01() - 0.5f) * 0.2f, random01() - 0.5f));
+        centers[i] = glm::vec3(random01() * 200.0f - 100.0f, random01() * 10.0f, random01() * 200.0f - 100.0f);
+        frustums[i] = Frustum(projection * glm::lookAt(origins[i], origins[i] + directions[i], glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+
+    // brute force references
+    std::vector<float> bruteDistances(queries), bvhDistances(queries);
+    std::vector<size_t> bruteFrustum(queries), bvhFrustum(queries), bruteOverlap(queries), bvhOverlap(queries);
+    const float maxDistance = 150.0f, radius = 3.0f;
+    double bruteRay = timeKernel([&]() {
+        for (int q = 0; q < queries; q++)
+        {
+            float closest = maxDistance;
+            for (const BruteObject &object : brute)
+            {
+                glm::vec3 origin = glm::vec3(object.inverse * glm::vec4(origins[q], 1.0f));
+                glm::vec3 direction = glm::mat3(object.inverse) * directions[q];
+                for (size_t t = 0; t < indices.size(); t += 3)
+                {
+                    float distance;
+                    if (TriangleBVH::IntersectTriangle(origin, direction, positions[indices[t]], positions[indices[t + 1]], positions[indices[t + 2]], distance))
+                        closest = std::min(closest, distance);
+                }
+            }
+            bruteDistances[q] = closest;
+        }
+    }, 1);
+    double bruteFrustumTime = timeKernel([&]() {
+        for (int q = 0; q < queries; q++)
+        {
+            bruteFrustum[q] = 0;
+            for (const BruteObject &object : brute)
+                bruteFrustum[q] += !object.bounds.Outside(frustums[q]);
+        }
+    });
+    double bruteOverlapTime = timeKernel([&]() {
+        for (int q = 0; q < queries; q++)
+        {
+            bruteOverlap[q] = 0;
+            for (const BruteObject &object : brute)
+            {
+                glm::vec3 center = glm::vec3(object.inverse * glm::vec4(centers[q], 1.0f));
+                float localRadius = radius * object.inverseScale;
+                for (size_t t = 0; t < indices.size(); t += 3)
+                {
+                    glm::vec3 d = center - TriangleBVH::ClosestPoint(center, positions[indices[t]], positions[indices[t + 1]], positions[indices[t + 2]]);
+                    if (glm::dot(d, d) <= localRadius * localRadius)
+                    {
+                        bruteOverlap[q]++;
+                        break;
+                    }
+                }
+            }
+        }
+    }, 1);
+
+    std::vector<size_t> found;
+    double bvhRay = timeKernel([&]() {
+        for (int q = 0; q < queries; q++)
+            bvhDistances[q] = bvh.Raycast(origins[q], directions[q], maxDistance).distance;
+    });
+    double bvhFrustumTime = timeKernel([&]() {
+        for (int q = 0; q < queries; q++)
+        {
+            bvh.Query(frustums[q], found);
+            bvhFrustum[q] = found.size();
+        }
+    });
+    double bvhOverlapTime = timeKernel([&]() {
+        for (int q = 0; q < queries; q++)
+        {
+            bvh.Overlap(centers[q], radius, found);
+            bvhOverlap[q] = found.size();
+        }
+    });
+
+    int mismatches = 0;
+    for (int q = 0; q < queries; q++)
+        mismatches += std::fabs(bruteDistances[q] - bvhDistances[q]) > 1e-3f * std::max(1.0f, bruteDistances[q])
+                    || bruteFrustum[q] != bvhFrustum[q] || bruteOverlap[q] != bvhOverlap[q];
+
+    // every thread casts all rays against the shared tree
+    unsigned int threads = std::max(2u, std::thread::hardware_concurrency());
+    double parallelRay = timeKernel([&]() {
+        std::vector<std::thread> workers;
+        for (unsigned int t = 0; t < threads; t++)
+            workers.push_back(std::thread([&]() {
+                for (int q = 0; q < queries; q++)
+                    bvh.Raycast(origins[q], directions[q], maxDistance);
+            }));
+        for (std::thread &worker : workers)
+            worker.join();
+    });
+
+    // a tenth of the objects move every frame; each move refits the boxes above it
+    double refit = timeKernel([&]() {
+        for (size_t i = 0; i < objectCount; i += 10)
+        {
+            transforms[i] = glm::translate(transforms[i], glm::vec3(0.1f, 0.0f, 0.0f));
+            bvh.Move(i, transforms[i]);
+        }
+    });
+    double rebuild = timeKernel([&]() { bvh.Rebuild(); });
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << std::left << std::setw(28) << "query" << std::right << std::setw(14) << "brute ms" << std::setw(14) << "bvh ms" << std::setw(10) << "speedup" << std::endl;
+    std::cout << std::left << std::setw(28) << "ray casts" << std::right << std::setw(14) << bruteRay << std::setw(14) << bvhRay << std::setw(10) << bruteRay / bvhRay << std::endl;
+    std::cout << std::left << std::setw(28) << "frustum queries" << std::right << std::setw(14) << bruteFrustumTime << std::setw(14) << bvhFrustumTime << std::setw(10) << bruteFrustumTime / bvhFrustumTime << std::endl;
+    std::cout << std::left << std::setw(28) << "sphere overlaps" << std::right << std::setw(14) << bruteOverlapTime << std::setw(14) << bvhOverlapTime << std::setw(10) << bruteOverlapTime / bvhOverlapTime << std::endl;
+    std::cout << queries << " queries each; " << threads << " threads cast " << threads * queries << " rays in " << parallelRay << " ms" << std::endl;
+    std::cout << "insert " << objectCount << " objects: " << insertTime << " ms, move " << (objectCount + 9) / 10
+              << ": " << refit << " ms, rebuild: " << rebuild << " ms" << std::endl;
+    if (mismatches)
+        std::cout << "ERROR::BENCHMARK:: " << mismatches << " queries differ from brute force" << std::endl;
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,121 @@
+// Times the ImageKernels SIMD paths against the scalar reference on a texture sized image.
+// usage: image_kernels_benchmark [image file] (defaults to a 2048x2048 noise image)
+#include <stb_image.h>
+
+#include <learnopengl/image_kernels.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock benchmark_clock;
+
+// best of a few runs, in milliseconds
+double timeKernel(const std::function<void()> &kernel, int runs = 7)
+{
+    double best = 1e30;
+    for (int i = 0; i < runs; i++)
+    {
+        benchmark_clock::time_point start = benchmark_clock::now();
+        kernel();
+        best = std::min(best, std::chrono::duration<double, std::milli>(benchmark_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    int width = 2048, height = 2048, channels = 3;
+    std::vector<unsigned char> rgb;
+    if (argc > 1)
+    {
+        unsigned char *data = stbi_load(argv[1], &width, &height, &channels, 3);
+        if (!data)
+        {
+            std::cout << "ERROR::BENCHMARK:: could not load " << argv[1] << std::endl;
+            return 1;
+        }
+        rgb.assign(data, data + (size_t)width * height * 3);
+        stbi_image_free(data);
+    }
+    else
+    {
+        rgb.resize((size_t)width * height * 3);
+        srand(1);
+        for (unsigned char &c : rgb)
+            c = (unsigned char)(rand() & 0xFF);
+    }
+    size_t count = (size_t)width * height;
+    std::vector<unsigned char> rgba(count * 4), scratch(count * 4), plane(count * 2);
+    ImageKernels::ExpandRGBToRGBA(rgb.data(), rgba.data(), count);
+    for (size_t i = 0; i < count; i++)
+        rgba[i * 4 + 3] = rgb[i * 3];
+    std::vector<unsigned char> premultiplied = rgba;
+    ImageKernels::PremultiplyAlpha(premultiplied.data(), count);
+    ImageLevel level;
+    level.width = width;
+    level.height = height;
+    level.pixels = rgba;
+
+    struct Kernel {
+        std::string name;
+        size_t bytes;
+        std::function<void()> run;
+    };
+    std::vector<Kernel> kernels = {
+        {"rgb -> rgba", count * 3, [&]() { ImageKernels::ExpandRGBToRGBA(rgb.data(), scratch.data(), count); }},
+        {"premultiply alpha", count * 4, [&]() { scratch = rgba; ImageKernels::PremultiplyAlpha(scratch.data(), count); }},
+        {"unpremultiply alpha", count * 4, [&]() { scratch = premultiplied; ImageKernels::UnpremultiplyAlpha(scratch.data(), count); }},
+        {"extract channel", count * 4, [&]() { ImageKernels::ExtractChannel(rgba.data(), 1, plane.data(), count); }},
+        {"pack rg", count * 4, [&]() { ImageKernels::PackRG(rgba.data(), plane.data(), count); }},
+        {"box downsample", count * 4, [&]() { ImageKernels::DownsampleBox(level, false); }},
+        {"box downsample srgb", count * 4, [&]() { ImageKernels::DownsampleBox(level, true); }},
+        {"kaiser downsample srgb", count * 4, [&]() { ImageKernels::DownsampleKaiser(level, true); }},
+        {"mip chain (box, srgb)", count * 3, [&]() {
+             MipSettings settings;
+             settings.srgb = true;
+             ImageKernels::BuildMipChain(rgb.data(), width, height, 3, settings);
+         }},
+        {"mip chain (kaiser, premul)", count * 4, [&]() {
+             MipSettings settings;
+             settings.filter = MipFilter::Kaiser;
+             settings.srgb = true;
+             settings.premultiplyAlpha = true;
+             ImageKernels::BuildMipChain(rgba.data(), width, height, 4, settings);
+         }},
+    };
+
+    std::vector<Isa> isas = {Isa::Scalar};
+    Isa detected = ImageKernels::Detected();
+    if (detected != Isa::Scalar)
+        isas.push_back(Isa::SSE41);
+    if (detected == Isa::AVX2)
+        isas.push_back(Isa::AVX2);
+
+    std::cout << "IMAGE_KERNELS:: " << width << "x" << height << ", best of 7 runs" << std::endl;
+    std::cout << std::left << std::setw(28) << "kernel";
+    for (Isa isa : isas)
+        std::cout << std::right << std::setw(27) << CpuFeatures::Name(isa);
+    std::cout << std::endl;
+    for (const Kernel &kernel : kernels)
+    {
+        std::cout << std::left << std::setw(28) << kernel.name << std::right << std::fixed << std::setprecision(2);
+        double scalar = 0.0;
+        for (Isa isa : isas)
+        {
+            ImageKernels::Active() = isa;
+            double ms = timeKernel(kernel.run);
+            if (isa == Isa::Scalar)
+                scalar = ms;
+            std::cout << std::setw(8) << ms << " ms" << std::setw(7) << scalar / ms << "x"
+                      << std::setw(7) << (int)(kernel.bytes / (1024.0 * 1024.0) / (ms / 1000.0)) << " MB/s";
+        }
+        std::cout << std::endl;
+    }
+    ImageKernels::Active() = detected;
+    return 0;
+}
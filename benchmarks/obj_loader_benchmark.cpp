@@ -0,0 +1,185 @@
+// Times ObjLoader (single threaded and on the shared pool) against Assimp and checks that both produce the same
+// triangles: per material, every triangle's corners (position, uv, normal) have to match to 1e-4.
+// usage: obj_loader_benchmark [file.obj ...] (defaults to the scene's models)
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/obj_loader.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock benchmark_clock;
+
+// same post processing as Model::importFlags
+static const unsigned int assimpFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+// best of a few runs, in milliseconds
+double timeLoad(const std::function<void()> &load, int runs = 5)
+{
+    double best = 1e30;
+    for (int i = 0; i < runs; i++)
+    {
+        benchmark_clock::time_point start = benchmark_clock::now();
+        load();
+        best = std::min(best, std::chrono::duration<double, std::milli>(benchmark_clock::now() - start).count());
+    }
+    return best;
+}
+
+// a triangle as quantized (position, uv, normal) corners, rotated so the smallest corner comes first
+// (keeps the winding, ignores where the triangulation started)
+typedef std::array<long, 8> QuantizedCorner;
+typedef std::array<QuantizedCorner, 3> QuantizedTriangle;
+
+QuantizedCorner quantize(const glm::vec3 &position, const glm::vec2 &uv, const glm::vec3 &normal)
+{
+    const float scale = 1e4f;
+    return QuantizedCorner{{std::lround(position.x * scale), std::lround(position.y * scale), std::lround(position.z * scale),
+                            std::lround(uv.x * scale), std::lround(uv.y * scale),
+                            std::lround(normal.x * 1e3f), std::lround(normal.y * 1e3f), std::lround(normal.z * 1e3f)}};
+}
+
+QuantizedTriangle canonical(QuantizedCorner a, QuantizedCorner b, QuantizedCorner c)
+{
+    if (b < a && b < c)
+        return QuantizedTriangle{{b, c, a}};
+    if (c < a && c < b)
+        return QuantizedTriangle{{c, a, b}};
+    return QuantizedTriangle{{a, b, c}};
+}
+
+typedef std::map<std::string, std::vector<QuantizedTriangle>> TrianglesByMaterial;
+
+void addTriangles(const MeshData &mesh, std::vector<QuantizedTriangle> &triangles)
+{
+    QuantizedCorner corners[3];
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            const Vertex &v = mesh.vertices[mesh.indices[i + k]];
+            corners[k] = quantize(v.Position, v.TexCoords, v.Normal);
+        }
+        triangles.push_back(canonical(corners[0], corners[1], corners[2]));
+    }
+}
+
+void addTriangles(const aiScene *scene, TrianglesByMaterial &byMaterial, size_t &vertices)
+{
+    for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+    {
+        const aiMesh *mesh = scene->mMeshes[m];
+        std::vector<QuantizedTriangle> &triangles = byMaterial[scene->mMaterials[mesh->mMaterialIndex]->GetName().C_Str()];
+        vertices += mesh->mNumVertices;
+        QuantizedCorner corners[3];
+        for (unsigned int f = 0; f < mesh->mNumFaces; f++)
+        {
+            if (mesh->mFaces[f].mNumIndices != 3)
+                continue;
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int i = mesh->mFaces[f].mIndices[k];
+                glm::vec3 position(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+                glm::vec2 uv(0.0f, 0.0f);
+                if (mesh->mTextureCoords[0])
+                    uv = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+                glm::vec3 normal(0.0f);
+                if (mesh->HasNormals())
+                    normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+                corners[k] = quantize(position, uv, normal);
+            }
+            triangles.push_back(canonical(corners[0], corners[1], corners[2]));
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++)
+        paths.push_back(argv[i]);
+    if (paths.empty())
+        for (const char *name : {"ammo_box/ammo_box.obj", "crates_and_barrels/crates_and_barrels.obj", "kv2/kv2.obj",
+                                 "oil_drums/oil_drums.obj", "reflector/reflector.obj", "watchtower/watchtower.obj"})
+            paths.push_back(FileSystem::getPath(std::string("resources/objects/") + name));
+
+    ThreadPool singleThread(0);
+    std::cout << "OBJ_LOADER:: best of 5 runs, " << ThreadPool::Shared().Size() << " pool threads" << std::endl;
+    std::cout << std::left << std::setw(26) << "file" << std::right << std::setw(9) << "MB" << std::setw(22) << "native 1 thread"
+              << std::setw(22) << "native pool" << std::setw(22) << "assimp" << std::setw(10) << "speedup"
+              << "  triangles identical" << std::endl;
+    bool allMatch = true;
+    for (const std::string &path : paths)
+    {
+        std::vector<MeshData> meshes;
+        std::vector<std::string> names;
+        ObjLoader::Stats stats;
+        if (!ObjLoader::Load(path, meshes, &names, &stats))
+        {
+            allMatch = false;
+            continue;
+        }
+        double mb = stats.bytes / (1024.0 * 1024.0);
+        double single = timeLoad([&]() {
+            std::vector<MeshData> result;
+            ObjLoader::Load(path, result, nullptr, nullptr, singleThread);
+        });
+        double pooled = timeLoad([&]() {
+            std::vector<MeshData> result;
+            ObjLoader::Load(path, result);
+        });
+        const aiScene *scene = nullptr;
+        Assimp::Importer importer;
+        double assimp = timeLoad([&]() {
+            importer.FreeScene();
+            scene = importer.ReadFile(path, assimpFlags);
+        }, 3);
+        if (!scene)
+        {
+            std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+            allMatch = false;
+            continue;
+        }
+
+        TrianglesByMaterial native, reference;
+        size_t nativeVertices = 0, referenceVertices = 0;
+        for (size_t m = 0; m < meshes.size(); m++)
+        {
+            addTriangles(meshes[m], native[names[m]]);
+            nativeVertices += meshes[m].vertices.size();
+        }
+        addTriangles(scene, reference, referenceVertices);
+        size_t total = 0, matched = 0;
+        for (auto &material : reference)
+        {
+            std::vector<QuantizedTriangle> &expected = material.second;
+            std::vector<QuantizedTriangle> &actual = native[material.first];
+            std::sort(expected.begin(), expected.end());
+            std::sort(actual.begin(), actual.end());
+            std::vector<QuantizedTriangle> common;
+            std::set_intersection(expected.begin(), expected.end(), actual.begin(), actual.end(), std::back_inserter(common));
+            total += std::max(expected.size(), actual.size());
+            matched += common.size();
+        }
+        allMatch = allMatch && matched == total;
+
+        std::string name = path.substr(path.find_last_of('/') + 1);
+        std::cout << std::left << std::setw(26) << name << std::right << std::fixed << std::setprecision(2) << std::setw(9) << mb;
+        for (double ms : {single, pooled, assimp})
+            std::cout << std::setw(9) << ms << " ms" << std::setw(6) << (int)(mb / (ms / 1000.0)) << " MB/s";
+        std::cout << std::setw(9) << assimp / pooled << "x  " << matched << "/" << total << " (" << nativeVertices
+                  << " vertices, assimp " << referenceVertices << ")" << std::endl;
+    }
+    return allMatch ? 0 : 1;
+}
@@ -0,0 +1,832 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+// an axis aligned box; empty (min > max) until something is added
+struct BVHBounds {
+    glm::vec3 boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+
+    BVHBounds() {}
+    BVHBounds(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) : boundsMin(boundsMin), boundsMax(boundsMax) {}
+
+    void Grow(const glm::vec3 &point)
+    {
+        boundsMin = glm::min(boundsMin, point);
+        boundsMax = glm::max(boundsMax, point);
+    }
+
+    void Grow(const BVHBounds &bounds)
+    {
+        boundsMin = glm::min(boundsMin, bounds.boundsMin);
+        boundsMax = glm::max(boundsMax, bounds.boundsMax);
+    }
+
+    bool Empty() const { return boundsMin.x > boundsMax.x; }
+    glm::vec3 Center() const { return (boundsMin + boundsMax) * 0.5f; }
+
+    // surface area, the cost measure of the surface area heuristic
+    float Area() const
+    {
+        if (Empty())
+            return 0.0f;
+        glm::vec3 d = boundsMax - boundsMin;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    bool operator==(const BVHBounds &other) const
+    {
+        return boundsMin == other.boundsMin && boundsMax == other.boundsMax;
+    }
+
+    // the box around this one placed with transform (Arvo)
+    BVHBounds Transformed(const glm::mat4 &transform) const
+    {
+        glm::vec3 center = glm::vec3(transform * glm::vec4(Center(), 1.0f));
+        glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+        glm::mat3 linear(transform);
+        glm::vec3 worldExtent(0.0f);
+        for (int column = 0; column < 3; column++)
+            worldExtent += glm::abs(linear[column]) * extent[column];
+        return BVHBounds(center - worldExtent, center + worldExtent);
+    }
+
+    // slab test; distance is where the ray enters the box, in units of the ray direction
+    bool Intersect(const glm::vec3 &origin, const glm::vec3 &inverseDirection, float maxDistance, float &distance) const
+    {
+        glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+        glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+        glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+        distance = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+        float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+        return distance <= exit;
+    }
+
+    float DistanceSquared(const glm::vec3 &point) const
+    {
+        glm::vec3 d = point - glm::clamp(point, boundsMin, boundsMax);
+        return glm::dot(d, d);
+    }
+
+    // whether the box lies entirely outside one of the frustum planes
+    bool Outside(const Frustum &frustum) const
+    {
+        glm::vec3 center = Center(), extent = (boundsMax - boundsMin) * 0.5f;
+        for (const glm::vec4 &plane : frustum.planes)
+        {
+            glm::vec3 normal(plane);
+            if (glm::dot(normal, center) + plane.w + glm::dot(glm::abs(normal), extent) < 0.0f)
+                return true;
+        }
+        return false;
+    }
+};
+
+// static BVH over the triangles of one mesh in object space, for ray casts and sphere overlaps against the
+// actual geometry. Built once with a binned surface area heuristic, on the loader thread for imported meshes
+// (see MeshData::buildTriangleBVH), and never changed afterwards, so any number of threads may query it.
+class TriangleBVH
+{
+public:
+    struct Node {
+        glm::vec3 boundsMin;
+        uint32_t first; // leaf: first triangle, inner node: left child (the right child follows it)
+        glm::vec3 boundsMax;
+        uint32_t count; // triangles of a leaf, 0 for inner nodes
+    };
+
+    // indices are triples into positions
+    TriangleBVH(const glm::vec3 *positions, const uint32_t *indices, size_t indexCount)
+    {
+        size_t count = indexCount / 3;
+        std::vector<BVHBounds> boxes(count);
+        std::vector<glm::vec3> centers(count);
+        std::vector<uint32_t> order(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            for (int k = 0; k < 3; k++)
+                boxes[i].Grow(positions[indices[i * 3 + k]]);
+            centers[i] = boxes[i].Center();
+            order[i] = (uint32_t)i;
+        }
+        build(boxes, centers, order);
+
+        // leaves reference contiguous triangles in the final order
+        vertices.resize(count * 3);
+        ids = order;
+        for (size_t i = 0; i < count; i++)
+            for (int k = 0; k < 3; k++)
+                vertices[i * 3 + k] = positions[indices[order[i] * 3 + k]];
+    }
+
+    // a BVH from the arrays of one built before (see MeshCacheFile), without running the build again;
+    // the nodes have to pass ValidNodes
+    TriangleBVH(const Node *nodes, size_t nodeCount, const glm::vec3 *vertices, const uint32_t *ids, size_t triangleCount)
+        : nodes(nodes, nodes + nodeCount), vertices(vertices, vertices + triangleCount * 3), ids(ids, ids + triangleCount)
+    {
+    }
+
+    // whether stored nodes form a tree the traversals can walk: every node reached once from the root, children
+    // after their parent, within the traversal depth, and leaves inside the triangle array
+    static bool ValidNodes(const Node *nodes, size_t nodeCount, size_t triangleCount)
+    {
+        if (nodeCount == 0)
+            return triangleCount == 0;
+        std::vector<int> depth(nodeCount, -1);
+        depth[0] = 0;
+        for (size_t i = 0; i < nodeCount; i++)
+        {
+            const Node &node = nodes[i];
+            if (depth[i] < 0)
+                return false;
+            if (node.count > 0)
+            {
+                if ((uint64_t)node.first + node.count > triangleCount)
+                    return false;
+                continue;
+            }
+            if (node.first <= i || (uint64_t)node.first + 1 >= nodeCount || depth[i] + 1 > MaxDepth / 2
+                || depth[node.first] >= 0 || depth[node.first + 1] >= 0)
+                return false;
+            depth[node.first] = depth[node.first + 1] = depth[i] + 1;
+        }
+        return true;
+    }
+
+    size_t TriangleCount() const { return ids.size(); }
+    size_t NodeCount() const { return nodes.size(); }
+
+    // the arrays the BVH is made of, for storing it
+    const Node *NodeData() const { return nodes.data(); }
+    const glm::vec3 *TriangleVertices() const { return vertices.data(); }
+    const uint32_t *TriangleIds() const { return ids.data(); }
+
+    BVHBounds Bounds() const
+    {
+        return nodes.empty() ? BVHBounds() : BVHBounds(nodes[0].boundsMin, nodes[0].boundsMax);
+    }
+
+    // closest hit along origin + t * direction for t in [0, distance); on a hit distance becomes its t and
+    // triangle the index of the hit triangle in the source index order
+    bool Raycast(const glm::vec3 &origin, const glm::vec3 &direction, float &distance, uint32_t &triangle) const
+    {
+        return traverse(origin, direction, distance, &triangle);
+    }
+
+    // whether anything lies along origin + t * direction for t in [0, maxDistance)
+    bool Intersects(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance) const
+    {
+        return traverse(origin, direction, maxDistance, nullptr);
+    }
+
+    // whether any triangle comes within radius of center
+    bool Overlaps(const glm::vec3 &center, float radius) const
+    {
+        if (nodes.empty())
+            return false;
+        float radius2 = radius * radius;
+        uint32_t stack[MaxDepth];
+        int size = 0;
+        stack[size++] = 0;
+        while (size > 0)
+        {
+            const Node &node = nodes[stack[--size]];
+            if (BVHBounds(node.boundsMin, node.boundsMax).DistanceSquared(center) > radius2)
+                continue;
+            if (node.count == 0)
+            {
+                stack[size++] = node.first;
+                stack[size++] = node.first + 1;
+                continue;
+            }
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                glm::vec3 d = center - ClosestPoint(center, vertices[i * 3], vertices[i * 3 + 1], vertices[i * 3 + 2]);
+                if (glm::dot(d, d) <= radius2)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    // Moeller-Trumbore, both sides of the triangle count
+    static bool IntersectTriangle(const glm::vec3 &origin, const glm::vec3 &direction,
+                                  const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, float &distance)
+    {
+        glm::vec3 ab = b - a, ac = c - a;
+        glm::vec3 p = glm::cross(direction, ac);
+        float determinant = glm::dot(ab, p);
+        if (std::fabs(determinant) < 1e-12f)
+            return false;
+        float inverse = 1.0f / determinant;
+        glm::vec3 s = origin - a;
+        float u = glm::dot(s, p) * inverse;
+        if (u < 0.0f || u > 1.0f)
+            return false;
+        glm::vec3 q = glm::cross(s, ab);
+        float v = glm::dot(direction, q) * inverse;
+        if (v < 0.0f || u + v > 1.0f)
+            return false;
+        distance = glm::dot(ac, q) * inverse;
+        return distance >= 0.0f;
+    }
+
+    // point of triangle abc closest to p (Ericson, Real-Time Collision Detection 5.1.5)
+    static glm::vec3 ClosestPoint(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+    {
+        glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+        float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+        if (d1 <= 0.0f && d2 <= 0.0f)
+            return a;
+        glm::vec3 bp = p - b;
+        float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+        if (d3 >= 0.0f && d4 <= d3)
+            return b;
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+            return a + ab * (d1 / (d1 - d3));
+        glm::vec3 cp = p - c;
+        float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+        if (d6 >= 0.0f && d5 <= d6)
+            return c;
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+            return a + ac * (d2 / (d2 - d6));
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+            return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        float denominator = 1.0f / (va + vb + vc);
+        return a + ab * (vb * denominator) + ac * (vc * denominator);
+    }
+
+private:
+    // deeper nodes become leaves, so the traversal stacks have a fixed size
+    static const int MaxDepth = 64;
+    static const uint32_t LeafSize = 4;
+    static const int Bins = 12;
+
+    std::vector<Node> nodes;
+    // three corners per triangle in leaf order, and the source index of each triangle
+    std::vector<glm::vec3> vertices;
+    std::vector<uint32_t> ids;
+
+    void build(const std::vector<BVHBounds> &boxes, const std::vector<glm::vec3> &centers, std::vector<uint32_t> &order)
+    {
+        if (order.empty())
+            return;
+        nodes.reserve(order.size() * 2);
+        nodes.push_back(Node{glm::vec3(0.0f), 0, glm::vec3(0.0f), (uint32_t)order.size()});
+        struct Pending {
+            uint32_t node;
+            int depth;
+        };
+        std::vector<Pending> pending(1, Pending{0, 0});
+        while (!pending.empty())
+        {
+            Pending current = pending.back();
+            pending.pop_back();
+            uint32_t first = nodes[current.node].first, count = nodes[current.node].count;
+            BVHBounds bounds, centerBounds;
+            for (uint32_t i = first; i < first + count; i++)
+            {
+                bounds.Grow(boxes[order[i]]);
+                centerBounds.Grow(centers[order[i]]);
+            }
+            nodes[current.node].boundsMin = bounds.boundsMin;
+            nodes[current.node].boundsMax = bounds.boundsMax;
+            if (count <= LeafSize || current.depth + 1 >= MaxDepth / 2)
+                continue;
+
+            // cheapest split between bins along any axis
+            int bestAxis = -1, bestSplit = 0;
+            float bestCost = count * bounds.Area();
+            for (int axis = 0; axis < 3; axis++)
+            {
+                float extent = centerBounds.boundsMax[axis] - centerBounds.boundsMin[axis];
+                if (extent <= 0.0f)
+                    continue;
+                BVHBounds binBounds[Bins];
+                uint32_t binCounts[Bins] = {0};
+                for (uint32_t i = first; i < first + count; i++)
+                {
+                    int bin = binOf(centers[order[i]][axis], centerBounds.boundsMin[axis], extent);
+                    binBounds[bin].Grow(boxes[order[i]]);
+                    binCounts[bin]++;
+                }
+                float rightArea[Bins];
+                uint32_t rightCount[Bins];
+                BVHBounds right;
+                uint32_t rightSum = 0;
+                for (int bin = Bins - 1; bin > 0; bin--)
+                {
+                    right.Grow(binBounds[bin]);
+                    rightSum += binCounts[bin];
+                    rightArea[bin] = right.Area();
+                    rightCount[bin] = rightSum;
+                }
+                BVHBounds left;
+                uint32_t leftSum = 0;
+                for (int split = 1; split < Bins; split++)
+                {
+                    left.Grow(binBounds[split - 1]);
+                    leftSum += binCounts[split - 1];
+                    float cost = leftSum * left.Area() + rightCount[split] * rightArea[split];
+                    if (leftSum > 0 && rightCount[split] > 0 && cost < bestCost)
+                    {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = split;
+                    }
+                }
+            }
+            if (bestAxis < 0)
+                continue;
+
+            float axisMin = centerBounds.boundsMin[bestAxis];
+            float extent = centerBounds.boundsMax[bestAxis] - axisMin;
+            uint32_t *middle = std::partition(order.data() + first, order.data() + first + count, [&](uint32_t i) {
+                return binOf(centers[i][bestAxis], axisMin, extent) < bestSplit;
+            });
+            uint32_t leftCount = (uint32_t)(middle - (order.data() + first));
+            uint32_t child = (uint32_t)nodes.size();
+            nodes.push_back(Node{glm::vec3(0.0f), first, glm::vec3(0.0f), leftCount});
+            nodes.push_back(Node{glm::vec3(0.0f), first + leftCount, glm::vec3(0.0f), count - leftCount});
+            nodes[current.node].first = child;
+            nodes[current.node].count = 0;
+            pending.push_back(Pending{child, current.depth + 1});
+            pending.push_back(Pending{child + 1, current.depth + 1});
+        }
+    }
+
+    static int binOf(float value, float axisMin, float extent)
+    {
+        int bin = (int)((value - axisMin) * (Bins / extent));
+        return std::min(std::max(bin, 0), Bins - 1);
+    }
+
+    // closest hit if triangle is set, any hit otherwise
+    bool traverse(const glm::vec3 &origin, const glm::vec3 &direction, float &distance, uint32_t *triangle) const
+    {
+        if (nodes.empty())
+            return false;
+        glm::vec3 inverseDirection = 1.0f / direction;
+        bool hit = false;
+        uint32_t stack[MaxDepth];
+        int size = 0;
+        stack[size++] = 0;
+        while (size > 0)
+        {
+            const Node &node = nodes[stack[--size]];
+            float entry;
+            if (!BVHBounds(node.boundsMin, node.boundsMax).Intersect(origin, inverseDirection, distance, entry))
+                continue;
+            if (node.count == 0)
+            {
+                // nearer child on top
+                const Node &left = nodes[node.first], &right = nodes[node.first + 1];
+                float leftEntry, rightEntry;
+                bool hitLeft = BVHBounds(left.boundsMin, left.boundsMax).Intersect(origin, inverseDirection, distance, leftEntry);
+                bool hitRight = BVHBounds(right.boundsMin, right.boundsMax).Intersect(origin, inverseDirection, distance, rightEntry);
+                if (hitLeft && hitRight)
+                {
+                    bool leftFirst = leftEntry <= rightEntry;
+                    stack[size++] = leftFirst ? node.first + 1 : node.first;
+                    stack[size++] = leftFirst ? node.first : node.first + 1;
+                }
+                else if (hitLeft)
+                    stack[size++] = node.first;
+                else if (hitRight)
+                    stack[size++] = node.first + 1;
+                continue;
+            }
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                float t;
+                if (!IntersectTriangle(origin, direction, vertices[i * 3], vertices[i * 3 + 1], vertices[i * 3 + 2], t) || t >= distance)
+                    continue;
+                if (!triangle)
+                    return true;
+                distance = t;
+                *triangle = ids[i];
+                hit = true;
+            }
+        }
+        return hit;
+    }
+};
+
+// dynamic two level BVH over the objects of a scene: the top level holds one world space box per object and
+// is updated incrementally (inserts descend to the cheapest sibling, moves refit the boxes above the object),
+// the bottom level is the TriangleBVH of each of the object's meshes, queried in object space.
+// Every query takes a shared lock and may run on any thread; Insert, Remove, Move and Rebuild take an
+// exclusive one.
+class SceneBVH
+{
+public:
+    enum : size_t { None = ~(size_t)0 };
+
+    struct Hit {
+        size_t object = None;
+        size_t mesh = 0;
+        uint32_t triangle = 0;
+        float distance = 0.0f;
+    };
+
+    struct Stats {
+        size_t objects = 0;
+        size_t nodes = 0;
+        size_t depth = 0;
+    };
+
+    // adds object (an id chosen by the caller, e.g. its index in Scene::objects) or replaces its meshes
+    void Insert(size_t object, const std::vector<std::shared_ptr<const TriangleBVH>> &meshes, const glm::mat4 &transform)
+    {
+        std::unique_lock<std::shared_timed_mutex> lock(mutex);
+        if (object >= objects.size())
+            objects.resize(object + 1);
+        Object &entry = objects[object];
+        if (entry.leaf >= 0)
+            removeLeaf(entry.leaf);
+        entry.meshes = meshes;
+        entry.localBounds = BVHBounds();
+        for (const std::shared_ptr<const TriangleBVH> &mesh : meshes)
+            if (mesh)
+                entry.localBounds.Grow(mesh->Bounds());
+        place(entry, transform);
+        entry.leaf = allocateNode();
+        nodes[entry.leaf].bounds = entry.bounds;
+        nodes[entry.leaf].object = object;
+        insertLeaf(entry.leaf);
+    }
+
+    void Remove(size_t object)
+    {
+        std::unique_lock<std::shared_timed_mutex> lock(mutex);
+        if (object >= objects.size() || objects[object].leaf < 0)
+            return;
+        removeLeaf(objects[object].leaf);
+        objects[object] = Object();
+    }
+
+    // moves object to transform: its box is replaced and the boxes above it are refit, the tree keeps its shape
+    void Move(size_t object, const glm::mat4 &transform)
+    {
+        std::unique_lock<std::shared_timed_mutex> lock(mutex);
+        if (object >= objects.size() || objects[object].leaf < 0)
+            return;
+        Object &entry = objects[object];
+        place(entry, transform);
+        nodes[entry.leaf].bounds = entry.bounds;
+        refit(nodes[entry.leaf].parent);
+    }
+
+    // builds the top level again from scratch (median splits), for when moves have left the refit tree loose
+    void Rebuild()
+    {
+        std::unique_lock<std::shared_timed_mutex> lock(mutex);
+        std::vector<size_t> placed;
+        for (size_t i = 0; i < objects.size(); i++)
+            if (objects[i].leaf >= 0)
+                placed.push_back(i);
+        nodes.clear();
+        freeNodes.clear();
+        root = placed.empty() ? -1 : build(placed, 0, placed.size(), -1);
+    }
+
+    bool Contains(size_t object) const
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(mutex);
+        return object < objects.size() && objects[object].leaf >= 0;
+    }
+
+    // world space box of object, empty if it is not in the tree
+    BVHBounds Bounds(size_t object) const
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(mutex);
+        return object < objects.size() && objects[object].leaf >= 0 ? objects[object].bounds : BVHBounds();
+    }
+
+    Stats Statistics() const
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(mutex);
+        Stats stats;
+        stats.nodes = nodes.size() - freeNodes.size();
+        for (const Object &object : objects)
+            stats.objects += object.leaf >= 0;
+        std::vector<std::pair<int, size_t>> stack;
+        if (root >= 0)
+            stack.push_back(std::make_pair(root, (size_t)1));
+        while (!stack.empty())
+        {
+            std::pair<int, size_t> node = stack.back();
+            stack.pop_back();
+            stats.depth = std::max(stats.depth, node.second);
+            if (!nodes[node.first].Leaf())
+            {
+                stack.push_back(std::make_pair(nodes[node.first].left, node.second + 1));
+                stack.push_back(std::make_pair(nodes[node.first].right, node.second + 1));
+            }
+        }
+        return stats;
+    }
+
+    // objects whose box may intersect the frustum
+    void Query(const Frustum &frustum, std::vector<size_t> &result) const
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(mutex);
+        result.clear();
+        std::vector<int> stack;
+        if (root >= 0)
+            stack.push_back(root);
+        while (!stack.empty())
+        {
+            const Node &node = nodes[stack.back()];
+            stack.pop_back();
+            if (node.bounds.Outside(frustum))
+                continue;
+            if (node.Leaf())
+                result.push_back(node.object);
+            else
+            {
+                stack.push_back(node.left);
+                stack.push_back(node.right);
+            }
+        }
+    }
+
+    // objects with a triangle within radius of center. The sphere is taken into object space with the largest
+    // scale of the inverse transform, which is exact for uniformly scaled objects and conservative otherwise.
+    void Overlap(const glm::vec3 &center, float radius, std::vector<size_t> &result) const
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(mutex);
+        result.clear();
+        std::vector<int> stack;
+        if (root >= 0)
+            stack.push_back(root);
+        while (!stack.empty())
+        {
+            const Node &node = nodes[stack.back()];
+            stack.pop_back();
+            if (node.bounds.DistanceSquared(center) > radius * radius)
+                continue;
+            if (!node.Leaf())
+            {
+                stack.push_back(node.left);
+                stack.push_back(node.right);
+                continue;
+            }
+            const Object &object = objects[node.object];
+            glm::vec3 localCenter = glm::vec3(object.inverse * glm::vec4(center, 1.0f));
+            for (const std::shared_ptr<const TriangleBVH> &mesh : object.meshes)
+                if (mesh && mesh->Overlaps(localCenter, radius * object.inverseScale))
+                {
+                    result.push_back(node.object);
+                    break;
+                }
+        }
+    }
+
+    // closest triangle along origin + t * direction for t in [0, maxDistance); hit.object is None on a miss
+    Hit Raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance) const
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(mutex);
+        Hit hit;
+        hit.distance = maxDistance;
+        traverse(origin, direction, hit, None, None, false);
+        return hit;
+    }
+
+    // whether the segment from -> to is free of triangles, not counting those of the objects ignored
+    // (usually the two objects looking at each other)
+    bool LineOfSight(const glm::vec3 &from, const glm::vec3 &to, size_t ignore = None, size_t ignoreToo = None) const
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(mutex);
+        Hit hit;
+        hit.distance = 1.0f;
+        return !traverse(from, to - from, hit, ignore, ignoreToo, true);
+    }
+
+private:
+    struct Node {
+        BVHBounds bounds;
+        int parent = -1;
+        int left = -1, right = -1;
+        size_t object = None;
+
+        bool Leaf() const { return left < 0; }
+    };
+
+    struct Object {
+        std::vector<std::shared_ptr<const TriangleBVH>> meshes;
+        BVHBounds localBounds;
+        BVHBounds bounds;
+        glm::mat4 inverse = glm::mat4(1.0f);
+        float inverseScale = 1.0f;
+        int leaf = -1;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int> freeNodes;
+    int root = -1;
+    std::vector<Object> objects;
+    mutable std::shared_timed_mutex mutex;
+
+    static void place(Object &object, const glm::mat4 &transform)
+    {
+        object.bounds = object.localBounds.Transformed(transform);
+        object.inverse = glm::inverse(transform);
+        glm::mat3 linear(object.inverse);
+        object.inverseScale = std::max(glm::length(linear[0]), std::max(glm::length(linear[1]), glm::length(linear[2])));
+    }
+
+    int allocateNode()
+    {
+        if (!freeNodes.empty())
+        {
+            int node = freeNodes.back();
+            freeNodes.pop_back();
+            nodes[node] = Node();
+            return node;
+        }
+        nodes.push_back(Node());
+        return (int)nodes.size() - 1;
+    }
+
+    // refits the boxes from node up to the root, stopping where a box does not change
+    void refit(int node)
+    {
+        while (node >= 0)
+        {
+            BVHBounds bounds = nodes[nodes[node].left].bounds;
+            bounds.Grow(nodes[nodes[node].right].bounds);
+            if (bounds == nodes[node].bounds)
+                return;
+            nodes[node].bounds = bounds;
+            node = nodes[node].parent;
+        }
+    }
+
+    // pairs leaf with the sibling that grows the total box area least (Box2D's dynamic tree heuristic)
+    void insertLeaf(int leaf)
+    {
+        if (root < 0)
+        {
+            root = leaf;
+            nodes[leaf].parent = -1;
+            return;
+        }
+        BVHBounds bounds = nodes[leaf].bounds;
+        int sibling = root;
+        while (!nodes[sibling].Leaf())
+        {
+            BVHBounds combined = nodes[sibling].bounds;
+            combined.Grow(bounds);
+            float cost = 2.0f * combined.Area();
+            float inherited = 2.0f * (combined.Area() - nodes[sibling].bounds.Area());
+            float childCost[2];
+            int children[2] = {nodes[sibling].left, nodes[sibling].right};
+            for (int i = 0; i < 2; i++)
+            {
+                BVHBounds grown = nodes[children[i]].bounds;
+                grown.Grow(bounds);
+                childCost[i] = grown.Area() + inherited - (nodes[children[i]].Leaf() ? 0.0f : nodes[children[i]].bounds.Area());
+            }
+            if (cost < childCost[0] && cost < childCost[1])
+                break;
+            sibling = childCost[0] < childCost[1] ? children[0] : children[1];
+        }
+
+        int oldParent = nodes[sibling].parent;
+        int parent = allocateNode();
+        nodes[parent].parent = oldParent;
+        nodes[parent].left = sibling;
+        nodes[parent].right = leaf;
+        nodes[parent].bounds = nodes[sibling].bounds;
+        nodes[parent].bounds.Grow(bounds);
+        nodes[sibling].parent = parent;
+        nodes[leaf].parent = parent;
+        if (oldParent < 0)
+            root = parent;
+        else
+        {
+            (nodes[oldParent].left == sibling ? nodes[oldParent].left : nodes[oldParent].right) = parent;
+            refit(oldParent);
+        }
+    }
+
+    // unlinks and frees leaf; its sibling takes the place of their parent
+    void removeLeaf(int leaf)
+    {
+        if (leaf == root)
+            root = -1;
+        else
+        {
+            int parent = nodes[leaf].parent;
+            int grandParent = nodes[parent].parent;
+            int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+            nodes[sibling].parent = grandParent;
+            if (grandParent < 0)
+                root = sibling;
+            else
+            {
+                (nodes[grandParent].left == parent ? nodes[grandParent].left : nodes[grandParent].right) = sibling;
+                refit(grandParent);
+            }
+            freeNodes.push_back(parent);
+        }
+        freeNodes.push_back(leaf);
+    }
+
+    int build(std::vector<size_t> &placed, size_t first, size_t last, int parent)
+    {
+        int node = allocateNode();
+        nodes[node].parent = parent;
+        if (last - first == 1)
+        {
+            nodes[node].bounds = objects[placed[first]].bounds;
+            nodes[node].object = placed[first];
+            objects[placed[first]].leaf = node;
+            return node;
+        }
+        BVHBounds centers;
+        for (size_t i = first; i < last; i++)
+            centers.Grow(objects[placed[i]].bounds.Center());
+        glm::vec3 extent = centers.boundsMax - centers.boundsMin;
+        int axis = extent.x > extent.y && extent.x > extent.z ? 0 : extent.y > extent.z ? 1 : 2;
+        size_t middle = (first + last) / 2;
+        std::nth_element(placed.begin() + first, placed.begin() + middle, placed.begin() + last, [&](size_t a, size_t b) {
+            return objects[a].bounds.Center()[axis] < objects[b].bounds.Center()[axis];
+        });
+        int left = build(placed, first, middle, node);
+        int right = build(placed, middle, last, node);
+        nodes[node].left = left;
+        nodes[node].right = right;
+        nodes[node].bounds = nodes[left].bounds;
+        nodes[node].bounds.Grow(nodes[right].bounds);
+        return node;
+    }
+
+    // closest hit into hit, or any hit if anyHit; objects ignore and ignoreToo are skipped
+    bool traverse(const glm::vec3 &origin, const glm::vec3 &direction, Hit &hit, size_t ignore, size_t ignoreToo, bool anyHit) const
+    {
+        glm::vec3 inverseDirection = 1.0f / direction;
+        std::vector<int> stack;
+        if (root >= 0)
+            stack.push_back(root);
+        bool found = false;
+        while (!stack.empty())
+        {
+            const Node &node = nodes[stack.back()];
+            stack.pop_back();
+            float entry;
+            if (!node.bounds.Intersect(origin, inverseDirection, hit.distance, entry))
+                continue;
+            if (!node.Leaf())
+            {
+                stack.push_back(node.left);
+                stack.push_back(node.right);
+                continue;
+            }
+            if (node.object == ignore || node.object == ignoreToo)
+                continue;
+            // t is the same along the object space ray, the transform being linear
+            const Object &object = objects[node.object];
+            glm::vec3 localOrigin = glm::vec3(object.inverse * glm::vec4(origin, 1.0f));
+            glm::vec3 localDirection = glm::mat3(object.inverse) * direction;
+            for (size_t i = 0; i < object.meshes.size(); i++)
+            {
+                if (!object.meshes[i])
+                    continue;
+                if (anyHit)
+                {
+                    if (object.meshes[i]->Intersects(localOrigin, localDirection, hit.distance))
+                        return true;
+                    continue;
+                }
+                uint32_t triangle;
+                if (object.meshes[i]->Raycast(localOrigin, localDirection, hit.distance, triangle))
+                {
+                    hit.object = node.object;
+                    hit.mesh = i;
+                    hit.triangle = triangle;
+                    found = true;
+                }
+            }
+        }
+        return found;
+    }
+};
+#endif
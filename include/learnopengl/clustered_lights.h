@@ -0,0 +1,304 @@
+#ifndef CLUSTERED_LIGHTS_H
+#define CLUSTERED_LIGHTS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/light_manager.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Clustered forward shading: the view frustum is split into TilesX x TilesY screen tiles and Slices depth
+// slices (exponentially spaced, so clusters stay roughly cube shaped), and every frame each point and spot
+// light is binned into the clusters its range reaches (LightRange in light_manager.h). The forward lighting
+// shader built with CLUSTERED (resources/shaders/clusters.glsl) then finds its fragment's cluster and only
+// evaluates the lights listed there, all of them, not just the ones the Lights block holds.
+// Binning runs on the thread pool, one depth slice per job, against the view space boxes of the clusters.
+// The lists live in three buffer textures, as GL 3.3 has no shader storage buffers:
+//  - the grid: first index and count per cluster (RG32UI),
+//  - the light indices of all clusters one after the other (R32UI),
+//  - the lights: LightTexels RGBA32F texels each, laid out like SpotLight in lights.glsl; point lights have
+//    0 in the w of their position, spot lights 1.
+// Only perspective projections are supported. Bin is CPU only; Upload and Bind need the GL thread.
+class ClusteredLights
+{
+public:
+    enum { TilesX = 16, TilesY = 9, Slices = 24, ClusterCount = TilesX * TilesY * Slices };
+    enum { LightTexels = 7 };
+    // texture units of the grid, the indices and the lights, above the ones the materials use
+    enum { GridUnit = 4, IndexUnit = 5, LightUnit = 6 };
+
+    struct Stats {
+        size_t lights = 0;
+        // light entries over all clusters and in the fullest one
+        size_t references = 0;
+        size_t busiestCluster = 0;
+        double binMs = 0.0;
+    };
+
+    explicit ClusteredLights(ThreadPool &pool = ThreadPool::Shared()) : pool(pool), slices(Slices), grid(ClusterCount * 2, 0) {}
+
+    ClusteredLights(const ClusteredLights &) = delete;
+    ClusteredLights &operator=(const ClusteredLights &) = delete;
+
+    // points the samplers of a program built with CLUSTERED at the units Bind uses
+    static void Attach(Shader &shader)
+    {
+        shader.use();
+        shader.setInt("clusterGrid", GridUnit);
+        shader.setInt("clusterLightIndices", IndexUnit);
+        shader.setInt("clusterLightData", LightUnit);
+    }
+
+    // bins every light of lights into the clusters of the frustum of view and projection
+    void Bin(const LightManager &lights, const glm::mat4 &view, const glm::mat4 &projection)
+    {
+        auto start = std::chrono::steady_clock::now();
+        if (revision != lights.Revision())
+            buildLights(lights);
+        if (projection != clusterProjection)
+            buildClusters(projection);
+
+        viewSpheres.resize(spheres.size());
+        for (size_t i = 0; i < spheres.size(); i++)
+            viewSpheres[i] = glm::vec4(glm::vec3(view * glm::vec4(glm::vec3(spheres[i]), 1.0f)), spheres[i].w);
+        pool.ParallelFor(Slices, [this](size_t slice) { binSlice((int)slice); });
+
+        // the slices' lists one after the other
+        indices.clear();
+        stats.busiestCluster = 0;
+        for (int slice = 0; slice < Slices; slice++)
+        {
+            const SliceBins &bins = slices[slice];
+            uint32_t base = (uint32_t)indices.size();
+            for (int tile = 0; tile < TilesX * TilesY; tile++)
+            {
+                size_t cluster = (size_t)slice * TilesX * TilesY + tile;
+                grid[cluster * 2] = base + bins.ranges[tile * 2];
+                grid[cluster * 2 + 1] = bins.ranges[tile * 2 + 1];
+                stats.busiestCluster = std::max<size_t>(stats.busiestCluster, bins.ranges[tile * 2 + 1]);
+            }
+            indices.insert(indices.end(), bins.indices.begin(), bins.indices.end());
+        }
+        stats.lights = spheres.size();
+        stats.references = indices.size();
+        stats.binMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // sends the lists of the last Bin (and the lights if they changed) to the buffer textures
+    void Upload()
+    {
+        if (!buffers[0])
+            create();
+        if (lightsDirty)
+        {
+            upload(buffers[LightBuffer], lightData.data(), lightData.size() * sizeof(float), GL_STATIC_DRAW);
+            lightsDirty = false;
+        }
+        upload(buffers[GridBuffer], grid.data(), grid.size() * sizeof(uint32_t), GL_STREAM_DRAW);
+        upload(buffers[IndexBuffer], indices.data(), indices.size() * sizeof(uint32_t), GL_STREAM_DRAW);
+    }
+
+    // binds the buffer textures to GridUnit, IndexUnit and LightUnit
+    void Bind()
+    {
+        GLState &state = GLState::Shared();
+        state.BindTexture(GridUnit, GL_TEXTURE_BUFFER, textures[GridBuffer]);
+        state.BindTexture(IndexUnit, GL_TEXTURE_BUFFER, textures[IndexBuffer]);
+        state.BindTexture(LightUnit, GL_TEXTURE_BUFFER, textures[LightBuffer]);
+    }
+
+    // first index into Indices and number of lights of cluster (slice * TilesY + tileY) * TilesX + tileX
+    uint32_t First(size_t cluster) const { return grid[cluster * 2]; }
+    uint32_t Count(size_t cluster) const { return grid[cluster * 2 + 1]; }
+    // indices of the lights in the order of LightManager: point lights first, then spot lights
+    const std::vector<uint32_t> &Indices() const { return indices; }
+
+    const Stats &LastFrame() const { return stats; }
+
+    // frees the GL objects; has to run while the context is still current
+    void Delete()
+    {
+        if (!buffers[0])
+            return;
+        GLState::Shared().DeleteTextures(BufferCount, textures);
+        glDeleteBuffers(BufferCount, buffers);
+        for (int i = 0; i < BufferCount; i++)
+            textures[i] = buffers[i] = 0;
+        lightsDirty = true;
+    }
+
+private:
+    enum { GridBuffer, IndexBuffer, LightBuffer, BufferCount };
+
+    // what the job of one depth slice bins
+    struct SliceBins {
+        // lights reaching into the slice
+        std::vector<uint32_t> candidates;
+        // first index into indices and count per tile
+        uint32_t ranges[TilesX * TilesY * 2];
+        std::vector<uint32_t> indices;
+    };
+
+    ThreadPool &pool;
+    // world space bounding sphere per light (w: radius), and in view space for this frame
+    std::vector<glm::vec4> spheres, viewSpheres;
+    std::vector<float> lightData;
+    size_t revision = ~(size_t)0;
+    bool lightsDirty = true;
+    // view space box per cluster and the depths of the slices' boundaries, for clusterProjection
+    std::vector<glm::vec3> boxMin, boxMax;
+    float sliceDepths[Slices + 1];
+    glm::mat4 clusterProjection = glm::mat4(0.0f);
+    std::vector<SliceBins> slices;
+    std::vector<uint32_t> grid, indices;
+    unsigned int buffers[BufferCount] = {0, 0, 0};
+    unsigned int textures[BufferCount] = {0, 0, 0};
+    Stats stats;
+
+    void buildLights(const LightManager &lights)
+    {
+        spheres.clear();
+        lightData.clear();
+        for (const PointLight &light : lights.PointLights())
+        {
+            spheres.push_back(glm::vec4(light.position, light.Range()));
+            const glm::vec4 texels[LightTexels] = {
+                glm::vec4(light.position, 0.0f), glm::vec4(0.0f), glm::vec4(light.ambient, 0.0f), glm::vec4(light.diffuse, 0.0f),
+                glm::vec4(light.specular, 0.0f), glm::vec4(light.constant, light.linear, light.quadratic, 0.0f), glm::vec4(0.0f)};
+            appendTexels(texels);
+        }
+        for (const SpotLight &light : lights.SpotLights())
+        {
+            spheres.push_back(coneBounds(light));
+            const glm::vec4 texels[LightTexels] = {
+                glm::vec4(light.position, 1.0f), glm::vec4(light.direction, 0.0f), glm::vec4(light.ambient, 0.0f),
+                glm::vec4(light.diffuse, 0.0f), glm::vec4(light.specular, 0.0f),
+                glm::vec4(light.constant, light.linear, light.quadratic, 0.0f), glm::vec4(light.cutOff, light.outerCutOff, 0.0f, 0.0f)};
+            appendTexels(texels);
+        }
+        revision = lights.Revision();
+        lightsDirty = true;
+    }
+
+    void appendTexels(const glm::vec4 (&texels)[LightTexels])
+    {
+        for (const glm::vec4 &texel : texels)
+            for (int i = 0; i < 4; i++)
+                lightData.push_back(texel[i]);
+    }
+
+    // smallest sphere around the part of the range sphere inside the outer cone
+    static glm::vec4 coneBounds(const SpotLight &light)
+    {
+        float range = light.Range();
+        float cosine = light.outerCutOff;
+        if (cosine <= 0.0f || std::isinf(range))
+            return glm::vec4(light.position, range);
+        glm::vec3 axis = glm::normalize(light.direction);
+        // narrow cones: the sphere through the apex and the rim; wide ones: the rim's circle
+        if (cosine > 0.70710678f)
+        {
+            float radius = range / (2.0f * cosine);
+            return glm::vec4(light.position + axis * radius, radius);
+        }
+        return glm::vec4(light.position + axis * (range * cosine), range * std::sqrt(1.0f - cosine * cosine));
+    }
+
+    // view space boxes of the clusters: the tiles' corner rays between the depths of their slice
+    void buildClusters(const glm::mat4 &projection)
+    {
+        // near and far plane of a GL perspective projection
+        float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+        float farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+        for (int slice = 0; slice <= Slices; slice++)
+            sliceDepths[slice] = nearPlane * std::pow(farPlane / nearPlane, (float)slice / Slices);
+
+        boxMin.resize(ClusterCount);
+        boxMax.resize(ClusterCount);
+        for (int slice = 0; slice < Slices; slice++)
+            for (int y = 0; y < TilesY; y++)
+                for (int x = 0; x < TilesX; x++)
+                {
+                    size_t cluster = ((size_t)slice * TilesY + y) * TilesX + x;
+                    boxMin[cluster] = glm::vec3(std::numeric_limits<float>::max());
+                    boxMax[cluster] = glm::vec3(-std::numeric_limits<float>::max());
+                    for (int corner = 0; corner < 8; corner++)
+                    {
+                        // x_ndc = (P00 x - P20 depth) / depth at view space z = -depth
+                        float ndcX = -1.0f + 2.0f * (x + (corner & 1)) / TilesX;
+                        float ndcY = -1.0f + 2.0f * (y + ((corner >> 1) & 1)) / TilesY;
+                        float depth = sliceDepths[slice + (corner >> 2)];
+                        glm::vec3 point((ndcX + projection[2][0]) * depth / projection[0][0],
+                                        (ndcY + projection[2][1]) * depth / projection[1][1], -depth);
+                        boxMin[cluster] = glm::min(boxMin[cluster], point);
+                        boxMax[cluster] = glm::max(boxMax[cluster], point);
+                    }
+                }
+        clusterProjection = projection;
+    }
+
+    // runs on the pool: the lights of every cluster of one slice, cluster by cluster
+    void binSlice(int slice)
+    {
+        SliceBins &bins = slices[slice];
+        bins.candidates.clear();
+        bins.indices.clear();
+        for (size_t i = 0; i < viewSpheres.size(); i++)
+        {
+            float depth = -viewSpheres[i].z, radius = viewSpheres[i].w;
+            if (radius > 0.0f && depth + radius >= sliceDepths[slice] && depth - radius <= sliceDepths[slice + 1])
+                bins.candidates.push_back((uint32_t)i);
+        }
+        for (int tile = 0; tile < TilesX * TilesY; tile++)
+        {
+            size_t cluster = (size_t)slice * TilesX * TilesY + tile;
+            uint32_t first = (uint32_t)bins.indices.size();
+            for (uint32_t light : bins.candidates)
+            {
+                // squared distance from the sphere's center to the box
+                glm::vec3 center(viewSpheres[light]);
+                glm::vec3 offset = center - glm::clamp(center, boxMin[cluster], boxMax[cluster]);
+                if (glm::dot(offset, offset) <= viewSpheres[light].w * viewSpheres[light].w)
+                    bins.indices.push_back(light);
+            }
+            bins.ranges[tile * 2] = first;
+            bins.ranges[tile * 2 + 1] = (uint32_t)bins.indices.size() - first;
+        }
+    }
+
+    void create()
+    {
+        const GLenum formats[BufferCount] = {GL_RG32UI, GL_R32UI, GL_RGBA32F};
+        glGenBuffers(BufferCount, buffers);
+        glGenTextures(BufferCount, textures);
+        for (int i = 0; i < BufferCount; i++)
+        {
+            // buffer textures need a data store to attach
+            upload(buffers[i], nullptr, 16, GL_STREAM_DRAW);
+            GLState::Shared().BindTexture(GridUnit + i, GL_TEXTURE_BUFFER, textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+        }
+    }
+
+    // replaces the buffer's data store, so the GPU can keep reading the last one
+    static void upload(unsigned int buffer, const void *data, size_t size, GLenum usage)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, (GLsizeiptr)std::max<size_t>(size, 16), nullptr, usage);
+        if (size > 0)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, (GLsizeiptr)size, data);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+};
+#endif
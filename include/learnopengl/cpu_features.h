@@ -0,0 +1,66 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+#include <initializer_list>
+
+// The SIMD variants of ImageKernels, FrustumCuller and OcclusionCuller are compiled with target attributes, so
+// the rest of the program does not need -mavx2; which one runs is decided once at startup from the CPU.
+// Other compilers and architectures only get the scalar kernels.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_X86 1
+#include <immintrin.h>
+#define CPU_SSE2 __attribute__((target("sse2")))
+#define CPU_SSE41 __attribute__((target("sse4.1")))
+#define CPU_AVX __attribute__((target("avx")))
+#define CPU_AVX2 __attribute__((target("avx2")))
+#else
+#define CPU_X86 0
+#endif
+
+// instruction sets kernels have variants for, each one implying the ones before it
+enum class Isa { Scalar, SSE2, SSE41, AVX, AVX2 };
+
+class CpuFeatures
+{
+public:
+    static bool Supports(Isa isa)
+    {
+#if CPU_X86
+        __builtin_cpu_init();
+        switch (isa)
+        {
+        case Isa::Scalar: return true;
+        case Isa::SSE2:   return __builtin_cpu_supports("sse2");
+        case Isa::SSE41:  return __builtin_cpu_supports("sse4.1");
+        case Isa::AVX:    return __builtin_cpu_supports("avx");
+        case Isa::AVX2:   return __builtin_cpu_supports("avx2");
+        }
+        return false;
+#else
+        return isa == Isa::Scalar;
+#endif
+    }
+
+    // the best of a kernel family's variants the CPU supports, Scalar if none
+    static Isa Best(std::initializer_list<Isa> variants)
+    {
+        Isa best = Isa::Scalar;
+        for (Isa isa : variants)
+            if ((int)isa > (int)best && Supports(isa))
+                best = isa;
+        return best;
+    }
+
+    static const char *Name(Isa isa)
+    {
+        switch (isa)
+        {
+        case Isa::SSE2:  return "SSE2";
+        case Isa::SSE41: return "SSE4.1";
+        case Isa::AVX:   return "AVX";
+        case Isa::AVX2:  return "AVX2";
+        default:         return "scalar";
+        }
+    }
+};
+#endif
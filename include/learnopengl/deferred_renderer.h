@@ -0,0 +1,484 @@
+#ifndef DEFERRED_RENDERER_H
+#define DEFERRED_RENDERER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/gpu_query.h>
+#include <learnopengl/light_manager.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+// Deferred shading into the HDR color buffer the bloom chain reads. The geometry pass draws the scene once
+// with gBuffer.fs into the G-buffer (albedo, normal, specular color and shininess, depth); the light passes
+// then add every light to the pixels it can reach:
+//  - the directional light as one full screen pass (deferredDirectional.fs),
+//  - point lights as spheres and spot lights as cones around their range (lightVolume.vs/.fs, LightRange in
+//    light_manager.h), all lights of a kind in one instanced draw.
+// A volume is drawn with its back faces and GL_GEQUAL against the scene depth, so it shades the surfaces in
+// front of its far side and nothing else; depth clamping keeps volumes that reach past the far plane.
+// The cost of a light is the pixels its volume covers, not every fragment of every mesh as in the forward
+// path. The color buffer keeps the scene depth afterwards (LightFramebuffer), so unlit things such as the
+// light cubes and the skybox can be drawn on top; ExtractBright then writes the bloom input.
+// The programs are built by the caller from the shaders named above; GL thread only.
+class DeferredRenderer
+{
+public:
+    struct Programs {
+        Shader *directional; // bloom.vs, deferredDirectional.fs
+        Shader *pointLights; // lightVolume.vs, lightVolume.fs
+        Shader *spotLights;  // lightVolume.vs, lightVolume.fs with SPOT
+        Shader *brightPass;  // bloom.vs, brightPass.fs
+    };
+
+    struct Stats {
+        size_t pointLights = 0, spotLights = 0;
+        // volumes left after frustum culling
+        size_t drawnPointLights = 0, drawnSpotLights = 0;
+        double geometryMs = 0.0;
+        double lightingMs = 0.0;
+    };
+
+    // colorBuffer receives the lit scene and brightBuffer its bright parts, both width x height RGBA16F textures
+    DeferredRenderer(int width, int height, unsigned int colorBuffer, unsigned int brightBuffer, const Programs &programs)
+        : width(width), height(height), programs(programs), geometryTime(GL_TIME_ELAPSED), lightingTime(GL_TIME_ELAPSED)
+    {
+        GLState &state = GLState::Shared();
+
+        // G-buffer: albedo, normal and specular color with shininess / 255 in alpha, depth as a texture the light
+        // passes read positions from
+        glGenFramebuffers(1, &gBuffer);
+        state.BindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+        const GLint formats[3] = {GL_RGBA8, GL_RGBA16F, GL_RGBA8};
+        const GLenum types[3] = {GL_UNSIGNED_BYTE, GL_FLOAT, GL_UNSIGNED_BYTE};
+        glGenTextures(3, gTextures);
+        for (int i = 0; i < 3; i++)
+        {
+            createTexture(gTextures[i], formats[i], GL_RGBA, types[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, gTextures[i], 0);
+        }
+        glGenTextures(1, &gDepth);
+        createTexture(gDepth, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gDepth, 0);
+        const GLenum attachments[3] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+        glDrawBuffers(3, attachments);
+        checkComplete("G_BUFFER");
+
+        // the lit scene: the caller's color buffer with a copy of the G-buffer depth, as sampling gDepth while
+        // it is attached would be a feedback loop
+        glGenFramebuffers(1, &lightFBO);
+        state.BindFramebuffer(GL_FRAMEBUFFER, lightFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorBuffer, 0);
+        glGenRenderbuffers(1, &lightDepth);
+        glBindRenderbuffer(GL_RENDERBUFFER, lightDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, lightDepth);
+        checkComplete("LIGHT");
+
+        glGenFramebuffers(1, &brightFBO);
+        state.BindFramebuffer(GL_FRAMEBUFFER, brightFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, brightBuffer, 0);
+        checkComplete("BRIGHT");
+        state.BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        this->colorBuffer = colorBuffer;
+        createQuad();
+        std::vector<glm::vec3> vertices;
+        std::vector<unsigned short> indices;
+        BuildSphere(vertices, indices);
+        createMesh(sphere, vertices, indices);
+        BuildCone(vertices, indices);
+        createMesh(cone, vertices, indices);
+        createBatch(batches[PointBatch], sphere);
+        createBatch(batches[ConeBatch], cone);
+        createBatch(batches[WideSpotBatch], sphere);
+
+        for (Shader *shader : {programs.directional, programs.pointLights, programs.spotLights})
+        {
+            shader->use();
+            shader->setInt("gAlbedo", 0);
+            shader->setInt("gNormal", 1);
+            shader->setInt("gSpecular", 2);
+            shader->setInt("gDepth", 3);
+        }
+        programs.brightPass->use();
+        programs.brightPass->setInt("scene", 0);
+    }
+
+    DeferredRenderer(const DeferredRenderer &) = delete;
+    DeferredRenderer &operator=(const DeferredRenderer &) = delete;
+
+    // binds the G-buffer and clears its depth; draw the scene with gBuffer.fs afterwards. Color is left as it
+    // was, the light passes skip every pixel still at the far plane.
+    void BeginGeometry()
+    {
+        GLState &state = GLState::Shared();
+        state.BindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+        state.DepthMask(GL_TRUE);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        geometryTime.Begin();
+    }
+
+    // shades the G-buffer with every light of lights into the color buffer; light volumes outside frustum are
+    // skipped. Leaves LightFramebuffer bound.
+    void Light(const LightManager &lights, const Frustum &frustum)
+    {
+        geometryTime.End();
+        lightingTime.Begin();
+        GLState &state = GLState::Shared();
+
+        state.BindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer);
+        state.BindFramebuffer(GL_DRAW_FRAMEBUFFER, lightFBO);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        state.BindFramebuffer(GL_FRAMEBUFFER, lightFBO);
+        const GLfloat black[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        glClearBufferfv(GL_COLOR, 0, black);
+
+        for (int i = 0; i < 3; i++)
+            state.BindTexture((unsigned int)i, GL_TEXTURE_2D, gTextures[i]);
+        state.BindTexture(3, GL_TEXTURE_2D, gDepth);
+        state.DepthMask(GL_FALSE);
+        state.Enable(GL_BLEND);
+        state.BlendFunc(GL_ONE, GL_ONE);
+
+        // the directional light reaches every pixel
+        state.Disable(GL_DEPTH_TEST);
+        programs.directional->use();
+        state.BindVertexArray(quadVAO);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        state.Enable(GL_DEPTH_TEST);
+
+        // the volumes' far sides, where the scene lies in front of them
+        cullVolumes(lights, frustum);
+        state.Enable(GL_CULL_FACE);
+        state.CullFace(GL_FRONT);
+        state.DepthFunc(GL_GEQUAL);
+        state.Enable(GL_DEPTH_CLAMP);
+        programs.pointLights->use();
+        drawBatch(batches[PointBatch]);
+        programs.spotLights->use();
+        drawBatch(batches[ConeBatch]);
+        drawBatch(batches[WideSpotBatch]);
+
+        state.Disable(GL_DEPTH_CLAMP);
+        state.CullFace(GL_BACK);
+        state.Disable(GL_CULL_FACE);
+        state.DepthFunc(GL_LESS);
+        state.Disable(GL_BLEND);
+        state.DepthMask(GL_TRUE);
+        lightingTime.End();
+
+        // results are a few frames old (see GpuQuery)
+        stats.pointLights = lights.PointLights().size();
+        stats.spotLights = lights.SpotLights().size();
+        stats.drawnPointLights = batches[PointBatch].visible.size();
+        stats.drawnSpotLights = batches[ConeBatch].visible.size() + batches[WideSpotBatch].visible.size();
+        stats.geometryMs = geometryTime.Result() / 1e6;
+        stats.lightingMs = lightingTime.Result() / 1e6;
+    }
+
+    // the color buffer with the scene depth, for what is drawn after the light passes
+    unsigned int LightFramebuffer() const { return lightFBO; }
+
+    // writes the pixels of the color buffer brighter than 1 into the bright buffer, as lightingShader.fs
+    // does for the forward path; leaves the bright buffer's framebuffer bound
+    void ExtractBright()
+    {
+        GLState &state = GLState::Shared();
+        state.BindFramebuffer(GL_FRAMEBUFFER, brightFBO);
+        state.Disable(GL_DEPTH_TEST);
+        programs.brightPass->use();
+        state.BindTexture(0, GL_TEXTURE_2D, colorBuffer);
+        state.BindVertexArray(quadVAO);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        state.Enable(GL_DEPTH_TEST);
+    }
+
+    const Stats &LastFrame() const { return stats; }
+
+    // frees the GL objects; has to run while the context is still current
+    void Delete()
+    {
+        GLState &state = GLState::Shared();
+        state.BindFramebuffer(GL_FRAMEBUFFER, 0);
+        const unsigned int framebuffers[3] = {gBuffer, lightFBO, brightFBO};
+        glDeleteFramebuffers(3, framebuffers);
+        glDeleteRenderbuffers(1, &lightDepth);
+        state.DeleteTextures(3, gTextures);
+        state.DeleteTextures(1, &gDepth);
+        state.DeleteVertexArrays(1, &quadVAO);
+        glDeleteBuffers(1, &quadVBO);
+        for (VolumeBatch &batch : batches)
+        {
+            state.DeleteVertexArrays(1, &batch.VAO);
+            glDeleteBuffers(1, &batch.instanceVBO);
+        }
+        for (VolumeMesh *mesh : {&sphere, &cone})
+        {
+            glDeleteBuffers(1, &mesh->VBO);
+            glDeleteBuffers(1, &mesh->EBO);
+        }
+        geometryTime.Delete();
+        lightingTime.Delete();
+    }
+
+    // unit sphere around the origin, widened so that its flat faces still enclose the round one
+    static void BuildSphere(std::vector<glm::vec3> &vertices, std::vector<unsigned short> &indices)
+    {
+        const int slices = 16, stacks = 8;
+        const float pi = 3.14159265f;
+        const float grow = 1.0f / (std::cos(pi / slices) * std::cos(pi / (2 * stacks)));
+        vertices.clear();
+        indices.clear();
+        for (int i = 0; i <= stacks; i++)
+        {
+            float polar = pi * i / stacks;
+            for (int j = 0; j <= slices; j++)
+            {
+                float azimuth = 2.0f * pi * j / slices;
+                vertices.push_back(grow * glm::vec3(std::sin(polar) * std::cos(azimuth), std::cos(polar), std::sin(polar) * std::sin(azimuth)));
+            }
+        }
+        // counter clockwise seen from outside
+        for (int i = 0; i < stacks; i++)
+            for (int j = 0; j < slices; j++)
+            {
+                unsigned short v00 = (unsigned short)(i * (slices + 1) + j), v01 = v00 + 1;
+                unsigned short v10 = (unsigned short)(v00 + slices + 1), v11 = v10 + 1;
+                if (i > 0)
+                    indices.insert(indices.end(), {v00, v01, v10});
+                if (i < stacks - 1)
+                    indices.insert(indices.end(), {v01, v11, v10});
+            }
+    }
+
+    // cone with its apex at the origin opening along +z to a base of radius 1 at z = 1, widened so that its
+    // flat sides still enclose the round one
+    static void BuildCone(std::vector<glm::vec3> &vertices, std::vector<unsigned short> &indices)
+    {
+        const int sides = 16;
+        const float pi = 3.14159265f;
+        const float grow = 1.0f / std::cos(pi / sides);
+        vertices.assign(1, glm::vec3(0.0f));
+        indices.clear();
+        for (int i = 0; i < sides; i++)
+        {
+            float azimuth = 2.0f * pi * i / sides;
+            vertices.push_back(glm::vec3(grow * std::cos(azimuth), grow * std::sin(azimuth), 1.0f));
+        }
+        vertices.push_back(glm::vec3(0.0f, 0.0f, 1.0f));
+        // counter clockwise seen from outside: the mantle and the base
+        const unsigned short base = (unsigned short)(sides + 1);
+        for (int i = 0; i < sides; i++)
+        {
+            unsigned short a = (unsigned short)(1 + i), b = (unsigned short)(1 + (i + 1) % sides);
+            indices.insert(indices.end(), {0, b, a});
+            indices.insert(indices.end(), {base, a, b});
+        }
+    }
+
+private:
+    // per light instance data of lightVolume.vs
+    struct LightVolume {
+        glm::mat4 volume;       // unit sphere or cone to world space
+        glm::vec4 position;     // w: range
+        glm::vec4 direction;    // w: cosine of the outer cone angle
+        glm::vec4 ambient;
+        glm::vec4 diffuse;
+        glm::vec4 specular;
+        glm::vec4 attenuation;  // constant, linear, quadratic; w: cosine of the inner cone angle
+    };
+    struct VolumeMesh {
+        unsigned int VBO = 0, EBO = 0;
+        GLsizei indexCount = 0;
+    };
+    // the lights drawn with one mesh and program: all of them and the ones in view this frame
+    struct VolumeBatch {
+        unsigned int VAO = 0, instanceVBO = 0;
+        const VolumeMesh *mesh = nullptr;
+        std::vector<LightVolume> volumes, visible;
+    };
+    // spot lights with very wide cones are bounded by a sphere instead (WideSpotBatch)
+    enum Batch { PointBatch, ConeBatch, WideSpotBatch, BatchCount };
+
+    int width, height;
+    Programs programs;
+    unsigned int gBuffer = 0, lightFBO = 0, brightFBO = 0;
+    unsigned int gTextures[3] = {0, 0, 0};
+    unsigned int gDepth = 0, lightDepth = 0, colorBuffer = 0;
+    unsigned int quadVAO = 0, quadVBO = 0;
+    VolumeMesh sphere, cone;
+    VolumeBatch batches[BatchCount];
+    // lights.Revision() the volumes were built for
+    size_t revision = ~(size_t)0;
+    GpuQuery geometryTime, lightingTime;
+    Stats stats;
+
+    void createTexture(unsigned int texture, GLint internalFormat, GLenum format, GLenum type)
+    {
+        GLState::Shared().BindTexture(0, GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    static void checkComplete(const char *name)
+    {
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::DEFERRED::FRAMEBUFFER_NOT_COMPLETE: " << name << std::endl;
+    }
+
+    // full screen quad in the layout of bloom.vs
+    void createQuad()
+    {
+        const float quadVertices[] = {
+            -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
+            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+             1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
+             1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+        };
+        glGenVertexArrays(1, &quadVAO);
+        glGenBuffers(1, &quadVBO);
+        GLState::Shared().BindVertexArray(quadVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)(3 * sizeof(float)));
+        GLState::Shared().BindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    static void createMesh(VolumeMesh &mesh, const std::vector<glm::vec3> &vertices, const std::vector<unsigned short> &indices)
+    {
+        glGenBuffers(1, &mesh.VBO);
+        glGenBuffers(1, &mesh.EBO);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+        // filled through GL_ARRAY_BUFFER, which needs no VAO; createBatch attaches it as the element buffer
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.EBO);
+        glBufferData(GL_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), indices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        mesh.indexCount = (GLsizei)indices.size();
+    }
+
+    // location 0: the mesh, 1-10: LightVolume per instance
+    static void createBatch(VolumeBatch &batch, const VolumeMesh &mesh)
+    {
+        batch.mesh = &mesh;
+        glGenVertexArrays(1, &batch.VAO);
+        glGenBuffers(1, &batch.instanceVBO);
+        GLState::Shared().BindVertexArray(batch.VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+        glBindBuffer(GL_ARRAY_BUFFER, batch.instanceVBO);
+        for (GLuint i = 0; i < 10; i++)
+        {
+            glEnableVertexAttribArray(1 + i);
+            glVertexAttribPointer(1 + i, 4, GL_FLOAT, GL_FALSE, sizeof(LightVolume), (void *)(i * sizeof(glm::vec4)));
+            glVertexAttribDivisor(1 + i, 1);
+        }
+        GLState::Shared().BindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // volumes of all lights, rebuilt whenever one changed; lights without falloff get a volume that reaches
+    // past the far plane, which depth clamping turns into a full screen pass
+    void buildVolumes(const LightManager &lights)
+    {
+        const float maxRange = 1000.0f;
+        for (VolumeBatch &batch : batches)
+            batch.volumes.clear();
+        for (const PointLight &light : lights.PointLights())
+        {
+            LightVolume volume;
+            float range = std::min(light.Range(), maxRange);
+            volume.volume = glm::mat4(range);
+            volume.volume[3] = glm::vec4(light.position, 1.0f);
+            volume.position = glm::vec4(light.position, range);
+            volume.direction = glm::vec4(0.0f);
+            volume.ambient = glm::vec4(light.ambient, 0.0f);
+            volume.diffuse = glm::vec4(light.diffuse, 0.0f);
+            volume.specular = glm::vec4(light.specular, 0.0f);
+            volume.attenuation = glm::vec4(light.constant, light.linear, light.quadratic, 0.0f);
+            if (range > 0.0f)
+                batches[PointBatch].volumes.push_back(volume);
+        }
+        for (const SpotLight &light : lights.SpotLights())
+        {
+            LightVolume volume;
+            float range = std::min(light.Range(), maxRange);
+            glm::vec3 axis = glm::normalize(light.direction);
+            volume.position = glm::vec4(light.position, range);
+            volume.direction = glm::vec4(axis, light.outerCutOff);
+            volume.ambient = glm::vec4(light.ambient, 0.0f);
+            volume.diffuse = glm::vec4(light.diffuse, 0.0f);
+            volume.specular = glm::vec4(light.specular, 0.0f);
+            volume.attenuation = glm::vec4(light.constant, light.linear, light.quadratic, light.cutOff);
+            if (range <= 0.0f)
+                continue;
+            // cones past ~80 degrees are too flat to be worth it
+            if (light.outerCutOff < 0.2f)
+            {
+                volume.volume = glm::mat4(range);
+                volume.volume[3] = glm::vec4(light.position, 1.0f);
+                batches[WideSpotBatch].volumes.push_back(volume);
+                continue;
+            }
+            // a right handed frame around the axis, scaled to the cone's height and base radius
+            float baseRadius = range * std::sqrt(1.0f - light.outerCutOff * light.outerCutOff) / light.outerCutOff;
+            glm::vec3 up = std::fabs(axis.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+            glm::vec3 x = glm::normalize(glm::cross(up, axis));
+            glm::vec3 y = glm::cross(axis, x);
+            volume.volume = glm::mat4(glm::vec4(x * baseRadius, 0.0f), glm::vec4(y * baseRadius, 0.0f),
+                                      glm::vec4(axis * range, 0.0f), glm::vec4(light.position, 1.0f));
+            batches[ConeBatch].volumes.push_back(volume);
+        }
+        revision = lights.Revision();
+    }
+
+    // keeps the volumes whose bounding sphere (the light's range) touches the frustum
+    void cullVolumes(const LightManager &lights, const Frustum &frustum)
+    {
+        if (revision != lights.Revision())
+            buildVolumes(lights);
+        for (VolumeBatch &batch : batches)
+        {
+            batch.visible.clear();
+            for (const LightVolume &volume : batch.volumes)
+            {
+                glm::vec3 center(volume.position);
+                bool inside = true;
+                for (const glm::vec4 &plane : frustum.planes)
+                    inside = inside && glm::dot(glm::vec3(plane), center) + plane.w >= -volume.position.w;
+                if (inside)
+                    batch.visible.push_back(volume);
+            }
+        }
+    }
+
+    void drawBatch(VolumeBatch &batch)
+    {
+        if (batch.visible.empty())
+            return;
+        glBindBuffer(GL_ARRAY_BUFFER, batch.instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, batch.visible.size() * sizeof(LightVolume), batch.visible.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        GLState::Shared().BindVertexArray(batch.VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, batch.mesh->indexCount, GL_UNSIGNED_SHORT, nullptr, (GLsizei)batch.visible.size());
+    }
+};
+#endif
@@ -0,0 +1,106 @@
+#ifndef DEPTH_PREPASS_H
+#define DEPTH_PREPASS_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/gpu_query.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/texture_pipeline.h>
+
+// Optional depth-only pass in front of the lit scene. The pre-pass lays down the depth of every opaque surface
+// from the meshes' position-only streams (Mesh::depthVAO) with color writes off; materials whose diffuse
+// texture has alpha are drawn from the full vertex buffer with the alpha-test variant instead, which discards
+// the same texels lightingShader.fs does. The lit pass then tests GL_EQUAL without writing depth, so every
+// pixel is shaded once, by the surface that ends up in front, and its discards no longer cost early-Z.
+// That only holds if both passes compute bit identical positions: the vertex shaders of both share the
+// position math and declare gl_Position invariant.
+// Either way the shading pass is timed and counted: overdraw is the number of fragments it shaded per pixel.
+class DepthPrepass
+{
+public:
+    struct Stats {
+        bool enabled = false;
+        double prepassMs = 0.0;
+        double shadingMs = 0.0;
+        // fragments that passed the depth test in the shading pass per framebuffer pixel
+        double overdraw = 0.0;
+    };
+
+    explicit DepthPrepass(const TexturePipeline &textures = TexturePipeline::Shared())
+        : textures(textures), prepassTime(GL_TIME_ELAPSED), shadingTime(GL_TIME_ELAPSED), shadedSamples(GL_SAMPLES_PASSED)
+    {
+    }
+
+    DepthPrepass(const DepthPrepass &) = delete;
+    DepthPrepass &operator=(const DepthPrepass &) = delete;
+
+    void SetEnabled(bool enabled) { this->enabled = enabled; }
+    bool Enabled() const { return enabled; }
+
+    // whether lightingShader.fs may discard texels of material: its diffuse texture (unit 0) has alpha
+    bool Cutout(const RenderMaterial &material) const
+    {
+        return !material.textures.empty() && textures.HasAlpha(material.textures[0]);
+    }
+
+    // starts the pre-pass if enabled: depth writes with GL_LESS, no color writes
+    void Begin()
+    {
+        if (!enabled)
+            return;
+        GLState &state = GLState::Shared();
+        state.ColorMask(GL_FALSE);
+        state.DepthMask(GL_TRUE);
+        state.DepthFunc(GL_LESS);
+        prepassTime.Begin();
+    }
+
+    // ends the pre-pass and starts the lit pass, which after a pre-pass only shades the stored depths
+    void BeginShading()
+    {
+        GLState &state = GLState::Shared();
+        if (enabled)
+        {
+            prepassTime.End();
+            state.ColorMask(GL_TRUE);
+            state.DepthFunc(GL_EQUAL);
+            state.DepthMask(GL_FALSE);
+        }
+        shadingTime.Begin();
+        shadedSamples.Begin();
+    }
+
+    // ends the lit pass and restores GL_LESS with depth writes; width x height is the framebuffer's size
+    void End(GLsizei width, GLsizei height)
+    {
+        shadedSamples.End();
+        shadingTime.End();
+        GLState &state = GLState::Shared();
+        state.DepthFunc(GL_LESS);
+        state.DepthMask(GL_TRUE);
+
+        // results are a few frames old (see GpuQuery)
+        stats.enabled = enabled;
+        stats.prepassMs = enabled ? prepassTime.Result() / 1e6 : 0.0;
+        stats.shadingMs = shadingTime.Result() / 1e6;
+        stats.overdraw = width > 0 && height > 0 ? (double)shadedSamples.Result() / ((double)width * height) : 0.0;
+    }
+
+    const Stats &LastFrame() const { return stats; }
+
+    // frees the queries; has to run while the context is still current
+    void Delete()
+    {
+        prepassTime.Delete();
+        shadingTime.Delete();
+        shadedSamples.Delete();
+    }
+
+private:
+    const TexturePipeline &textures;
+    bool enabled = true;
+    GpuQuery prepassTime, shadingTime, shadedSamples;
+    Stats stats;
+};
+#endif
@@ -0,0 +1,183 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/cpu_features.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// the six planes of a view frustum in world space. A plane is (normal, distance) with a unit normal pointing
+// inwards, so a point p is inside it if dot(normal, p) + distance >= 0.
+struct Frustum {
+    glm::vec4 planes[6];
+
+    Frustum() {}
+
+    // extracted from the rows of projection * view (Gribb/Hartmann): left, right, bottom, top, near, far
+    explicit Frustum(const glm::mat4 &viewProjection)
+    {
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++)
+            rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        for (int i = 0; i < 3; i++)
+        {
+            planes[i * 2 + 0] = rows[3] + rows[i];
+            planes[i * 2 + 1] = rows[3] - rows[i];
+        }
+        for (glm::vec4 &plane : planes)
+            plane /= glm::length(glm::vec3(plane));
+    }
+};
+
+// world space bounds of many objects kept as a structure of arrays, so that one SIMD instruction tests a plane
+// against 4 (SSE2) or 8 (AVX) objects. Every object has an axis aligned box and a bounding sphere around the
+// box center; against each plane the tighter of the two counts, and an object is culled once it lies
+// entirely outside one plane. The test is conservative: objects crossing a frustum corner may be kept.
+class FrustumCuller
+{
+public:
+    // best instruction set the CPU supports
+    static Isa Detected()
+    {
+        return CpuFeatures::Best({Isa::SSE2, Isa::AVX});
+    }
+
+    // instruction set used by Cull; can be lowered to compare against the scalar path
+    static Isa &Active()
+    {
+        static Isa isa = Detected();
+        return isa;
+    }
+
+    void Clear()
+    {
+        centerX.clear(); centerY.clear(); centerZ.clear();
+        extentX.clear(); extentY.clear(); extentZ.clear();
+        radius.clear();
+    }
+
+    // adds the object space box and the radius of the sphere around its center, placed with transform;
+    // returns the object's index
+    size_t Add(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, float boundsRadius, const glm::mat4 &transform)
+    {
+        glm::vec3 center = glm::vec3(transform * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+        glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+        // the box around the transformed box (Arvo): |M| * extent, and the sphere grows with the largest scale
+        glm::mat3 linear(transform);
+        glm::vec3 worldExtent(0.0f);
+        float scale = 0.0f;
+        for (int column = 0; column < 3; column++)
+        {
+            worldExtent += glm::abs(linear[column]) * extent[column];
+            scale = std::max(scale, glm::length(linear[column]));
+        }
+        centerX.push_back(center.x); centerY.push_back(center.y); centerZ.push_back(center.z);
+        extentX.push_back(worldExtent.x); extentY.push_back(worldExtent.y); extentZ.push_back(worldExtent.z);
+        radius.push_back(boundsRadius * scale);
+        return radius.size() - 1;
+    }
+
+    size_t Size() const { return radius.size(); }
+
+    // world space box of object i
+    glm::vec3 Center(size_t i) const { return glm::vec3(centerX[i], centerY[i], centerZ[i]); }
+    glm::vec3 Extent(size_t i) const { return glm::vec3(extentX[i], extentY[i], extentZ[i]); }
+
+    // visible[i] becomes 1 if object i may intersect the frustum and 0 if it is outside; returns the number culled
+    size_t Cull(const Frustum &frustum, std::vector<unsigned char> &visible) const
+    {
+        visible.resize(Size());
+        size_t done = 0;
+#if CPU_X86
+        if (Active() == Isa::AVX)
+            done = cullAVX(frustum, visible.data());
+        else if (Active() == Isa::SSE2)
+            done = cullSSE(frustum, visible.data());
+#endif
+        for (size_t i = done; i < Size(); i++)
+        {
+            visible[i] = 1;
+            for (const glm::vec4 &plane : frustum.planes)
+            {
+                float distance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+                float boxRadius = std::fabs(plane.x) * extentX[i] + std::fabs(plane.y) * extentY[i] + std::fabs(plane.z) * extentZ[i];
+                if (distance + std::min(boxRadius, radius[i]) < 0.0f)
+                {
+                    visible[i] = 0;
+                    break;
+                }
+            }
+        }
+        size_t culled = 0;
+        for (unsigned char v : visible)
+            culled += v == 0;
+        return culled;
+    }
+
+private:
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+    std::vector<float> radius;
+
+#if CPU_X86
+    // the SIMD variants handle whole groups of 4 or 8 objects and return how many they did
+    CPU_SSE2 size_t cullSSE(const Frustum &frustum, unsigned char *visible) const
+    {
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        size_t count = Size() / 4 * 4;
+        for (size_t i = 0; i < count; i += 4)
+        {
+            __m128 cx = _mm_loadu_ps(&centerX[i]), cy = _mm_loadu_ps(&centerY[i]), cz = _mm_loadu_ps(&centerZ[i]);
+            __m128 ex = _mm_loadu_ps(&extentX[i]), ey = _mm_loadu_ps(&extentY[i]), ez = _mm_loadu_ps(&extentZ[i]);
+            __m128 r = _mm_loadu_ps(&radius[i]);
+            __m128 outside = _mm_setzero_ps();
+            for (const glm::vec4 &plane : frustum.planes)
+            {
+                __m128 nx = _mm_set1_ps(plane.x), ny = _mm_set1_ps(plane.y), nz = _mm_set1_ps(plane.z);
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)), _mm_mul_ps(nz, cz)), _mm_set1_ps(plane.w));
+                __m128 boxRadius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, nx), ex),
+                                                         _mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)),
+                                              _mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+                __m128 reach = _mm_add_ps(distance, _mm_min_ps(boxRadius, r));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(reach, _mm_setzero_ps()));
+            }
+            int mask = _mm_movemask_ps(outside);
+            for (int k = 0; k < 4; k++)
+                visible[i + k] = (unsigned char)!((mask >> k) & 1);
+        }
+        return count;
+    }
+
+    CPU_AVX size_t cullAVX(const Frustum &frustum, unsigned char *visible) const
+    {
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+        size_t count = Size() / 8 * 8;
+        for (size_t i = 0; i < count; i += 8)
+        {
+            __m256 cx = _mm256_loadu_ps(&centerX[i]), cy = _mm256_loadu_ps(&centerY[i]), cz = _mm256_loadu_ps(&centerZ[i]);
+            __m256 ex = _mm256_loadu_ps(&extentX[i]), ey = _mm256_loadu_ps(&extentY[i]), ez = _mm256_loadu_ps(&extentZ[i]);
+            __m256 r = _mm256_loadu_ps(&radius[i]);
+            __m256 outside = _mm256_setzero_ps();
+            for (const glm::vec4 &plane : frustum.planes)
+            {
+                __m256 nx = _mm256_set1_ps(plane.x), ny = _mm256_set1_ps(plane.y), nz = _mm256_set1_ps(plane.z);
+                __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, cx), _mm256_mul_ps(ny, cy)), _mm256_mul_ps(nz, cz)), _mm256_set1_ps(plane.w));
+                __m256 boxRadius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(signMask, nx), ex),
+                                                               _mm256_mul_ps(_mm256_andnot_ps(signMask, ny), ey)),
+                                                 _mm256_mul_ps(_mm256_andnot_ps(signMask, nz), ez));
+                __m256 reach = _mm256_add_ps(distance, _mm256_min_ps(boxRadius, r));
+                outside = _mm256_or_ps(outside, _mm256_cmp_ps(reach, _mm256_setzero_ps(), _CMP_LT_OQ));
+            }
+            int mask = _mm256_movemask_ps(outside);
+            for (int k = 0; k < 8; k++)
+                visible[i + k] = (unsigned char)!((mask >> k) & 1);
+        }
+        return count;
+    }
+#endif
+};
+#endif
@@ -0,0 +1,398 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+
+// shadow of the GL state the engine changes most: the current program, VAO, the textures bound per unit,
+// framebuffers, depth/color mask/blend/cull state and the viewport. Every bind goes through here and a call that would
+// not change anything is dropped. That only holds as long as nothing binds these with raw gl calls; code
+// that does (or a library) has to call Invalidate afterwards. GL thread only.
+// With SetVerify(true) every dropped call is checked against glGet first, and Verify compares the whole
+// shadow; a mismatch is reported as ERROR::GL_STATE::MISMATCH and the call is issued anyway.
+class GLState
+{
+public:
+    static const int MaxTextureUnits = 16;
+
+    enum Kind {
+        Program,
+        VertexArray,
+        Texture,
+        Framebuffer,
+        Fixed, // capabilities, depth, color mask, blend, cull face and viewport
+        KindCount
+    };
+
+    struct Stats {
+        size_t issued[KindCount] = {0};
+        size_t elided[KindCount] = {0};
+
+        size_t Issued() const { return sum(issued); }
+        size_t Elided() const { return sum(elided); }
+
+    private:
+        static size_t sum(const size_t *counts)
+        {
+            size_t total = 0;
+            for (int i = 0; i < KindCount; i++)
+                total += counts[i];
+            return total;
+        }
+    };
+
+    static GLState &Shared()
+    {
+        static GLState state;
+        return state;
+    }
+
+    GLState(const GLState &) = delete;
+    GLState &operator=(const GLState &) = delete;
+
+    void UseProgram(GLuint program)
+    {
+        if (elide(Program, program == currentProgram, GL_CURRENT_PROGRAM, program, "program"))
+            return;
+        glUseProgram(program);
+        currentProgram = program;
+    }
+
+    void BindVertexArray(GLuint vao)
+    {
+        if (elide(VertexArray, vao == vertexArray, GL_VERTEX_ARRAY_BINDING, vao, "vertex array"))
+            return;
+        glBindVertexArray(vao);
+        vertexArray = vao;
+    }
+
+    // binds texture to target on unit (0 based), making unit the active one only if the binding changes
+    void BindTexture(unsigned int unit, GLenum target, GLuint texture)
+    {
+        int slot = targetSlot(target);
+        if (unit >= (unsigned int)MaxTextureUnits || slot < 0)
+        {
+            activeTexture(unit);
+            glBindTexture(target, texture);
+            stats.issued[Texture]++;
+            return;
+        }
+        GLuint &bound = textures[unit][slot];
+        if (bound == texture)
+        {
+            GLuint actual = verify ? boundTexture(unit, target) : texture;
+            if (actual == texture)
+            {
+                stats.elided[Texture]++;
+                return;
+            }
+            mismatch("texture", texture, actual);
+        }
+        activeTexture(unit);
+        glBindTexture(target, texture);
+        bound = texture;
+        stats.issued[Texture]++;
+    }
+
+    // target is GL_FRAMEBUFFER (both), GL_DRAW_FRAMEBUFFER or GL_READ_FRAMEBUFFER
+    void BindFramebuffer(GLenum target, GLuint framebuffer)
+    {
+        bool draw = target != GL_READ_FRAMEBUFFER, read = target != GL_DRAW_FRAMEBUFFER;
+        bool same = (!draw || drawFramebuffer == framebuffer) && (!read || readFramebuffer == framebuffer);
+        if (elide(Framebuffer, same, draw ? GL_DRAW_FRAMEBUFFER_BINDING : GL_READ_FRAMEBUFFER_BINDING, framebuffer, "framebuffer"))
+            return;
+        glBindFramebuffer(target, framebuffer);
+        if (draw)
+            drawFramebuffer = framebuffer;
+        if (read)
+            readFramebuffer = framebuffer;
+    }
+
+    void Enable(GLenum capability) { setCapability(capability, true); }
+    void Disable(GLenum capability) { setCapability(capability, false); }
+
+    void DepthFunc(GLenum func)
+    {
+        if (elide(Fixed, func == depthFunc, GL_DEPTH_FUNC, func, "depth func"))
+            return;
+        glDepthFunc(func);
+        depthFunc = func;
+    }
+
+    void DepthMask(GLboolean mask)
+    {
+        if (elide(Fixed, mask == depthMask, GL_DEPTH_WRITEMASK, mask, "depth mask"))
+            return;
+        glDepthMask(mask);
+        depthMask = mask;
+    }
+
+    // writes to all channels of every draw buffer on or off, e.g. off for a depth only pass
+    void ColorMask(GLboolean mask)
+    {
+        if (colorMask == mask)
+        {
+            GLint actual[4] = {mask, mask, mask, mask};
+            if (verify)
+                glGetIntegerv(GL_COLOR_WRITEMASK, actual);
+            if (std::count(actual, actual + 4, (GLint)mask) == 4)
+            {
+                stats.elided[Fixed]++;
+                return;
+            }
+            mismatch("color mask", mask, (GLuint)actual[0]);
+        }
+        glColorMask(mask, mask, mask, mask);
+        colorMask = mask;
+        stats.issued[Fixed]++;
+    }
+
+    void BlendFunc(GLenum source, GLenum destination)
+    {
+        if (elide(Fixed, source == blendSource && destination == blendDestination, GL_BLEND_SRC_RGB, source, "blend func"))
+            return;
+        glBlendFunc(source, destination);
+        blendSource = source;
+        blendDestination = destination;
+    }
+
+    // which faces GL_CULL_FACE drops, e.g. GL_FRONT to draw the inside of light volumes
+    void CullFace(GLenum face)
+    {
+        if (elide(Fixed, face == cullFace, GL_CULL_FACE_MODE, face, "cull face"))
+            return;
+        glCullFace(face);
+        cullFace = face;
+    }
+
+    void Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        GLint viewport[4] = {x, y, width, height};
+        bool same = viewportKnown;
+        for (int i = 0; i < 4; i++)
+            same = same && currentViewport[i] == viewport[i];
+        if (same)
+        {
+            GLint actual[4] = {x, y, width, height};
+            if (verify)
+                glGetIntegerv(GL_VIEWPORT, actual);
+            if (std::equal(actual, actual + 4, viewport))
+            {
+                stats.elided[Fixed]++;
+                return;
+            }
+            mismatch("viewport", (GLuint)width, (GLuint)actual[2]);
+        }
+        glViewport(x, y, width, height);
+        std::copy(viewport, viewport + 4, currentViewport);
+        viewportKnown = true;
+        stats.issued[Fixed]++;
+    }
+
+    // unbinds deleted objects from the shadow as well, so a new object reusing the name gets bound
+    void DeleteVertexArrays(GLsizei count, const GLuint *names)
+    {
+        for (GLsizei i = 0; i < count; i++)
+            if (names[i] == vertexArray)
+                vertexArray = 0;
+        glDeleteVertexArrays(count, names);
+    }
+
+    void DeleteTextures(GLsizei count, const GLuint *names)
+    {
+        for (GLsizei i = 0; i < count; i++)
+            for (GLuint (&unit)[TargetCount] : textures)
+                for (GLuint &bound : unit)
+                    if (bound == names[i])
+                        bound = 0;
+        glDeleteTextures(count, names);
+    }
+
+    // forgets everything, e.g. after state was changed behind the cache's back
+    void Invalidate()
+    {
+        currentProgram = vertexArray = activeUnit = Unknown;
+        drawFramebuffer = readFramebuffer = Unknown;
+        for (GLuint (&unit)[TargetCount] : textures)
+            std::fill(unit, unit + TargetCount, Unknown);
+        std::fill(capabilities, capabilities + CapabilityCount, Unknown);
+        depthFunc = depthMask = colorMask = blendSource = blendDestination = cullFace = Unknown;
+        viewportKnown = false;
+    }
+
+    // checks every known shadow value against glGet and forgets the shadow if any differed; returns whether all matched
+    bool Verify()
+    {
+        size_t before = mismatches;
+        check("program", currentProgram, GL_CURRENT_PROGRAM);
+        check("vertex array", vertexArray, GL_VERTEX_ARRAY_BINDING);
+        check("active texture", activeUnit == Unknown ? Unknown : GL_TEXTURE0 + activeUnit, GL_ACTIVE_TEXTURE);
+        check("draw framebuffer", drawFramebuffer, GL_DRAW_FRAMEBUFFER_BINDING);
+        check("read framebuffer", readFramebuffer, GL_READ_FRAMEBUFFER_BINDING);
+        for (unsigned int unit = 0; unit < (unsigned int)MaxTextureUnits; unit++)
+            for (int slot = 0; slot < TargetCount; slot++)
+                if (textures[unit][slot] != Unknown && boundTexture(unit, Targets()[slot]) != textures[unit][slot])
+                    mismatch("texture", textures[unit][slot], boundTexture(unit, Targets()[slot]));
+        for (int i = 0; i < CapabilityCount; i++)
+            if (capabilities[i] != Unknown && (GLuint)glIsEnabled(Capabilities()[i]) != capabilities[i])
+                mismatch("capability", capabilities[i], glIsEnabled(Capabilities()[i]));
+        check("depth func", depthFunc, GL_DEPTH_FUNC);
+        check("depth mask", depthMask, GL_DEPTH_WRITEMASK);
+        if (colorMask != Unknown)
+        {
+            GLint actual[4];
+            glGetIntegerv(GL_COLOR_WRITEMASK, actual);
+            if (std::count(actual, actual + 4, (GLint)colorMask) != 4)
+                mismatch("color mask", colorMask, (GLuint)actual[0]);
+        }
+        check("blend source", blendSource, GL_BLEND_SRC_RGB);
+        check("blend destination", blendDestination, GL_BLEND_DST_RGB);
+        check("cull face", cullFace, GL_CULL_FACE_MODE);
+        if (viewportKnown)
+        {
+            GLint actual[4];
+            glGetIntegerv(GL_VIEWPORT, actual);
+            if (!std::equal(actual, actual + 4, currentViewport))
+                mismatch("viewport", (GLuint)currentViewport[2], (GLuint)actual[2]);
+        }
+        if (mismatches == before)
+            return true;
+        Invalidate();
+        return false;
+    }
+
+    // checks the state behind every dropped call as well (slow, for debugging)
+    void SetVerify(bool enabled) { verify = enabled; }
+
+    // counts since the last ResetStats, e.g. of one frame
+    const Stats &FrameStats() const { return stats; }
+    void ResetStats() { stats = Stats(); }
+
+    // mismatches found by verification so far
+    size_t Mismatches() const { return mismatches; }
+
+private:
+    enum : GLuint { Unknown = ~0u };
+    enum { TargetCount = 3, CapabilityCount = 4 };
+
+    static const GLenum *Targets()
+    {
+        static const GLenum targets[TargetCount] = {GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BUFFER};
+        return targets;
+    }
+    static const GLenum *Capabilities()
+    {
+        static const GLenum capabilities[CapabilityCount] = {GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE, GL_DEPTH_CLAMP};
+        return capabilities;
+    }
+
+    GLuint currentProgram, vertexArray, activeUnit;
+    GLuint drawFramebuffer, readFramebuffer;
+    GLuint textures[MaxTextureUnits][TargetCount];
+    GLuint capabilities[CapabilityCount];
+    GLuint depthFunc, depthMask, colorMask, blendSource, blendDestination, cullFace;
+    GLint currentViewport[4] = {0, 0, 0, 0};
+    bool viewportKnown = false;
+    bool verify = false;
+    size_t mismatches = 0;
+    Stats stats;
+
+    GLState()
+    {
+        Invalidate();
+    }
+
+    static int targetSlot(GLenum target)
+    {
+        for (int i = 0; i < TargetCount; i++)
+            if (Targets()[i] == target)
+                return i;
+        return -1;
+    }
+
+    // counts the call as elided and returns true if the shadow already holds value (and, when verifying,
+    // GL agrees); otherwise counts it as issued and the caller makes it
+    bool elide(Kind kind, bool same, GLenum query, GLuint value, const char *what)
+    {
+        if (same)
+        {
+            GLint actual = (GLint)value;
+            if (verify)
+                glGetIntegerv(query, &actual);
+            if ((GLuint)actual == value)
+            {
+                stats.elided[kind]++;
+                return true;
+            }
+            mismatch(what, value, (GLuint)actual);
+        }
+        stats.issued[kind]++;
+        return false;
+    }
+
+    void setCapability(GLenum capability, bool enabled)
+    {
+        int index = -1;
+        for (int i = 0; i < CapabilityCount; i++)
+            if (Capabilities()[i] == capability)
+                index = i;
+        if (index >= 0 && capabilities[index] == (GLuint)enabled)
+        {
+            bool actual = verify ? glIsEnabled(capability) == GL_TRUE : enabled;
+            if (actual == enabled)
+            {
+                stats.elided[Fixed]++;
+                return;
+            }
+            mismatch("capability", enabled, actual);
+        }
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+        if (index >= 0)
+            capabilities[index] = enabled;
+        stats.issued[Fixed]++;
+    }
+
+    void activeTexture(unsigned int unit)
+    {
+        if (unit == activeUnit)
+            return;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+    }
+
+    // the texture GL has bound to target on unit; leaves the active unit as it was
+    GLuint boundTexture(unsigned int unit, GLenum target)
+    {
+        GLenum query = target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_BINDING_CUBE_MAP
+                     : target == GL_TEXTURE_BUFFER ? GL_TEXTURE_BINDING_BUFFER : GL_TEXTURE_BINDING_2D;
+        GLint active = 0, texture = 0;
+        glGetIntegerv(GL_ACTIVE_TEXTURE, &active);
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glGetIntegerv(query, &texture);
+        glActiveTexture((GLenum)active);
+        return (GLuint)texture;
+    }
+
+    void check(const char *what, GLuint shadow, GLenum query)
+    {
+        if (shadow == Unknown)
+            return;
+        GLint actual = 0;
+        glGetIntegerv(query, &actual);
+        if ((GLuint)actual != shadow)
+            mismatch(what, shadow, (GLuint)actual);
+    }
+
+    void mismatch(const char *what, GLuint shadow, GLuint actual)
+    {
+        mismatches++;
+        std::cout << "ERROR::GL_STATE::MISMATCH: " << what << " is " << actual << ", shadow " << shadow << std::endl;
+    }
+};
+#endif
@@ -0,0 +1,75 @@
+#ifndef GPU_QUERY_H
+#define GPU_QUERY_H
+
+#include <glad/glad.h>
+
+// a GL query (GL_TIME_ELAPSED, GL_SAMPLES_PASSED, ...) issued once per frame around the same work. The
+// queries of the last Latency frames stay in flight and are read back once the GPU has answered them, so
+// reading a result never waits for the GPU; Result is that of the newest frame answered so far. GL thread only.
+class GpuQuery
+{
+public:
+    enum { Latency = 4 };
+
+    explicit GpuQuery(GLenum target) : target(target) {}
+
+    GpuQuery(const GpuQuery &) = delete;
+    GpuQuery &operator=(const GpuQuery &) = delete;
+
+    // only one query per target can be active at a time
+    void Begin()
+    {
+        if (!names[0])
+            glGenQueries(Latency, names);
+        glBeginQuery(target, names[next]);
+    }
+
+    void End()
+    {
+        glEndQuery(target);
+        pending[next] = true;
+        next = (next + 1) % Latency;
+        collect();
+    }
+
+    // nanoseconds for GL_TIME_ELAPSED, samples for GL_SAMPLES_PASSED; 0 until the first result arrived
+    GLuint64 Result() const { return result; }
+
+    // frees the queries; has to run while the context is still current
+    void Delete()
+    {
+        if (names[0])
+            glDeleteQueries(Latency, names);
+        for (int i = 0; i < Latency; i++)
+        {
+            names[i] = 0;
+            pending[i] = false;
+        }
+    }
+
+private:
+    GLenum target;
+    GLuint names[Latency] = {0};
+    bool pending[Latency] = {false};
+    // the query the next Begin reuses, which is also the oldest one in flight
+    int next = 0;
+    GLuint64 result = 0;
+
+    // reads the answered queries oldest first and stops at the first the GPU has not finished
+    void collect()
+    {
+        for (int k = 0; k < Latency; k++)
+        {
+            int i = (next + k) % Latency;
+            if (!pending[i])
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(names[i], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                return;
+            glGetQueryObjectui64v(names[i], GL_QUERY_RESULT, &result);
+            pending[i] = false;
+        }
+    }
+};
+#endif
@@ -0,0 +1,138 @@
+#ifndef GROUND_H
+#define GROUND_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/shader.h>
+
+#include <cstdint>
+#include <vector>
+
+// The ground field: dimension x dimension square tiles of tileSize world units at the given height, laid out
+// like the old per tile loop (tile (i, j) centred on ((i - dimension / 2) * tileSize, -(j - dimension / 2) * tileSize)).
+// All tiles are baked into one static grid mesh with shared corner vertices and uvs that run on across tiles;
+// with GL_REPEAT that samples the texture exactly like one 0..1 quad per tile, so the whole field is a single
+// draw call with nothing computed per frame.
+class Ground
+{
+public:
+    Ground(int dimension, float tileSize, float height) : dimension(dimension)
+    {
+        const int corners = dimension + 1;
+        const float half = dimension / 2.0f;
+        const float minX = -half * tileSize - tileSize * 0.5f;
+        const float minZ = -(dimension - 1 - half) * tileSize - tileSize * 0.5f;
+
+        // position, normal, uv: locations 0-2 of lightingShader.vs
+        std::vector<float> vertices;
+        vertices.reserve((size_t)corners * corners * 8);
+        for (int b = 0; b < corners; b++)
+            for (int a = 0; a < corners; a++)
+            {
+                float x = minX + a * tileSize, z = minZ + b * tileSize;
+                float attributes[8] = {x, height, z, 0.0f, 1.0f, 0.0f, x / tileSize + 0.5f, z / tileSize + 0.5f};
+                vertices.insert(vertices.end(), attributes, attributes + 8);
+            }
+
+        // two triangles per tile, counter clockwise seen from above
+        std::vector<unsigned int> indices;
+        indices.reserve((size_t)dimension * dimension * 6);
+        for (int b = 0; b < dimension; b++)
+            for (int a = 0; a < dimension; a++)
+            {
+                unsigned int v00 = b * corners + a, v10 = v00 + 1, v01 = v00 + corners, v11 = v01 + 1;
+                unsigned int tile[6] = {v00, v01, v10, v10, v01, v11};
+                indices.insert(indices.end(), tile, tile + 6);
+            }
+        indexCount = (unsigned int)indices.size();
+        // every index fits in 16 bits up to a 255 x 255 field
+        indexType = (size_t)corners * corners <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        std::vector<uint16_t> shortIndices;
+        if (indexType == GL_UNSIGNED_SHORT)
+            shortIndices.assign(indices.begin(), indices.end());
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        GLState::Shared().BindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        if (indexType == GL_UNSIGNED_SHORT)
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(uint16_t), shortIndices.data(), GL_STATIC_DRAW);
+        else
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(3 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(6 * sizeof(float)));
+        GLState::Shared().BindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // frees the GL objects; has to run while the context is still current
+    void Delete()
+    {
+        GLState::Shared().DeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+    }
+
+    Ground(const Ground &) = delete;
+    Ground &operator=(const Ground &) = delete;
+
+    // draws the field with the diffuse texture and no specular map; the camera comes from the Frame uniform block
+    void Draw(Shader &shader, unsigned int diffuse)
+    {
+        GLState &state = GLState::Shared();
+        state.BindTexture(0, GL_TEXTURE_2D, diffuse);
+        state.BindTexture(1, GL_TEXTURE_2D, 0);
+
+        shader.setMat4("model", glm::mat4(1.0f));
+        state.BindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, indexCount, indexType, nullptr);
+    }
+
+    // queues the field like Draw (see RenderQueue)
+    void Submit(RenderQueue &queue, Shader &shader, unsigned int diffuse)
+    {
+        if (material.textures.empty() || material.textures[0] != diffuse)
+            material = RenderMaterial({diffuse, 0}, {});
+        RenderItem item;
+        item.shader = &shader;
+        item.VAO = VAO;
+        item.indexType = indexType;
+        item.indexCount = (GLsizei)indexCount;
+        item.material = &material;
+        queue.Submit(item, glm::vec3(0.0f));
+    }
+
+    // queues the field for a depth pre-pass (see DepthPrepass); shader reads location 0 only, and the ground
+    // texture is opaque, so no alpha test is needed
+    void SubmitDepth(RenderQueue &queue, Shader &shader)
+    {
+        RenderItem item;
+        item.shader = &shader;
+        item.VAO = VAO;
+        item.indexType = indexType;
+        item.indexCount = (GLsizei)indexCount;
+        queue.Submit(item, glm::vec3(0.0f));
+    }
+
+    int Tiles() const { return dimension * dimension; }
+
+private:
+    int dimension;
+    unsigned int VAO, VBO, EBO;
+    unsigned int indexCount;
+    GLenum indexType;
+    // the texture Submit binds, unit 1 (specular) cleared
+    RenderMaterial material;
+};
+#endif
@@ -0,0 +1,817 @@
+#ifndef IMAGE_KERNELS_H
+#define IMAGE_KERNELS_H
+
+#include <learnopengl/cpu_features.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// one mip level, always 4 bytes per texel
+struct ImageLevel {
+    int width = 0, height = 0;
+    std::vector<unsigned char> pixels;
+};
+
+enum class MipFilter {
+    Box,   // 2x2 average, cheap enough to run on every load
+    Kaiser // 6 tap Kaiser windowed sinc, sharper; used when the result is cached
+};
+
+struct MipSettings {
+    MipFilter filter = MipFilter::Box;
+    // color data: filter in linear space and encode the result back to sRGB
+    bool srgb = false;
+    // filter with premultiplied alpha (in float, after the sRGB decode) so transparent texels do not bleed their
+    // color into the mips; texels that end up fully transparent keep the filtered straight color
+    bool premultiplyAlpha = false;
+    // renormalize every level of a tangent space normal map
+    bool normalMap = false;
+};
+
+// Image processing used while loading textures: format conversion and mip chain generation on RGBA8 data.
+// Every kernel is thread safe and has a scalar reference implementation the SIMD variants must match bit exact.
+class ImageKernels
+{
+public:
+    // best instruction set the CPU supports
+    static Isa Detected()
+    {
+        return CpuFeatures::Best({Isa::SSE41, Isa::AVX2});
+    }
+
+    // instruction set used by the kernels; can be lowered to compare against the scalar path
+    static Isa &Active()
+    {
+        static Isa isa = Detected();
+        return isa;
+    }
+
+    // RGB -> RGBA with opaque alpha
+    static void ExpandRGBToRGBA(const unsigned char *src, unsigned char *dst, size_t count)
+    {
+        size_t done = 0;
+#if CPU_X86
+        if (Active() == Isa::AVX2)
+            done = expandRGBAVX2(src, dst, count);
+        else if (Active() == Isa::SSE41)
+            done = expandRGBSSE41(src, dst, count);
+#endif
+        for (size_t i = done; i < count; i++)
+        {
+            dst[i * 4 + 0] = src[i * 3 + 0];
+            dst[i * 4 + 1] = src[i * 3 + 1];
+            dst[i * 4 + 2] = src[i * 3 + 2];
+            dst[i * 4 + 3] = 255;
+        }
+    }
+
+    // any channel count -> RGBA; grey images are replicated, missing alpha is opaque
+    static void ExpandToRGBA(const unsigned char *src, int channels, unsigned char *dst, size_t count)
+    {
+        if (channels == 4)
+        {
+            std::memcpy(dst, src, count * 4);
+            return;
+        }
+        if (channels == 3)
+        {
+            ExpandRGBToRGBA(src, dst, count);
+            return;
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            const unsigned char *texel = src + i * channels;
+            dst[i * 4 + 0] = texel[0];
+            dst[i * 4 + 1] = channels > 1 ? texel[1] : texel[0];
+            dst[i * 4 + 2] = texel[0];
+            dst[i * 4 + 3] = 255;
+        }
+    }
+
+    // rgb *= alpha / 255, rounded
+    static void PremultiplyAlpha(unsigned char *rgba, size_t count)
+    {
+        size_t done = 0;
+#if CPU_X86
+        if (Active() == Isa::AVX2)
+            done = premultiplyAVX2(rgba, count);
+        else if (Active() == Isa::SSE41)
+            done = premultiplySSE41(rgba, count);
+#endif
+        for (size_t i = done; i < count; i++)
+        {
+            unsigned char *texel = rgba + i * 4;
+            for (int k = 0; k < 3; k++)
+                texel[k] = div255(texel[k] * texel[3]);
+        }
+    }
+
+    // inverse of PremultiplyAlpha; fully transparent texels stay black
+    static void UnpremultiplyAlpha(unsigned char *rgba, size_t count)
+    {
+        size_t done = 0;
+#if CPU_X86
+        if (Active() == Isa::AVX2)
+            done = unpremultiplyAVX2(rgba, count);
+        else if (Active() == Isa::SSE41)
+            done = unpremultiplySSE41(rgba, count);
+#endif
+        for (size_t i = done; i < count; i++)
+        {
+            unsigned char *texel = rgba + i * 4;
+            unsigned int alpha = texel[3];
+            if (alpha == 0 || alpha == 255)
+                continue;
+            for (int k = 0; k < 3; k++)
+                texel[k] = (unsigned char)std::min(255u, (texel[k] * 255u + alpha / 2) / alpha);
+        }
+    }
+
+    // copies one channel of RGBA texels into a tightly packed single channel image
+    static void ExtractChannel(const unsigned char *rgba, int channel, unsigned char *dst, size_t count)
+    {
+        size_t done = 0;
+#if CPU_X86
+        if (Active() != Isa::Scalar)
+            done = extractChannelSSE41(rgba, channel, dst, count);
+#endif
+        for (size_t i = done; i < count; i++)
+            dst[i] = rgba[i * 4 + channel];
+    }
+
+    // packs RGBA texels into 2 channels (red, green), e.g. for normal maps uploaded as GL_RG
+    static void PackRG(const unsigned char *rgba, unsigned char *dst, size_t count)
+    {
+        size_t done = 0;
+#if CPU_X86
+        if (Active() != Isa::Scalar)
+            done = packRGSSE41(rgba, dst, count);
+#endif
+        for (size_t i = done; i < count; i++)
+        {
+            dst[i * 2 + 0] = rgba[i * 4 + 0];
+            dst[i * 2 + 1] = rgba[i * 4 + 1];
+        }
+    }
+
+    // halves an RGBA image with a 2x2 box filter. Odd sizes drop the last row/column, like most drivers do.
+    // with srgb set the color channels are averaged in linear space, alpha is always linear.
+    // premultiplyAlpha weights the colors by alpha (see MipSettings); that path is scalar float.
+    static ImageLevel DownsampleBox(const ImageLevel &src, bool srgb, bool premultiplyAlpha = false)
+    {
+        ImageLevel dst;
+        dst.width = std::max(1, src.width / 2);
+        dst.height = std::max(1, src.height / 2);
+        dst.pixels.resize((size_t)dst.width * dst.height * 4);
+        for (int y = 0; y < dst.height; y++)
+        {
+            const unsigned char *row0 = &src.pixels[(size_t)std::min(y * 2, src.height - 1) * src.width * 4];
+            const unsigned char *row1 = &src.pixels[(size_t)std::min(y * 2 + 1, src.height - 1) * src.width * 4];
+            unsigned char *out = &dst.pixels[(size_t)y * dst.width * 4];
+            if (premultiplyAlpha)
+            {
+                // a column averages each texel with itself
+                size_t step = src.width == 1 ? 0 : 4;
+                for (int x = 0; x < dst.width; x++)
+                {
+                    const unsigned char *texels[4] = {row0 + x * 8, row0 + x * 8 + step, row1 + x * 8, row1 + x * 8 + step};
+                    boxTexelPremultiplied(texels, srgb, out + x * 4);
+                }
+                continue;
+            }
+            if (src.width == 1)
+            {
+                // a column: only average vertically
+                for (int k = 0; k < 4; k++)
+                    out[k] = srgb && k < 3 ? Tables().ToSRGB((Tables().toLinear[row0[k]] + Tables().toLinear[row1[k]]) * 0.5f)
+                                           : (unsigned char)((row0[k] + row1[k] + 1) / 2);
+                continue;
+            }
+            size_t done = 0;
+#if CPU_X86
+            if (Active() == Isa::AVX2)
+                done = srgb ? boxRowSRGBAVX2(row0, row1, out, dst.width) : boxRowAVX2(row0, row1, out, dst.width);
+            else if (Active() == Isa::SSE41 && !srgb)
+                done = boxRowSSE41(row0, row1, out, dst.width);
+#endif
+            if (srgb)
+                boxRowSRGB(row0 + done * 8, row1 + done * 8, out + done * 4, dst.width - done);
+            else
+                boxRow(row0 + done * 8, row1 + done * 8, out + done * 4, dst.width - done);
+        }
+        return dst;
+    }
+
+    // halves an RGBA image with a separable Kaiser windowed sinc, filtering in float (linear space when srgb is set).
+    // source rows are decoded into one float plane per channel with their even and odd columns split, so both
+    // passes are weighted sums of 6 contiguous rows that the SIMD kernels run 4 or 8 texels at a time.
+    // premultiplyAlpha filters premultiplied colors next to the straight ones (see MipSettings).
+    static ImageLevel DownsampleKaiser(const ImageLevel &src, bool srgb, bool premultiplyAlpha = false)
+    {
+        ImageLevel dst;
+        dst.width = std::max(1, src.width / 2);
+        dst.height = std::max(1, src.height / 2);
+        dst.pixels.resize((size_t)dst.width * dst.height * 4);
+
+        // a dimension of 1 is passed through instead of filtered
+        static const float passThrough[KaiserTaps] = {0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f};
+        const float *weightsX = src.width > 1 ? KaiserWeights() : passThrough;
+        const float *weightsY = src.height > 1 ? KaiserWeights() : passThrough;
+
+        const ColorTables &tables = Tables();
+        const float *color = srgb ? tables.toLinear : tables.alpha;
+
+        // every source row is read by up to 3 destination rows, so the decoded rows are kept in a ring of
+        // KaiserRing rows of 2 planes (even/odd columns) per channel: RGBA, then straight RGB when premultiplying
+        const int channels = premultiplyAlpha ? 7 : 4, planes = channels * 2;
+        const size_t stride = (size_t)dst.width + 2;
+        std::vector<float> ring(KaiserRing * planes * stride), vertical(planes * stride), filtered((size_t)dst.width * channels);
+        int ringRow[KaiserRing];
+        std::fill(ringRow, ringRow + KaiserRing, -1);
+
+        for (int y = 0; y < dst.height; y++)
+        {
+            // vertical pass over the planes, then the horizontal one from the even/odd columns
+            const float *rows[KaiserTaps];
+            for (int t = 0; t < KaiserTaps; t++)
+            {
+                int sy = std::min(std::max(y * 2 - KaiserTaps / 2 + 1 + t, 0), src.height - 1);
+                float *decoded = &ring[(size_t)(sy % KaiserRing) * planes * stride];
+                if (ringRow[sy % KaiserRing] != sy)
+                {
+                    kaiserDecodeRow(&src.pixels[(size_t)sy * src.width * 4], src.width, color, premultiplyAlpha, decoded, stride);
+                    ringRow[sy % KaiserRing] = sy;
+                }
+                rows[t] = decoded;
+            }
+            for (int plane = 0; plane < planes; plane++)
+            {
+                const float *taps[KaiserTaps];
+                for (int t = 0; t < KaiserTaps; t++)
+                    taps[t] = rows[t] + plane * stride;
+                kaiserSum(taps, weightsY, &vertical[plane * stride], stride);
+            }
+            for (int c = 0; c < channels; c++)
+            {
+                const float *even = &vertical[(c * 2) * stride], *odd = &vertical[(c * 2 + 1) * stride];
+                const float *taps[KaiserTaps] = {even, odd, even + 1, odd + 1, even + 2, odd + 2};
+                kaiserSum(taps, weightsX, &filtered[(size_t)c * dst.width], dst.width);
+            }
+
+            unsigned char *out = &dst.pixels[(size_t)y * dst.width * 4];
+            for (int x = 0; x < dst.width; x++)
+            {
+                float alpha = std::min(1.0f, std::max(0.0f, filtered[(size_t)3 * dst.width + x]));
+                out[x * 4 + 3] = tables.Encode(alpha, false);
+                for (int c = 0; c < 3; c++)
+                {
+                    float value = filtered[(size_t)c * dst.width + x];
+                    // unpremultiply before encoding; texels that round to transparent keep the straight color
+                    if (premultiplyAlpha)
+                        value = out[x * 4 + 3] ? value / alpha : filtered[(size_t)(4 + c) * dst.width + x];
+                    out[x * 4 + c] = tables.Encode(std::min(1.0f, std::max(0.0f, value)), srgb);
+                }
+            }
+        }
+        return dst;
+    }
+
+    // rescales tangent space normals stored as unsigned bytes to unit length
+    static void RenormalizeNormals(unsigned char *rgba, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            unsigned char *texel = rgba + i * 4;
+            float n[3];
+            for (int k = 0; k < 3; k++)
+                n[k] = texel[k] / 127.5f - 1.0f;
+            float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (length < 1e-5f)
+                continue;
+            for (int k = 0; k < 3; k++)
+                texel[k] = (unsigned char)std::min(255.0f, std::max(0.0f, (n[k] / length + 1.0f) * 127.5f + 0.5f));
+        }
+    }
+
+    // full RGBA8 mip chain down to 1x1 from an image with 1 to 4 channels
+    static std::vector<ImageLevel> BuildMipChain(const unsigned char *pixels, int width, int height, int channels, const MipSettings &settings)
+    {
+        std::vector<ImageLevel> chain;
+        ImageLevel base;
+        base.width = width;
+        base.height = height;
+        base.pixels.resize((size_t)width * height * 4);
+        ExpandToRGBA(pixels, channels, base.pixels.data(), (size_t)width * height);
+
+        // every level is stored with straight alpha; the filters premultiply in float and undo it before encoding
+        bool premultiply = settings.premultiplyAlpha && channels == 4;
+        chain.push_back(std::move(base));
+        while (chain.back().width > 1 || chain.back().height > 1)
+        {
+            const ImageLevel &previous = chain.back();
+            ImageLevel level = settings.filter == MipFilter::Kaiser ? DownsampleKaiser(previous, settings.srgb, premultiply)
+                                                                    : DownsampleBox(previous, settings.srgb, premultiply);
+            // the next level is filtered from the renormalized one
+            if (settings.normalMap)
+                RenormalizeNormals(level.pixels.data(), (size_t)level.width * level.height);
+            chain.push_back(std::move(level));
+        }
+        return chain;
+    }
+
+private:
+    static const int KaiserTaps = 6;
+    // decoded source rows DownsampleKaiser keeps; destination row y reads rows 2y - 2 .. 2y + 3
+    static const int KaiserRing = 8;
+
+    struct ColorTables {
+        float toLinear[256];
+        float alpha[256];
+        unsigned char fromLinear[4096];
+
+        ColorTables()
+        {
+            for (int i = 0; i < 256; i++)
+            {
+                float c = i / 255.0f;
+                toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+                alpha[i] = c;
+            }
+            for (int i = 0; i < 4096; i++)
+            {
+                float l = i / 4095.0f;
+                float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+                fromLinear[i] = (unsigned char)std::min(255.0f, std::max(0.0f, c * 255.0f + 0.5f));
+            }
+        }
+
+        unsigned char ToSRGB(float linear) const { return fromLinear[(int)(linear * 4095.0f + 0.5f)]; }
+        // a filtered value in [0, 1] to a byte, through the sRGB curve for color
+        unsigned char Encode(float value, bool srgb) const { return srgb ? ToSRGB(value) : (unsigned char)(value * 255.0f + 0.5f); }
+    };
+
+    static const ColorTables &Tables()
+    {
+        static const ColorTables tables;
+        return tables;
+    }
+
+    // taps at source offsets -2.5 .. 2.5 around the center of each destination texel, normalized
+    static const float *KaiserWeights()
+    {
+        struct Weights {
+            float w[KaiserTaps];
+            Weights()
+            {
+                const double pi = 3.14159265358979323846, alpha = 4.0, radius = KaiserTaps / 2.0;
+                double sum = 0.0, values[KaiserTaps];
+                for (int t = 0; t < KaiserTaps; t++)
+                {
+                    double x = t - radius + 0.5;
+                    double sinc = std::sin(pi * x / 2.0) / (pi * x / 2.0);
+                    double r = x / radius;
+                    double window = besselI0(alpha * std::sqrt(std::max(0.0, 1.0 - r * r))) / besselI0(alpha);
+                    values[t] = sinc * window;
+                    sum += values[t];
+                }
+                for (int t = 0; t < KaiserTaps; t++)
+                    w[t] = (float)(values[t] / sum);
+            }
+            static double besselI0(double x)
+            {
+                double sum = 1.0, term = 1.0;
+                for (int k = 1; k < 20; k++)
+                {
+                    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+                    sum += term;
+                }
+                return sum;
+            }
+        };
+        static const Weights weights;
+        return weights.w;
+    }
+
+    // one box filtered texel from 4 source texels in float, colors weighted by alpha. a result that rounds to
+    // fully transparent keeps the plain average color instead of black
+    static void boxTexelPremultiplied(const unsigned char *const texels[4], bool srgb, unsigned char *out)
+    {
+        const ColorTables &tables = Tables();
+        const float *color = srgb ? tables.toLinear : tables.alpha;
+        float alpha = 0.0f, premultiplied[3] = {0.0f, 0.0f, 0.0f}, straight[3] = {0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < 4; i++)
+        {
+            float a = tables.alpha[texels[i][3]];
+            alpha += a;
+            for (int k = 0; k < 3; k++)
+            {
+                premultiplied[k] += color[texels[i][k]] * a;
+                straight[k] += color[texels[i][k]];
+            }
+        }
+        out[3] = tables.Encode(alpha * 0.25f, false);
+        for (int k = 0; k < 3; k++)
+            out[k] = tables.Encode(std::min(1.0f, out[3] ? premultiplied[k] / alpha : straight[k] * 0.25f), srgb);
+    }
+
+    static unsigned char div255(unsigned int value)
+    {
+        value += 128;
+        return (unsigned char)((value + (value >> 8)) >> 8);
+    }
+
+    // decodes a source row into 2 planes of stride floats per channel (RGBA, then straight RGB when premultiplying),
+    // holding its even and odd columns. column k of the even/odd plane is source column 2k - 2 / 2k - 1 clamped to
+    // the image, so destination texel x reads columns x .. x + 2 of both
+    static void kaiserDecodeRow(const unsigned char *row, int width, const float *color, bool premultiplyAlpha, float *planes, size_t stride)
+    {
+        const float *alpha = Tables().alpha;
+        for (size_t k = 0; k < stride; k++)
+        {
+            const unsigned char *even = row + std::min(std::max((int)k * 2 - 2, 0), width - 1) * 4;
+            const unsigned char *odd = row + std::min(std::max((int)k * 2 - 1, 0), width - 1) * 4;
+            float evenAlpha = alpha[even[3]], oddAlpha = alpha[odd[3]];
+            planes[6 * stride + k] = evenAlpha;
+            planes[7 * stride + k] = oddAlpha;
+            for (int c = 0; c < 3; c++)
+            {
+                float evenColor = color[even[c]], oddColor = color[odd[c]];
+                if (premultiplyAlpha)
+                {
+                    planes[(c * 2) * stride + k] = evenColor * evenAlpha;
+                    planes[(c * 2 + 1) * stride + k] = oddColor * oddAlpha;
+                    planes[((4 + c) * 2) * stride + k] = evenColor;
+                    planes[((4 + c) * 2 + 1) * stride + k] = oddColor;
+                }
+                else
+                {
+                    planes[(c * 2) * stride + k] = evenColor;
+                    planes[(c * 2 + 1) * stride + k] = oddColor;
+                }
+            }
+        }
+    }
+
+    // out[i] = sum of taps[t][i] * weights[t]; the SIMD variants add in the same order, so they match bit exact
+    static void kaiserSum(const float *const taps[KaiserTaps], const float *weights, float *out, size_t count)
+    {
+        size_t done = 0;
+#if CPU_X86
+        if (Active() == Isa::AVX2)
+            done = kaiserSumAVX2(taps, weights, out, count);
+        else if (Active() == Isa::SSE41)
+            done = kaiserSumSSE41(taps, weights, out, count);
+#endif
+        for (size_t i = done; i < count; i++)
+        {
+            float sum = 0.0f;
+            for (int t = 0; t < KaiserTaps; t++)
+                sum += taps[t][i] * weights[t];
+            out[i] = sum;
+        }
+    }
+
+    static void boxRow(const unsigned char *row0, const unsigned char *row1, unsigned char *out, size_t count)
+    {
+        for (size_t x = 0; x < count; x++)
+            for (int k = 0; k < 4; k++)
+                out[x * 4 + k] = (unsigned char)((row0[x * 8 + k] + row0[x * 8 + 4 + k] + row1[x * 8 + k] + row1[x * 8 + 4 + k] + 2) / 4);
+    }
+
+    static void boxRowSRGB(const unsigned char *row0, const unsigned char *row1, unsigned char *out, size_t count)
+    {
+        // same operation order as the AVX2 kernel, so both round identically
+        const ColorTables &tables = Tables();
+        for (size_t x = 0; x < count; x++)
+        {
+            const unsigned char *a = row0 + x * 8, *b = row1 + x * 8;
+            for (int k = 0; k < 3; k++)
+            {
+                float sum = (tables.toLinear[a[k]] + tables.toLinear[b[k]]) + (tables.toLinear[a[4 + k]] + tables.toLinear[b[4 + k]]);
+                out[x * 4 + k] = tables.ToSRGB(sum * 0.25f);
+            }
+            float alpha = (tables.alpha[a[3]] + tables.alpha[b[3]]) + (tables.alpha[a[7]] + tables.alpha[b[7]]);
+            out[x * 4 + 3] = (unsigned char)(int)(alpha * 0.25f * 255.0f + 0.5f);
+        }
+    }
+
+#if CPU_X86
+    // every SIMD kernel processes whole vectors and returns how many texels it handled; the caller finishes the tail
+
+    CPU_SSE41 static size_t expandRGBSSE41(const unsigned char *src, unsigned char *dst, size_t count)
+    {
+        const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+        size_t i = 0;
+        // 16 byte loads for 4 texels (12 bytes): stop early enough not to read past the end
+        for (; i + 6 <= count; i += 4)
+        {
+            __m128i rgb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 3));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha));
+        }
+        return i;
+    }
+
+    CPU_AVX2 static size_t expandRGBAVX2(const unsigned char *src, unsigned char *dst, size_t count)
+    {
+        const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                                 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+        size_t i = 0;
+        for (; i + 10 <= count; i += 8)
+        {
+            __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 3));
+            __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 3 + 12));
+            __m256i rgb = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(rgb, shuffle), alpha));
+        }
+        return i;
+    }
+
+    // (x * a) / 255 rounded on 16 bit lanes: t = x * a + 128; (t + (t >> 8)) >> 8
+    CPU_SSE41 static __m128i premultiplyWordsSSE41(__m128i texels)
+    {
+        const __m128i alphaShuffle = _mm_setr_epi8(6, 7, 6, 7, 6, 7, -1, -1, 14, 15, 14, 15, 14, 15, -1, -1);
+        const __m128i alphaOne = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+        __m128i alpha = _mm_or_si128(_mm_shuffle_epi8(texels, alphaShuffle), alphaOne);
+        __m128i t = _mm_add_epi16(_mm_mullo_epi16(texels, alpha), _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+    }
+
+    CPU_SSE41 static size_t premultiplySSE41(unsigned char *rgba, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i texels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + i * 4));
+            __m128i low = premultiplyWordsSSE41(_mm_cvtepu8_epi16(texels));
+            __m128i high = premultiplyWordsSSE41(_mm_cvtepu8_epi16(_mm_srli_si128(texels, 8)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(rgba + i * 4), _mm_packus_epi16(low, high));
+        }
+        return i;
+    }
+
+    CPU_AVX2 static __m256i premultiplyWordsAVX2(__m256i texels)
+    {
+        const __m256i alphaShuffle = _mm256_setr_epi8(6, 7, 6, 7, 6, 7, -1, -1, 14, 15, 14, 15, 14, 15, -1, -1,
+                                                      6, 7, 6, 7, 6, 7, -1, -1, 14, 15, 14, 15, 14, 15, -1, -1);
+        const __m256i alphaOne = _mm256_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255);
+        __m256i alpha = _mm256_or_si256(_mm256_shuffle_epi8(texels, alphaShuffle), alphaOne);
+        __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(texels, alpha), _mm256_set1_epi16(128));
+        return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+    }
+
+    CPU_AVX2 static size_t premultiplyAVX2(unsigned char *rgba, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + i * 4));
+            __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + i * 4 + 16));
+            // packus works per 128 bit lane, so the two halves come back in order
+            __m256i a = premultiplyWordsAVX2(_mm256_cvtepu8_epi16(low));
+            __m256i b = premultiplyWordsAVX2(_mm256_cvtepu8_epi16(high));
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(rgba + i * 4), packed);
+        }
+        return i;
+    }
+
+    // (x * 255 + a / 2) / a in float, one texel per 128 bit lane: the numerator is exact and every quotient that
+    // is not clamped to 255 is far enough from the next integer for the truncation to match the integer division
+    CPU_SSE41 static __m128i unpremultiplyTexelsSSE41(__m128i texels)
+    {
+        __m128i alpha = _mm_shuffle_epi32(texels, _MM_SHUFFLE(3, 3, 3, 3));
+        __m128 numerator = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(texels), _mm_set1_ps(255.0f)),
+                                      _mm_cvtepi32_ps(_mm_srli_epi32(alpha, 1)));
+        __m128i color = _mm_min_epi32(_mm_cvttps_epi32(_mm_div_ps(numerator, _mm_cvtepi32_ps(alpha))), _mm_set1_epi32(255));
+        // alpha itself and texels with alpha 0 or 255 are kept
+        __m128i keep = _mm_or_si128(_mm_setr_epi32(0, 0, 0, -1),
+                                    _mm_or_si128(_mm_cmpeq_epi32(alpha, _mm_setzero_si128()), _mm_cmpeq_epi32(alpha, _mm_set1_epi32(255))));
+        return _mm_blendv_epi8(color, texels, keep);
+    }
+
+    CPU_SSE41 static size_t unpremultiplySSE41(unsigned char *rgba, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i texels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + i * 4));
+            __m128i t0 = unpremultiplyTexelsSSE41(_mm_cvtepu8_epi32(texels));
+            __m128i t1 = unpremultiplyTexelsSSE41(_mm_cvtepu8_epi32(_mm_srli_si128(texels, 4)));
+            __m128i t2 = unpremultiplyTexelsSSE41(_mm_cvtepu8_epi32(_mm_srli_si128(texels, 8)));
+            __m128i t3 = unpremultiplyTexelsSSE41(_mm_cvtepu8_epi32(_mm_srli_si128(texels, 12)));
+            __m128i packed = _mm_packus_epi16(_mm_packus_epi32(t0, t1), _mm_packus_epi32(t2, t3));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(rgba + i * 4), packed);
+        }
+        return i;
+    }
+
+    // two texels per 256 bit register, same arithmetic as unpremultiplyTexelsSSE41
+    CPU_AVX2 static __m256i unpremultiplyTexelsAVX2(__m256i texels)
+    {
+        __m256i alpha = _mm256_shuffle_epi32(texels, _MM_SHUFFLE(3, 3, 3, 3));
+        __m256 numerator = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(texels), _mm256_set1_ps(255.0f)),
+                                         _mm256_cvtepi32_ps(_mm256_srli_epi32(alpha, 1)));
+        __m256i color = _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_div_ps(numerator, _mm256_cvtepi32_ps(alpha))),
+                                         _mm256_set1_epi32(255));
+        __m256i keep = _mm256_or_si256(_mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1),
+                                       _mm256_or_si256(_mm256_cmpeq_epi32(alpha, _mm256_setzero_si256()),
+                                                       _mm256_cmpeq_epi32(alpha, _mm256_set1_epi32(255))));
+        return _mm256_blendv_epi8(color, texels, keep);
+    }
+
+    CPU_AVX2 static size_t unpremultiplyAVX2(unsigned char *rgba, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + i * 4));
+            __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + i * 4 + 16));
+            __m256i t0 = unpremultiplyTexelsAVX2(_mm256_cvtepu8_epi32(low));
+            __m256i t1 = unpremultiplyTexelsAVX2(_mm256_cvtepu8_epi32(_mm_srli_si128(low, 8)));
+            __m256i t2 = unpremultiplyTexelsAVX2(_mm256_cvtepu8_epi32(high));
+            __m256i t3 = unpremultiplyTexelsAVX2(_mm256_cvtepu8_epi32(_mm_srli_si128(high, 8)));
+            // the packs work per 128 bit lane and leave texels 0 2 4 6 | 1 3 5 7, put them back in order
+            __m256i words0 = _mm256_packus_epi32(t0, t1), words1 = _mm256_packus_epi32(t2, t3);
+            __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(words0, words1), _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(rgba + i * 4), bytes);
+        }
+        return i;
+    }
+
+    CPU_SSE41 static size_t extractChannelSSE41(const unsigned char *rgba, int channel, unsigned char *dst, size_t count)
+    {
+        const char c = (char)channel;
+        const __m128i shuffle = _mm_setr_epi8(c, c + 4, c + 8, c + 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            const __m128i *src = reinterpret_cast<const __m128i *>(rgba + i * 4);
+            __m128i a = _mm_shuffle_epi8(_mm_loadu_si128(src + 0), shuffle);
+            __m128i b = _mm_shuffle_epi8(_mm_loadu_si128(src + 1), shuffle);
+            __m128i c0 = _mm_shuffle_epi8(_mm_loadu_si128(src + 2), shuffle);
+            __m128i d = _mm_shuffle_epi8(_mm_loadu_si128(src + 3), shuffle);
+            __m128i packed = _mm_unpacklo_epi64(_mm_unpacklo_epi32(a, b), _mm_unpacklo_epi32(c0, d));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), packed);
+        }
+        return i;
+    }
+
+    CPU_SSE41 static size_t packRGSSE41(const unsigned char *rgba, unsigned char *dst, size_t count)
+    {
+        const __m128i shuffle = _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i a = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + i * 4)), shuffle);
+            __m128i b = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + i * 4 + 16)), shuffle);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 2), _mm_unpacklo_epi64(a, b));
+        }
+        return i;
+    }
+
+    CPU_SSE41 static size_t kaiserSumSSE41(const float *const taps[KaiserTaps], const float *weights, float *out, size_t count)
+    {
+        __m128 w[KaiserTaps];
+        for (int t = 0; t < KaiserTaps; t++)
+            w[t] = _mm_set1_ps(weights[t]);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 sum = _mm_setzero_ps();
+            for (int t = 0; t < KaiserTaps; t++)
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(taps[t] + i), w[t]));
+            _mm_storeu_ps(out + i, sum);
+        }
+        return i;
+    }
+
+    CPU_AVX2 static size_t kaiserSumAVX2(const float *const taps[KaiserTaps], const float *weights, float *out, size_t count)
+    {
+        __m256 w[KaiserTaps];
+        for (int t = 0; t < KaiserTaps; t++)
+            w[t] = _mm256_set1_ps(weights[t]);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 sum = _mm256_setzero_ps();
+            for (int t = 0; t < KaiserTaps; t++)
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(taps[t] + i), w[t]));
+            _mm256_storeu_ps(out + i, sum);
+        }
+        return i;
+    }
+
+    // sums the two horizontally adjacent texels held in the low and high 64 bits of a 16 bit register
+    CPU_SSE41 static __m128i boxPairsSSE41(__m128i row0, __m128i row1)
+    {
+        __m128i sum = _mm_add_epi16(row0, row1);
+        return _mm_add_epi16(sum, _mm_srli_si128(sum, 8));
+    }
+
+    // 2 destination texels as 16 bit words from 4 source texels per row
+    CPU_SSE41 static __m128i boxTwoSSE41(const unsigned char *row0, const unsigned char *row1)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1));
+        __m128i left = boxPairsSSE41(_mm_cvtepu8_epi16(a), _mm_cvtepu8_epi16(b));
+        __m128i right = boxPairsSSE41(_mm_cvtepu8_epi16(_mm_srli_si128(a, 8)), _mm_cvtepu8_epi16(_mm_srli_si128(b, 8)));
+        return _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(left, right), _mm_set1_epi16(2)), 2);
+    }
+
+    CPU_SSE41 static size_t boxRowSSE41(const unsigned char *row0, const unsigned char *row1, unsigned char *out, size_t count)
+    {
+        size_t x = 0;
+        for (; x + 4 <= count; x += 4)
+        {
+            __m128i first = boxTwoSSE41(row0 + x * 8, row1 + x * 8);
+            __m128i second = boxTwoSSE41(row0 + x * 8 + 16, row1 + x * 8 + 16);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x * 4), _mm_packus_epi16(first, second));
+        }
+        return x;
+    }
+
+    CPU_AVX2 static size_t boxRowAVX2(const unsigned char *row0, const unsigned char *row1, unsigned char *out, size_t count)
+    {
+        const __m256i round = _mm256_set1_epi16(2);
+        size_t x = 0;
+        // 8 source texels per row give 4 destination texels
+        for (; x + 4 <= count; x += 4)
+        {
+            __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + x * 8));
+            __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + x * 8 + 16));
+            __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + x * 8));
+            __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + x * 8 + 16));
+            // each 128 bit lane holds two horizontally adjacent texels: [t0 t1 | t2 t3]
+            __m256i first = _mm256_add_epi16(_mm256_cvtepu8_epi16(a0), _mm256_cvtepu8_epi16(b0));
+            __m256i second = _mm256_add_epi16(_mm256_cvtepu8_epi16(a1), _mm256_cvtepu8_epi16(b1));
+            first = _mm256_add_epi16(first, _mm256_srli_si256(first, 8));
+            second = _mm256_add_epi16(second, _mm256_srli_si256(second, 8));
+            // low qwords of each lane: [d0 d2 | d1 d3] -> reorder to d0 d1 d2 d3
+            __m256i sum = _mm256_srli_epi16(_mm256_add_epi16(_mm256_unpacklo_epi64(first, second), round), 2);
+            sum = _mm256_permute4x64_epi64(sum, _MM_SHUFFLE(3, 1, 2, 0));
+            __m256i packed = _mm256_packus_epi16(sum, sum);
+            packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x * 4), _mm256_castsi256_si128(packed));
+        }
+        return x;
+    }
+
+    // linear space box filter: texels are decoded with gathers from the sRGB table, averaged in float and
+    // encoded again with a gather from the 12 bit linear -> sRGB table. Alpha goes through a linear table.
+    CPU_AVX2 static size_t boxRowSRGBAVX2(const unsigned char *row0, const unsigned char *row1, unsigned char *out, size_t count)
+    {
+        struct GatherTables {
+            float toLinear[512];    // sRGB decode for color, then value / 255 for alpha at +256
+            int fromLinear[4096];
+            GatherTables()
+            {
+                for (int i = 0; i < 256; i++)
+                {
+                    toLinear[i] = Tables().toLinear[i];
+                    toLinear[256 + i] = Tables().alpha[i];
+                }
+                for (int i = 0; i < 4096; i++)
+                    fromLinear[i] = Tables().fromLinear[i];
+            }
+        };
+        static const GatherTables tables;
+        const __m256i alphaOffset = _mm256_setr_epi32(0, 0, 0, 256, 0, 0, 0, 256);
+        const __m256 colorMask = _mm256_castsi256_ps(_mm256_setr_epi32(-1, -1, -1, 0, -1, -1, -1, 0));
+        const __m256 quarter = _mm256_set1_ps(0.25f);
+        const __m256 colorScale = _mm256_set1_ps(4095.0f), alphaScale = _mm256_set1_ps(255.0f), half = _mm256_set1_ps(0.5f);
+        size_t x = 0;
+        for (; x + 2 <= count; x += 2)
+        {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + x * 8));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + x * 8));
+            // [t0 | t1] of each source pair as 32 bit indices
+            __m256 s0 = _mm256_add_ps(
+                    _mm256_i32gather_ps(tables.toLinear, _mm256_add_epi32(_mm256_cvtepu8_epi32(a), alphaOffset), 4),
+                    _mm256_i32gather_ps(tables.toLinear, _mm256_add_epi32(_mm256_cvtepu8_epi32(b), alphaOffset), 4));
+            __m256 s1 = _mm256_add_ps(
+                    _mm256_i32gather_ps(tables.toLinear, _mm256_add_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(a, 8)), alphaOffset), 4),
+                    _mm256_i32gather_ps(tables.toLinear, _mm256_add_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(b, 8)), alphaOffset), 4));
+            // add the left and right texel of each pair: [d0 | d1]
+            __m256 sum = _mm256_add_ps(_mm256_permute2f128_ps(s0, s1, 0x20), _mm256_permute2f128_ps(s0, s1, 0x31));
+            __m256 average = _mm256_mul_ps(sum, quarter);
+            __m256i colorIndex = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(average, colorScale), half));
+            __m256i color = _mm256_i32gather_epi32(tables.fromLinear, colorIndex, 4);
+            __m256i alpha = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(average, alphaScale), half));
+            __m256i result = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(alpha), _mm256_castsi256_ps(color), colorMask));
+            __m256i words = _mm256_packus_epi32(result, result);
+            __m256i bytes = _mm256_packus_epi16(words, words);
+            uint32_t first = (uint32_t)_mm256_extract_epi32(bytes, 0), second = (uint32_t)_mm256_extract_epi32(bytes, 4);
+            std::memcpy(out + x * 4, &first, 4);
+            std::memcpy(out + x * 4 + 4, &second, 4);
+        }
+        return x;
+    }
+#endif
+};
+#endif
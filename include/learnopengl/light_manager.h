@@ -0,0 +1,273 @@
+#ifndef LIGHT_MANAGER_H
+#define LIGHT_MANAGER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/uniform_buffer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+// the most lights of each kind the Lights block holds; has to match resources/shaders/lights.glsl
+#define MAX_POINT_LIGHTS 64
+#define MAX_SPOT_LIGHTS 16
+
+// distance at which a light of the given brightness, attenuated by 1 / (constant + linear * d + quadratic * d^2),
+// falls below 5/256 and stops making a visible difference; infinite for lights without falloff
+inline float LightRange(float constant, float linear, float quadratic, float brightness)
+{
+    float limit = brightness * 256.0f / 5.0f;
+    if (limit <= constant)
+        return 0.0f;
+    if (quadratic > 0.0f)
+        return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * (constant - limit))) / (2.0f * quadratic);
+    if (linear > 0.0f)
+        return (limit - constant) / linear;
+    return std::numeric_limits<float>::infinity();
+}
+
+struct DirectionalLight {
+    glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    glm::vec3 ambient = glm::vec3(0.0f);
+    glm::vec3 diffuse = glm::vec3(0.0f);
+    glm::vec3 specular = glm::vec3(0.0f);
+};
+
+struct PointLight {
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 ambient = glm::vec3(0.0f);
+    glm::vec3 diffuse = glm::vec3(0.0f);
+    glm::vec3 specular = glm::vec3(0.0f);
+    float constant = 1.0f;
+    float linear = 0.0f;
+    float quadratic = 0.0f;
+
+    // how far the light reaches (see LightRange), from its brightest channel
+    float Range() const
+    {
+        glm::vec3 sum = ambient + diffuse + specular;
+        return LightRange(constant, linear, quadratic, std::max(sum.x, std::max(sum.y, sum.z)));
+    }
+};
+
+struct SpotLight {
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    glm::vec3 ambient = glm::vec3(0.0f);
+    glm::vec3 diffuse = glm::vec3(0.0f);
+    glm::vec3 specular = glm::vec3(0.0f);
+    float constant = 1.0f;
+    float linear = 0.0f;
+    float quadratic = 0.0f;
+    // cosines of the inner and outer cone angles
+    float cutOff = 1.0f;
+    float outerCutOff = 1.0f;
+
+    // how far the light reaches along its cone (see LightRange), from its brightest channel
+    float Range() const
+    {
+        glm::vec3 sum = ambient + diffuse + specular;
+        return LightRange(constant, linear, quadratic, std::max(sum.x, std::max(sum.y, sum.z)));
+    }
+};
+
+// keeps every light of the scene in one uniform buffer (the Lights block in resources/shaders/lights.glsl)
+// that the lighting shader loops over with the runtime light counts. Changes only mark the buffer dirty;
+// Upload sends it once per change, so static lights cost nothing per frame however many there are.
+// The block holds the first MAX_POINT_LIGHTS / MAX_SPOT_LIGHTS; the renderers that take their lights from
+// PointLights() and SpotLights() (DeferredRenderer, ClusteredLights) see all of them.
+class LightManager
+{
+public:
+    LightManager()
+    {
+        std::memset(static_cast<void *>(&block), 0, sizeof(block));
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(block), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, UniformBlock::LightsBinding, UBO);
+    }
+
+    LightManager(const LightManager &) = delete;
+    LightManager &operator=(const LightManager &) = delete;
+
+    // frees the GL objects; has to run while the context is still current
+    void Delete()
+    {
+        glDeleteBuffers(1, &UBO);
+    }
+
+    void SetDirectional(const DirectionalLight &light)
+    {
+        directional = light;
+        GpuDirectionalLight gpu;
+        gpu.direction = glm::vec4(light.direction, 0.0f);
+        gpu.ambient = glm::vec4(light.ambient, 0.0f);
+        gpu.diffuse = glm::vec4(light.diffuse, 0.0f);
+        gpu.specular = glm::vec4(light.specular, 0.0f);
+        assign(block.directional, gpu);
+    }
+
+    // index of the new light; lights past MAX_POINT_LIGHTS are left out of the Lights block
+    int AddPointLight(const PointLight &light)
+    {
+        if (pointLights.size() == MAX_POINT_LIGHTS)
+            std::cout << "WARNING::LIGHTS::POINT_LIGHTS_PAST_BLOCK: the Lights block holds the first " << MAX_POINT_LIGHTS << std::endl;
+        pointLights.push_back(light);
+        revision++;
+        if (block.counts.x < MAX_POINT_LIGHTS)
+        {
+            block.counts.x++;
+            dirty = true;
+        }
+        SetPointLight((int)pointLights.size() - 1, light);
+        return (int)pointLights.size() - 1;
+    }
+
+    void SetPointLight(int index, const PointLight &light)
+    {
+        if (index < 0 || index >= (int)pointLights.size())
+            return;
+        if (std::memcmp(&pointLights[index], &light, sizeof(PointLight)) != 0)
+        {
+            pointLights[index] = light;
+            revision++;
+        }
+        if (index >= block.counts.x)
+            return;
+        GpuPointLight gpu;
+        gpu.position = glm::vec4(light.position, 0.0f);
+        gpu.ambient = glm::vec4(light.ambient, 0.0f);
+        gpu.diffuse = glm::vec4(light.diffuse, 0.0f);
+        gpu.specular = glm::vec4(light.specular, 0.0f);
+        gpu.attenuation = glm::vec4(light.constant, light.linear, light.quadratic, 0.0f);
+        assign(block.pointLights[index], gpu);
+    }
+
+    // index of the new light; lights past MAX_SPOT_LIGHTS are left out of the Lights block
+    int AddSpotLight(const SpotLight &light)
+    {
+        if (spotLights.size() == MAX_SPOT_LIGHTS)
+            std::cout << "WARNING::LIGHTS::SPOT_LIGHTS_PAST_BLOCK: the Lights block holds the first " << MAX_SPOT_LIGHTS << std::endl;
+        spotLights.push_back(light);
+        revision++;
+        if (block.counts.y < MAX_SPOT_LIGHTS)
+        {
+            block.counts.y++;
+            dirty = true;
+        }
+        SetSpotLight((int)spotLights.size() - 1, light);
+        return (int)spotLights.size() - 1;
+    }
+
+    void SetSpotLight(int index, const SpotLight &light)
+    {
+        if (index < 0 || index >= (int)spotLights.size())
+            return;
+        if (std::memcmp(&spotLights[index], &light, sizeof(SpotLight)) != 0)
+        {
+            spotLights[index] = light;
+            revision++;
+        }
+        if (index >= block.counts.y)
+            return;
+        GpuSpotLight gpu;
+        gpu.position = glm::vec4(light.position, 0.0f);
+        gpu.direction = glm::vec4(light.direction, 0.0f);
+        gpu.ambient = glm::vec4(light.ambient, 0.0f);
+        gpu.diffuse = glm::vec4(light.diffuse, 0.0f);
+        gpu.specular = glm::vec4(light.specular, 0.0f);
+        gpu.attenuation = glm::vec4(light.constant, light.linear, light.quadratic, 0.0f);
+        gpu.cutOff = glm::vec4(light.cutOff, light.outerCutOff, 0.0f, 0.0f);
+        assign(block.spotLights[index], gpu);
+    }
+
+    void Clear()
+    {
+        pointLights.clear();
+        spotLights.clear();
+        block.counts = glm::ivec4(0);
+        dirty = true;
+        revision++;
+    }
+
+    int PointLightCount() const { return (int)pointLights.size(); }
+    int SpotLightCount() const { return (int)spotLights.size(); }
+
+    // every light, also those past the Lights block's capacity
+    const DirectionalLight &Directional() const { return directional; }
+    const std::vector<PointLight> &PointLights() const { return pointLights; }
+    const std::vector<SpotLight> &SpotLights() const { return spotLights; }
+
+    // changes whenever a point or spot light is added, changed or removed, so copies of them know when to update
+    size_t Revision() const { return revision; }
+
+    // sends the lights if any changed since the last upload; returns whether it did
+    bool Upload()
+    {
+        if (!dirty)
+            return false;
+        // only the lights in use are sent
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, offsetof(LightsBlock, pointLights) + block.counts.x * sizeof(GpuPointLight), &block);
+        if (block.counts.y > 0)
+            glBufferSubData(GL_UNIFORM_BUFFER, offsetof(LightsBlock, spotLights), block.counts.y * sizeof(GpuSpotLight), block.spotLights);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        dirty = false;
+        uploads++;
+        return true;
+    }
+
+    // number of uploads so far
+    size_t Uploads() const { return uploads; }
+
+private:
+    // std140 images of the structs in lights.glsl
+    struct GpuDirectionalLight {
+        glm::vec4 direction, ambient, diffuse, specular;
+    };
+    struct GpuPointLight {
+        glm::vec4 position, ambient, diffuse, specular;
+        glm::vec4 attenuation; // constant, linear, quadratic
+    };
+    struct GpuSpotLight {
+        glm::vec4 position, direction, ambient, diffuse, specular;
+        glm::vec4 attenuation; // constant, linear, quadratic
+        glm::vec4 cutOff;      // inner and outer cone cosines
+    };
+    struct LightsBlock {
+        GpuDirectionalLight directional;
+        glm::ivec4 counts; // point lights, spot lights
+        GpuPointLight pointLights[MAX_POINT_LIGHTS];
+        GpuSpotLight spotLights[MAX_SPOT_LIGHTS];
+    };
+    static_assert(offsetof(LightsBlock, counts) == 64 && offsetof(LightsBlock, pointLights) == 80
+                  && offsetof(LightsBlock, spotLights) == 80 + 80 * MAX_POINT_LIGHTS, "LightsBlock does not match std140");
+
+    LightsBlock block;
+    DirectionalLight directional;
+    std::vector<PointLight> pointLights;
+    std::vector<SpotLight> spotLights;
+    unsigned int UBO;
+    bool dirty = true;
+    size_t uploads = 0;
+    size_t revision = 0;
+
+    template <typename T>
+    void assign(T &target, const T &value)
+    {
+        if (std::memcmp(&target, &value, sizeof(T)) == 0)
+            return;
+        target = value;
+        dirty = true;
+    }
+};
+#endif
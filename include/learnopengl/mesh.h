@@ -6,41 +6,175 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/bvh.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/render_queue.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/vertex_format.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <memory>
 #include <string>
 #include <vector>
 using namespace std;
 
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
-};
-
-
-
 struct Texture {
     unsigned int id;
     string type;
     string path;
 };
 
+// index range of a merged mesh that is drawn with one set of textures (one source material).
+// indices are relative to baseVertex, so they stay small enough for 16-bit index buffers.
+struct SubMesh {
+    size_t firstIndex = 0;
+    size_t indexCount = 0;
+    size_t baseVertex = 0;
+    size_t vertexCount = 0;
+    vector<Texture> textures;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+};
+
+// CPU side result of importing a single mesh. It can be produced on any thread and is turned into a Mesh
+// on the GL thread. A fresh import fills the Vertex/index vectors and converts them to the GPU layout; a mesh
+// read from a mesh cache only has the GPU layout data, pointing into the mapped cache file.
+struct MeshData {
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;
+    vector<Texture>      textures; // ids are not resolved yet, only type and path are set
+    // set for meshes merged from several source meshes (see Model::MergeByMaterial), which draw these ranges
+    // with their own textures instead of textures
+    vector<SubMesh>      subMeshes;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    // radius of the sphere around the center of the bounds that holds every vertex
+    float boundsRadius = 0.0f;
+    // object space triangles for ray and overlap queries (see SceneBVH); built by buildTriangleBVH
+    shared_ptr<const TriangleBVH> triangles;
+    // post-transform vertex cache statistics of the index order (see MeshOptimizer), 0 if not analyzed
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+
+    // vertex/index buffers in the layout uploaded to the GPU (see VertexFormat), built on the loader thread.
+    // empty if the mesh is uploaded in the Vertex layout or was read from a mesh cache
+    vector<unsigned char> gpuVertices;
+    vector<unsigned char> gpuIndices;
+    VertexLayout layout;
+
+    // the GPU layout data of a cached mesh in the mapped cache file
+    const unsigned char *mappedVertices = nullptr;
+    const unsigned char *mappedIndices = nullptr;
+    size_t mappedVertexCount = 0;
+    size_t mappedIndexCount = 0;
+
+    bool Cached() const { return mappedVertices != nullptr; }
+    size_t VertexCount() const { return Cached() ? mappedVertexCount : vertices.size(); }
+    size_t IndexCount() const { return Cached() ? mappedIndexCount : indices.size(); }
+
+    const unsigned char *GpuVertexData() const { return Cached() ? mappedVertices : gpuVertices.data(); }
+    size_t GpuVertexBytes() const { return Cached() ? mappedVertexCount * layout.stride : gpuVertices.size(); }
+    const unsigned char *GpuIndexData() const { return Cached() ? mappedIndices : gpuIndices.data(); }
+    size_t GpuIndexBytes() const { return Cached() ? mappedIndexCount * layout.IndexSize() : gpuIndices.size(); }
+
+    void buildGpuData(const VertexFormatSettings &settings)
+    {
+        // indices only have to address the largest range
+        size_t addressed = vertices.size();
+        if (!subMeshes.empty())
+        {
+            addressed = 0;
+            for (const SubMesh &subMesh : subMeshes)
+                addressed = std::max(addressed, subMesh.vertexCount);
+        }
+        layout = VertexFormat::Layout(settings, addressed);
+        gpuVertices.resize(vertices.size() * layout.stride);
+        gpuIndices.resize(indices.size() * layout.IndexSize());
+        VertexFormat::Build(vertices.data(), vertices.size(), layout, gpuVertices.data());
+        VertexFormat::BuildIndices(indices.data(), indices.size(), layout, gpuIndices.data());
+    }
+
+    void computeBounds()
+    {
+        boundsMin = boundsMax = glm::vec3(0.0f);
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            boundsMin = i == 0 ? vertices[i].Position : glm::min(boundsMin, vertices[i].Position);
+            boundsMax = i == 0 ? vertices[i].Position : glm::max(boundsMax, vertices[i].Position);
+        }
+        boundsRadius = BoundsRadius(vertices.data(), vertices.size(), boundsMin, boundsMax);
+    }
+
+    void buildTriangleBVH()
+    {
+        vector<glm::vec3> positions(vertices.size());
+        for (size_t i = 0; i < positions.size(); i++)
+            positions[i] = vertices[i].Position;
+        vector<uint32_t> triangleIndices(indices.begin(), indices.end());
+        // indices of merged meshes are relative to their range's base vertex
+        for (const SubMesh &subMesh : subMeshes)
+            for (size_t i = subMesh.firstIndex; i < subMesh.firstIndex + subMesh.indexCount; i++)
+                triangleIndices[i] += (uint32_t)subMesh.baseVertex;
+        triangles = make_shared<const TriangleBVH>(positions.data(), triangleIndices.data(), triangleIndices.size());
+    }
+
+    // usually well below the half diagonal of the box, as few meshes reach into all of its corners
+    static float BoundsRadius(const Vertex *vertices, size_t count, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+    {
+        glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        float radius2 = 0.0f;
+        for (size_t i = 0; i < count; i++)
+        {
+            glm::vec3 d = vertices[i].Position - center;
+            radius2 = std::max(radius2, glm::dot(d, d));
+        }
+        return std::sqrt(radius2);
+    }
+};
+
+// per instance vertex data of Model::DrawInstanced, read by lightingShader.vs built with INSTANCED: the model
+// matrix at locations 6-9 and its normal matrix at 10-12, computed once on the CPU instead of per vertex
+struct InstanceData {
+    glm::mat4 model;
+    glm::mat3 normalMatrix;
+
+    enum : GLuint {
+        ModelLocation = 6,
+        NormalMatrixLocation = 10
+    };
+
+    InstanceData() {}
+    explicit InstanceData(const glm::mat4 &model)
+        : model(model), normalMatrix(glm::transpose(glm::inverse(glm::mat3(model))))
+    {
+    }
+};
+static_assert(sizeof(InstanceData) == 100, "InstanceData has to be tightly packed");
+
 class Mesh {
 public:
     // mesh Data
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    // ranges drawn with their own textures for merged meshes, empty otherwise
+    vector<SubMesh>      subMeshes;
+    // object space bounds of the vertex positions
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    // radius of the sphere around the center of the bounds that holds every vertex (see FrustumCuller)
+    float boundsRadius;
+    // object space triangles for ray and overlap queries (see SceneBVH)
+    shared_ptr<const TriangleBVH> triangles;
+    unsigned int indexCount;
+    VertexLayout layout;
 
     unsigned int VAO;
+    // positions only, from a copy of the vertex buffer's position attribute behind the same index buffer,
+    // for depth passes (see SubmitDepth); 0 if the layout has no positions
+    unsigned int depthVAO = 0;
     std::string glslIdentifierPrefix;
     // constructor
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
@@ -48,25 +182,238 @@ public:
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
+        this->indexCount = static_cast<unsigned int>(this->indices.size());
+
+        boundsMin = boundsMax = glm::vec3(0.0f);
+        for (size_t i = 0; i < this->vertices.size(); i++)
+        {
+            boundsMin = i == 0 ? this->vertices[i].Position : glm::min(boundsMin, this->vertices[i].Position);
+            boundsMax = i == 0 ? this->vertices[i].Position : glm::max(boundsMax, this->vertices[i].Position);
+        }
+        boundsRadius = MeshData::BoundsRadius(this->vertices.data(), this->vertices.size(), boundsMin, boundsMax);
+        vector<glm::vec3> positions(this->vertices.size());
+        for (size_t i = 0; i < positions.size(); i++)
+            positions[i] = this->vertices[i].Position;
+        triangles = make_shared<const TriangleBVH>(positions.data(), this->indices.data(), this->indices.size());
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(this->vertices.data(), this->vertices.size() * sizeof(Vertex), this->indices.data(), this->indices.size() * sizeof(unsigned int));
+        SetShaderTextureNamePrefix("");
+    }
+
+    // constructor for imported data (see MeshData). The vertex/index data is uploaded straight from
+    // the import (or the mapped mesh cache), in the GPU layout if there is one, and no CPU side copy is kept.
+    Mesh(const MeshData &data, vector<Texture> textures, vector<SubMesh> subMeshes = vector<SubMesh>())
+    {
+        this->textures = textures;
+        this->subMeshes = subMeshes;
+        this->indexCount = static_cast<unsigned int>(data.IndexCount());
+        this->boundsMin = data.boundsMin;
+        this->boundsMax = data.boundsMax;
+        this->boundsRadius = data.boundsRadius;
+        this->triangles = data.triangles;
+
+        if (data.GpuVertexBytes() > 0)
+        {
+            this->layout = data.layout;
+            this->indexCount = static_cast<unsigned int>(data.GpuIndexBytes() / data.layout.IndexSize());
+            setupMesh(data.GpuVertexData(), data.GpuVertexBytes(), data.GpuIndexData(), data.GpuIndexBytes());
+        }
+        else
+            setupMesh(data.vertices.data(), data.vertices.size() * sizeof(Vertex), data.indices.data(), data.indices.size() * sizeof(unsigned int));
+        SetShaderTextureNamePrefix("");
+    }
+
+    // sets the prefix of the sampler uniforms (e.g. "material.") and builds the materials (texture names and
+    // sampler names) once instead of on every draw
+    void SetShaderTextureNamePrefix(const std::string &prefix)
+    {
+        glslIdentifierPrefix = prefix;
+        materials.clear();
+        if (subMeshes.empty())
+            materials.push_back(buildMaterial(prefix, textures));
+        for (const SubMesh &subMesh : subMeshes)
+            materials.push_back(buildMaterial(prefix, subMesh.textures));
     }
 
     // render the mesh
     void Draw(Shader &shader)
     {
-        // bind appropriate textures
+        draw(shader, 0);
+    }
+
+    // renders instances copies of the mesh, one per InstanceData in instanceBuffer
+    void DrawInstanced(Shader &shader, unsigned int instanceBuffer, GLsizei instances)
+    {
+        if (instanceBuffer != this->instanceBuffer)
+            attachInstances(instanceBuffer);
+        draw(shader, instances);
+    }
+
+    // draws the copies of the mesh for a depth pre-pass, split between shader and alphaTested like SubmitDepth;
+    // both are built with INSTANCED and get their packedVertex uniform set per draw
+    template<typename Cutout>
+    void DrawDepthInstanced(Shader &shader, Shader &alphaTested, unsigned int instanceBuffer, GLsizei instances, const Cutout &cutout)
+    {
+        if (!depthVAO)
+            return;
+        if (instanceBuffer != this->instanceBuffer)
+            attachInstances(instanceBuffer);
+        for (size_t i = 0; i < DrawCount(); i++)
+        {
+            bool alpha = cutout(materials[i]);
+            Shader &program = alpha ? alphaTested : shader;
+            program.use();
+            const VertexUniforms &uniforms = VertexUniforms::Of(program);
+            program.set(uniforms.packedVertex, layout.packed);
+            uniforms.SetQuantization(program, layout);
+            GLState::Shared().BindVertexArray(alpha ? VAO : depthVAO);
+            if (alpha)
+                bindTextures(program, materials[i]);
+            drawElements(i, instances);
+        }
+    }
+
+    // number of draw calls Draw issues
+    size_t DrawCount() const { return subMeshes.empty() ? 1 : subMeshes.size(); }
+
+    // the GPU buffers, e.g. for copying the mesh into a GeometryArena
+    unsigned int VertexBuffer() const { return VBO; }
+    unsigned int IndexBuffer() const { return EBO; }
+    size_t VertexBytes() const { return vertexBytes; }
+    size_t IndexBytes() const { return indexBytes; }
+    // one material per draw of Draw, in the same order
+    const vector<RenderMaterial> &Materials() const { return materials; }
+
+    // queues the draws of Draw instead of issuing them
+    void Submit(RenderQueue &queue, Shader &shader, const glm::mat4 &model)
+    {
+        RenderItem item;
+        item.shader = &shader;
+        item.VAO = VAO;
+        item.indexType = layout.indexType;
+        item.layout = &layout;
+        item.model = model;
+        if (subMeshes.empty())
+        {
+            item.indexCount = (GLsizei)indexCount;
+            item.material = &materials[0];
+            queue.Submit(item, (boundsMin + boundsMax) * 0.5f);
+        }
+        for (size_t i = 0; i < subMeshes.size(); i++)
+        {
+            const SubMesh &subMesh = subMeshes[i];
+            item.indexCount = (GLsizei)subMesh.indexCount;
+            item.indexOffset = subMesh.firstIndex * layout.IndexSize();
+            item.baseVertex = (GLint)subMesh.baseVertex;
+            item.material = &materials[i];
+            queue.Submit(item, (subMesh.boundsMin + subMesh.boundsMax) * 0.5f);
+        }
+    }
+
+    // queues the draws of a depth pre-pass: from the position-only stream with shader, or, for the materials
+    // cutout(material) says may discard texels, from the full vertex buffer with alphaTested and the material's
+    // textures (see DepthPrepass)
+    template<typename Cutout>
+    void SubmitDepth(RenderQueue &queue, Shader &shader, Shader &alphaTested, const glm::mat4 &model, const Cutout &cutout)
+    {
+        if (!depthVAO)
+            return;
+        RenderItem item;
+        item.indexType = layout.indexType;
+        item.layout = &layout;
+        item.model = model;
+        for (size_t i = 0; i < DrawCount(); i++)
+        {
+            bool alpha = cutout(materials[i]);
+            item.shader = alpha ? &alphaTested : &shader;
+            item.VAO = alpha ? VAO : depthVAO;
+            item.material = alpha ? &materials[i] : nullptr;
+            if (subMeshes.empty())
+            {
+                item.indexCount = (GLsizei)indexCount;
+                queue.Submit(item, (boundsMin + boundsMax) * 0.5f);
+                continue;
+            }
+            const SubMesh &subMesh = subMeshes[i];
+            item.indexCount = (GLsizei)subMesh.indexCount;
+            item.indexOffset = subMesh.firstIndex * layout.IndexSize();
+            item.baseVertex = (GLint)subMesh.baseVertex;
+            queue.Submit(item, (subMesh.boundsMin + subMesh.boundsMax) * 0.5f);
+        }
+    }
+
+private:
+    // render data
+    unsigned int VBO, EBO;
+    unsigned int depthVBO = 0;
+    size_t vertexBytes = 0, indexBytes = 0;
+    // the buffer the VAO's instance attributes read, 0 before the first DrawInstanced
+    unsigned int instanceBuffer = 0;
+    // textures and sampler names of textures, or of each submesh's textures (see SetShaderTextureNamePrefix)
+    vector<RenderMaterial> materials;
+
+    // draws the mesh, instanced if instances > 0
+    void draw(Shader &shader, GLsizei instances)
+    {
+        VertexUniforms::Of(shader).SetQuantization(shader, layout);
+
+        // draw mesh; the VAO and textures stay bound, GLState drops the binds of a following draw that match
+        GLState::Shared().BindVertexArray(VAO);
+        // one draw per material range of a merged mesh
+        for (size_t i = 0; i < DrawCount(); i++)
+        {
+            bindTextures(shader, materials[i]);
+            drawElements(i, instances);
+        }
+    }
+
+    // issues draw i of DrawCount, the whole mesh or the range of submesh i, from the bound VAO; instanced if instances > 0
+    void drawElements(size_t i, GLsizei instances)
+    {
+        if (subMeshes.empty())
+        {
+            if (instances > 0)
+                glDrawElementsInstanced(GL_TRIANGLES, indexCount, layout.indexType, 0, instances);
+            else
+                glDrawElements(GL_TRIANGLES, indexCount, layout.indexType, 0);
+            return;
+        }
+        const SubMesh &subMesh = subMeshes[i];
+        void *offset = (void*)(subMesh.firstIndex * layout.IndexSize());
+        if (instances > 0)
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, (GLsizei)subMesh.indexCount, layout.indexType, offset,
+                                              instances, (GLint)subMesh.baseVertex);
+        else
+            glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)subMesh.indexCount, layout.indexType, offset, (GLint)subMesh.baseVertex);
+    }
+
+    void bindTextures(Shader &shader, const RenderMaterial &material)
+    {
+        // point the samplers at their texture units
+        material.SetSamplers(shader);
+        // and bind the textures to those units
+        for(unsigned int i = 0; i < material.textures.size(); i++)
+            GLState::Shared().BindTexture(i, GL_TEXTURE_2D, material.textures[i]);
+    }
+
+    // the texture names and sampler uniform names (prefix + type + N, the N counting textures of the same type).
+    // The lighting shaders sample unit 0 as the diffuse and unit 1 as the specular map, so the first texture of
+    // each of those types gets that unit (0, reading black, if there is none) and every other texture, normal and
+    // height maps included, goes to the units after them.
+    static RenderMaterial buildMaterial(const string &prefix, const vector<Texture> &textures)
+    {
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
+        vector<unsigned int> ids = {0, 0};
+        vector<string> names = {prefix + "texture_diffuse1", prefix + "texture_specular1"};
+        for(const Texture &texture : textures)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
-            string name = textures[i].type;
+            const string &name = texture.type;
             if(name == "texture_diffuse")
                 number = std::to_string(diffuseNr++);
             else if(name == "texture_specular")
@@ -75,65 +422,89 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to stream
             else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            if (name == "texture_diffuse" && diffuseNr == 2)
+                ids[0] = texture.id;
+            else if (name == "texture_specular" && specularNr == 2)
+                ids[1] = texture.id;
+            else
+            {
+                ids.push_back(texture.id);
+                names.push_back(prefix + name + number);
+            }
         }
-
-
-
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        return RenderMaterial(ids, names);
     }
 
-private:
-    // render data
-    unsigned int VBO, EBO;
+    // points the instance attributes (InstanceData) of both VAOs at buffer
+    void attachInstances(unsigned int buffer)
+    {
+        instanceBuffer = buffer;
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        for (unsigned int vao : {VAO, depthVAO})
+        {
+            if (!vao)
+                continue;
+            GLState::Shared().BindVertexArray(vao);
+            for (GLuint column = 0; column < 4; column++)
+            {
+                GLuint location = InstanceData::ModelLocation + column;
+                glEnableVertexAttribArray(location);
+                glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                      (void*)(offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+                glVertexAttribDivisor(location, 1);
+            }
+            for (GLuint column = 0; column < 3; column++)
+            {
+                GLuint location = InstanceData::NormalMatrixLocation + column;
+                glEnableVertexAttribArray(location);
+                glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                      (void*)(offsetof(InstanceData, normalMatrix) + column * sizeof(glm::vec3)));
+                glVertexAttribDivisor(location, 1);
+            }
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
 
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const void *vertexData, size_t vertexBytes, const void *indexData, size_t indexBytes)
     {
+        this->vertexBytes = vertexBytes;
+        this->indexBytes = indexBytes;
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
+        GLState::Shared().BindVertexArray(VAO);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertexData, GL_STATIC_DRAW);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indexData, GL_STATIC_DRAW);
+
+        // set the vertex attribute pointers (position, normal, texture coords, tangent, bitangent at locations 0-4)
+        layout.Apply();
+
+        // the depth pre-pass reads positions only; a tight copy of them fetches less than the full vertices
+        if (layout.attributes & VertexAttribute::Position)
+        {
+            size_t count = vertexBytes / layout.stride;
+            vector<unsigned char> positions(count * layout.PositionStride());
+            VertexFormat::BuildPositions(static_cast<const unsigned char *>(vertexData), count, layout, positions.data());
+            glGenVertexArrays(1, &depthVAO);
+            glGenBuffers(1, &depthVBO);
+            GLState::Shared().BindVertexArray(depthVAO);
+            glBindBuffer(GL_ARRAY_BUFFER, depthVBO);
+            glBufferData(GL_ARRAY_BUFFER, positions.size(), positions.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+            layout.ApplyPositions();
+        }
+
+        GLState::Shared().BindVertexArray(0);
     }
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,627 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/mesh.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Binary cache of an imported model, stored next to the source file as "<source>.meshcache".
+// It holds the meshes as they are uploaded: vertex/index buffers in the GPU layout (see VertexFormat) with
+// their quantization, and the triangle BVH of each mesh. The file is mmap'd on load and the blobs are handed to
+// glBufferData as they are, so a warm start neither imports, converts nor builds anything. It is rebuilt when the
+// source or one of the files it depends on (the material libraries of an .obj) changed, when the import flags,
+// weld tolerances, GPU vertex format or merge setting changed, or when the format was bumped.
+// Models merged by material are stored merged, with their SubMesh table.
+//
+// layout (native endianness, every blob 16 byte aligned):
+//   MeshCacheHeader
+//   MeshCacheRecord[meshCount]
+//   MeshCacheSubMesh[subMeshCount]
+//   MeshCacheTexture[textureCount]
+//   MeshCacheDependency[dependencyCount]
+//   string table (NUL terminated texture types and paths, dependency paths)
+//   per mesh: vertex, index, BVH node, BVH triangle and triangle id blobs, referenced by offset from the records
+#define MESH_CACHE_MAGIC "RGMESH\0\0"
+#define MESH_CACHE_VERSION 7u
+#define MESH_CACHE_EXTENSION ".meshcache"
+
+struct MeshCacheHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t importFlags;
+    uint64_t sourceMTime;
+    uint64_t sourceSize;
+    uint64_t pathHash;
+    // VertexFormatSettings::Hash() of the GPU layout the blobs are in
+    uint32_t vertexFormatHash;
+    uint32_t meshCount;
+    uint32_t textureCount;
+    uint32_t stringTableSize;
+    uint64_t stringTableOffset;
+    float    boundsMin[3];
+    float    boundsMax[3];
+    // WeldSettings::Hash() of the import, and the model's vertex/index counts before welding
+    uint32_t weldHash;
+    // Model::MergeByMaterial() of the import
+    uint32_t mergeByMaterial;
+    uint64_t importedVertexCount;
+    uint64_t importedIndexCount;
+    uint32_t subMeshCount;
+    uint32_t dependencyCount;
+};
+
+struct MeshCacheRecord {
+    // vertexCount vertices of layoutStride bytes and indexCount indices of layoutIndexType
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    // the TriangleBVH: nodes, three corners per triangle in leaf order and the source index of each triangle
+    uint64_t nodeOffset;
+    uint64_t triangleOffset;
+    uint64_t triangleIdOffset;
+    uint32_t nodeCount;
+    uint32_t triangleCount;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t textureFirst;
+    uint32_t textureCount;
+    float    boundsMin[3];
+    float    boundsMax[3];
+    // vertex cache statistics of the stored (optimized) index order
+    float    acmr;
+    float    atvr;
+    float    boundsRadius;
+    // material ranges of a merged mesh (see SubMesh)
+    uint32_t subMeshFirst;
+    uint32_t subMeshCount;
+    // VertexLayout of the vertex/index blobs
+    uint32_t layoutPacked;
+    uint32_t layoutAttributes;
+    uint32_t layoutStride;
+    uint32_t layoutIndexType;
+    float    positionOffset[3];
+    float    positionScale[3];
+    float    uvOffset[2];
+    float    uvScale[2];
+};
+
+struct MeshCacheSubMesh {
+    uint64_t firstIndex;
+    uint64_t indexCount;
+    uint64_t baseVertex;
+    uint64_t vertexCount;
+    uint32_t textureFirst;
+    uint32_t textureCount;
+    float    boundsMin[3];
+    float    boundsMax[3];
+};
+
+struct MeshCacheTexture {
+    uint32_t typeOffset;
+    uint32_t pathOffset;
+};
+
+// another file the import read, e.g. an .obj's mtllib: the cache is stale once its size or mtime differ.
+// a file that was missing is stored with size MissingSize, so creating it invalidates the cache as well
+struct MeshCacheDependency {
+    static const uint64_t MissingSize = ~0ull;
+    uint32_t pathOffset;
+    uint32_t reserved;
+    uint64_t mtime;
+    uint64_t size;
+};
+
+// 64-bit FNV-1a, used to key the cache on the full source path
+inline uint64_t MeshCacheHash(const void *data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+class MeshCacheFile
+{
+public:
+    MeshCacheFile() : base(nullptr), size(0) {}
+    ~MeshCacheFile() { Close(); }
+
+    MeshCacheFile(const MeshCacheFile &) = delete;
+    MeshCacheFile &operator=(const MeshCacheFile &) = delete;
+
+    static std::string PathFor(const std::string &sourcePath)
+    {
+        return sourcePath + MESH_CACHE_EXTENSION;
+    }
+
+    // maps the cache for sourcePath; returns false (and leaves nothing mapped) if the cache is missing or stale.
+    bool Open(const std::string &sourcePath, unsigned int importFlags, uint32_t weldHash, uint32_t vertexFormatHash,
+              bool mergeByMaterial)
+    {
+        Close();
+        struct stat sourceStat;
+        if (stat(sourcePath.c_str(), &sourceStat) != 0)
+            return false;
+
+        std::string cachePath = PathFor(sourcePath);
+        int fd = open(cachePath.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat cacheStat;
+        if (fstat(fd, &cacheStat) != 0 || (size_t)cacheStat.st_size < sizeof(MeshCacheHeader))
+        {
+            close(fd);
+            return false;
+        }
+        size = (size_t)cacheStat.st_size;
+        void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED)
+        {
+            size = 0;
+            return false;
+        }
+        base = static_cast<const unsigned char *>(mapping);
+
+        const MeshCacheHeader &h = Header();
+        bool valid = std::memcmp(h.magic, MESH_CACHE_MAGIC, sizeof(h.magic)) == 0
+                && h.version == MESH_CACHE_VERSION
+                && h.importFlags == importFlags
+                && h.weldHash == weldHash
+                && h.mergeByMaterial == (mergeByMaterial ? 1u : 0u)
+                && h.vertexFormatHash == vertexFormatHash
+                && h.sourceMTime == (uint64_t)sourceStat.st_mtime
+                && h.sourceSize == (uint64_t)sourceStat.st_size
+                && h.pathHash == MeshCacheHash(sourcePath.data(), sourcePath.size())
+                && h.stringTableOffset + h.stringTableSize <= size
+                && dependencyTableOffset() + (uint64_t)h.dependencyCount * sizeof(MeshCacheDependency) <= size;
+        for (unsigned int i = 0; valid && i < h.meshCount; i++)
+        {
+            const MeshCacheRecord &r = Record(i);
+            valid = r.layoutStride > 0
+                    && (r.layoutIndexType == GL_UNSIGNED_SHORT || r.layoutIndexType == GL_UNSIGNED_INT)
+                    && r.vertexOffset + (uint64_t)r.vertexCount * r.layoutStride <= size
+                    && r.indexOffset + (uint64_t)r.indexCount * Layout(i).IndexSize() <= size
+                    && r.triangleCount == r.indexCount / 3
+                    && r.nodeOffset + (uint64_t)r.nodeCount * sizeof(TriangleBVH::Node) <= size
+                    && r.triangleOffset + (uint64_t)r.triangleCount * 3 * sizeof(glm::vec3) <= size
+                    && r.triangleIdOffset + (uint64_t)r.triangleCount * sizeof(uint32_t) <= size
+                    && TriangleBVH::ValidNodes(Nodes(i), r.nodeCount, r.triangleCount)
+                    && (uint64_t)r.textureFirst + r.textureCount <= h.textureCount
+                    && (uint64_t)r.subMeshFirst + r.subMeshCount <= h.subMeshCount;
+            for (unsigned int k = r.subMeshFirst; valid && k < r.subMeshFirst + r.subMeshCount; k++)
+            {
+                const MeshCacheSubMesh &subMesh = SubMeshRecord(k);
+                valid = subMesh.firstIndex + subMesh.indexCount <= r.indexCount
+                        && subMesh.baseVertex + subMesh.vertexCount <= r.vertexCount
+                        && (uint64_t)subMesh.textureFirst + subMesh.textureCount <= h.textureCount;
+            }
+        }
+        // Textures() hands the strings out as C strings, so each has to start and end inside the table
+        for (unsigned int i = 0; valid && i < h.textureCount; i++)
+        {
+            const MeshCacheTexture &ref = TextureRef(i);
+            valid = validString(ref.typeOffset) && validString(ref.pathOffset);
+        }
+        for (unsigned int i = 0; valid && i < h.dependencyCount; i++)
+        {
+            const MeshCacheDependency &dependency = DependencyRecord(i);
+            valid = validString(dependency.pathOffset)
+                    && fileStamp(reinterpret_cast<const char *>(base + h.stringTableOffset) + dependency.pathOffset)
+                               == std::make_pair(dependency.mtime, dependency.size);
+        }
+        if (!valid)
+        {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close()
+    {
+        if (base)
+            munmap(const_cast<unsigned char *>(base), size);
+        base = nullptr;
+        size = 0;
+    }
+
+    const MeshCacheHeader &Header() const { return *reinterpret_cast<const MeshCacheHeader *>(base); }
+    unsigned int MeshCount() const { return Header().meshCount; }
+
+    const MeshCacheRecord &Record(unsigned int mesh) const
+    {
+        return reinterpret_cast<const MeshCacheRecord *>(base + sizeof(MeshCacheHeader))[mesh];
+    }
+    const MeshCacheSubMesh &SubMeshRecord(unsigned int subMesh) const
+    {
+        return reinterpret_cast<const MeshCacheSubMesh *>(
+                base + sizeof(MeshCacheHeader) + Header().meshCount * sizeof(MeshCacheRecord))[subMesh];
+    }
+    const MeshCacheTexture &TextureRef(unsigned int texture) const
+    {
+        return reinterpret_cast<const MeshCacheTexture *>(base + textureTableOffset())[texture];
+    }
+    const MeshCacheDependency &DependencyRecord(unsigned int dependency) const
+    {
+        return reinterpret_cast<const MeshCacheDependency *>(base + dependencyTableOffset())[dependency];
+    }
+    // vertex/index buffers of a mesh in its Layout
+    const unsigned char *Vertices(unsigned int mesh) const { return base + Record(mesh).vertexOffset; }
+    const unsigned char *Indices(unsigned int mesh) const { return base + Record(mesh).indexOffset; }
+    const TriangleBVH::Node *Nodes(unsigned int mesh) const
+    {
+        return reinterpret_cast<const TriangleBVH::Node *>(base + Record(mesh).nodeOffset);
+    }
+
+    VertexLayout Layout(unsigned int mesh) const
+    {
+        const MeshCacheRecord &r = Record(mesh);
+        VertexLayout layout;
+        layout.packed = r.layoutPacked != 0;
+        layout.attributes = r.layoutAttributes;
+        layout.stride = r.layoutStride;
+        layout.indexType = (GLenum)r.layoutIndexType;
+        layout.quantization.positionOffset = glm::vec3(r.positionOffset[0], r.positionOffset[1], r.positionOffset[2]);
+        layout.quantization.positionScale = glm::vec3(r.positionScale[0], r.positionScale[1], r.positionScale[2]);
+        layout.quantization.uvOffset = glm::vec2(r.uvOffset[0], r.uvOffset[1]);
+        layout.quantization.uvScale = glm::vec2(r.uvScale[0], r.uvScale[1]);
+        return layout;
+    }
+
+    // the mesh's triangle BVH, copied out of the mapping since meshes keep it after the upload
+    std::shared_ptr<const TriangleBVH> Triangles(unsigned int mesh) const
+    {
+        const MeshCacheRecord &r = Record(mesh);
+        return std::make_shared<const TriangleBVH>(Nodes(mesh), r.nodeCount,
+                reinterpret_cast<const glm::vec3 *>(base + r.triangleOffset),
+                reinterpret_cast<const uint32_t *>(base + r.triangleIdOffset), r.triangleCount);
+    }
+    // texture references of a mesh; only type and path (relative to the model directory) are set
+    std::vector<Texture> Textures(unsigned int mesh) const
+    {
+        return textureRefs(Record(mesh).textureFirst, Record(mesh).textureCount);
+    }
+
+    // material ranges of a merged mesh, with their texture references like Textures
+    std::vector<SubMesh> SubMeshes(unsigned int mesh) const
+    {
+        const MeshCacheRecord &r = Record(mesh);
+        std::vector<SubMesh> subMeshes;
+        for (unsigned int i = r.subMeshFirst; i < r.subMeshFirst + r.subMeshCount; i++)
+        {
+            const MeshCacheSubMesh &record = SubMeshRecord(i);
+            SubMesh subMesh;
+            subMesh.firstIndex = (size_t)record.firstIndex;
+            subMesh.indexCount = (size_t)record.indexCount;
+            subMesh.baseVertex = (size_t)record.baseVertex;
+            subMesh.vertexCount = (size_t)record.vertexCount;
+            subMesh.textures = textureRefs(record.textureFirst, record.textureCount);
+            subMesh.boundsMin = glm::vec3(record.boundsMin[0], record.boundsMin[1], record.boundsMin[2]);
+            subMesh.boundsMax = glm::vec3(record.boundsMax[0], record.boundsMax[1], record.boundsMax[2]);
+            subMeshes.push_back(subMesh);
+        }
+        return subMeshes;
+    }
+
+    // fills meshes with views into the mapped file; the cache has to stay open until they are uploaded.
+    void GetMeshes(std::vector<MeshData> &meshes) const
+    {
+        for (unsigned int i = 0; i < MeshCount(); i++)
+        {
+            const MeshCacheRecord &r = Record(i);
+            MeshData mesh;
+            mesh.layout = Layout(i);
+            mesh.triangles = Triangles(i);
+            mesh.mappedVertices = Vertices(i);
+            mesh.mappedVertexCount = r.vertexCount;
+            mesh.mappedIndices = Indices(i);
+            mesh.mappedIndexCount = r.indexCount;
+            mesh.textures = Textures(i);
+            mesh.subMeshes = SubMeshes(i);
+            mesh.boundsMin = glm::vec3(r.boundsMin[0], r.boundsMin[1], r.boundsMin[2]);
+            mesh.boundsMax = glm::vec3(r.boundsMax[0], r.boundsMax[1], r.boundsMax[2]);
+            mesh.boundsRadius = r.boundsRadius;
+            mesh.acmr = r.acmr;
+            mesh.atvr = r.atvr;
+            meshes.push_back(std::move(mesh));
+        }
+    }
+
+    // the material libraries an .obj file names (mtllib), as paths next to it; empty for other formats.
+    // reads the whole file, so it is only called when writing a cache
+    static std::vector<std::string> MaterialLibraries(const std::string &sourcePath)
+    {
+        std::vector<std::string> libraries;
+        if (sourcePath.size() < 4 || sourcePath.compare(sourcePath.size() - 4, 4, ".obj") != 0)
+            return libraries;
+        std::string directory = sourcePath.substr(0, sourcePath.find_last_of('/') + 1);
+        std::ifstream file(sourcePath);
+        std::string line;
+        while (std::getline(file, line))
+        {
+            size_t start = line.find_first_not_of(" \t");
+            if (start == std::string::npos || line.compare(start, 6, "mtllib") != 0)
+                continue;
+            std::istringstream names(line.substr(start + 6));
+            std::string name;
+            while (names >> name)
+                if (std::find(libraries.begin(), libraries.end(), directory + name) == libraries.end())
+                    libraries.push_back(directory + name);
+        }
+        return libraries;
+    }
+
+    // writes the cache for sourcePath from freshly imported meshes, once their GPU data and BVH are built.
+    // the file is written under a temporary name and renamed, so a crashed write never leaves a half valid cache.
+    // importedVertexCount/importedIndexCount are the counts before welding, kept for the weld report.
+    // dependencies are the other files the import read (see MaterialLibraries).
+    static bool Write(const std::string &sourcePath, unsigned int importFlags, uint32_t weldHash, uint32_t vertexFormatHash,
+                      bool mergeByMaterial, const std::vector<MeshData> &meshes, uint64_t importedVertexCount,
+                      uint64_t importedIndexCount, const std::vector<std::string> &dependencies)
+    {
+        struct stat sourceStat;
+        if (stat(sourcePath.c_str(), &sourceStat) != 0)
+            return false;
+
+        MeshCacheHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+        header.version = MESH_CACHE_VERSION;
+        header.importFlags = importFlags;
+        header.sourceMTime = (uint64_t)sourceStat.st_mtime;
+        header.sourceSize = (uint64_t)sourceStat.st_size;
+        header.pathHash = MeshCacheHash(sourcePath.data(), sourcePath.size());
+        header.vertexFormatHash = vertexFormatHash;
+        header.meshCount = (uint32_t)meshes.size();
+        header.weldHash = weldHash;
+        header.mergeByMaterial = mergeByMaterial ? 1u : 0u;
+        header.importedVertexCount = importedVertexCount;
+        header.importedIndexCount = importedIndexCount;
+
+        std::vector<MeshCacheRecord> records(meshes.size());
+        std::vector<MeshCacheSubMesh> subMeshes;
+        std::vector<MeshCacheTexture> textures;
+        std::string strings;
+        auto addTextures = [&](const std::vector<Texture> &references) {
+            for (const Texture &texture : references)
+            {
+                MeshCacheTexture ref;
+                ref.typeOffset = (uint32_t)strings.size();
+                strings.append(texture.type.c_str(), texture.type.size() + 1);
+                ref.pathOffset = (uint32_t)strings.size();
+                strings.append(texture.path.c_str(), texture.path.size() + 1);
+                textures.push_back(ref);
+            }
+        };
+        glm::vec3 modelMin(0.0f), modelMax(0.0f);
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            const MeshData &mesh = meshes[i];
+            MeshCacheRecord &r = records[i];
+            std::memset(&r, 0, sizeof(r));
+            r.vertexCount = (uint32_t)mesh.VertexCount();
+            r.indexCount = (uint32_t)mesh.IndexCount();
+            r.nodeCount = mesh.triangles ? (uint32_t)mesh.triangles->NodeCount() : 0;
+            r.triangleCount = mesh.triangles ? (uint32_t)mesh.triangles->TriangleCount() : 0;
+            r.layoutPacked = mesh.layout.packed ? 1u : 0u;
+            r.layoutAttributes = mesh.layout.attributes;
+            r.layoutStride = mesh.layout.stride;
+            r.layoutIndexType = (uint32_t)mesh.layout.indexType;
+            const VertexQuantization &quantization = mesh.layout.quantization;
+            for (int k = 0; k < 3; k++)
+            {
+                r.positionOffset[k] = quantization.positionOffset[k];
+                r.positionScale[k] = quantization.positionScale[k];
+            }
+            for (int k = 0; k < 2; k++)
+            {
+                r.uvOffset[k] = quantization.uvOffset[k];
+                r.uvScale[k] = quantization.uvScale[k];
+            }
+            r.textureFirst = (uint32_t)textures.size();
+            r.textureCount = (uint32_t)mesh.textures.size();
+            addTextures(mesh.textures);
+            r.subMeshFirst = (uint32_t)subMeshes.size();
+            r.subMeshCount = (uint32_t)mesh.subMeshes.size();
+            for (const SubMesh &subMesh : mesh.subMeshes)
+            {
+                MeshCacheSubMesh record;
+                std::memset(&record, 0, sizeof(record));
+                record.firstIndex = subMesh.firstIndex;
+                record.indexCount = subMesh.indexCount;
+                record.baseVertex = subMesh.baseVertex;
+                record.vertexCount = subMesh.vertexCount;
+                record.textureFirst = (uint32_t)textures.size();
+                record.textureCount = (uint32_t)subMesh.textures.size();
+                addTextures(subMesh.textures);
+                for (int k = 0; k < 3; k++)
+                {
+                    record.boundsMin[k] = subMesh.boundsMin[k];
+                    record.boundsMax[k] = subMesh.boundsMax[k];
+                }
+                subMeshes.push_back(record);
+            }
+            r.boundsRadius = mesh.boundsRadius;
+            r.acmr = mesh.acmr;
+            r.atvr = mesh.atvr;
+            for (int k = 0; k < 3; k++)
+            {
+                r.boundsMin[k] = mesh.boundsMin[k];
+                r.boundsMax[k] = mesh.boundsMax[k];
+            }
+            modelMin = i == 0 ? mesh.boundsMin : glm::min(modelMin, mesh.boundsMin);
+            modelMax = i == 0 ? mesh.boundsMax : glm::max(modelMax, mesh.boundsMax);
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            header.boundsMin[k] = modelMin[k];
+            header.boundsMax[k] = modelMax[k];
+        }
+        std::vector<MeshCacheDependency> dependencyRecords;
+        for (const std::string &path : dependencies)
+        {
+            MeshCacheDependency dependency;
+            std::memset(&dependency, 0, sizeof(dependency));
+            dependency.pathOffset = (uint32_t)strings.size();
+            strings.append(path.c_str(), path.size() + 1);
+            std::pair<uint64_t, uint64_t> stamp = fileStamp(path.c_str());
+            dependency.mtime = stamp.first;
+            dependency.size = stamp.second;
+            dependencyRecords.push_back(dependency);
+        }
+        header.subMeshCount = (uint32_t)subMeshes.size();
+        header.textureCount = (uint32_t)textures.size();
+        header.dependencyCount = (uint32_t)dependencyRecords.size();
+        header.stringTableSize = (uint32_t)strings.size();
+        header.stringTableOffset = sizeof(MeshCacheHeader) + records.size() * sizeof(MeshCacheRecord)
+                + subMeshes.size() * sizeof(MeshCacheSubMesh) + textures.size() * sizeof(MeshCacheTexture)
+                + dependencyRecords.size() * sizeof(MeshCacheDependency);
+
+        uint64_t offset = align(header.stringTableOffset + header.stringTableSize);
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            MeshCacheRecord &r = records[i];
+            r.vertexOffset = offset;
+            offset = align(offset + meshes[i].GpuVertexBytes());
+            r.indexOffset = offset;
+            offset = align(offset + meshes[i].GpuIndexBytes());
+            r.nodeOffset = offset;
+            offset = align(offset + (uint64_t)r.nodeCount * sizeof(TriangleBVH::Node));
+            r.triangleOffset = offset;
+            offset = align(offset + (uint64_t)r.triangleCount * 3 * sizeof(glm::vec3));
+            r.triangleIdOffset = offset;
+            offset = align(offset + (uint64_t)r.triangleCount * sizeof(uint32_t));
+        }
+
+        std::string cachePath = PathFor(sourcePath);
+        std::string tempPath = cachePath + ".tmp";
+        FILE *file = std::fopen(tempPath.c_str(), "wb");
+        if (!file)
+        {
+            std::cout << "ERROR::MESH_CACHE:: could not write " << cachePath << std::endl;
+            return false;
+        }
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+        if (!records.empty())
+            ok = ok && std::fwrite(records.data(), sizeof(MeshCacheRecord), records.size(), file) == records.size();
+        if (!subMeshes.empty())
+            ok = ok && std::fwrite(subMeshes.data(), sizeof(MeshCacheSubMesh), subMeshes.size(), file) == subMeshes.size();
+        if (!textures.empty())
+            ok = ok && std::fwrite(textures.data(), sizeof(MeshCacheTexture), textures.size(), file) == textures.size();
+        if (!dependencyRecords.empty())
+            ok = ok && std::fwrite(dependencyRecords.data(), sizeof(MeshCacheDependency), dependencyRecords.size(), file)
+                               == dependencyRecords.size();
+        ok = ok && std::fwrite(strings.data(), 1, strings.size(), file) == strings.size();
+        for (size_t i = 0; ok && i < meshes.size(); i++)
+        {
+            const MeshData &mesh = meshes[i];
+            const MeshCacheRecord &r = records[i];
+            ok = pad(file, r.vertexOffset) && writeBlob(file, mesh.GpuVertexData(), mesh.GpuVertexBytes())
+                    && pad(file, r.indexOffset) && writeBlob(file, mesh.GpuIndexData(), mesh.GpuIndexBytes());
+            if (ok && mesh.triangles)
+                ok = pad(file, r.nodeOffset)
+                        && writeBlob(file, mesh.triangles->NodeData(), r.nodeCount * sizeof(TriangleBVH::Node))
+                        && pad(file, r.triangleOffset)
+                        && writeBlob(file, mesh.triangles->TriangleVertices(), r.triangleCount * 3 * sizeof(glm::vec3))
+                        && pad(file, r.triangleIdOffset)
+                        && writeBlob(file, mesh.triangles->TriangleIds(), r.triangleCount * sizeof(uint32_t));
+        }
+        ok = std::fclose(file) == 0 && ok;
+        if (!ok || std::rename(tempPath.c_str(), cachePath.c_str()) != 0)
+        {
+            std::remove(tempPath.c_str());
+            std::cout << "ERROR::MESH_CACHE:: could not write " << cachePath << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    const unsigned char *base;
+    size_t size;
+
+    uint64_t textureTableOffset() const
+    {
+        const MeshCacheHeader &h = Header();
+        return sizeof(MeshCacheHeader) + (uint64_t)h.meshCount * sizeof(MeshCacheRecord) + (uint64_t)h.subMeshCount * sizeof(MeshCacheSubMesh);
+    }
+
+    uint64_t dependencyTableOffset() const
+    {
+        return textureTableOffset() + (uint64_t)Header().textureCount * sizeof(MeshCacheTexture);
+    }
+
+    // mtime and size of a file, MissingSize if it does not exist
+    static std::pair<uint64_t, uint64_t> fileStamp(const char *path)
+    {
+        struct stat fileStat;
+        if (stat(path, &fileStat) != 0)
+            return std::make_pair((uint64_t)0, (uint64_t)MeshCacheDependency::MissingSize);
+        return std::make_pair((uint64_t)fileStat.st_mtime, (uint64_t)fileStat.st_size);
+    }
+
+    std::vector<Texture> textureRefs(unsigned int first, unsigned int count) const
+    {
+        const char *strings = reinterpret_cast<const char *>(base + Header().stringTableOffset);
+        std::vector<Texture> references;
+        for (unsigned int i = first; i < first + count; i++)
+        {
+            Texture texture;
+            texture.id = 0;
+            texture.type = strings + TextureRef(i).typeOffset;
+            texture.path = strings + TextureRef(i).pathOffset;
+            references.push_back(texture);
+        }
+        return references;
+    }
+
+    // whether a NUL terminated string starts at offset inside the string table
+    bool validString(uint32_t offset) const
+    {
+        const MeshCacheHeader &h = Header();
+        if (offset >= h.stringTableSize)
+            return false;
+        const char *start = reinterpret_cast<const char *>(base + h.stringTableOffset) + offset;
+        return std::memchr(start, '\0', h.stringTableSize - offset) != nullptr;
+    }
+
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + 15) & ~(uint64_t)15;
+    }
+
+    static bool writeBlob(FILE *file, const void *data, size_t bytes)
+    {
+        return bytes == 0 || std::fwrite(data, 1, bytes, file) == bytes;
+    }
+
+    // zero fill the file up to offset, keeping blobs aligned
+    static bool pad(FILE *file, uint64_t offset)
+    {
+        static const char zeros[16] = {0};
+        long position = std::ftell(file);
+        if (position < 0 || (uint64_t)position > offset)
+            return false;
+        size_t count = (size_t)(offset - (uint64_t)position);
+        return count == 0 || std::fwrite(zeros, 1, count, file) == count;
+    }
+};
+#endif
@@ -0,0 +1,564 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <learnopengl/mesh.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+// post-transform vertex cache statistics of an index buffer, simulated with a FIFO cache
+struct VertexCacheStats {
+    // average cache miss ratio: transformed vertices per triangle (0.5 is the ideal for large regular meshes, 3 the worst)
+    float acmr = 0.0f;
+    // average transformed vertex ratio: transformed vertices per referenced vertex (1 is ideal)
+    float atvr = 0.0f;
+};
+
+// tolerances under which two imported vertices are considered the same
+struct WeldSettings {
+    bool enabled = true;
+    float positionEpsilon = 1e-5f;
+    float normalEpsilon = 1e-3f;
+    float uvEpsilon = 1e-5f;
+
+    // identifies the settings in the mesh cache key
+    uint32_t Hash() const
+    {
+        uint32_t values[4];
+        values[0] = enabled ? 1u : 0u;
+        std::memcpy(&values[1], &positionEpsilon, 4);
+        std::memcpy(&values[2], &normalEpsilon, 4);
+        std::memcpy(&values[3], &uvEpsilon, 4);
+        uint32_t hash = 2166136261u;
+        for (uint32_t value : values)
+            hash = (hash ^ value) * 16777619u;
+        return hash;
+    }
+};
+
+// vertex/index counts before and after welding, summed over the meshes of a model
+struct WeldStats {
+    size_t verticesBefore = 0, verticesAfter = 0;
+    size_t indicesBefore = 0, indicesAfter = 0;
+
+    WeldStats &operator+=(const WeldStats &other)
+    {
+        verticesBefore += other.verticesBefore;
+        verticesAfter += other.verticesAfter;
+        indicesBefore += other.indicesBefore;
+        indicesAfter += other.indicesAfter;
+        return *this;
+    }
+};
+
+// Import time vertex welding and triangle/vertex reordering:
+//  - welding of vertices whose position, normal and uv agree within WeldSettings, found through a hash grid
+//    on the position,
+//  - Tipsify (Sander, Nehab, Barczak 2007) for vertex cache locality, followed by its fast overdraw pass that
+//    sorts the cache clusters so outward facing parts of the mesh are drawn first,
+//  - Forsyth's linear speed vertex cache optimizer, used instead when the overdraw order costs too much
+//    cache efficiency,
+//  - vertex reordering by first use for fetch locality.
+// Everything is single threaded and allocation heavy, so it only runs when a model is imported (the result is
+// kept in the mesh cache).
+class MeshOptimizer
+{
+public:
+    // FIFO size the statistics and Tipsify assume; close to the effective cache of current GPUs
+    static const unsigned int CacheSize = 16;
+
+    static VertexCacheStats Analyze(const unsigned int *indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = CacheSize)
+    {
+        VertexCacheStats stats;
+        if (indexCount < 3 || vertexCount == 0)
+            return stats;
+        // a vertex is cached while fewer than cacheSize misses happened since it was loaded
+        std::vector<size_t> loadedAt(vertexCount, 0);
+        size_t misses = 0, referenced = 0;
+        std::vector<bool> seen(vertexCount, false);
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            unsigned int v = indices[i];
+            if (!seen[v])
+            {
+                seen[v] = true;
+                referenced++;
+            }
+            if (loadedAt[v] == 0 || misses - loadedAt[v] >= cacheSize)
+            {
+                misses++;
+                loadedAt[v] = misses;
+            }
+        }
+        stats.acmr = (float)misses / (float)(indexCount / 3);
+        stats.atvr = (float)misses / (float)referenced;
+        return stats;
+    }
+
+    // Tipsify: returns the new triangle order (as indices) and the first triangle of every cluster the
+    // algorithm started after a cache flush
+    static std::vector<unsigned int> Tipsify(const unsigned int *indices, size_t indexCount, size_t vertexCount,
+                                             unsigned int cacheSize, std::vector<size_t> *clusters = nullptr)
+    {
+        size_t triangleCount = indexCount / 3;
+        Adjacency adjacency(indices, indexCount, vertexCount);
+        std::vector<unsigned int> live(adjacency.counts);
+        std::vector<size_t> timestamps(vertexCount, 0);
+        std::vector<unsigned char> emitted(triangleCount, 0);
+        std::vector<unsigned int> deadEnd;
+        std::vector<unsigned int> candidates;
+        std::vector<unsigned int> result;
+        result.reserve(triangleCount * 3);
+        if (clusters)
+            clusters->clear();
+
+        size_t time = cacheSize + 1;
+        size_t cursor = 0;
+        long fanning = vertexCount > 0 ? 0 : -1;
+        bool newCluster = true;
+        while (fanning >= 0)
+        {
+            candidates.clear();
+            const unsigned int *fan = adjacency.Triangles((unsigned int)fanning);
+            for (unsigned int k = 0; k < adjacency.counts[fanning]; k++)
+            {
+                unsigned int t = fan[k];
+                if (emitted[t])
+                    continue;
+                if (newCluster && clusters)
+                    clusters->push_back(result.size() / 3);
+                newCluster = false;
+                for (int c = 0; c < 3; c++)
+                {
+                    unsigned int v = indices[t * 3 + c];
+                    result.push_back(v);
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    live[v]--;
+                    if (time - timestamps[v] > cacheSize)
+                        timestamps[v] = time++;
+                }
+                emitted[t] = true;
+            }
+
+            // next fanning vertex: the candidate that stays in the cache longest without being evicted by its own fan
+            long best = -1;
+            long bestPriority = -1;
+            for (unsigned int v : candidates)
+            {
+                if (live[v] == 0)
+                    continue;
+                long priority = 0;
+                if (time - timestamps[v] + 2 * live[v] <= cacheSize)
+                    priority = (long)(time - timestamps[v]);
+                if (priority > bestPriority)
+                {
+                    bestPriority = priority;
+                    best = v;
+                }
+            }
+            if (best < 0)
+            {
+                // dead end: the most recently used vertex with triangles left, else the next one in input order
+                newCluster = true;
+                while (!deadEnd.empty() && best < 0)
+                {
+                    unsigned int v = deadEnd.back();
+                    deadEnd.pop_back();
+                    if (live[v] > 0)
+                        best = v;
+                }
+                while (best < 0 && cursor < vertexCount)
+                {
+                    if (live[cursor] > 0)
+                        best = (long)cursor;
+                    cursor++;
+                }
+            }
+            fanning = best;
+        }
+        return result;
+    }
+
+    // Forsyth's vertex cache optimizer ("Linear-Speed Vertex Cache Optimisation"), LRU cache of 32 entries
+    static std::vector<unsigned int> Forsyth(const unsigned int *indices, size_t indexCount, size_t vertexCount)
+    {
+        const int lruSize = 32;
+        size_t triangleCount = indexCount / 3;
+        Adjacency adjacency(indices, indexCount, vertexCount);
+        std::vector<unsigned int> live(adjacency.counts);
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<float> vertexScore(vertexCount);
+        std::vector<float> triangleScore(triangleCount, 0.0f);
+        std::vector<unsigned char> emitted(triangleCount, 0);
+        for (size_t v = 0; v < vertexCount; v++)
+            vertexScore[v] = forsythScore(-1, live[v], lruSize);
+        for (size_t t = 0; t < triangleCount; t++)
+            triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+        std::vector<unsigned int> result;
+        result.reserve(triangleCount * 3);
+        std::vector<unsigned int> cache, nextCache;
+        size_t cursor = 0;
+        long best = triangleCount > 0 ? bestTriangle(triangleScore, emitted, cursor) : -1;
+        while (best >= 0)
+        {
+            const unsigned int *triangle = indices + best * 3;
+            emitted[best] = true;
+            nextCache.clear();
+            for (int c = 0; c < 3; c++)
+            {
+                unsigned int v = triangle[c];
+                result.push_back(v);
+                nextCache.push_back(v);
+                live[v]--;
+            }
+            for (unsigned int v : cache)
+                if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                    nextCache.push_back(v);
+
+            // entries pushed past the end of the LRU are evicted; rescore every vertex that moved and pick the
+            // best triangle around them
+            best = -1;
+            float bestScore = -1.0f;
+            for (size_t i = 0; i < nextCache.size(); i++)
+            {
+                unsigned int v = nextCache[i];
+                cachePosition[v] = i < (size_t)lruSize ? (int)i : -1;
+                vertexScore[v] = forsythScore(cachePosition[v], live[v], lruSize);
+            }
+            for (unsigned int v : nextCache)
+            {
+                const unsigned int *fan = adjacency.Triangles(v);
+                for (unsigned int k = 0; k < adjacency.counts[v]; k++)
+                {
+                    unsigned int t = fan[k];
+                    if (emitted[t])
+                        continue;
+                    float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                    triangleScore[t] = score;
+                    if (score > bestScore)
+                    {
+                        bestScore = score;
+                        best = (long)t;
+                    }
+                }
+            }
+            if (nextCache.size() > (size_t)lruSize)
+                nextCache.resize(lruSize);
+            cache.swap(nextCache);
+            if (best < 0)
+                best = bestTriangle(triangleScore, emitted, cursor);
+        }
+        return result;
+    }
+
+    // sorts the clusters of a Tipsify order so the ones facing away from the mesh center come first
+    // (the fast, view independent overdraw pass of Sander et al.)
+    static void SortClustersForOverdraw(std::vector<unsigned int> &indices, const std::vector<size_t> &clusters, const Vertex *vertices)
+    {
+        size_t triangleCount = indices.size() / 3;
+        if (clusters.size() < 2)
+            return;
+        glm::vec3 meshCenter(0.0f);
+        float meshArea = 0.0f;
+        std::vector<float> metric(clusters.size());
+        std::vector<glm::vec3> centroids(clusters.size()), normals(clusters.size());
+        for (size_t c = 0; c < clusters.size(); c++)
+        {
+            size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+            glm::vec3 centroid(0.0f), normal(0.0f);
+            float area = 0.0f;
+            for (size_t t = clusters[c]; t < end; t++)
+            {
+                const glm::vec3 &a = vertices[indices[t * 3]].Position;
+                const glm::vec3 &b = vertices[indices[t * 3 + 1]].Position;
+                const glm::vec3 &p = vertices[indices[t * 3 + 2]].Position;
+                glm::vec3 cross = glm::cross(b - a, p - a);
+                float triangleArea = glm::length(cross) * 0.5f;
+                centroid += (a + b + p) / 3.0f * triangleArea;
+                normal += cross;
+                area += triangleArea;
+            }
+            meshCenter += centroid;
+            meshArea += area;
+            centroids[c] = area > 0.0f ? centroid / area : centroid;
+            float length = glm::length(normal);
+            normals[c] = length > 0.0f ? normal / length : normal;
+        }
+        if (meshArea > 0.0f)
+            meshCenter /= meshArea;
+        for (size_t c = 0; c < clusters.size(); c++)
+            metric[c] = glm::dot(centroids[c] - meshCenter, normals[c]);
+
+        std::vector<size_t> order(clusters.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&metric](size_t a, size_t b) { return metric[a] > metric[b]; });
+        std::vector<unsigned int> sorted;
+        sorted.reserve(indices.size());
+        for (size_t c : order)
+        {
+            size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+            sorted.insert(sorted.end(), indices.begin() + clusters[c] * 3, indices.begin() + end * 3);
+        }
+        indices.swap(sorted);
+    }
+
+    // renumbers vertices in the order the index buffer first uses them; unused vertices go to the end
+    static void OptimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+    {
+        const unsigned int unused = ~0u;
+        std::vector<unsigned int> remap(vertices.size(), unused);
+        std::vector<Vertex> reordered;
+        reordered.reserve(vertices.size());
+        for (unsigned int &index : indices)
+        {
+            if (remap[index] == unused)
+            {
+                remap[index] = (unsigned int)reordered.size();
+                reordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        for (size_t v = 0; v < vertices.size(); v++)
+            if (remap[v] == unused)
+                reordered.push_back(vertices[v]);
+        vertices.swap(reordered);
+    }
+
+    // merges vertices that agree within the settings' tolerances and rebuilds the index buffer.
+    // tangent frames of merged vertices are averaged; vertices with mirrored uvs (opposite handedness) never merge.
+    // triangles that collapse to a line are dropped.
+    static WeldStats Weld(MeshData &mesh, const WeldSettings &settings)
+    {
+        WeldStats stats;
+        stats.verticesBefore = mesh.vertices.size();
+        stats.indicesBefore = mesh.indices.size();
+        if (!settings.enabled || mesh.vertices.empty())
+        {
+            stats.verticesAfter = stats.verticesBefore;
+            stats.indicesAfter = stats.indicesBefore;
+            return stats;
+        }
+
+        // cells are twice the position tolerance. A match is at most the tolerance (half a cell) away on each axis,
+        // so it lies in the vertex's own cell or in the neighbour on the side of the half of the cell the vertex is in.
+        // That makes its own cell plus the 7 neighbours towards the nearest cell corner
+        float cellSize = std::max(settings.positionEpsilon, 1e-12f) * 2.0f;
+        std::unordered_map<uint64_t, std::vector<unsigned int>> grid;
+        grid.reserve(mesh.vertices.size());
+        std::vector<Vertex> welded;
+        welded.reserve(mesh.vertices.size());
+        std::vector<unsigned int> remap(mesh.vertices.size());
+        std::vector<unsigned int> mergedCount;
+        mergedCount.reserve(mesh.vertices.size());
+
+        for (size_t v = 0; v < mesh.vertices.size(); v++)
+        {
+            const Vertex &vertex = mesh.vertices[v];
+            glm::vec3 scaled = vertex.Position / cellSize;
+            int64_t cell[3], step[3];
+            for (int k = 0; k < 3; k++)
+            {
+                float floored = std::floor(scaled[k]);
+                cell[k] = (int64_t)floored;
+                step[k] = scaled[k] - floored < 0.5f ? -1 : 1;
+            }
+            long match = -1;
+            for (int n = 0; n < 8 && match < 0; n++)
+            {
+                int64_t x = cell[0] + ((n & 1) ? step[0] : 0);
+                int64_t y = cell[1] + ((n & 2) ? step[1] : 0);
+                int64_t z = cell[2] + ((n & 4) ? step[2] : 0);
+                std::unordered_map<uint64_t, std::vector<unsigned int>>::const_iterator bucket = grid.find(cellKey(x, y, z));
+                if (bucket == grid.end())
+                    continue;
+                for (unsigned int candidate : bucket->second)
+                    if (sameVertex(welded[candidate], vertex, settings))
+                    {
+                        match = candidate;
+                        break;
+                    }
+            }
+            if (match >= 0)
+            {
+                // accumulate the tangent frame, normalized once all vertices are merged
+                welded[match].Tangent += vertex.Tangent;
+                welded[match].Bitangent += vertex.Bitangent;
+                mergedCount[match]++;
+                remap[v] = (unsigned int)match;
+                continue;
+            }
+            remap[v] = (unsigned int)welded.size();
+            grid[cellKey(cell[0], cell[1], cell[2])].push_back((unsigned int)welded.size());
+            welded.push_back(vertex);
+            mergedCount.push_back(1);
+        }
+        for (size_t v = 0; v < welded.size(); v++)
+        {
+            if (mergedCount[v] == 1)
+                continue;
+            Vertex &vertex = welded[v];
+            float tangentLength = glm::length(vertex.Tangent), bitangentLength = glm::length(vertex.Bitangent);
+            if (tangentLength > 0.0f)
+                vertex.Tangent /= tangentLength;
+            if (bitangentLength > 0.0f)
+                vertex.Bitangent /= bitangentLength;
+        }
+
+        std::vector<unsigned int> indices;
+        indices.reserve(mesh.indices.size());
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            unsigned int a = remap[mesh.indices[i]], b = remap[mesh.indices[i + 1]], c = remap[mesh.indices[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            indices.push_back(a);
+            indices.push_back(b);
+            indices.push_back(c);
+        }
+        mesh.vertices.swap(welded);
+        mesh.indices.swap(indices);
+        stats.verticesAfter = mesh.vertices.size();
+        stats.indicesAfter = mesh.indices.size();
+        return stats;
+    }
+
+    struct Result {
+        VertexCacheStats before, after;
+        bool overdrawOrder = false;
+    };
+
+    // reorders an imported mesh in place. The overdraw friendly Tipsify order is kept unless it is
+    // more than 5% worse for the vertex cache than Forsyth.
+    static Result Optimize(MeshData &mesh)
+    {
+        Result result;
+        std::vector<unsigned int> &indices = mesh.indices;
+        size_t vertexCount = mesh.vertices.size();
+        result.before = Analyze(indices.data(), indices.size(), vertexCount);
+        if (indices.size() < 6 || indices.size() % 3 != 0)
+        {
+            result.after = result.before;
+            return result;
+        }
+
+        std::vector<size_t> clusters;
+        std::vector<unsigned int> tipsify = Tipsify(indices.data(), indices.size(), vertexCount, CacheSize, &clusters);
+        SortClustersForOverdraw(tipsify, clusters, mesh.vertices.data());
+        std::vector<unsigned int> forsyth = Forsyth(indices.data(), indices.size(), vertexCount);
+        VertexCacheStats tipsifyStats = Analyze(tipsify.data(), tipsify.size(), vertexCount);
+        VertexCacheStats forsythStats = Analyze(forsyth.data(), forsyth.size(), vertexCount);
+
+        result.overdrawOrder = tipsifyStats.acmr <= forsythStats.acmr * 1.05f;
+        std::vector<unsigned int> &best = result.overdrawOrder ? tipsify : forsyth;
+        // never make things worse than the order Assimp produced
+        if ((result.overdrawOrder ? tipsifyStats : forsythStats).acmr <= result.before.acmr)
+            indices.swap(best);
+        else
+            result.overdrawOrder = false;
+        OptimizeVertexFetch(mesh.vertices, indices);
+        result.after = Analyze(indices.data(), indices.size(), vertexCount);
+        mesh.acmr = result.after.acmr;
+        mesh.atvr = result.after.atvr;
+        return result;
+    }
+
+private:
+    static uint64_t cellKey(int64_t x, int64_t y, int64_t z)
+    {
+        uint64_t hash = (uint64_t)x * 0x9E3779B97F4A7C15ull;
+        hash ^= (uint64_t)y * 0xC2B2AE3D27D4EB4Full + (hash << 6) + (hash >> 2);
+        hash ^= (uint64_t)z * 0x165667B19E3779F9ull + (hash << 6) + (hash >> 2);
+        return hash;
+    }
+
+    static bool within(const glm::vec3 &a, const glm::vec3 &b, float epsilon)
+    {
+        return std::fabs(a.x - b.x) <= epsilon && std::fabs(a.y - b.y) <= epsilon && std::fabs(a.z - b.z) <= epsilon;
+    }
+
+    static bool sameVertex(const Vertex &a, const Vertex &b, const WeldSettings &settings)
+    {
+        if (!within(a.Position, b.Position, settings.positionEpsilon) || !within(a.Normal, b.Normal, settings.normalEpsilon)
+                || std::fabs(a.TexCoords.x - b.TexCoords.x) > settings.uvEpsilon
+                || std::fabs(a.TexCoords.y - b.TexCoords.y) > settings.uvEpsilon)
+            return false;
+        // same handedness of the tangent frame (a is the accumulated frame, only its direction matters)
+        float handednessA = glm::dot(glm::cross(a.Normal, a.Tangent), a.Bitangent);
+        float handednessB = glm::dot(glm::cross(b.Normal, b.Tangent), b.Bitangent);
+        return (handednessA < 0.0f) == (handednessB < 0.0f);
+    }
+
+    // vertex -> triangle lists in one flat array
+    struct Adjacency {
+        std::vector<unsigned int> counts;
+        std::vector<unsigned int> offsets;
+        std::vector<unsigned int> triangles;
+
+        Adjacency(const unsigned int *indices, size_t indexCount, size_t vertexCount)
+            : counts(vertexCount, 0), offsets(vertexCount, 0), triangles(indexCount)
+        {
+            for (size_t i = 0; i < indexCount; i++)
+                counts[indices[i]]++;
+            unsigned int offset = 0;
+            for (size_t v = 0; v < vertexCount; v++)
+            {
+                offsets[v] = offset;
+                offset += counts[v];
+            }
+            std::vector<unsigned int> fill(offsets);
+            for (size_t i = 0; i < indexCount; i++)
+                triangles[fill[indices[i]]++] = (unsigned int)(i / 3);
+        }
+
+        const unsigned int *Triangles(unsigned int vertex) const { return triangles.data() + offsets[vertex]; }
+    };
+
+    static float forsythScore(int cachePosition, unsigned int liveTriangles, int lruSize)
+    {
+        // the score only depends on small integers, so it comes from tables built once
+        struct Tables {
+            float position[64];
+            float valence[64];
+            Tables()
+            {
+                for (int i = 0; i < 64; i++)
+                {
+                    // the three vertices of the last triangle get a fixed score so the next triangle does not just reuse them
+                    position[i] = i < 3 ? 0.75f : std::pow(std::max(0.0f, 1.0f - (float)(i - 3) / (float)(32 - 3)), 1.5f);
+                    // boost vertices with few triangles left so they are finished off instead of left behind
+                    valence[i] = i == 0 ? 0.0f : 2.0f * std::pow((float)i, -0.5f);
+                }
+            }
+        };
+        static const Tables tables;
+        if (liveTriangles == 0)
+            return -1.0f;
+        float score = cachePosition >= 0 && cachePosition < lruSize ? tables.position[cachePosition] : 0.0f;
+        score += liveTriangles < 64 ? tables.valence[liveTriangles] : 2.0f * std::pow((float)liveTriangles, -0.5f);
+        return score;
+    }
+
+    // linear scan for the best remaining triangle, only needed when the cache runs out of candidates
+    static long bestTriangle(const std::vector<float> &scores, const std::vector<unsigned char> &emitted, size_t &cursor)
+    {
+        while (cursor < scores.size() && emitted[cursor])
+            cursor++;
+        if (cursor == scores.size())
+            return -1;
+        long best = (long)cursor;
+        for (size_t t = cursor; t < scores.size() && t < cursor + 256; t++)
+            if (!emitted[t] && scores[t] > scores[best])
+                best = (long)t;
+        return best;
+    }
+};
+#endif
@@ -11,69 +11,321 @@
 #include <assimp/postprocess.h>
 
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/obj_loader.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture_registry.h>
 
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <iomanip>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <set>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
-
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false, TextureRole role = TextureRole::Color,
+                             const void *owner = nullptr);
 
+// everything the CPU side of an import produces for one model. Built by Model::Import on any thread
+// and consumed by Model::Upload on the GL thread.
+struct ModelData {
+    string path;
+    string directory;
+    vector<MeshData> meshes;
+    // keeps the mapped vertex/index data of a cache hit alive until upload
+    shared_ptr<MeshCacheFile> cache;
+    // vertex/index counts before and after welding
+    WeldStats weld;
+    bool loaded = false;
+};
 
 class Model
 {
 public:
     // model data
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    std::string glslIdentifierPrefix;
 
-    // constructor, expects a filepath to a 3D model.
+    // post processing applied by Assimp; part of the mesh cache key
+    static const unsigned int importFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+    // tolerances of the welding stage that replaces aiProcess_JoinIdenticalVertices; part of the mesh cache key.
+    // set before any model is imported, Import reads it from the loader threads.
+    static WeldSettings &Welding()
+    {
+        static WeldSettings settings;
+        return settings;
+    }
+
+    // layout the vertex buffers are uploaded in. Set before any model is imported, like Welding().
+    static VertexFormatSettings &GpuVertexFormat()
+    {
+        static VertexFormatSettings settings;
+        return settings;
+    }
+
+    // merges all meshes of a model into one vertex/index buffer with one index range per material,
+    // so drawing the model costs one VAO bind and one draw call per material. Set before importing;
+    // part of the mesh cache key, which stores the merged meshes.
+    // On by default, for the draw calls it saves. The trade-off is culling granularity: Scene's
+    // frustum/occlusion culler works on whole meshes, so a merged model is culled and tested for occlusion as
+    // one box. Its parts are no longer culled on their own. Turn it off for large models that are usually
+    // only partly in view.
+    static bool &MergeByMaterial()
+    {
+        static bool merge = true;
+        return merge;
+    }
+
+    // reads .obj files with ObjLoader instead of Assimp. Set before importing. Off by default: obj_loader_benchmark
+    // only checks ObjLoader against Assimp on part of the scene's models, so it is opt-in until it covers all of them.
+    static bool &NativeObjImport()
+    {
+        static bool native = false;
+        return native;
+    }
+
+    // constructor for a model that is filled in later by Upload (see ModelLoader).
+    Model() : gammaCorrection(false)
+    {
+    }
+
+    // constructor, expects a filepath to a 3D model. Blocks until the textures are uploaded too, so the model
+    // can be drawn right away; ModelLoader overlaps several loads instead.
     Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
     {
-        loadModel(path);
+        ModelData data = Import(path);
+        Upload(data);
+        TexturePipeline::Shared().Finish();
     }
 
     // draws the model, and thus all its meshes
     void Draw(Shader &shader)
     {
+        // the vertex shader decodes packed attributes only while drawing packed meshes
+        bool packed = !meshes.empty() && meshes[0].layout.packed;
+        const VertexUniforms &uniforms = VertexUniforms::Of(shader);
+        if (packed)
+            shader.set(uniforms.packedVertex, true);
         for(unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
+        if (packed)
+            shader.set(uniforms.packedVertex, false);
+    }
+
+    // queues the draws of Draw with the given model matrix (see RenderQueue)
+    void Submit(RenderQueue &queue, Shader &shader, const glm::mat4 &model)
+    {
+        for (Mesh &mesh : meshes)
+            mesh.Submit(queue, shader, model);
+    }
+
+    // draws one copy of the model per transform with one instanced draw per mesh (per material range of merged
+    // meshes). shader has to be built with the INSTANCED define (see lightingShader.vs). The transforms go to
+    // the GPU together with their normal matrices, and only if they differ from those of the last call.
+    void DrawInstanced(Shader &shader, const glm::mat4 *transforms, size_t count)
+    {
+        if (count == 0)
+            return;
+        uploadInstances(transforms, count);
+        bool packed = !meshes.empty() && meshes[0].layout.packed;
+        const VertexUniforms &uniforms = VertexUniforms::Of(shader);
+        if (packed)
+            shader.set(uniforms.packedVertex, true);
+        for (Mesh &mesh : meshes)
+            mesh.DrawInstanced(shader, instanceBuffer, (GLsizei)count);
+        if (packed)
+            shader.set(uniforms.packedVertex, false);
+    }
+
+    void DrawInstanced(Shader &shader, const vector<glm::mat4> &transforms)
+    {
+        DrawInstanced(shader, transforms.data(), transforms.size());
+    }
+
+    // depth pre-pass of DrawInstanced: the copies from the position-only streams with shader, or with alphaTested
+    // for the materials cutout says may discard texels (see Mesh::SubmitDepth); both are built with INSTANCED
+    template<typename Cutout>
+    void DrawDepthInstanced(Shader &shader, Shader &alphaTested, const vector<glm::mat4> &transforms, const Cutout &cutout)
+    {
+        if (transforms.empty())
+            return;
+        uploadInstances(transforms.data(), transforms.size());
+        for (Mesh &mesh : meshes)
+            mesh.DrawDepthInstanced(shader, alphaTested, instanceBuffer, (GLsizei)transforms.size(), cutout);
+    }
+
+    // frees the instance buffer of DrawInstanced; has to run while the context is still current
+    void Delete()
+    {
+        if (instanceBuffer)
+            glDeleteBuffers(1, &instanceBuffer);
+        instanceBuffer = 0;
+        instanceTransforms.clear();
+    }
+
+    // number of draw calls Draw issues
+    size_t DrawCount() const
+    {
+        size_t draws = 0;
+        for (const Mesh &mesh : meshes)
+            draws += mesh.DrawCount();
+        return draws;
     }
 
     void SetShaderTextureNamePrefix(std::string prefix) {
+        glslIdentifierPrefix = prefix;
         for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
+            mesh.SetShaderTextureNamePrefix(prefix);
         }
     }
-private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+
+    // reads a model with supported ASSIMP extensions (or its mesh cache) into CPU memory. Does not touch OpenGL.
+    static ModelData Import(string const &path)
     {
+        ModelData data;
+        data.path = path;
+        // retrieve the directory path of the filepath
+        data.directory = path.substr(0, path.find_last_of('/'));
+
+        // the native loader has no Assimp post processing, caches it wrote are keyed on flags 0
+        bool native = NativeObjImport() && path.size() > 4 && path.compare(path.size() - 4, 4, ".obj") == 0;
+        const unsigned int flags = native ? 0u : importFlags;
+
+        // a valid mesh cache lets us skip Assimp altogether
+        const uint32_t weldHash = Welding().Hash();
+        const uint32_t vertexFormatHash = GpuVertexFormat().Hash();
+        shared_ptr<MeshCacheFile> cache = make_shared<MeshCacheFile>();
+        if (cache->Open(path, flags, weldHash, vertexFormatHash, MergeByMaterial()))
+        {
+            cache->GetMeshes(data.meshes);
+            data.cache = cache;
+            data.weld.verticesBefore = (size_t)cache->Header().importedVertexCount;
+            data.weld.indicesBefore = (size_t)cache->Header().importedIndexCount;
+            for (const MeshData &mesh : data.meshes)
+            {
+                data.weld.verticesAfter += mesh.VertexCount();
+                data.weld.indicesAfter += mesh.IndexCount();
+            }
+            data.loaded = true;
+            reportWeld(data, true);
+            reportCachedOptimization(data);
+            finishImport(data);
+            return data;
+        }
+
+        if (native)
+        {
+            vector<MeshData> meshes;
+            vector<string> names;
+            if (!ObjLoader::Load(path, meshes, &names))
+                return data;
+            for (size_t i = 0; i < meshes.size(); i++)
+            {
+                postProcess(meshes[i], names[i], data.weld);
+                data.meshes.push_back(std::move(meshes[i]));
+            }
+            data.loaded = true;
+            reportWeld(data, false);
+
+            if (MergeByMaterial())
+                mergeByMaterial(data);
+            finishImport(data);
+            MeshCacheFile::Write(path, flags, weldHash, vertexFormatHash, MergeByMaterial(), data.meshes, data.weld.verticesBefore,
+                                 data.weld.indicesBefore, MeshCacheFile::MaterialLibraries(path));
+            return data;
+        }
+
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, importFlags);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            return data;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        processNode(scene->mRootNode, scene, data);
+        data.loaded = true;
+        reportWeld(data, false);
+
+        if (MergeByMaterial())
+            mergeByMaterial(data);
+        finishImport(data);
+        MeshCacheFile::Write(path, flags, weldHash, vertexFormatHash, MergeByMaterial(), data.meshes, data.weld.verticesBefore,
+                             data.weld.indicesBefore, MeshCacheFile::MaterialLibraries(path));
+        return data;
+    }
+
+    // every texture path referenced by the imported meshes, relative to data.directory
+    static set<string> TexturePaths(const ModelData &data)
+    {
+        set<string> paths;
+        for (const MeshData &mesh : data.meshes)
+        {
+            for (const Texture &texture : mesh.textures)
+                paths.insert(texture.path);
+            for (const SubMesh &subMesh : mesh.subMeshes)
+                for (const Texture &texture : subMesh.textures)
+                    paths.insert(texture.path);
+        }
+        return paths;
+    }
+
+    // creates the GL objects for imported data. Has to run on the GL thread.
+    // textures are handed to the TexturePipeline and filled in once they are decoded.
+    void Upload(ModelData &data)
+    {
+        directory = data.directory;
+        for (const MeshData &meshData : data.meshes)
+        {
+            vector<Texture> textures;
+            for (const Texture &texture : meshData.textures)
+                textures.push_back(loadTexture(texture.path.c_str(), texture.type));
+            vector<SubMesh> subMeshes = meshData.subMeshes;
+            for (SubMesh &subMesh : subMeshes)
+                for (Texture &texture : subMesh.textures)
+                    texture = loadTexture(texture.path.c_str(), texture.type);
+            meshes.push_back(Mesh(meshData, textures, subMeshes));
+            meshes.back().SetShaderTextureNamePrefix(glslIdentifierPrefix);
+        }
+    }
+
+private:
+    // per instance data of DrawInstanced and the transforms it was built from
+    unsigned int instanceBuffer = 0;
+    vector<glm::mat4> instanceTransforms;
+    vector<InstanceData> instances;
+
+    void uploadInstances(const glm::mat4 *transforms, size_t count)
+    {
+        if (instanceBuffer && count == instanceTransforms.size()
+            && std::memcmp(instanceTransforms.data(), transforms, count * sizeof(glm::mat4)) == 0)
+            return;
+        instanceTransforms.assign(transforms, transforms + count);
+        instances.resize(count);
+        for (size_t i = 0; i < count; i++)
+            instances[i] = InstanceData(transforms[i]);
+        if (!instanceBuffer)
+            glGenBuffers(1, &instanceBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, count * sizeof(InstanceData), instances.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    static void processNode(aiNode *node, const aiScene *scene, ModelData &data)
     {
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -81,24 +333,26 @@ private:
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            data.meshes.push_back(processMesh(mesh, scene, data.weld));
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, data);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static MeshData processMesh(aiMesh *mesh, const aiScene *scene, WeldStats &weld)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        MeshData data;
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        vector<Texture> &textures = data.textures;
 
         // walk through each of the mesh's vertices
+        vertices.reserve(mesh->mNumVertices);
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
             Vertex vertex;
@@ -137,13 +391,18 @@ private:
                 vertex.Bitangent = vector;
             }
             else
+            {
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+                vertex.Tangent = glm::vec3(0.0f);
+                vertex.Bitangent = glm::vec3(0.0f);
+            }
 
             vertices.push_back(vertex);
 
 
         }
         // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+        indices.reserve(mesh->mNumFaces * 3);
         for(unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
             aiFace face = mesh->mFaces[i];
@@ -164,96 +423,245 @@ private:
 
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+        vector<Texture> diffuseMaps = getMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
         textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+        vector<Texture> specularMaps = getMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
         textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
+        std::vector<Texture> normalMaps = getMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
         textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
+        std::vector<Texture> heightMaps = getMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
+        postProcess(data, mesh->mName.C_Str(), weld);
 
+        // return the extracted mesh data, the GL objects are created by Upload
+        return data;
+    }
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+    // welding, bounds and vertex cache optimization of a freshly imported mesh (Assimp or ObjLoader)
+    static void postProcess(MeshData &data, const string &name, WeldStats &weld)
+    {
+        // merge the duplicates Assimp leaves behind (.obj faces come in with one vertex per corner)
+        weld += MeshOptimizer::Weld(data, Welding());
+
+        data.computeBounds();
+
+        // reorder triangles and vertices for the post-transform cache, overdraw and fetch locality.
+        // the result ends up in the mesh cache, so this only runs on a cold import.
+        MeshOptimizer::Result optimized = MeshOptimizer::Optimize(data);
+        ostringstream report;
+        report << "MESH_OPTIMIZER:: " << name << " (" << data.indices.size() / 3 << " triangles) ACMR "
+               << fixed << setprecision(3) << optimized.before.acmr << " -> " << optimized.after.acmr << ", ATVR "
+               << optimized.before.atvr << " -> " << optimized.after.atvr
+               << (optimized.overdrawOrder ? " (tipsify + overdraw order)" : " (forsyth)") << "\n";
+        cout << report.str() << flush;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // the vertex cache statistics postProcess printed when the cache was written, over the whole model:
+    // misses summed over triangles (ACMR) and over referenced vertices (ATVR)
+    static void reportCachedOptimization(const ModelData &data)
     {
-        vector<Texture> textures;
-        for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+        double triangles = 0.0, misses = 0.0, referenced = 0.0;
+        for (const MeshData &mesh : data.meshes)
         {
-            aiString str;
-            mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
+            if (mesh.acmr <= 0.0f || mesh.atvr <= 0.0f)
+                continue;
+            double meshTriangles = (double)(mesh.IndexCount() / 3);
+            triangles += meshTriangles;
+            misses += mesh.acmr * meshTriangles;
+            referenced += mesh.acmr * meshTriangles / mesh.atvr;
+        }
+        if (triangles == 0.0)
+            return;
+        ostringstream report;
+        report << "MESH_OPTIMIZER:: " << data.path << " (cached, " << (size_t)triangles << " triangles) ACMR " << fixed
+               << setprecision(3) << misses / triangles << ", ATVR " << misses / referenced << "\n";
+        cout << report.str() << flush;
+    }
+
+    // builds the triangle BVH and GPU layout data of freshly imported meshes; cached meshes come with both
+    static void finishImport(ModelData &data)
+    {
+        for (MeshData &mesh : data.meshes)
+            if (!mesh.Cached())
+                mesh.buildTriangleBVH();
+        buildGpuData(data);
+    }
+
+    // replaces the meshes of a model with one mesh holding a SubMesh per material. Meshes are grouped by their
+    // textures, which is all the renderer uses of a material; each group's vertices are stored contiguously so
+    // its indices can be relative to the group and stay 16 bit where possible. Runs on a cold import only,
+    // the mesh cache stores the merged mesh.
+    static void mergeByMaterial(ModelData &data)
+    {
+        size_t drawsBefore = data.meshes.size();
+        if (drawsBefore < 2)
+            return;
+
+        vector<vector<size_t>> groups;
+        unordered_map<string, size_t> groupOfMaterial;
+        size_t vertexCount = 0, indexCount = 0;
+        for (size_t i = 0; i < data.meshes.size(); i++)
+        {
+            const MeshData &mesh = data.meshes[i];
+            string material;
+            for (const Texture &texture : mesh.textures)
+                material += texture.type + '\n' + texture.path + '\n';
+            unordered_map<string, size_t>::iterator group = groupOfMaterial.find(material);
+            if (group == groupOfMaterial.end())
+            {
+                group = groupOfMaterial.emplace(material, groups.size()).first;
+                groups.push_back(vector<size_t>());
+            }
+            groups[group->second].push_back(i);
+            vertexCount += mesh.VertexCount();
+            indexCount += mesh.IndexCount();
+        }
+
+        MeshData merged;
+        merged.vertices.reserve(vertexCount);
+        merged.indices.reserve(indexCount);
+        // vertex cache statistics over all meshes, summed like reportCachedOptimization does
+        double triangles = 0.0, misses = 0.0, referenced = 0.0;
+        for (const vector<size_t> &group : groups)
+        {
+            SubMesh subMesh;
+            subMesh.firstIndex = merged.indices.size();
+            subMesh.baseVertex = merged.vertices.size();
+            subMesh.textures = data.meshes[group[0]].textures;
+            for (size_t m = 0; m < group.size(); m++)
             {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
+                const MeshData &mesh = data.meshes[group[m]];
+                unsigned int offset = (unsigned int)(merged.vertices.size() - subMesh.baseVertex);
+                merged.vertices.insert(merged.vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+                for (unsigned int index : mesh.indices)
+                    merged.indices.push_back(index + offset);
+                subMesh.boundsMin = m == 0 ? mesh.boundsMin : glm::min(subMesh.boundsMin, mesh.boundsMin);
+                subMesh.boundsMax = m == 0 ? mesh.boundsMax : glm::max(subMesh.boundsMax, mesh.boundsMax);
+                if (mesh.acmr > 0.0f && mesh.atvr > 0.0f)
                 {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
+                    double meshTriangles = (double)(mesh.IndexCount() / 3);
+                    triangles += meshTriangles;
+                    misses += mesh.acmr * meshTriangles;
+                    referenced += mesh.acmr * meshTriangles / mesh.atvr;
                 }
             }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            subMesh.indexCount = merged.indices.size() - subMesh.firstIndex;
+            subMesh.vertexCount = merged.vertices.size() - subMesh.baseVertex;
+            merged.subMeshes.push_back(subMesh);
         }
-        return textures;
+        merged.computeBounds();
+        if (triangles > 0.0)
+        {
+            merged.acmr = (float)(misses / triangles);
+            merged.atvr = (float)(misses / referenced);
+        }
+
+        data.meshes.clear();
+        data.meshes.push_back(std::move(merged));
+
+        ostringstream report;
+        report << "MESH_MERGE:: " << data.path << ": " << drawsBefore << " draws -> " << groups.size()
+               << " draws (" << groups.size() << " materials, 1 vertex array)\n";
+        cout << report.str() << flush;
     }
-};
 
+    // converts every freshly imported mesh to the GpuVertexFormat() layout and prints what that saves over the
+    // Vertex layout
+    static void buildGpuData(ModelData &data)
+    {
+        size_t vertices = 0, floatBytes = 0, gpuBytes = 0, shortIndexMeshes = 0;
+        for (MeshData &mesh : data.meshes)
+        {
+            if (!mesh.Cached())
+                mesh.buildGpuData(GpuVertexFormat());
+            vertices += mesh.VertexCount();
+            floatBytes += mesh.VertexCount() * sizeof(Vertex) + mesh.IndexCount() * sizeof(unsigned int);
+            gpuBytes += mesh.GpuVertexBytes() + mesh.GpuIndexBytes();
+            if (mesh.layout.indexType == GL_UNSIGNED_SHORT)
+                shortIndexMeshes++;
+        }
+        if (data.meshes.empty())
+            return;
+        ostringstream report;
+        report << "VERTEX_FORMAT:: " << data.path << ": " << sizeof(Vertex) << " -> " << data.meshes[0].layout.stride
+               << " bytes per vertex" << (data.meshes[0].layout.packed ? " (packed)" : "") << ", " << fixed << setprecision(2)
+               << floatBytes / (1024.0 * 1024.0) << " MB -> " << gpuBytes / (1024.0 * 1024.0) << " MB for " << vertices
+               << " vertices, " << shortIndexMeshes << " of " << data.meshes.size() << " meshes with 16-bit indices\n";
+        cout << report.str() << flush;
+    }
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
-{
-    string filename = string(path);
-    filename = directory + '/' + filename;
+    // prints vertex/index counts, buffer sizes and vertex reuse (indices per vertex) before and after welding
+    static void reportWeld(const ModelData &data, bool cached)
+    {
+        const WeldStats &weld = data.weld;
+        auto megabytes = [](size_t vertices, size_t indices) {
+            return (vertices * sizeof(Vertex) + indices * sizeof(unsigned int)) / (1024.0 * 1024.0);
+        };
+        auto reuse = [](size_t vertices, size_t indices) {
+            return vertices ? (double)indices / vertices : 0.0;
+        };
+        ostringstream report;
+        report << "MESH_WELDER:: " << data.path << (cached ? " (cached)" : "") << ": vertices " << weld.verticesBefore
+               << " -> " << weld.verticesAfter << ", indices " << weld.indicesBefore << " -> " << weld.indicesAfter
+               << ", " << fixed << setprecision(2) << megabytes(weld.verticesBefore, weld.indicesBefore) << " MB -> "
+               << megabytes(weld.verticesAfter, weld.indicesAfter) << " MB, reuse "
+               << reuse(weld.verticesBefore, weld.indicesBefore) << " -> " << reuse(weld.verticesAfter, weld.indicesAfter) << "\n";
+        cout << report.str() << flush;
+    }
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    // collects all material textures of a given type. Only type and path are filled in, the textures
+    // themselves are loaded by Upload.
+    static vector<Texture> getMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    {
+        vector<Texture> textures;
+        for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+        {
+            aiString str;
+            mat->GetTexture(type, i, &str);
+            Texture texture;
+            texture.id = 0;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
+        }
+        return textures;
+    }
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    // loads a single texture of the given type. The TextureRegistry makes sure every file is only loaded once,
+    // no matter how many meshes or models reference it.
+    Texture loadTexture(const char *path, const string &typeName)
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
+        Texture texture;
+        texture.id = TextureFromFile(path, this->directory, gammaCorrection, textureRole(typeName), this);
+        texture.type = typeName;
+        texture.path = path;
+        return texture;
     }
-    else
+
+    // normal maps are compressed to two channels and height maps to one, everything else is treated as color
+    static TextureRole textureRole(const string &typeName)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        if (typeName == "texture_normal")
+            return TextureRole::Normal;
+        if (typeName == "texture_height")
+            return TextureRole::Mask;
+        return TextureRole::Color;
     }
+};
+
+
+// returns the shared texture for the file, reserving a new texture name the first time it is requested;
+// the image is decoded on the worker threads and uploaded by TexturePipeline::Pump/Finish on the GL thread.
+// owner is the requesting model, for the registry's statistics.
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma, TextureRole role, const void *owner)
+{
+    string filename = string(path);
+    filename = directory + '/' + filename;
 
-    return textureID;
+    return TextureRegistry::Shared().Acquire(filename, role, owner);
 }
 #endif
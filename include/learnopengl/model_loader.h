@@ -0,0 +1,177 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include <learnopengl/model.h>
+#include <learnopengl/texture_pipeline.h>
+#include <learnopengl/thread_pool.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Loads models asynchronously. Import (Assimp or the mesh cache) and vertex conversion run on the thread
+// pool; only Model::Upload, which creates the VAOs/VBOs and texture names, runs on the GL thread inside
+// Finish(). Texture decoding goes through the TexturePipeline, which uses the same pool.
+// Each asset's timings are reported once it is uploaded.
+class ModelLoader
+{
+public:
+    explicit ModelLoader(ThreadPool &pool = ThreadPool::Shared(), TexturePipeline &textures = TexturePipeline::Shared())
+        : pool(pool), textures(textures), started(clock::now())
+    {
+    }
+
+    ModelLoader(const ModelLoader &) = delete;
+    ModelLoader &operator=(const ModelLoader &) = delete;
+
+    // starts loading path into model. The model must stay at the same address until Finish() returns.
+    void Load(Model &model, const std::string &path)
+    {
+        std::unique_ptr<Job> job(new Job());
+        job->model = &model;
+        job->path = path;
+        job->name = path.substr(path.find_last_of('/') + 1);
+        job->queued = clock::now();
+        Job *jobPtr = job.get();
+        jobs.push_back(std::move(job));
+        pool.Submit([this, jobPtr]() { importJob(jobPtr); });
+    }
+
+    // GL thread: uploads models in the order their imports complete and returns once every loaded model,
+    // including its textures, is ready. Decoded textures are uploaded while waiting for the imports.
+    void Finish()
+    {
+        size_t remaining = 0;
+        for (const std::unique_ptr<Job> &job : jobs)
+            remaining += job->uploaded ? 0 : 1;
+
+        double importTotal = 0.0, uploadTotal = 0.0;
+        while (remaining > 0)
+        {
+            Job *job = nullptr;
+            {
+                // wake up regularly: texture decodes block once the pipeline queue is full until we pump it
+                std::unique_lock<std::mutex> lock(mutex);
+                readyChanged.wait_for(lock, std::chrono::milliseconds(1), [this]() { return !ready.empty(); });
+                if (!ready.empty())
+                {
+                    job = ready.front();
+                    ready.pop_front();
+                }
+            }
+            textures.Pump();
+            if (!job)
+                continue;
+
+            if (job->failed)
+            {
+                // the model stays empty; the other jobs are uploaded as usual
+                job->uploaded = true;
+                remaining--;
+                std::cout << "ERROR::MODEL_LOADER:: failed to load " << job->path << ": " << job->error << std::endl;
+                continue;
+            }
+
+            clock::time_point uploadStart = clock::now();
+            job->model->Upload(job->data);
+            double uploadMs = milliseconds(uploadStart, clock::now());
+            job->data = ModelData(); // releases the mapped cache
+            job->uploaded = true;
+            remaining--;
+
+            importTotal += job->importMs;
+            uploadTotal += uploadMs;
+            std::cout << "MODEL_LOADER:: " << std::left << std::setw(40) << job->name << std::right << std::fixed << std::setprecision(1)
+                      << " import " << std::setw(7) << job->importMs << " ms"
+                      << " | upload " << std::setw(6) << uploadMs << " ms (" << job->textureCount << " textures queued)"
+                      << " | ready after " << std::setw(7) << milliseconds(job->queued, clock::now()) << " ms" << std::endl;
+        }
+        jobs.clear();
+        textures.Finish();
+
+        double wallMs = milliseconds(started, clock::now());
+        std::cout << "MODEL_LOADER:: " << pool.Size() << " workers, wall " << std::fixed << std::setprecision(1) << wallMs
+                  << " ms (import " << importTotal << " ms, mesh upload " << uploadTotal << " ms)" << std::endl;
+        started = clock::now();
+    }
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    struct Job {
+        Model *model = nullptr;
+        std::string path;
+        std::string name;
+        ModelData data;
+        clock::time_point queued;
+        double importMs = 0.0;
+        unsigned int textureCount = 0;
+        bool uploaded = false;
+        // set by importJob if the import threw or produced no model; Finish reports error and skips the upload
+        bool failed = false;
+        std::string error;
+    };
+
+    ThreadPool &pool;
+    TexturePipeline &textures;
+    std::vector<std::unique_ptr<Job>> jobs;
+    std::deque<Job *> ready;
+    std::mutex mutex;
+    std::condition_variable readyChanged;
+    clock::time_point started;
+
+    static double milliseconds(clock::time_point from, clock::time_point to)
+    {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+
+    // worker: imports the model and hands it to the GL thread. Every job is handed over, failed or not,
+    // as Finish waits for all of them.
+    void importJob(Job *job)
+    {
+        clock::time_point start = clock::now();
+        bool failed = false;
+        try
+        {
+            job->data = Model::Import(job->path);
+            job->textureCount = static_cast<unsigned int>(Model::TexturePaths(job->data).size());
+            if (!job->data.loaded)
+            {
+                failed = true;
+                job->error = "import failed";
+            }
+        }
+        catch (const std::exception &e)
+        {
+            failed = true;
+            job->error = e.what();
+        }
+        catch (...)
+        {
+            failed = true;
+            job->error = "unknown exception";
+        }
+        job->importMs = milliseconds(start, clock::now());
+        markReady(job, failed);
+    }
+
+    void markReady(Job *job, bool failed)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (failed)
+                job->data = ModelData();
+            job->failed = failed;
+            ready.push_back(job);
+        }
+        readyChanged.notify_one();
+    }
+};
+#endif
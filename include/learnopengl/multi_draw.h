@@ -0,0 +1,438 @@
+#ifndef MULTI_DRAW_H
+#define MULTI_DRAW_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/scene.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/vertex_format.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+// GL 4.3 names the 3.3 loader does not know
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+
+// multi-draw-indirect needs GL 4.3, while glad only loads 3.3: the one extra entry point is loaded here at
+// runtime, and everything that uses it checks Supported() and falls back to the per mesh path otherwise.
+namespace MultiDraw {
+    typedef void (APIENTRYP MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+
+    inline MultiDrawElementsIndirectProc &MultiDrawElementsIndirect()
+    {
+        static MultiDrawElementsIndirectProc proc = nullptr;
+        return proc;
+    }
+
+    enum : GLuint {
+        DrawDataBinding = 0, // shader storage binding of the Draws block (lightingShaderIndirect.vs)
+        DrawIdLocation = 5   // vertex attribute with the index of the draw's record (see GeometryArena)
+    };
+
+    // loads the 4.3 entry points with the context's loader (e.g. glfwGetProcAddress); false for older contexts
+    inline bool Load(GLADloadproc load)
+    {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major < 4 || (major == 4 && minor < 3))
+            return false;
+        MultiDrawElementsIndirect() = (MultiDrawElementsIndirectProc)load("glMultiDrawElementsIndirect");
+        return MultiDrawElementsIndirect() != nullptr;
+    }
+
+    inline bool Supported() { return MultiDrawElementsIndirect() != nullptr; }
+
+    // one record of GL_DRAW_INDIRECT_BUFFER
+    struct DrawElementsIndirectCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+}
+
+// one vertex and one index buffer holding many meshes of the same vertex layout behind a single VAO, so that
+// drawing any of them needs no VAO switch. Meshes are copied in on the GPU from their own buffers. Index
+// ranges start 4 byte aligned, so meshes with 16 and 32-bit indices share the index buffer.
+// The VAO also has an instanced uint attribute at DrawIdLocation holding 0, 1, 2, ...: an indirect draw with
+// baseInstance n reads n from it, which is how the multi-draw shader finds the draw's record.
+class GeometryArena
+{
+public:
+    // where a mesh ended up: its vertex 0 and its first index byte in the arena
+    struct Allocation {
+        GLint baseVertex = 0;
+        size_t indexOffset = 0;
+    };
+
+    GeometryArena(const VertexLayout &layout, size_t vertexCapacity, size_t indexCapacity)
+        : layout(layout), vertexCapacity(vertexCapacity), indexCapacity(indexCapacity)
+    {
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        glGenBuffers(1, &drawIds);
+        GLState::Shared().BindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertexCapacity, nullptr, GL_STATIC_DRAW);
+        layout.Apply();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCapacity, nullptr, GL_STATIC_DRAW);
+        GLState::Shared().BindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    GeometryArena(const GeometryArena &) = delete;
+    GeometryArena &operator=(const GeometryArena &) = delete;
+
+    // frees the GL objects; has to run while the context is still current
+    void Delete()
+    {
+        GLState::Shared().DeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        glDeleteBuffers(1, &drawIds);
+    }
+
+    // whether meshes of layout can be drawn through this arena's VAO
+    bool Holds(const VertexLayout &other) const { return SameFormat(layout, other); }
+
+    // whether the vertex attributes of a and b are the same; index type and quantization may differ
+    static bool SameFormat(const VertexLayout &a, const VertexLayout &b)
+    {
+        return a.packed == b.packed && a.attributes == b.attributes && a.stride == b.stride;
+    }
+
+    // copies the mesh's buffers in; false if it does not fit
+    bool Add(const Mesh &mesh, Allocation &allocation)
+    {
+        size_t indexOffset = (indexUsed + 3) / 4 * 4;
+        if (!Holds(mesh.layout) || vertexUsed + mesh.VertexBytes() > vertexCapacity || indexOffset + mesh.IndexBytes() > indexCapacity)
+            return false;
+        copy(mesh.VertexBuffer(), VBO, vertexUsed, mesh.VertexBytes());
+        copy(mesh.IndexBuffer(), EBO, indexOffset, mesh.IndexBytes());
+        allocation.baseVertex = (GLint)(vertexUsed / layout.stride);
+        allocation.indexOffset = indexOffset;
+        vertexUsed += mesh.VertexBytes();
+        indexUsed = indexOffset + mesh.IndexBytes();
+        return true;
+    }
+
+    // makes the draw index attribute cover draws 0 to count - 1
+    void ReserveDraws(size_t count)
+    {
+        if (count <= drawIdCount)
+            return;
+        drawIdCount = std::max(count, drawIdCount * 2);
+        std::vector<GLuint> ids(drawIdCount);
+        std::iota(ids.begin(), ids.end(), 0u);
+        GLState::Shared().BindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, drawIds);
+        glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(GLuint), ids.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(MultiDraw::DrawIdLocation);
+        glVertexAttribIPointer(MultiDraw::DrawIdLocation, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+        glVertexAttribDivisor(MultiDraw::DrawIdLocation, 1);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    GLuint VAO() const { return vao; }
+    size_t VertexBytes() const { return vertexUsed; }
+    size_t IndexBytes() const { return indexUsed; }
+
+private:
+    VertexLayout layout;
+    size_t vertexCapacity, indexCapacity;
+    size_t vertexUsed = 0, indexUsed = 0;
+    size_t drawIdCount = 0;
+    unsigned int vao, VBO, EBO, drawIds;
+
+    static void copy(GLuint from, GLuint to, size_t offset, size_t bytes)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, from);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, to);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, (GLintptr)offset, (GLsizeiptr)bytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+};
+
+// draws the meshes of a scene out of GeometryArenas with glMultiDrawElementsIndirect. Every frame the
+// submitted draws are sorted by arena, index type and material; their model matrices and vertex quantization
+// go into a shader storage buffer and their DrawElementsIndirectCommands into an indirect buffer, and each
+// run of draws sharing arena, index type and material is one multi-draw call.
+// The shader finds its record through the arena's draw index attribute (baseInstance is the record's index)
+// rather than gl_DrawID, which needs GL 4.6 or ARB_shader_draw_parameters. 4.3 has no bindless textures, so
+// draws with different textures cannot share a call and the number of calls is the number of materials.
+class MultiDrawRenderer
+{
+public:
+    struct Stats {
+        size_t draws = 0;
+        size_t multiDraws = 0;
+    };
+
+    // copies every mesh of the scene's models into arenas, one per vertex format. The models have to be loaded
+    // and must not change their meshes or texture name prefix afterwards, as the draws point at their materials.
+    void Build(const Scene &scene)
+    {
+        std::vector<const Mesh *> added;
+        for (const SceneObject &object : scene.objects)
+            for (const Mesh &mesh : object.model->meshes)
+                if (entries.find(&mesh) == entries.end())
+                {
+                    entries[&mesh] = MeshEntry();
+                    added.push_back(&mesh);
+                }
+
+        // sizes per layout first, so every arena is allocated once
+        std::vector<std::pair<size_t, size_t>> sizes;
+        std::vector<const VertexLayout *> layouts;
+        for (const Mesh *mesh : added)
+        {
+            size_t i = 0;
+            while (i < layouts.size() && !GeometryArena::SameFormat(*layouts[i], mesh->layout))
+                i++;
+            if (i == layouts.size())
+            {
+                layouts.push_back(&mesh->layout);
+                sizes.push_back(std::make_pair(0, 0));
+            }
+            sizes[i].first += mesh->VertexBytes();
+            sizes[i].second += (mesh->IndexBytes() + 3) / 4 * 4;
+        }
+        size_t firstArena = arenas.size();
+        for (size_t i = 0; i < layouts.size(); i++)
+            arenas.push_back(std::unique_ptr<GeometryArena>(new GeometryArena(*layouts[i], sizes[i].first, sizes[i].second)));
+
+        for (const Mesh *mesh : added)
+        {
+            size_t arena = firstArena;
+            GeometryArena::Allocation allocation;
+            while (arena < arenas.size() && !arenas[arena]->Add(*mesh, allocation))
+                arena++;
+            if (arena == arenas.size())
+            {
+                std::cout << "ERROR::MULTI_DRAW::ARENA_FULL" << std::endl;
+                entries.erase(mesh);
+                continue;
+            }
+            addRanges(*mesh, arena, allocation);
+        }
+    }
+
+    // whether Submit can draw the mesh
+    bool Contains(const Mesh &mesh) const { return entries.find(&mesh) != entries.end(); }
+
+    void Begin()
+    {
+        draws.clear();
+        keys.clear();
+    }
+
+    // queues the draws of mesh (one per material range); meshes not added by Build are skipped
+    void Submit(const Mesh &mesh, const glm::mat4 &model)
+    {
+        std::unordered_map<const Mesh *, MeshEntry>::const_iterator entry = entries.find(&mesh);
+        if (entry == entries.end())
+            return;
+        if (model != normalModel)
+        {
+            glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+            for (int column = 0; column < 3; column++)
+                normalColumns[column] = glm::vec4(normalMatrix[column], 0.0f);
+            normalModel = model;
+        }
+        DrawData data;
+        data.model = model;
+        for (int column = 0; column < 3; column++)
+            data.normalMatrix[column] = normalColumns[column];
+        const VertexQuantization &quantization = mesh.layout.quantization;
+        data.positionOffset = glm::vec4(quantization.positionOffset, mesh.layout.packed ? 1.0f : 0.0f);
+        data.positionScale = glm::vec4(quantization.positionScale, 0.0f);
+        data.uvOffsetScale = glm::vec4(quantization.uvOffset, quantization.uvScale);
+        for (size_t i = entry->second.firstRange; i < entry->second.firstRange + entry->second.rangeCount; i++)
+        {
+            const Range &range = ranges[i];
+            uint64_t key = (uint64_t)range.arena << 48
+                         | (uint64_t)(range.indexType == GL_UNSIGNED_INT) << 47
+                         | ((uint64_t)(range.material ? range.material->id : 0) & 0xFFFFFFFF);
+            keys.push_back(RenderQueue::SortEntry{key, (uint32_t)draws.size()});
+            draws.push_back(Draw{(uint32_t)i, data});
+        }
+    }
+
+    // queues the meshes of the scene its last Cull kept
+    void Submit(const Scene &scene)
+    {
+        for (size_t object = 0; object < scene.objects.size(); object++)
+        {
+            const SceneObject &placed = scene.objects[object];
+            for (size_t i = 0; i < placed.model->meshes.size(); i++)
+                if (scene.Visible(object, i))
+                    Submit(placed.model->meshes[i], placed.transform);
+        }
+    }
+
+    // sorts and uploads the submitted draws and issues them with shader (lightingShaderIndirect.vs)
+    void Execute(Shader &shader)
+    {
+        stats = Stats();
+        if (keys.empty() || !MultiDraw::Supported())
+            return;
+        scratch.resize(keys.size());
+        RenderQueue::RadixSort(keys.data(), scratch.data(), keys.size());
+
+        // a draw's record and command both sit at its sorted position, which is its baseInstance
+        commands.resize(keys.size());
+        records.resize(keys.size());
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            const Draw &draw = draws[keys[i].item];
+            const Range &range = ranges[draw.range];
+            commands[i] = MultiDraw::DrawElementsIndirectCommand{range.count, 1, range.firstIndex, range.baseVertex, (GLuint)i};
+            records[i] = draw.data;
+        }
+        if (!dataBuffer)
+        {
+            glGenBuffers(1, &dataBuffer);
+            glGenBuffers(1, &commandBuffer);
+        }
+        // orphaned every frame, so the upload does not wait for last frame's draws
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, dataBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, records.size() * sizeof(DrawData), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, records.size() * sizeof(DrawData), records.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MultiDraw::DrawDataBinding, dataBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(MultiDraw::DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+
+        shader.use();
+        for (const std::unique_ptr<GeometryArena> &arena : arenas)
+            arena->ReserveDraws(keys.size());
+        for (size_t first = 0, last; first < keys.size(); first = last)
+        {
+            last = first + 1;
+            while (last < keys.size() && keys[last].key == keys[first].key)
+                last++;
+            const Range &range = ranges[draws[keys[first].item].range];
+            GLState::Shared().BindVertexArray(arenas[range.arena]->VAO());
+            if (range.material)
+                bindMaterial(shader, *range.material);
+            MultiDraw::MultiDrawElementsIndirect()(GL_TRIANGLES, range.indexType,
+                                                   (void*)(first * sizeof(MultiDraw::DrawElementsIndirectCommand)), (GLsizei)(last - first), 0);
+            stats.multiDraws++;
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        stats.draws = keys.size();
+    }
+
+    const Stats &LastFrame() const { return stats; }
+
+    // bytes of vertex and index data in the arenas
+    size_t ArenaBytes() const
+    {
+        size_t bytes = 0;
+        for (const std::unique_ptr<GeometryArena> &arena : arenas)
+            bytes += arena->VertexBytes() + arena->IndexBytes();
+        return bytes;
+    }
+
+    // frees the GL objects; has to run while the context is still current
+    void Delete()
+    {
+        for (const std::unique_ptr<GeometryArena> &arena : arenas)
+            arena->Delete();
+        arenas.clear();
+        if (dataBuffer)
+        {
+            glDeleteBuffers(1, &dataBuffer);
+            glDeleteBuffers(1, &commandBuffer);
+            dataBuffer = commandBuffer = 0;
+        }
+    }
+
+private:
+    // std430 image of Draw in lightingShaderIndirect.vs
+    struct DrawData {
+        glm::mat4 model;
+        glm::vec4 normalMatrix[3];  // columns of the inverse transpose of the model matrix
+        glm::vec4 positionOffset; // w: 1 for packed vertices
+        glm::vec4 positionScale;
+        glm::vec4 uvOffsetScale;  // uv offset in xy, scale in zw
+    };
+    static_assert(sizeof(DrawData) == 160, "DrawData does not match std430");
+
+    // one material range of a mesh, in its arena
+    struct Range {
+        size_t arena;
+        GLenum indexType;
+        GLuint count;
+        GLuint firstIndex; // in indices of indexType
+        GLint baseVertex;
+        const RenderMaterial *material;
+    };
+    struct MeshEntry {
+        size_t firstRange = 0;
+        size_t rangeCount = 0;
+    };
+    struct Draw {
+        uint32_t range;
+        DrawData data;
+    };
+
+    std::vector<std::unique_ptr<GeometryArena>> arenas;
+    std::unordered_map<const Mesh *, MeshEntry> entries;
+    std::vector<Range> ranges;
+    std::vector<Draw> draws;
+    std::vector<RenderQueue::SortEntry> keys, scratch;
+    std::vector<MultiDraw::DrawElementsIndirectCommand> commands;
+    std::vector<DrawData> records;
+    // normal matrix of the last model matrix submitted; the meshes of an object share one transform
+    glm::mat4 normalModel = glm::mat4(0.0f);
+    glm::vec4 normalColumns[3] = {glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f)};
+    unsigned int dataBuffer = 0, commandBuffer = 0;
+    Stats stats;
+
+    void addRanges(const Mesh &mesh, size_t arena, const GeometryArena::Allocation &allocation)
+    {
+        MeshEntry &entry = entries[&mesh];
+        entry.firstRange = ranges.size();
+        size_t indexSize = mesh.layout.IndexSize();
+        GLuint firstIndex = (GLuint)(allocation.indexOffset / indexSize);
+        if (mesh.subMeshes.empty())
+            ranges.push_back(Range{arena, mesh.layout.indexType, mesh.indexCount, firstIndex, allocation.baseVertex, &mesh.Materials()[0]});
+        for (size_t i = 0; i < mesh.subMeshes.size(); i++)
+        {
+            const SubMesh &subMesh = mesh.subMeshes[i];
+            ranges.push_back(Range{arena, mesh.layout.indexType, (GLuint)subMesh.indexCount, firstIndex + (GLuint)subMesh.firstIndex,
+                                   allocation.baseVertex + (GLint)subMesh.baseVertex, &mesh.Materials()[i]});
+        }
+        entry.rangeCount = ranges.size() - entry.firstRange;
+    }
+
+    static void bindMaterial(Shader &shader, const RenderMaterial &material)
+    {
+        material.SetSamplers(shader);
+        for (size_t i = 0; i < material.textures.size() && i < (size_t)GLState::MaxTextureUnits; i++)
+            GLState::Shared().BindTexture((unsigned int)i, GL_TEXTURE_2D, material.textures[i]);
+    }
+};
+#endif
@@ -0,0 +1,731 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/thread_pool.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Native loader for the Wavefront .obj/.mtl files all of our assets are stored as, used by Model::Import in
+// place of Assimp. The .obj is mmap'd and cut into line aligned chunks that are parsed in parallel; the
+// chunks are then stitched together (relative indices need the element counts of the chunks before them)
+// and every material is built into one MeshData, again in parallel.
+//
+// The output matches what Assimp produces with Model::importFlags: polygons are fanned into triangles,
+// normals are generated (smooth, per position) when a face has none, uvs are flipped, and tangents and
+// bitangents are derived from the uvs. Vertices are welded on their (position, uv, normal) index triplet
+// while they are built, so no separate unique-vertex pass is needed.
+class ObjLoader
+{
+public:
+    struct Stats {
+        size_t bytes = 0;
+        unsigned int chunks = 0;
+        double parseMs = 0.0;
+        double buildMs = 0.0;
+    };
+
+    // loads path into one mesh per material, in order of first use, with the material names in names.
+    // texture paths are relative to the directory of the .obj, like the ones read through Assimp.
+    // chunkCount 0 picks one chunk per pool thread (and per 256 KB at most); the calling thread always helps,
+    // so this can run on a pool thread itself.
+    static bool Load(const std::string &path, std::vector<MeshData> &meshes, std::vector<std::string> *names = nullptr,
+                     Stats *stats = nullptr, ThreadPool &pool = ThreadPool::Shared(), unsigned int chunkCount = 0)
+    {
+        typedef std::chrono::steady_clock clock;
+        clock::time_point start = clock::now();
+
+        MappedFile file;
+        if (!file.Open(path))
+        {
+            std::cout << "ERROR::OBJ_LOADER:: could not read " << path << std::endl;
+            return false;
+        }
+        const char *begin = file.data, *end = file.data + file.size;
+
+        if (chunkCount == 0)
+            chunkCount = std::max(1u, std::min(pool.Size() + 1, (unsigned int)(file.size / (256 * 1024)) + 1));
+        std::vector<Chunk> chunks(chunkCount);
+        for (unsigned int i = 0; i < chunkCount; i++)
+        {
+            chunks[i].begin = i == 0 ? begin : chunks[i - 1].end;
+            const char *split = std::min(end, begin + file.size * (i + 1) / chunkCount);
+            if (i + 1 == chunkCount)
+                split = end;
+            while (split < end && split[-1] != '\n')
+                split++;
+            chunks[i].end = std::max(split, chunks[i].begin);
+        }
+        pool.ParallelFor(chunkCount, [&chunks](size_t i) { parseChunk(chunks[i]); });
+        clock::time_point parsed = clock::now();
+
+        if (!checkChunks(chunks, path))
+            return false;
+
+        // stitch the chunks: global attribute arrays and face ranges per material
+        Attributes attributes;
+        std::vector<std::string> materialNames;
+        std::unordered_map<std::string, size_t> materialIndex;
+        std::vector<std::vector<FaceRange>> materialFaces;
+        std::string mtllib;
+        size_t current = (size_t)-1;
+        auto useMaterial = [&](const std::string &name) {
+            std::unordered_map<std::string, size_t>::const_iterator known = materialIndex.find(name);
+            if (known != materialIndex.end())
+                return known->second;
+            materialIndex[name] = materialNames.size();
+            materialNames.push_back(name);
+            materialFaces.push_back(std::vector<FaceRange>());
+            return materialNames.size() - 1;
+        };
+        for (size_t c = 0; c < chunks.size(); c++)
+        {
+            Chunk &chunk = chunks[c];
+            chunk.positionBase = attributes.positions.size() / 3;
+            chunk.uvBase = attributes.uvs.size() / 2;
+            chunk.normalBase = attributes.normals.size() / 3;
+            attributes.positions.insert(attributes.positions.end(), chunk.positions.begin(), chunk.positions.end());
+            attributes.uvs.insert(attributes.uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+            attributes.normals.insert(attributes.normals.end(), chunk.normals.begin(), chunk.normals.end());
+            if (mtllib.empty() && !chunk.mtllib.empty())
+                mtllib = chunk.mtllib;
+
+            size_t face = 0;
+            for (size_t s = 0; s <= chunk.materialSwitches.size(); s++)
+            {
+                size_t next = s < chunk.materialSwitches.size() ? chunk.materialSwitches[s].first : chunk.faceSizes.size();
+                if (next > face)
+                {
+                    if (current == (size_t)-1)
+                        current = useMaterial("");
+                    materialFaces[current].push_back(FaceRange{c, face, next});
+                }
+                if (s < chunk.materialSwitches.size())
+                    current = useMaterial(chunk.materialSwitches[s].second);
+                face = next;
+            }
+            // first corner of every face, so material builds can start in the middle of a chunk
+            chunk.faceStarts.resize(chunk.faceSizes.size() + 1);
+            chunk.faceStarts[0] = 0;
+            for (size_t f = 0; f < chunk.faceSizes.size(); f++)
+                chunk.faceStarts[f + 1] = chunk.faceStarts[f] + chunk.faceSizes[f];
+        }
+
+        // face indices can only be checked against the whole file once the chunk bases are known
+        pool.ParallelFor(chunkCount, [&chunks, &attributes](size_t i) { checkIndices(chunks[i], attributes); });
+        if (!checkChunks(chunks, path))
+            return false;
+
+        std::string directory = path.substr(0, path.find_last_of('/') + 1);
+        std::unordered_map<std::string, std::vector<Texture>> materials;
+        if (!mtllib.empty())
+            parseMtl(directory + mtllib, materials);
+
+        std::vector<MeshData> built(materialNames.size());
+        pool.ParallelFor(materialNames.size(), [&](size_t m) {
+            buildMesh(chunks, attributes, materialFaces[m], built[m]);
+            std::unordered_map<std::string, std::vector<Texture>>::const_iterator material = materials.find(materialNames[m]);
+            if (material != materials.end())
+                built[m].textures = material->second;
+        });
+        for (size_t m = 0; m < built.size(); m++)
+        {
+            if (built[m].indices.empty())
+                continue;
+            meshes.push_back(std::move(built[m]));
+            if (names)
+                names->push_back(materialNames[m]);
+        }
+
+        if (stats)
+        {
+            stats->bytes = file.size;
+            stats->chunks = chunkCount;
+            stats->parseMs = std::chrono::duration<double, std::milli>(parsed - start).count();
+            stats->buildMs = std::chrono::duration<double, std::milli>(clock::now() - parsed).count();
+        }
+        return true;
+    }
+
+    // parses a decimal floating point number at p (no leading whitespace), returns the end of the number or
+    // nullptr if there is none. Up to 15 significant digits and exponents up to 22 the mantissa and the power
+    // of ten are exact doubles, so the result is the correctly rounded double (like strtod) rounded to float,
+    // which can differ from strtof by one ulp in rare halfway cases. Longer numbers go through strtof.
+    static const char *ParseFloat(const char *p, const char *end, float &value)
+    {
+        static const double powers[23] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                          1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        const char *start = p;
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+        uint64_t mantissa = 0;
+        int digits = 0, exponent = 0;
+        const char *digitsStart = p;
+        for (; p < end && isDigit(*p); p++)
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                if (mantissa)
+                    digits++;
+            }
+            else
+                exponent++;
+        }
+        if (p < end && *p == '.')
+        {
+            p++;
+            for (; p < end && isDigit(*p); p++)
+                if (digits < 19)
+                {
+                    mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                    if (mantissa)
+                        digits++;
+                    exponent--;
+                }
+        }
+        if (p == digitsStart || (p == digitsStart + 1 && *digitsStart == '.'))
+            return parseFloatSlow(start, end, value);
+        if (p < end && (*p == 'e' || *p == 'E'))
+        {
+            const char *e = p + 1;
+            bool negativeExponent = false;
+            if (e < end && (*e == '-' || *e == '+'))
+                negativeExponent = *e++ == '-';
+            if (e < end && isDigit(*e))
+            {
+                int parsed = 0;
+                for (; e < end && isDigit(*e); e++)
+                    parsed = std::min(parsed * 10 + (*e - '0'), 100000);
+                exponent += negativeExponent ? -parsed : parsed;
+                p = e;
+            }
+        }
+        if (digits > 15 || exponent > 22 || exponent < -22)
+            return parseFloatSlow(start, end, value);
+        double result = (double)mantissa;
+        result = exponent >= 0 ? result * powers[exponent] : result / powers[-exponent];
+        value = (float)(negative ? -result : result);
+        return p;
+    }
+
+private:
+    struct MappedFile {
+        const char *data = nullptr;
+        size_t size = 0;
+        std::vector<char> copy;
+
+        ~MappedFile()
+        {
+            if (data && copy.empty() && size)
+                munmap(const_cast<char *>(data), size);
+        }
+
+        bool Open(const std::string &path)
+        {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+            struct stat fileStat;
+            if (fstat(fd, &fileStat) != 0)
+            {
+                close(fd);
+                return false;
+            }
+            size = (size_t)fileStat.st_size;
+            if (size == 0)
+            {
+                close(fd);
+                copy.resize(1);
+                data = copy.data();
+                return true;
+            }
+            void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (mapping == MAP_FAILED)
+                return false;
+            madvise(mapping, size, MADV_SEQUENTIAL);
+            data = static_cast<const char *>(mapping);
+            return true;
+        }
+    };
+
+    // index into the position/uv/normal arrays: the 1-based index of the file (0 if missing) or, with the
+    // attribute's bit in relative set, a 0-based index relative to the chunk's first element (negative for
+    // elements of earlier chunks)
+    struct Corner {
+        int32_t position, uv, normal;
+        uint32_t relative;
+    };
+
+    struct Chunk {
+        const char *begin = nullptr, *end = nullptr;
+        std::vector<float> positions, uvs, normals;
+        std::vector<Corner> corners;
+        std::vector<uint32_t> faceSizes;
+        std::vector<size_t> faceStarts;
+        // usemtl name taking effect at the given face of this chunk
+        std::vector<std::pair<size_t, std::string>> materialSwitches;
+        std::string mtllib;
+        std::string error;
+        size_t positionBase = 0, uvBase = 0, normalBase = 0;
+    };
+
+    struct FaceRange {
+        size_t chunk, first, last;
+    };
+
+    struct Attributes {
+        std::vector<float> positions, uvs, normals;
+    };
+
+    static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+    static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    static const char *parseFloatSlow(const char *p, const char *end, float &value)
+    {
+        char buffer[64];
+        size_t length = 0;
+        while (p + length < end && length + 1 < sizeof(buffer) && !isSpace(p[length]) && p[length] != '\n')
+            length++;
+        std::memcpy(buffer, p, length);
+        buffer[length] = '\0';
+        char *parsedEnd = nullptr;
+        value = std::strtof(buffer, &parsedEnd);
+        return parsedEnd == buffer ? nullptr : p + (parsedEnd - buffer);
+    }
+
+    static const char *skipSpace(const char *p, const char *end)
+    {
+        while (p < end && isSpace(*p))
+            p++;
+        return p;
+    }
+
+    static const char *parseIndex(const char *p, const char *end, int32_t &index, uint32_t &relative, uint32_t bit, size_t localCount)
+    {
+        bool negative = p < end && *p == '-';
+        if (negative)
+            p++;
+        int64_t value = 0;
+        const char *digits = p;
+        for (; p < end && isDigit(*p); p++)
+            value = value * 10 + (*p - '0');
+        if (p == digits)
+            return nullptr;
+        if (!negative)
+            index = (int32_t)value;
+        else
+        {
+            index = (int32_t)((int64_t)localCount - value);
+            relative |= bit;
+        }
+        return p;
+    }
+
+    static bool keyword(const char *p, const char *end, const char *word, size_t length)
+    {
+        return (size_t)(end - p) > length && std::memcmp(p, word, length) == 0 && isSpace(p[length]);
+    }
+
+    static std::string restOfLine(const char *p, const char *end)
+    {
+        p = skipSpace(p, end);
+        const char *last = end;
+        while (last > p && isSpace(last[-1]))
+            last--;
+        return std::string(p, last);
+    }
+
+    static void parseChunk(Chunk &chunk)
+    {
+        const char *p = chunk.begin;
+        while (p < chunk.end && chunk.error.empty())
+        {
+            const char *lineEnd = static_cast<const char *>(std::memchr(p, '\n', (size_t)(chunk.end - p)));
+            if (!lineEnd)
+                lineEnd = chunk.end;
+            p = skipSpace(p, lineEnd);
+            if (p + 1 < lineEnd)
+            {
+                if (p[0] == 'v' && isSpace(p[1]))
+                    parseFloats(p + 2, lineEnd, chunk.positions, 3, chunk);
+                else if (p[0] == 'v' && p[1] == 't' && p + 2 < lineEnd && isSpace(p[2]))
+                    parseFloats(p + 3, lineEnd, chunk.uvs, 2, chunk);
+                else if (p[0] == 'v' && p[1] == 'n' && p + 2 < lineEnd && isSpace(p[2]))
+                    parseFloats(p + 3, lineEnd, chunk.normals, 3, chunk);
+                else if (p[0] == 'f' && isSpace(p[1]))
+                    parseFace(p + 2, lineEnd, chunk);
+                else if (keyword(p, lineEnd, "usemtl", 6))
+                    chunk.materialSwitches.push_back(std::make_pair(chunk.faceSizes.size(), restOfLine(p + 6, lineEnd)));
+                else if (keyword(p, lineEnd, "mtllib", 6))
+                    chunk.mtllib = restOfLine(p + 6, lineEnd);
+                // comments, groups, objects, smoothing groups and lines/points are ignored
+            }
+            p = lineEnd + 1;
+        }
+    }
+
+    // reads count floats; missing trailing components (a "vt u" line, say) are 0 and extra ones (w) are ignored
+    static void parseFloats(const char *p, const char *end, std::vector<float> &out, int count, Chunk &chunk)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            p = skipSpace(p, end);
+            float value = 0.0f;
+            if (p < end)
+            {
+                const char *next = ParseFloat(p, end, value);
+                if (!next)
+                {
+                    chunk.error = "malformed number \"" + restOfLine(p, end) + "\"";
+                    return;
+                }
+                p = next;
+            }
+            out.push_back(value);
+        }
+    }
+
+    static void parseFace(const char *p, const char *end, Chunk &chunk)
+    {
+        uint32_t corners = 0;
+        for (;;)
+        {
+            p = skipSpace(p, end);
+            if (p >= end)
+                break;
+            Corner corner = {0, 0, 0, 0};
+            p = parseIndex(p, end, corner.position, corner.relative, 1, chunk.positions.size() / 3);
+            if (p && p < end && *p == '/')
+            {
+                p++;
+                if (p < end && *p != '/')
+                    p = parseIndex(p, end, corner.uv, corner.relative, 2, chunk.uvs.size() / 2);
+                if (p && p < end && *p == '/')
+                    p = parseIndex(p + 1, end, corner.normal, corner.relative, 4, chunk.normals.size() / 3);
+            }
+            if (!p || (p < end && !isSpace(*p)))
+            {
+                chunk.error = "malformed face";
+                return;
+            }
+            chunk.corners.push_back(corner);
+            corners++;
+        }
+        if (corners < 3)
+        {
+            // points and degenerate faces carry no triangles
+            chunk.corners.resize(chunk.corners.size() - corners);
+            return;
+        }
+        chunk.faceSizes.push_back(corners);
+    }
+
+    static int64_t resolve(int32_t index, bool relative, size_t base)
+    {
+        return relative ? (int64_t)base + index : (int64_t)index - 1;
+    }
+
+    // prints the first parse error of the chunks, if any
+    static bool checkChunks(const std::vector<Chunk> &chunks, const std::string &path)
+    {
+        for (const Chunk &chunk : chunks)
+            if (!chunk.error.empty())
+            {
+                std::cout << "ERROR::OBJ_LOADER:: " << path << ": " << chunk.error << std::endl;
+                return false;
+            }
+        return true;
+    }
+
+    // fails the chunk if a face names a position, uv or normal the file does not have; a missing uv or normal
+    // (index 0 without the relative bit) is fine
+    static void checkIndices(Chunk &chunk, const Attributes &attributes)
+    {
+        const size_t positionCount = attributes.positions.size() / 3;
+        const size_t uvCount = attributes.uvs.size() / 2;
+        const size_t normalCount = attributes.normals.size() / 3;
+        for (const Corner &corner : chunk.corners)
+        {
+            int64_t position = resolve(corner.position, (corner.relative & 1) != 0, chunk.positionBase);
+            int64_t uv = resolve(corner.uv, (corner.relative & 2) != 0, chunk.uvBase);
+            int64_t normal = resolve(corner.normal, (corner.relative & 4) != 0, chunk.normalBase);
+            bool hasUv = corner.uv != 0 || (corner.relative & 2) != 0;
+            bool hasNormal = corner.normal != 0 || (corner.relative & 4) != 0;
+            if (position < 0 || (size_t)position >= positionCount)
+                chunk.error = "face index out of range: position " + std::to_string(position + 1) + " of " + std::to_string(positionCount);
+            else if (hasUv && (uv < 0 || (size_t)uv >= uvCount))
+                chunk.error = "face index out of range: uv " + std::to_string(uv + 1) + " of " + std::to_string(uvCount);
+            else if (hasNormal && (normal < 0 || (size_t)normal >= normalCount))
+                chunk.error = "face index out of range: normal " + std::to_string(normal + 1) + " of " + std::to_string(normalCount);
+            if (!chunk.error.empty())
+                return;
+        }
+    }
+
+    // open addressed (position, uv, normal) -> vertex table
+    struct VertexTable {
+        std::vector<int64_t> keys;
+        std::vector<unsigned int> values;
+        size_t mask;
+
+        explicit VertexTable(size_t expected)
+        {
+            size_t capacity = 16;
+            while (capacity < expected * 2)
+                capacity *= 2;
+            keys.assign(capacity * 3, -2);
+            values.resize(capacity);
+            mask = capacity - 1;
+        }
+
+        // returns the vertex of the triplet, or inserts next and returns it
+        unsigned int FindOrInsert(int64_t position, int64_t uv, int64_t normal, unsigned int next, bool &inserted)
+        {
+            uint64_t hash = (uint64_t)position * 0x9E3779B97F4A7C15ull ^ (uint64_t)(uv + 1) * 0xC2B2AE3D27D4EB4Full
+                    ^ (uint64_t)(normal + 1) * 0x165667B19E3779F9ull;
+            hash ^= hash >> 29;
+            for (size_t slot = (size_t)hash & mask;; slot = (slot + 1) & mask)
+            {
+                int64_t *key = &keys[slot * 3];
+                if (key[0] == -2)
+                {
+                    key[0] = position;
+                    key[1] = uv;
+                    key[2] = normal;
+                    values[slot] = next;
+                    inserted = true;
+                    return next;
+                }
+                if (key[0] == position && key[1] == uv && key[2] == normal)
+                {
+                    inserted = false;
+                    return values[slot];
+                }
+            }
+        }
+    };
+
+    static void buildMesh(const std::vector<Chunk> &chunks, const Attributes &attributes,
+                          const std::vector<FaceRange> &faces, MeshData &mesh)
+    {
+        size_t cornerCount = 0;
+        for (const FaceRange &range : faces)
+        {
+            const Chunk &chunk = chunks[range.chunk];
+            cornerCount += chunk.faceStarts[range.last] - chunk.faceStarts[range.first];
+        }
+        VertexTable table(cornerCount);
+        std::vector<int64_t> vertexPosition;
+        std::vector<bool> generatedNormal;
+        vertexPosition.reserve(cornerCount);
+        mesh.vertices.reserve(cornerCount);
+        mesh.indices.reserve(cornerCount * 3);
+
+        bool anyGenerated = false;
+        std::vector<unsigned int> polygon;
+        for (const FaceRange &range : faces)
+        {
+            const Chunk &chunk = chunks[range.chunk];
+            for (size_t f = range.first; f < range.last; f++)
+            {
+                polygon.clear();
+                for (size_t c = chunk.faceStarts[f]; c < chunk.faceStarts[f + 1]; c++)
+                {
+                    const Corner &corner = chunk.corners[c];
+                    int64_t position = resolve(corner.position, (corner.relative & 1) != 0, chunk.positionBase);
+                    int64_t uv = resolve(corner.uv, (corner.relative & 2) != 0, chunk.uvBase);
+                    // in range (see checkIndices), -1 for a missing uv or normal
+                    int64_t normal = resolve(corner.normal, (corner.relative & 4) != 0, chunk.normalBase);
+                    bool inserted;
+                    unsigned int vertex = table.FindOrInsert(position, uv, normal, (unsigned int)mesh.vertices.size(), inserted);
+                    if (inserted)
+                    {
+                        Vertex v;
+                        v.Normal = glm::vec3(0.0f);
+                        v.TexCoords = glm::vec2(0.0f, 0.0f);
+                        v.Tangent = v.Bitangent = glm::vec3(0.0f);
+                        const float *xyz = &attributes.positions[(size_t)position * 3];
+                        v.Position = glm::vec3(xyz[0], xyz[1], xyz[2]);
+                        if (normal >= 0)
+                        {
+                            const float *n = &attributes.normals[(size_t)normal * 3];
+                            v.Normal = glm::vec3(n[0], n[1], n[2]);
+                        }
+                        if (uv >= 0)
+                            v.TexCoords = glm::vec2(attributes.uvs[(size_t)uv * 2], 1.0f - attributes.uvs[(size_t)uv * 2 + 1]);
+                        mesh.vertices.push_back(v);
+                        vertexPosition.push_back(position);
+                        generatedNormal.push_back(normal < 0);
+                        anyGenerated = anyGenerated || normal < 0;
+                    }
+                    polygon.push_back(vertex);
+                }
+                // fan triangulation
+                for (size_t k = 1; k + 1 < polygon.size(); k++)
+                {
+                    mesh.indices.push_back(polygon[0]);
+                    mesh.indices.push_back(polygon[k]);
+                    mesh.indices.push_back(polygon[k + 1]);
+                }
+            }
+        }
+        if (anyGenerated)
+            generateNormals(mesh, vertexPosition, generatedNormal);
+        generateTangents(mesh);
+    }
+
+    // smooth normals for vertices without one: area weighted face normals summed per position
+    static void generateNormals(MeshData &mesh, const std::vector<int64_t> &vertexPosition, const std::vector<bool> &generated)
+    {
+        std::unordered_map<int64_t, glm::vec3> sums;
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            const glm::vec3 &a = mesh.vertices[mesh.indices[i]].Position;
+            glm::vec3 faceNormal = glm::cross(mesh.vertices[mesh.indices[i + 1]].Position - a, mesh.vertices[mesh.indices[i + 2]].Position - a);
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int v = mesh.indices[i + k];
+                if (generated[v])
+                    sums[vertexPosition[v]] += faceNormal;
+            }
+        }
+        for (size_t v = 0; v < mesh.vertices.size(); v++)
+        {
+            if (!generated[v])
+                continue;
+            glm::vec3 sum = sums[vertexPosition[v]];
+            float length = glm::length(sum);
+            mesh.vertices[v].Normal = length > 0.0f ? sum / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+    }
+
+    // per triangle tangent frames from the uv gradients, summed per vertex and made orthogonal to the normal
+    static void generateTangents(MeshData &mesh)
+    {
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            Vertex &a = mesh.vertices[mesh.indices[i]];
+            Vertex &b = mesh.vertices[mesh.indices[i + 1]];
+            Vertex &c = mesh.vertices[mesh.indices[i + 2]];
+            glm::vec3 e1 = b.Position - a.Position, e2 = c.Position - a.Position;
+            float s1 = b.TexCoords.x - a.TexCoords.x, t1 = b.TexCoords.y - a.TexCoords.y;
+            float s2 = c.TexCoords.x - a.TexCoords.x, t2 = c.TexCoords.y - a.TexCoords.y;
+            float determinant = s1 * t2 - s2 * t1;
+            if (std::fabs(determinant) < 1e-20f)
+                continue;
+            float r = 1.0f / determinant;
+            glm::vec3 tangent = (e1 * t2 - e2 * t1) * r;
+            glm::vec3 bitangent = (e2 * s1 - e1 * s2) * r;
+            a.Tangent += tangent; b.Tangent += tangent; c.Tangent += tangent;
+            a.Bitangent += bitangent; b.Bitangent += bitangent; c.Bitangent += bitangent;
+        }
+        for (Vertex &v : mesh.vertices)
+        {
+            glm::vec3 tangent = v.Tangent - v.Normal * glm::dot(v.Normal, v.Tangent);
+            glm::vec3 bitangent = v.Bitangent - v.Normal * glm::dot(v.Normal, v.Bitangent);
+            float tangentLength = glm::length(tangent), bitangentLength = glm::length(bitangent);
+            v.Tangent = tangentLength > 0.0f ? tangent / tangentLength : glm::vec3(0.0f);
+            v.Bitangent = bitangentLength > 0.0f ? bitangent / bitangentLength : glm::vec3(0.0f);
+        }
+    }
+
+    // material name -> textures, with the texture types Model::processMesh assigns to the Assimp equivalents
+    static void parseMtl(const std::string &path, std::unordered_map<std::string, std::vector<Texture>> &materials)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            std::cout << "ERROR::OBJ_LOADER:: could not read material library " << path << std::endl;
+            return;
+        }
+        static const char *const maps[][2] = {
+            {"map_Kd", "texture_diffuse"}, {"map_Ks", "texture_specular"}, {"map_bump", "texture_normal"},
+            {"map_Bump", "texture_normal"}, {"bump", "texture_normal"}, {"map_Ka", "texture_height"}};
+        std::vector<Texture> *material = nullptr;
+        std::string line;
+        while (std::getline(file, line))
+        {
+            const char *p = skipSpace(line.data(), line.data() + line.size());
+            const char *end = line.data() + line.size();
+            if (keyword(p, end, "newmtl", 6))
+            {
+                material = &materials[restOfLine(p + 6, end)];
+                continue;
+            }
+            if (!material)
+                continue;
+            for (const auto &map : maps)
+            {
+                size_t length = std::strlen(map[0]);
+                if (!keyword(p, end, map[0], length))
+                    continue;
+                Texture texture;
+                texture.id = 0;
+                texture.type = map[1];
+                texture.path = texturePath(restOfLine(p + length, end));
+                if (!texture.path.empty())
+                    material->push_back(texture);
+                break;
+            }
+        }
+    }
+
+    // drops the options in front of a texture file name ("-bm 1.0 normal.png")
+    static std::string texturePath(const std::string &arguments)
+    {
+        std::istringstream tokens(arguments);
+        std::vector<std::string> words;
+        std::string word;
+        while (tokens >> word)
+            words.push_back(word);
+        // option -> number of arguments; -o, -s and -t take 1 to 3 numbers
+        static const char *const options[][2] = {
+            {"-blendu", "1"}, {"-blendv", "1"}, {"-boost", "1"}, {"-mm", "2"}, {"-o", "3"}, {"-s", "3"}, {"-t", "3"},
+            {"-texres", "1"}, {"-clamp", "1"}, {"-bm", "1"}, {"-imfchan", "1"}, {"-type", "1"}, {"-cc", "1"}};
+        size_t i = 0;
+        while (i + 1 < words.size() && words[i][0] == '-')
+        {
+            std::string option = words[i++];
+            for (const auto &known : options)
+            {
+                if (option != known[0])
+                    continue;
+                bool vector = option == "-o" || option == "-s" || option == "-t";
+                for (int k = 0; k < known[1][0] - '0' && i + 1 < words.size(); k++)
+                {
+                    if (vector && k > 0 && words[i].find_first_not_of("-+.0123456789eE") != std::string::npos)
+                        break;
+                    i++;
+                }
+            }
+        }
+        std::string path;
+        for (; i < words.size(); i++)
+            path += (path.empty() ? "" : " ") + words[i];
+        return path;
+    }
+};
+#endif
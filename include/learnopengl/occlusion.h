@@ -0,0 +1,337 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/cpu_features.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Software occlusion culling: a few simplified occluder meshes are rasterized on the CPU into a small depth
+// buffer every frame, and the world space boxes of the scene's meshes are tested against it before anything is
+// submitted. The buffer holds 1 / w of the nearest occluder per pixel (0 where there is none), so depths
+// interpolate linearly in screen space and larger is nearer. Horizontal bands of the buffer are rasterized in
+// parallel on the thread pool, 4 (SSE2) or 8 (AVX) pixels of a row at a time.
+// Occluders have to lie inside the geometry they stand for; anything bigger hides objects that are visible.
+class OcclusionCuller
+{
+public:
+    enum : int {
+        Width = 256,
+        Height = 128,
+        BandHeight = 16
+    };
+
+    struct Stats {
+        size_t occluders = 0;
+        size_t triangles = 0; // rasterized, after clipping
+        size_t tested = 0;
+        size_t occluded = 0;
+        double rasterizeMs = 0.0;
+        double testMs = 0.0;
+
+        float CullRate() const { return tested ? (float)occluded / (float)tested : 0.0f; }
+    };
+
+    // best instruction set the CPU supports
+    static Isa Detected()
+    {
+        return CpuFeatures::Best({Isa::SSE2, Isa::AVX});
+    }
+
+    // instruction set used by Render; can be lowered to compare against the scalar path
+    static Isa &Active()
+    {
+        static Isa isa = Detected();
+        return isa;
+    }
+
+    explicit OcclusionCuller(ThreadPool &pool = ThreadPool::Shared()) : pool(pool), depth(Width * Height, 0.0f)
+    {
+    }
+
+    // adds a triangle mesh placed with transform; indices are triples into positions
+    void AddOccluder(const std::vector<glm::vec3> &positions, const std::vector<uint32_t> &indices, const glm::mat4 &transform)
+    {
+        Occluder occluder;
+        occluder.positions = positions;
+        occluder.indices = indices;
+        occluder.transform = transform;
+        occluders.push_back(occluder);
+    }
+
+    // adds the box between boundsMin and boundsMax placed with transform
+    void AddBox(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, const glm::mat4 &transform)
+    {
+        std::vector<glm::vec3> corners(8);
+        for (int i = 0; i < 8; i++)
+            corners[i] = glm::vec3(i & 1 ? boundsMax.x : boundsMin.x, i & 2 ? boundsMax.y : boundsMin.y, i & 4 ? boundsMax.z : boundsMin.z);
+        static const uint32_t faces[36] = {
+            0, 2, 1, 1, 2, 3,  4, 5, 6, 5, 7, 6,  0, 1, 4, 1, 5, 4,
+            2, 6, 3, 3, 6, 7,  0, 4, 2, 2, 4, 6,  1, 3, 5, 3, 7, 5
+        };
+        AddOccluder(corners, std::vector<uint32_t>(faces, faces + 36), transform);
+    }
+
+    void ClearOccluders() { occluders.clear(); }
+    size_t OccluderCount() const { return occluders.size(); }
+
+    // clears the depth buffer and rasterizes every occluder as seen through viewProjection
+    void Render(const glm::mat4 &viewProjection)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        this->viewProjection = viewProjection;
+        triangles.clear();
+        for (const Occluder &occluder : occluders)
+        {
+            glm::mat4 transform = viewProjection * occluder.transform;
+            clipped.resize(occluder.positions.size());
+            for (size_t i = 0; i < occluder.positions.size(); i++)
+                clipped[i] = transform * glm::vec4(occluder.positions[i], 1.0f);
+            for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3)
+                addTriangle(clipped[occluder.indices[i]], clipped[occluder.indices[i + 1]], clipped[occluder.indices[i + 2]]);
+        }
+        pool.ParallelFor(Height / BandHeight, [this](size_t band) { rasterizeBand((int)band); });
+
+        stats.occluders = occluders.size();
+        stats.triangles = triangles.size();
+        stats.rasterizeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // whether any part of the world space box may be in front of the occluders of the last Render. Boxes reaching
+    // behind the near plane or entirely off screen count as visible, the frustum test decides about those.
+    bool Visible(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) const
+    {
+        float minX = (float)Width, maxX = 0.0f, minY = (float)Height, maxY = 0.0f, nearest = 0.0f;
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec3 corner(i & 1 ? boundsMax.x : boundsMin.x, i & 2 ? boundsMax.y : boundsMin.y, i & 4 ? boundsMax.z : boundsMin.z);
+            glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+            if (clip.z < -clip.w || clip.w <= 0.0f)
+                return true;
+            glm::vec3 screen = toScreen(clip);
+            minX = std::min(minX, screen.x); maxX = std::max(maxX, screen.x);
+            minY = std::min(minY, screen.y); maxY = std::max(maxY, screen.y);
+            nearest = std::max(nearest, screen.z);
+        }
+        // every pixel the box's screen rectangle touches
+        int x0 = std::max(0, (int)std::floor(minX)), x1 = std::min(Width - 1, (int)std::floor(maxX));
+        int y0 = std::max(0, (int)std::floor(minY)), y1 = std::min(Height - 1, (int)std::floor(maxY));
+        if (x0 > x1 || y0 > y1)
+            return true;
+        for (int y = y0; y <= y1; y++)
+        {
+            const float *row = &depth[y * Width];
+            for (int x = x0; x <= x1; x++)
+                if (row[x] <= nearest)
+                    return true;
+        }
+        return false;
+    }
+
+    // clears visible[i] for every entry of bounds that is still visible but occluded; returns how many were
+    size_t Test(const FrustumCuller &bounds, std::vector<unsigned char> &visible)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        stats.tested = 0;
+        stats.occluded = 0;
+        for (size_t i = 0; i < bounds.Size() && i < visible.size(); i++)
+        {
+            if (!visible[i])
+                continue;
+            stats.tested++;
+            glm::vec3 center = bounds.Center(i), extent = bounds.Extent(i);
+            if (!Visible(center - extent, center + extent))
+            {
+                visible[i] = 0;
+                stats.occluded++;
+            }
+        }
+        stats.testMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return stats.occluded;
+    }
+
+    // Width * Height values, row 0 at the bottom of the screen; 1 / w of the nearest occluder, 0 for none
+    const float *Depth() const { return depth.data(); }
+
+    const Stats &LastFrame() const { return stats; }
+
+private:
+    struct Occluder {
+        std::vector<glm::vec3> positions;
+        std::vector<uint32_t> indices;
+        glm::mat4 transform;
+    };
+
+    // a clipped triangle in pixels, z = 1 / w
+    struct ScreenTriangle {
+        glm::vec3 a, b, c;
+        int minX, maxX, minY, maxY;
+    };
+
+    ThreadPool &pool;
+    std::vector<Occluder> occluders;
+    std::vector<glm::vec4> clipped;
+    std::vector<ScreenTriangle> triangles;
+    std::vector<float> depth;
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    Stats stats;
+
+    static glm::vec3 toScreen(const glm::vec4 &clip)
+    {
+        float inverseW = 1.0f / clip.w;
+        return glm::vec3((clip.x * inverseW * 0.5f + 0.5f) * Width, (clip.y * inverseW * 0.5f + 0.5f) * Height, inverseW);
+    }
+
+    // clips against the near plane (z >= -w), which leaves at most a quad, and queues what is on screen
+    void addTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c)
+    {
+        const glm::vec4 in[3] = {a, b, c};
+        glm::vec4 out[4];
+        int count = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            const glm::vec4 &from = in[i], &to = in[(i + 1) % 3];
+            float dFrom = from.z + from.w, dTo = to.z + to.w;
+            if (dFrom >= 0.0f)
+                out[count++] = from;
+            if ((dFrom >= 0.0f) != (dTo >= 0.0f))
+                out[count++] = from + (to - from) * (dFrom / (dFrom - dTo));
+        }
+        for (int i = 1; i + 1 < count; i++)
+            addScreenTriangle(toScreen(out[0]), toScreen(out[i]), toScreen(out[i + 1]));
+    }
+
+    void addScreenTriangle(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+    {
+        ScreenTriangle triangle;
+        triangle.a = a;
+        triangle.b = b;
+        triangle.c = c;
+        triangle.minX = std::max(0, (int)std::floor(std::min(a.x, std::min(b.x, c.x))));
+        triangle.maxX = std::min(Width - 1, (int)std::ceil(std::max(a.x, std::max(b.x, c.x))));
+        triangle.minY = std::max(0, (int)std::floor(std::min(a.y, std::min(b.y, c.y))));
+        triangle.maxY = std::min(Height - 1, (int)std::ceil(std::max(a.y, std::max(b.y, c.y))));
+        if (triangle.minX <= triangle.maxX && triangle.minY <= triangle.maxY)
+            triangles.push_back(triangle);
+    }
+
+    // edge functions and the 1 / w plane of a triangle, each value v(x, y) = dx * x + dy * y + c at pixel centers
+    struct Setup {
+        float edgeX[3], edgeY[3], edgeC[3];
+        float depthX, depthY, depthC;
+    };
+
+    static bool setup(const ScreenTriangle &triangle, Setup &s)
+    {
+        glm::vec3 a = triangle.a, b = triangle.b, c = triangle.c;
+        float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (std::fabs(area) < 1e-8f)
+            return false;
+        // both windings are drawn, counter clockwise after this
+        if (area < 0.0f)
+        {
+            std::swap(b, c);
+            area = -area;
+        }
+        const glm::vec3 *from[3] = {&b, &c, &a}, *to[3] = {&c, &a, &b};
+        for (int i = 0; i < 3; i++)
+        {
+            s.edgeX[i] = from[i]->y - to[i]->y;
+            s.edgeY[i] = to[i]->x - from[i]->x;
+            s.edgeC[i] = -(s.edgeX[i] * from[i]->x + s.edgeY[i] * from[i]->y);
+        }
+        // barycentric weights are the edge values over the area
+        float inverseArea = 1.0f / area;
+        s.depthX = (s.edgeX[0] * a.z + s.edgeX[1] * b.z + s.edgeX[2] * c.z) * inverseArea;
+        s.depthY = (s.edgeY[0] * a.z + s.edgeY[1] * b.z + s.edgeY[2] * c.z) * inverseArea;
+        s.depthC = (s.edgeC[0] * a.z + s.edgeC[1] * b.z + s.edgeC[2] * c.z) * inverseArea;
+        return true;
+    }
+
+    void rasterizeBand(int band)
+    {
+        int y0 = band * BandHeight, y1 = y0 + BandHeight - 1;
+        std::fill(depth.begin() + y0 * Width, depth.begin() + (y1 + 1) * Width, 0.0f);
+        for (const ScreenTriangle &triangle : triangles)
+        {
+            if (triangle.maxY < y0 || triangle.minY > y1)
+                continue;
+            Setup s;
+            if (!setup(triangle, s))
+                continue;
+            for (int y = std::max(y0, triangle.minY); y <= std::min(y1, triangle.maxY); y++)
+            {
+                float py = y + 0.5f;
+                float row[3] = {s.edgeY[0] * py + s.edgeC[0], s.edgeY[1] * py + s.edgeC[1], s.edgeY[2] * py + s.edgeC[2]};
+                float depthRow = s.depthY * py + s.depthC;
+                float *target = &depth[y * Width];
+                int x = triangle.minX;
+#if CPU_X86
+                if (Active() == Isa::AVX)
+                    x = rasterizeSpanAVX(s, row, depthRow, target, x, triangle.maxX);
+                else if (Active() == Isa::SSE2)
+                    x = rasterizeSpanSSE(s, row, depthRow, target, x, triangle.maxX);
+#endif
+                for (; x <= triangle.maxX; x++)
+                {
+                    float px = x + 0.5f;
+                    float e0 = s.edgeX[0] * px + row[0], e1 = s.edgeX[1] * px + row[1], e2 = s.edgeX[2] * px + row[2];
+                    if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f)
+                        target[x] = std::max(target[x], s.depthX * px + depthRow);
+                }
+            }
+        }
+    }
+
+#if CPU_X86
+    // the SIMD spans handle whole groups of 4 or 8 pixels from x on and return where the scalar tail starts;
+    // they evaluate the same expressions as the scalar loop, so the buffers match bit for bit
+    CPU_SSE2 static int rasterizeSpanSSE(const Setup &s, const float *row, float depthRow, float *target, int x, int maxX)
+    {
+        const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128 zero = _mm_setzero_ps();
+        for (; x + 3 <= maxX; x += 4)
+        {
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+            __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(s.edgeX[0]), px), _mm_set1_ps(row[0])), zero);
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(s.edgeX[1]), px), _mm_set1_ps(row[1])), zero));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(s.edgeX[2]), px), _mm_set1_ps(row[2])), zero));
+            if (_mm_movemask_ps(inside) == 0)
+                continue;
+            __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(s.depthX), px), _mm_set1_ps(depthRow));
+            __m128 old = _mm_loadu_ps(target + x);
+            __m128 nearer = _mm_max_ps(old, z);
+            _mm_storeu_ps(target + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+        }
+        return x;
+    }
+
+    CPU_AVX static int rasterizeSpanAVX(const Setup &s, const float *row, float depthRow, float *target, int x, int maxX)
+    {
+        const __m256 offsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+        const __m256 zero = _mm256_setzero_ps();
+        for (; x + 7 <= maxX; x += 8)
+        {
+            __m256 px = _mm256_add_ps(_mm256_set1_ps((float)x), offsets);
+            __m256 inside = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(s.edgeX[0]), px), _mm256_set1_ps(row[0])), zero, _CMP_GE_OQ);
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(s.edgeX[1]), px), _mm256_set1_ps(row[1])), zero, _CMP_GE_OQ));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(s.edgeX[2]), px), _mm256_set1_ps(row[2])), zero, _CMP_GE_OQ));
+            if (_mm256_movemask_ps(inside) == 0)
+                continue;
+            __m256 z = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(s.depthX), px), _mm256_set1_ps(depthRow));
+            __m256 old = _mm256_loadu_ps(target + x);
+            _mm256_storeu_ps(target + x, _mm256_blendv_ps(old, _mm256_max_ps(old, z), inside));
+        }
+        return x;
+    }
+#endif
+};
+#endif
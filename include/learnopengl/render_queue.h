@@ -0,0 +1,311 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/vertex_format.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+// the textures one draw binds: textures[i] goes to unit i and samplerNames[i] (if present) is pointed at it.
+// id is the same for every material with the same textures, so the render queue can group draws by it.
+struct RenderMaterial {
+    std::vector<unsigned int> textures;
+    std::vector<std::string> samplerNames;
+    uint32_t id = 0;
+
+    RenderMaterial() {}
+
+    RenderMaterial(const std::vector<unsigned int> &textures, const std::vector<std::string> &samplerNames)
+        : textures(textures), samplerNames(samplerNames), id(Intern(textures, samplerNames))
+    {
+    }
+
+    // small id per distinct texture/sampler combination; GL thread only
+    static uint32_t Intern(const std::vector<unsigned int> &textures, const std::vector<std::string> &samplerNames)
+    {
+        static std::map<std::pair<std::vector<unsigned int>, std::vector<std::string>>, uint32_t> ids;
+        auto inserted = ids.insert(std::make_pair(std::make_pair(textures, samplerNames), (uint32_t)ids.size() + 1));
+        return inserted.first->second;
+    }
+
+    // points samplerNames[i] of shader's program at unit i. The handles are resolved on the first call with a
+    // program, and afterwards only values the program doesn't hold yet are sent (see UniformTable)
+    void SetSamplers(const Shader &shader) const
+    {
+        if (samplerNames.empty())
+            return;
+        const std::vector<Uniform<int>> &uniforms = samplerUniforms(shader);
+        for (size_t i = 0; i < uniforms.size() && i < textures.size(); i++)
+            shader.set(uniforms[i], (int)i);
+    }
+
+private:
+    struct ProgramSamplers {
+        GLuint program;
+        std::vector<Uniform<int>> uniforms;
+    };
+    // sampler handles per program the material was drawn with
+    mutable std::vector<ProgramSamplers> programSamplers;
+
+    const std::vector<Uniform<int>> &samplerUniforms(const Shader &shader) const
+    {
+        for (const ProgramSamplers &samplers : programSamplers)
+            if (samplers.program == shader.ID)
+                return samplers.uniforms;
+        ProgramSamplers samplers;
+        samplers.program = shader.ID;
+        for (const std::string &name : samplerNames)
+            samplers.uniforms.push_back(shader.uniform<int>(name.c_str()));
+        programSamplers.push_back(samplers);
+        return programSamplers.back().uniforms;
+    }
+};
+
+// the uniforms the vertex shader decodes packed vertices with (see VertexQuantization), resolved once per program
+struct VertexUniforms {
+    Uniform<bool> packedVertex;
+    Uniform<glm::vec3> positionOffset, positionScale;
+    Uniform<glm::vec2> uvOffset, uvScale;
+
+    explicit VertexUniforms(const Shader &shader)
+        : packedVertex(shader.uniform<bool>("packedVertex")),
+          positionOffset(shader.uniform<glm::vec3>("positionOffset")), positionScale(shader.uniform<glm::vec3>("positionScale")),
+          uvOffset(shader.uniform<glm::vec2>("uvOffset")), uvScale(shader.uniform<glm::vec2>("uvScale"))
+    {
+    }
+
+    // the handles of shader's program, resolved on the first call with it; GL thread only
+    static const VertexUniforms &Of(const Shader &shader)
+    {
+        static std::deque<std::pair<GLuint, VertexUniforms>> programs;
+        for (const auto &program : programs)
+            if (program.first == shader.ID)
+                return program.second;
+        programs.push_back(std::make_pair(shader.ID, VertexUniforms(shader)));
+        return programs.back().second;
+    }
+
+    // the quantization of a packed layout; float layouts have none
+    void SetQuantization(const Shader &shader, const VertexLayout &layout) const
+    {
+        if (!layout.packed)
+            return;
+        shader.set(positionOffset, layout.quantization.positionOffset);
+        shader.set(positionScale, layout.quantization.positionScale);
+        shader.set(uvOffset, layout.quantization.uvOffset);
+        shader.set(uvScale, layout.quantization.uvScale);
+    }
+};
+
+// one indexed draw submitted to a RenderQueue
+struct RenderItem {
+    Shader *shader = nullptr;
+    unsigned int VAO = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    GLsizei indexCount = 0;
+    size_t indexOffset = 0; // in bytes
+    GLint baseVertex = 0;
+    const RenderMaterial *material = nullptr;
+    // layout of the vertex buffer, packed meshes need their quantization uniforms; null for float vertices
+    const VertexLayout *layout = nullptr;
+    glm::mat4 model = glm::mat4(1.0f);
+};
+
+// collects the draws of a frame and executes them sorted by a 64-bit key, so that draws sharing a program,
+// textures and VAO run back to back and state is only changed where it differs from the previous draw.
+// key, most significant first:
+//   pass (4 bits) | program (8) | material (16) | VAO (12) | depth (24, front to back)
+// Submit between Begin and Execute; the submitted materials and layouts have to outlive Execute.
+class RenderQueue
+{
+public:
+    enum Pass : uint64_t {
+        Opaque = 0
+    };
+
+    // state changes of the last Execute; the avoided ones are those a draw-by-draw Model::Draw would have made
+    struct Stats {
+        size_t draws = 0;
+        size_t programChanges = 0;
+        size_t vaoChanges = 0;
+        size_t materialChanges = 0;
+        size_t textureBinds = 0;
+        size_t programChangesAvoided = 0;
+        size_t vaoChangesAvoided = 0;
+        size_t textureBindsAvoided = 0;
+
+        size_t Avoided() const { return programChangesAvoided + vaoChangesAvoided + textureBindsAvoided; }
+    };
+
+    // starts a frame; depth keys are view space distances up to farPlane
+    void Begin(const glm::mat4 &view, float farPlane)
+    {
+        items.clear();
+        keys.clear();
+        this->view = view;
+        this->farPlane = farPlane;
+    }
+
+    // center is the object space point the draw is depth sorted by (e.g. the middle of its bounds)
+    void Submit(const RenderItem &item, const glm::vec3 &center, Pass pass = Opaque)
+    {
+        float depth = -(view * item.model * glm::vec4(center, 1.0f)).z;
+        uint64_t depthBits = (uint64_t)(std::min(std::max(depth / farPlane, 0.0f), 1.0f) * 16777215.0f);
+        uint64_t key = (uint64_t)pass << 60
+                     | (uint64_t)(programIndex(item.shader) & 0xFF) << 52
+                     | (uint64_t)((item.material ? item.material->id : 0) & 0xFFFF) << 36
+                     | (uint64_t)(item.VAO & 0xFFF) << 24
+                     | depthBits;
+        keys.push_back(SortEntry{key, (uint32_t)items.size()});
+        items.push_back(item);
+    }
+
+    // sorts the submitted draws and issues them
+    void Execute()
+    {
+        scratch.resize(keys.size());
+        RadixSort(keys.data(), scratch.data(), keys.size());
+
+        stats = Stats();
+        Shader *shader = nullptr;
+        Program *program = nullptr;
+        unsigned int VAO = 0;
+        const RenderMaterial *material = nullptr;
+        // textures bound per unit by this Execute; anything bound before is unknown
+        std::fill(boundTextures, boundTextures + MaxTextureUnits, ~0u);
+
+        for (const SortEntry &entry : keys)
+        {
+            const RenderItem &item = items[entry.item];
+            if (item.shader != shader)
+            {
+                shader = item.shader;
+                program = &programs[programIndex(shader)];
+                shader->use();
+                stats.programChanges++;
+            }
+            else
+                stats.programChangesAvoided++;
+
+            if (item.material != material)
+            {
+                material = item.material;
+                stats.materialChanges++;
+                if (material)
+                    bindMaterial(*shader, *material);
+            }
+            else if (material)
+                stats.textureBindsAvoided += material->textures.size();
+
+            shader->set(program->vertex->packedVertex, item.layout && item.layout->packed);
+            if (item.layout)
+                program->vertex->SetQuantization(*shader, *item.layout);
+            shader->set(program->model, item.model);
+
+            if (item.VAO != VAO)
+            {
+                VAO = item.VAO;
+                GLState::Shared().BindVertexArray(VAO);
+                stats.vaoChanges++;
+            }
+            else
+                stats.vaoChangesAvoided++;
+
+            glDrawElementsBaseVertex(GL_TRIANGLES, item.indexCount, item.indexType, (void*)item.indexOffset, item.baseVertex);
+            stats.draws++;
+        }
+        if (shader)
+            shader->set(program->vertex->packedVertex, false);
+    }
+
+    const Stats &LastFrame() const { return stats; }
+
+    struct SortEntry {
+        uint64_t key;
+        uint32_t item;
+    };
+
+    // LSD radix sort by key, one byte per pass; stable, and passes in which all keys share the byte are skipped
+    static void RadixSort(SortEntry *entries, SortEntry *scratch, size_t count)
+    {
+        SortEntry *from = entries, *to = scratch;
+        for (int shift = 0; shift < 64; shift += 8)
+        {
+            size_t offsets[256] = {0};
+            for (size_t i = 0; i < count; i++)
+                offsets[(from[i].key >> shift) & 0xFF]++;
+            if (count == 0 || offsets[(from[0].key >> shift) & 0xFF] == count)
+                continue;
+            size_t sum = 0;
+            for (size_t &offset : offsets)
+            {
+                size_t n = offset;
+                offset = sum;
+                sum += n;
+            }
+            for (size_t i = 0; i < count; i++)
+                to[offsets[(from[i].key >> shift) & 0xFF]++] = from[i];
+            std::swap(from, to);
+        }
+        if (from != entries)
+            std::copy(from, from + count, entries);
+    }
+
+private:
+    static const int MaxTextureUnits = 16;
+
+    // uniforms every draw sets, resolved once per program
+    struct Program {
+        Shader *shader;
+        Uniform<glm::mat4> model;
+        const VertexUniforms *vertex;
+    };
+
+    std::vector<RenderItem> items;
+    std::vector<SortEntry> keys, scratch;
+    std::vector<Program> programs;
+    glm::mat4 view = glm::mat4(1.0f);
+    float farPlane = 100.0f;
+    unsigned int boundTextures[MaxTextureUnits];
+    Stats stats;
+
+    size_t programIndex(Shader *shader)
+    {
+        for (size_t i = 0; i < programs.size(); i++)
+            if (programs[i].shader == shader)
+                return i;
+        Program program;
+        program.shader = shader;
+        program.model = shader->uniform<glm::mat4>("model");
+        program.vertex = &VertexUniforms::Of(*shader);
+        programs.push_back(program);
+        return programs.size() - 1;
+    }
+
+    void bindMaterial(Shader &shader, const RenderMaterial &material)
+    {
+        material.SetSamplers(shader);
+        for (size_t i = 0; i < material.textures.size() && i < (size_t)MaxTextureUnits; i++)
+        {
+            if (boundTextures[i] == material.textures[i])
+            {
+                stats.textureBindsAvoided++;
+                continue;
+            }
+            GLState::Shared().BindTexture((unsigned int)i, GL_TEXTURE_2D, material.textures[i]);
+            boundTextures[i] = material.textures[i];
+            stats.textureBinds++;
+        }
+    }
+};
+#endif
@@ -0,0 +1,197 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/bvh.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/model.h>
+#include <learnopengl/occlusion.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/shader.h>
+
+#include <vector>
+
+// a model placed in the world
+struct SceneObject {
+    Model *model;
+    glm::mat4 transform;
+};
+
+// every transform one model is placed with, and the objects placing it
+struct SceneInstances {
+    Model *model;
+    std::vector<glm::mat4> transforms;
+    std::vector<size_t> objects;
+};
+
+// the models of the scene with their transforms. Built once with Add; every frame the objects are submitted to
+// a RenderQueue, which decides the draw order, and models placed more than once can be drawn instanced instead.
+// After Cull only the meshes of each object that may be in view are submitted or drawn. Index() answers
+// spatial queries (frustum, ray casts, sphere overlaps, line of sight) on the objects' triangles.
+class Scene
+{
+public:
+    std::vector<SceneObject> objects;
+    // the objects grouped by model, in the order the models were first added
+    std::vector<SceneInstances> instances;
+
+    // meshes (one per placed mesh of a model) tested by the last Cull, outside the frustum, and hidden by occluders
+    struct CullStats {
+        size_t tested = 0;
+        size_t culled = 0;
+        size_t occluded = 0;
+    };
+
+    enum Placement {
+        All,
+        PlacedOnce // only models placed a single time, the others are left to DrawInstanced
+    };
+
+    // the model has to outlive the scene; it may still be loading (see ModelLoader)
+    size_t Add(Model &model, const glm::mat4 &transform)
+    {
+        objects.push_back(SceneObject{&model, transform});
+        size_t group = 0;
+        while (group < instances.size() && instances[group].model != &model)
+            group++;
+        if (group == instances.size())
+            instances.push_back(SceneInstances{&model, std::vector<glm::mat4>(), std::vector<size_t>()});
+        instances[group].transforms.push_back(transform);
+        instances[group].objects.push_back(objects.size() - 1);
+        return objects.size() - 1;
+    }
+
+    // picks up models that finished loading and objects that moved since the last call: their bounds go to
+    // the culler and their triangles into the BVH. Cull calls it first.
+    void Update()
+    {
+        size_t meshes = 0;
+        for (const SceneObject &object : objects)
+            meshes += object.model->meshes.size();
+        if (meshes != culler.Size() || moved)
+        {
+            culler.Clear();
+            firstMesh.clear();
+            for (const SceneObject &object : objects)
+            {
+                firstMesh.push_back(culler.Size());
+                for (const Mesh &mesh : object.model->meshes)
+                    culler.Add(mesh.boundsMin, mesh.boundsMax, mesh.boundsRadius, object.transform);
+            }
+            moved = false;
+        }
+        for (size_t i = 0; i < objects.size(); i++)
+        {
+            if (objects[i].model->meshes.empty() || bvh.Contains(i))
+                continue;
+            std::vector<std::shared_ptr<const TriangleBVH>> triangles;
+            for (const Mesh &mesh : objects[i].model->meshes)
+                triangles.push_back(mesh.triangles);
+            bvh.Insert(i, triangles, objects[i].transform);
+        }
+    }
+
+    // places object at transform; the BVH refits at once, the culler takes the new bounds on the next Update
+    void Move(size_t object, const glm::mat4 &transform)
+    {
+        objects[object].transform = transform;
+        for (SceneInstances &group : instances)
+            for (size_t i = 0; i < group.objects.size(); i++)
+                if (group.objects[i] == object)
+                    group.transforms[i] = transform;
+        moved = true;
+        bvh.Move(object, transform);
+    }
+
+    // tests the world space bounds of every placed mesh against frustum, and those inside it against the
+    // occluders of the last OcclusionCuller::Render if occlusion is set; returns the number culled by either
+    size_t Cull(const Frustum &frustum, OcclusionCuller *occlusion = nullptr)
+    {
+        Update();
+        cullStats.tested = culler.Size();
+        cullStats.culled = culler.Cull(frustum, visible);
+        cullStats.occluded = occlusion ? occlusion->Test(culler, visible) : 0;
+        return cullStats.culled + cullStats.occluded;
+    }
+
+    // object ids are indices into objects; objects enter once their model has loaded (see Update).
+    // Queries may run on any thread, also while the GL thread updates the scene.
+    const SceneBVH &Index() const { return bvh; }
+
+    // whether the last Cull kept mesh of object; everything is visible before the first Cull
+    bool Visible(size_t object, size_t mesh) const
+    {
+        if (object >= firstMesh.size() || firstMesh[object] + mesh >= visible.size())
+            return true;
+        return visible[firstMesh[object] + mesh] != 0;
+    }
+
+    const CullStats &LastCull() const { return cullStats; }
+
+    void Submit(RenderQueue &queue, Shader &shader, Placement placement = All) const
+    {
+        for (const SceneInstances &group : instances)
+            if (placement == All || group.objects.size() == 1)
+                for (size_t object : group.objects)
+                    for (size_t i = 0; i < group.model->meshes.size(); i++)
+                        if (Visible(object, i))
+                            group.model->meshes[i].Submit(queue, shader, objects[object].transform);
+    }
+
+    // queues the depth pre-pass of what Submit queues (see Mesh::SubmitDepth)
+    template<typename Cutout>
+    void SubmitDepth(RenderQueue &queue, Shader &shader, Shader &alphaTested, const Cutout &cutout, Placement placement = All) const
+    {
+        for (const SceneInstances &group : instances)
+            if (placement == All || group.objects.size() == 1)
+                for (size_t object : group.objects)
+                    for (size_t i = 0; i < group.model->meshes.size(); i++)
+                        if (Visible(object, i))
+                            group.model->meshes[i].SubmitDepth(queue, shader, alphaTested, objects[object].transform, cutout);
+    }
+
+    // draws every model placed more than once with one instanced draw per mesh; shader is built with INSTANCED.
+    // Culling works per placement here: a copy is drawn whole if any of its meshes is in view.
+    void DrawInstanced(Shader &shader)
+    {
+        shader.use();
+        for (const SceneInstances &group : instances)
+            if (group.objects.size() >= 2)
+                group.model->DrawInstanced(shader, visibleCopies(group));
+    }
+
+    // the depth pre-pass of DrawInstanced (see Model::DrawDepthInstanced)
+    template<typename Cutout>
+    void DrawDepthInstanced(Shader &shader, Shader &alphaTested, const Cutout &cutout)
+    {
+        for (const SceneInstances &group : instances)
+            if (group.objects.size() >= 2)
+                group.model->DrawDepthInstanced(shader, alphaTested, visibleCopies(group), cutout);
+    }
+
+private:
+    FrustumCuller culler;
+    // per object the index of its first mesh in culler and visible
+    std::vector<size_t> firstMesh;
+    std::vector<unsigned char> visible;
+    std::vector<glm::mat4> visibleTransforms;
+    CullStats cullStats;
+    bool moved = false;
+    SceneBVH bvh;
+
+    // the transforms of the copies of group with a mesh in view
+    const std::vector<glm::mat4> &visibleCopies(const SceneInstances &group)
+    {
+        visibleTransforms.clear();
+        for (size_t i = 0; i < group.objects.size(); i++)
+            for (size_t mesh = 0; mesh < group.model->meshes.size(); mesh++)
+                if (Visible(group.objects[i], mesh))
+                {
+                    visibleTransforms.push_back(group.transforms[i]);
+                    break;
+                }
+        return visibleTransforms;
+    }
+};
+#endif
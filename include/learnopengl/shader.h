@@ -5,17 +5,24 @@
 #include <glm/glm.hpp>
 
 #include <string>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <common.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/shader_source.h>
+#include <learnopengl/uniform_buffer.h>
+#include <learnopengl/uniform_table.h>
 class Shader
 {
 public:
     unsigned int ID;
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    // defines are put at the top of every stage, to build variants of one source (see ShaderSource::Define)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+           const std::vector<std::string> &defines = std::vector<std::string>())
     {
         std::string vertexPathString(vertexPath);
         std::string fragmentPathString(fragmentPath);
@@ -46,8 +53,8 @@ public:
             vShaderFile.close();
             fShaderFile.close();
             // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
+            vertexCode = ShaderSource::Define(ShaderSource::ExpandIncludes(vShaderStream.str(), vertexPath), defines);
+            fragmentCode = ShaderSource::Define(ShaderSource::ExpandIncludes(fShaderStream.str(), fragmentPath), defines);			
             // if geometry shader path is present, also load a geometry shader
             if(geometryPath != nullptr)
             {
@@ -57,7 +64,7 @@ public:
                 std::stringstream gShaderStream;
                 gShaderStream << gShaderFile.rdbuf();
                 gShaderFile.close();
-                geometryCode = gShaderStream.str();
+                geometryCode = ShaderSource::Define(ShaderSource::ExpandIncludes(gShaderStream.str(), geometryPath), defines);
             }
         }
         catch (std::ifstream::failure& e)
@@ -96,6 +103,8 @@ public:
             glAttachShader(ID, geometry);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        uniforms.Reflect(ID);
+        UniformBlock::Bind(ID);
         // delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(vertex);
         glDeleteShader(fragment);
@@ -103,72 +112,99 @@ public:
             glDeleteShader(geometry);
 
     }
-    // activate the shader
+    // activate the shader (dropped if it already is, see GLState)
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        GLState::Shared().UseProgram(ID);
     }
     // utility uniform functions
+    // uniforms are looked up in the table reflected at link time (see UniformTable): no location queries,
+    // and values the program already holds are not sent again
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
-    {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+    template <typename T>
+    Uniform<T> uniform(const char *name) const
+    {
+        return uniforms.Resolve<T>(name);
+    }
+    template <typename T>
+    void set(Uniform<T> uniform, const typename Uniform<T>::Value &value) const
+    {
+        uniforms.Set(uniform.slot, value);
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
-    { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+    void setBool(const char *name, bool value) const
+    {
+        uniforms.Set(uniforms.Find(name), value);
     }
+    void setBool(const std::string &name, bool value) const { setBool(name.c_str(), value); }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
-    { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+    void setInt(const char *name, int value) const
+    {
+        uniforms.Set(uniforms.Find(name), value);
     }
+    void setInt(const std::string &name, int value) const { setInt(name.c_str(), value); }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
-    { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    void setFloat(const char *name, float value) const
+    {
+        uniforms.Set(uniforms.Find(name), value);
     }
-    void setVec2(const std::string &name, float x, float y) const
-    { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+    void setFloat(const std::string &name, float value) const { setFloat(name.c_str(), value); }
+    // ------------------------------------------------------------------------
+    void setVec2(const char *name, const glm::vec2 &value) const
+    {
+        uniforms.Set(uniforms.Find(name), value);
     }
+    void setVec2(const char *name, float x, float y) const
+    {
+        setVec2(name, glm::vec2(x, y));
+    }
+    void setVec2(const std::string &name, const glm::vec2 &value) const { setVec2(name.c_str(), value); }
+    void setVec2(const std::string &name, float x, float y) const { setVec2(name.c_str(), glm::vec2(x, y)); }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
-    { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    void setVec3(const char *name, const glm::vec3 &value) const
+    {
+        uniforms.Set(uniforms.Find(name), value);
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
-    { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+    void setVec3(const char *name, float x, float y, float z) const
+    {
+        setVec3(name, glm::vec3(x, y, z));
     }
+    void setVec3(const std::string &name, const glm::vec3 &value) const { setVec3(name.c_str(), value); }
+    void setVec3(const std::string &name, float x, float y, float z) const { setVec3(name.c_str(), glm::vec3(x, y, z)); }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
-    { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    void setVec4(const char *name, const glm::vec4 &value) const
+    {
+        uniforms.Set(uniforms.Find(name), value);
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) 
-    { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+    void setVec4(const char *name, float x, float y, float z, float w) const
+    {
+        setVec4(name, glm::vec4(x, y, z, w));
     }
+    void setVec4(const std::string &name, const glm::vec4 &value) const { setVec4(name.c_str(), value); }
+    void setVec4(const std::string &name, float x, float y, float z, float w) const { setVec4(name.c_str(), glm::vec4(x, y, z, w)); }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(const char *name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        uniforms.Set(uniforms.Find(name), mat);
     }
+    void setMat2(const std::string &name, const glm::mat2 &mat) const { setMat2(name.c_str(), mat); }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(const char *name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        uniforms.Set(uniforms.Find(name), mat);
     }
+    void setMat3(const std::string &name, const glm::mat3 &mat) const { setMat3(name.c_str(), mat); }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(const char *name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        uniforms.Set(uniforms.Find(name), mat);
     }
+    void setMat4(const std::string &name, const glm::mat4 &mat) const { setMat4(name.c_str(), mat); }
 
 private:
+    mutable UniformTable uniforms;
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -8,6 +8,8 @@
 #include <sstream>
 #include <iostream>
 
+#include <learnopengl/gl_state.h>
+
 
 class Shader
 {
@@ -73,11 +75,11 @@ public:
         glDeleteShader(vertex);
         glDeleteShader(fragment);
     }
-    // activate the shader
+    // activate the shader (dropped if it already is, see GLState)
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        GLState::Shared().UseProgram(ID);
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
@@ -0,0 +1,93 @@
+#ifndef SHADER_SOURCE_H
+#define SHADER_SOURCE_H
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// GLSL has no #include, so the shader loaders expand it themselves: a line '#include "file"' is replaced by
+// the contents of file, relative to the including file. Every file is included at most once per shader, and a
+// #line directive after each include keeps compiler messages pointing at the right line of the includer.
+// Variants of one source are built with Define, which puts #defines right after the #version line.
+class ShaderSource
+{
+public:
+    static std::string ExpandIncludes(const std::string &source, const std::string &path)
+    {
+        std::set<std::string> included;
+        included.insert(path);
+        return expand(source, path, included);
+    }
+
+    // source with '#define define' for each of defines ("INSTANCED", "MAX_LIGHTS 16") after its #version line
+    static std::string Define(const std::string &source, const std::vector<std::string> &defines)
+    {
+        if (defines.empty())
+            return source;
+        size_t insert = 0, version = source.find("#version");
+        if (version != std::string::npos)
+        {
+            size_t end = source.find('\n', version);
+            insert = end == std::string::npos ? source.size() : end + 1;
+        }
+        std::ostringstream result;
+        result << source.substr(0, insert);
+        if (insert > 0 && source[insert - 1] != '\n')
+            result << '\n';
+        for (const std::string &define : defines)
+            result << "#define " << define << '\n';
+        // the line after the #version line keeps its number
+        int line = 1 + (int)std::count(source.begin(), source.begin() + insert, '\n');
+        result << "#line " << line << '\n' << source.substr(insert);
+        return result.str();
+    }
+
+private:
+    static std::string expand(const std::string &source, const std::string &path, std::set<std::string> &included)
+    {
+        if (source.find("#include") == std::string::npos)
+            return source;
+
+        std::string directory = path.substr(0, path.find_last_of('/') + 1);
+        std::istringstream lines(source);
+        std::ostringstream result;
+        std::string line;
+        int number = 0;
+        while (std::getline(lines, line))
+        {
+            number++;
+            size_t directive = line.find_first_not_of(" \t");
+            if (directive == std::string::npos || line.compare(directive, 8, "#include") != 0)
+            {
+                result << line << '\n';
+                continue;
+            }
+            size_t open = line.find('"', directive), close = line.find('"', open + 1);
+            if (open == std::string::npos || close == std::string::npos)
+            {
+                std::cout << "ERROR::SHADER::INCLUDE_SYNTAX: " << path << ":" << number << std::endl;
+                continue;
+            }
+            std::string includePath = directory + line.substr(open + 1, close - open - 1);
+            if (included.insert(includePath).second)
+            {
+                std::ifstream file(includePath);
+                if (!file)
+                {
+                    std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND: " << includePath << std::endl;
+                    continue;
+                }
+                std::stringstream contents;
+                contents << file.rdbuf();
+                result << expand(contents.str(), includePath, included) << '\n';
+            }
+            result << "#line " << number + 1 << '\n';
+        }
+        return result.str();
+    }
+};
+#endif
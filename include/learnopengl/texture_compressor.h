@@ -0,0 +1,559 @@
+#ifndef TEXTURE_COMPRESSOR_H
+#define TEXTURE_COMPRESSOR_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/image_kernels.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// S3TC is not part of core OpenGL; the enums come from EXT_texture_compression_s3tc and may only be used
+// when the driver advertises the extension (see TexturePipeline). RGTC (BC4/BC5) is core since 3.0.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// what a texture is used for; decides the block format it is compressed to
+enum class TextureRole {
+    Color,  // BC1, or BC3 when the image has alpha (needs S3TC)
+    Normal, // BC5, two channels. The blue channel reads as 0, shaders have to rebuild z from x and y
+    Mask    // BC4, the first channel only; samples as (r, 0, 0, 1) just like a GL_RED texture
+};
+
+enum class BlockFormat : uint32_t {
+    None = 0,
+    BC1,
+    BC3,
+    BC4,
+    BC5
+};
+
+// a block compressed texture with its full mip chain, as uploaded by glCompressedTexImage2D
+struct CompressedTexture {
+    struct Level {
+        int width, height;
+        size_t offset, size;
+    };
+
+    BlockFormat format = BlockFormat::None;
+    std::vector<Level> levels;
+    std::vector<unsigned char> data;
+
+    bool Valid() const { return format != BlockFormat::None && !levels.empty(); }
+    size_t Bytes() const { return data.size(); }
+    int Width() const { return levels.empty() ? 0 : levels[0].width; }
+    int Height() const { return levels.empty() ? 0 : levels[0].height; }
+    const unsigned char *LevelData(size_t level) const { return data.data() + levels[level].offset; }
+
+    GLenum InternalFormat() const
+    {
+        switch (format)
+        {
+        case BlockFormat::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case BlockFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case BlockFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+        case BlockFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+        default: return GL_NONE;
+        }
+    }
+
+    static size_t BlockBytes(BlockFormat format)
+    {
+        return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+    }
+    static size_t LevelBytes(BlockFormat format, int width, int height)
+    {
+        return (size_t)((width + 3) / 4) * ((height + 3) / 4) * BlockBytes(format);
+    }
+    static bool IsS3TC(BlockFormat format) { return format == BlockFormat::BC1 || format == BlockFormat::BC3; }
+};
+
+// CPU encoder for BC1/BC3/BC4/BC5. Endpoints are fitted along the principal axis of each 4x4 block
+// (BC1/BC3 colors) or to the block's range (BC4/BC5 channels), which is fast and good enough for
+// cooking textures once at import time. Every function is thread safe.
+class TextureCompressor
+{
+public:
+    // picks the block format for an image of the given role, BlockFormat::None if it should stay uncompressed
+    static BlockFormat ChooseFormat(TextureRole role, const unsigned char *pixels, int width, int height, int channels, bool s3tc)
+    {
+        if (role == TextureRole::Normal)
+            return channels >= 2 ? BlockFormat::BC5 : BlockFormat::BC4;
+        if (role == TextureRole::Mask || channels == 1)
+            return BlockFormat::BC4;
+        if (channels == 2 || !s3tc)
+            return BlockFormat::None;
+        if (channels == 4)
+        {
+            size_t count = (size_t)width * height;
+            for (size_t i = 0; i < count; i++)
+                if (pixels[i * 4 + 3] != 255)
+                    return BlockFormat::BC3;
+        }
+        return BlockFormat::BC1;
+    }
+
+    // builds the mip chain down to 1x1 and compresses every level
+    static CompressedTexture Compress(const unsigned char *pixels, int width, int height, int channels, BlockFormat format, TextureRole role)
+    {
+        CompressedTexture texture;
+        if (format == BlockFormat::None || !pixels || width <= 0 || height <= 0)
+            return texture;
+        texture.format = format;
+
+        // cooking runs once per image, so it can afford the sharper Kaiser filter
+        MipSettings settings;
+        settings.filter = MipFilter::Kaiser;
+        settings.srgb = role == TextureRole::Color;
+        settings.premultiplyAlpha = format == BlockFormat::BC3;
+        settings.normalMap = role == TextureRole::Normal;
+        std::vector<ImageLevel> chain = ImageKernels::BuildMipChain(pixels, width, height, channels, settings);
+
+        size_t total = 0;
+        for (const ImageLevel &level : chain)
+            total += CompressedTexture::LevelBytes(format, level.width, level.height);
+        texture.data.resize(total);
+
+        size_t offset = 0;
+        for (const ImageLevel &level : chain)
+        {
+            CompressedTexture::Level info;
+            info.width = level.width;
+            info.height = level.height;
+            info.offset = offset;
+            info.size = CompressedTexture::LevelBytes(format, level.width, level.height);
+            compressLevel(level.pixels.data(), level.width, level.height, format, texture.data.data() + offset);
+            texture.levels.push_back(info);
+            offset += info.size;
+        }
+        return texture;
+    }
+
+    // compresses one 4x4 block of RGBA texels into dst
+    static void CompressBlock(const unsigned char block[16][4], BlockFormat format, unsigned char *dst)
+    {
+        switch (format)
+        {
+        case BlockFormat::BC1:
+            encodeColorBlock(block, dst);
+            break;
+        case BlockFormat::BC3:
+            encodeChannelBlock(block, 3, dst);
+            encodeColorBlock(block, dst + 8);
+            break;
+        case BlockFormat::BC4:
+            encodeChannelBlock(block, 0, dst);
+            break;
+        case BlockFormat::BC5:
+            encodeChannelBlock(block, 0, dst);
+            encodeChannelBlock(block, 1, dst + 8);
+            break;
+        default:
+            break;
+        }
+    }
+
+private:
+    static void compressLevel(const unsigned char *rgba, int width, int height, BlockFormat format, unsigned char *dst)
+    {
+        size_t blockBytes = CompressedTexture::BlockBytes(format);
+        unsigned char block[16][4];
+        for (int by = 0; by < height; by += 4)
+        {
+            for (int bx = 0; bx < width; bx += 4)
+            {
+                // blocks hanging over the edge repeat the last row/column
+                for (int y = 0; y < 4; y++)
+                    for (int x = 0; x < 4; x++)
+                    {
+                        const unsigned char *texel = rgba + ((size_t)std::min(by + y, height - 1) * width + std::min(bx + x, width - 1)) * 4;
+                        std::memcpy(block[y * 4 + x], texel, 4);
+                    }
+                CompressBlock(block, format, dst);
+                dst += blockBytes;
+            }
+        }
+    }
+
+    static uint16_t packRGB565(const float color[3])
+    {
+        int r = (int)std::min(31.0f, std::max(0.0f, color[0] * 31.0f / 255.0f + 0.5f));
+        int g = (int)std::min(63.0f, std::max(0.0f, color[1] * 63.0f / 255.0f + 0.5f));
+        int b = (int)std::min(31.0f, std::max(0.0f, color[2] * 31.0f / 255.0f + 0.5f));
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    static void unpackRGB565(uint16_t packed, int color[3])
+    {
+        int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    // BC1 color block, always in 4 color mode so it can also be used inside BC3
+    static void encodeColorBlock(const unsigned char block[16][4], unsigned char *dst)
+    {
+        float mean[3] = {0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < 16; i++)
+            for (int k = 0; k < 3; k++)
+                mean[k] += block[i][k] / 16.0f;
+
+        // principal axis of the block's colors by power iteration on the covariance matrix
+        float cov[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < 16; i++)
+        {
+            float r = block[i][0] - mean[0], g = block[i][1] - mean[1], b = block[i][2] - mean[2];
+            cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+            cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+        }
+        float axis[3] = {1.0f, 1.0f, 1.0f};
+        for (int iteration = 0; iteration < 4; iteration++)
+        {
+            float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+            float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+            float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+            float length = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+            if (length < 1e-6f)
+                break;
+            axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+        }
+
+        float minT = 1e30f, maxT = -1e30f;
+        for (int i = 0; i < 16; i++)
+        {
+            float t = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2];
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+        float axisLength2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        if (axisLength2 > 0.0f)
+        {
+            minT /= axisLength2;
+            maxT /= axisLength2;
+        }
+        // pull the endpoints in a little; the extremes are rarely the best least squares fit
+        float inset = (maxT - minT) / 16.0f;
+        minT += inset;
+        maxT -= inset;
+        float end0[3], end1[3];
+        for (int k = 0; k < 3; k++)
+        {
+            end0[k] = mean[k] + axis[k] * maxT;
+            end1[k] = mean[k] + axis[k] * minT;
+        }
+        uint16_t color0 = packRGB565(end0), color1 = packRGB565(end1);
+        uint32_t indices = 0;
+        int error = chooseColorIndices(block, color0, color1, indices);
+
+        // one least squares pass: solve for the endpoints that best fit the chosen indices and keep them if they are better
+        if (error > 0 && color0 != color1)
+        {
+            static const float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+            float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax[3] = {0.0f, 0.0f, 0.0f}, bx[3] = {0.0f, 0.0f, 0.0f};
+            for (int i = 0; i < 16; i++)
+            {
+                float a = weights[(indices >> (i * 2)) & 3], b = 1.0f - a;
+                aa += a * a;
+                ab += a * b;
+                bb += b * b;
+                for (int k = 0; k < 3; k++)
+                {
+                    ax[k] += a * block[i][k];
+                    bx[k] += b * block[i][k];
+                }
+            }
+            float determinant = aa * bb - ab * ab;
+            if (std::fabs(determinant) > 1e-6f)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    end0[k] = (ax[k] * bb - bx[k] * ab) / determinant;
+                    end1[k] = (bx[k] * aa - ax[k] * ab) / determinant;
+                }
+                uint16_t refined0 = packRGB565(end0), refined1 = packRGB565(end1);
+                uint32_t refinedIndices = 0;
+                int refinedError = chooseColorIndices(block, refined0, refined1, refinedIndices);
+                if (refinedError < error)
+                {
+                    color0 = refined0;
+                    color1 = refined1;
+                    indices = refinedIndices;
+                }
+            }
+        }
+        dst[0] = (unsigned char)(color0 & 0xFF);
+        dst[1] = (unsigned char)(color0 >> 8);
+        dst[2] = (unsigned char)(color1 & 0xFF);
+        dst[3] = (unsigned char)(color1 >> 8);
+        for (int b = 0; b < 4; b++)
+            dst[4 + b] = (unsigned char)(indices >> (b * 8));
+    }
+
+    // orders the endpoints for 4 color mode and picks the closest palette entry for every texel; returns the squared error
+    static int chooseColorIndices(const unsigned char block[16][4], uint16_t &color0, uint16_t &color1, uint32_t &indices)
+    {
+        if (color0 < color1)
+            std::swap(color0, color1);
+        int palette[4][3];
+        unpackRGB565(color0, palette[0]);
+        unpackRGB565(color1, palette[1]);
+        for (int k = 0; k < 3; k++)
+        {
+            palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+            palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+        }
+        // equal endpoints would switch BC1 to 3 color mode, where index 3 means transparent black
+        int paletteSize = color0 == color1 ? 1 : 4;
+        int total = 0;
+        indices = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0, bestError = 1 << 30;
+            for (int p = 0; p < paletteSize; p++)
+            {
+                int dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+                int error = dr * dr + dg * dg + db * db;
+                if (error < bestError)
+                {
+                    bestError = error;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (i * 2);
+            total += bestError;
+        }
+        return total;
+    }
+
+    // BC4 block (also the alpha half of BC3 and each half of BC5) in 8 value mode over the channel's range
+    static void encodeChannelBlock(const unsigned char block[16][4], int channel, unsigned char *dst)
+    {
+        int lo = 255, hi = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            lo = std::min(lo, (int)block[i][channel]);
+            hi = std::max(hi, (int)block[i][channel]);
+        }
+        uint64_t indices = 0;
+        if (hi != lo)
+        {
+            int range = hi - lo;
+            for (int i = 0; i < 16; i++)
+            {
+                // position 0..7 between lo and hi, mapped to the index order red0 (hi), red1 (lo), then interpolants
+                int position = ((block[i][channel] - lo) * 7 + range / 2) / range;
+                int index = position == 7 ? 0 : position == 0 ? 1 : 8 - position;
+                indices |= (uint64_t)index << (i * 3);
+            }
+        }
+        dst[0] = (unsigned char)hi;
+        dst[1] = (unsigned char)lo;
+        for (int b = 0; b < 6; b++)
+            dst[2 + b] = (unsigned char)(indices >> (b * 8));
+    }
+};
+
+// Cooked textures are stored next to the source image as "<source>.bcn.dds": a standard DDS file
+// (DXT1, DXT5, ATI1 or ATI2 FourCC with the whole mip chain), so any DDS viewer can inspect them.
+// The reserved header words identify the source the file was cooked from, which makes it stale
+// as soon as the image changes.
+#define TEXTURE_CACHE_EXTENSION ".bcn.dds"
+#define TEXTURE_CACHE_TAG 0x58544752u // "RGTX"
+#define TEXTURE_CACHE_VERSION 3u
+
+struct DDSPixelFormat {
+    uint32_t size;
+    uint32_t flags;
+    uint32_t fourCC;
+    uint32_t rgbBitCount;
+    uint32_t rBitMask, gBitMask, bBitMask, aBitMask;
+};
+
+struct DDSHeader {
+    uint32_t size;
+    uint32_t flags;
+    uint32_t height;
+    uint32_t width;
+    uint32_t pitchOrLinearSize;
+    uint32_t depth;
+    uint32_t mipMapCount;
+    // [0] tag, [1] version, [2] role, [3..4] source size, [5..6] source mtime
+    uint32_t reserved1[11];
+    DDSPixelFormat pixelFormat;
+    uint32_t caps, caps2, caps3, caps4;
+    uint32_t reserved2;
+};
+
+class TextureCache
+{
+public:
+    static std::string PathFor(const std::string &sourcePath)
+    {
+        return sourcePath + TEXTURE_CACHE_EXTENSION;
+    }
+
+    // whether sourcePath has an up to date cooked texture for role; only reads the DDS header
+    static bool Fresh(const std::string &sourcePath, TextureRole role)
+    {
+        DDSHeader header;
+        FILE *file = openFresh(sourcePath, role, header);
+        if (!file)
+            return false;
+        std::fclose(file);
+        return true;
+    }
+
+    // reads the cooked texture for sourcePath; returns false if it is missing, stale or was cooked for another role
+    static bool Read(const std::string &sourcePath, TextureRole role, CompressedTexture &texture)
+    {
+        DDSHeader header;
+        FILE *file = openFresh(sourcePath, role, header);
+        if (!file)
+            return false;
+        BlockFormat format = formatFromFourCC(header.pixelFormat.fourCC);
+
+        texture = CompressedTexture();
+        texture.format = format;
+        size_t offset = 0;
+        int w = (int)header.width, h = (int)header.height;
+        for (uint32_t i = 0; i < header.mipMapCount; i++)
+        {
+            CompressedTexture::Level level;
+            level.width = w;
+            level.height = h;
+            level.offset = offset;
+            level.size = CompressedTexture::LevelBytes(format, w, h);
+            texture.levels.push_back(level);
+            offset += level.size;
+            w = std::max(1, w / 2);
+            h = std::max(1, h / 2);
+        }
+        texture.data.resize(offset);
+        bool ok = std::fread(texture.data.data(), 1, offset, file) == offset;
+        std::fclose(file);
+        if (!ok)
+            texture = CompressedTexture();
+        return ok;
+    }
+
+    // writes a temporary file and renames it, so a crashed write never leaves a half valid cache
+    static bool Write(const std::string &sourcePath, TextureRole role, const CompressedTexture &texture)
+    {
+        struct stat sourceStat;
+        if (!texture.Valid() || stat(sourcePath.c_str(), &sourceStat) != 0)
+            return false;
+
+        DDSHeader header;
+        std::memset(&header, 0, sizeof(header));
+        header.size = sizeof(DDSHeader);
+        header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; // caps, height, width, pixel format, mip count, linear size
+        header.height = (uint32_t)texture.Height();
+        header.width = (uint32_t)texture.Width();
+        header.pitchOrLinearSize = (uint32_t)texture.levels[0].size;
+        header.mipMapCount = (uint32_t)texture.levels.size();
+        header.reserved1[0] = TEXTURE_CACHE_TAG;
+        header.reserved1[1] = TEXTURE_CACHE_VERSION;
+        header.reserved1[2] = (uint32_t)role;
+        header.reserved1[3] = (uint32_t)((uint64_t)sourceStat.st_size & 0xFFFFFFFFu);
+        header.reserved1[4] = (uint32_t)((uint64_t)sourceStat.st_size >> 32);
+        header.reserved1[5] = (uint32_t)((uint64_t)sourceStat.st_mtime & 0xFFFFFFFFu);
+        header.reserved1[6] = (uint32_t)((uint64_t)sourceStat.st_mtime >> 32);
+        header.pixelFormat.size = sizeof(DDSPixelFormat);
+        header.pixelFormat.flags = 0x4; // FourCC
+        header.pixelFormat.fourCC = fourCC(texture.format);
+        header.caps = 0x1000 | 0x8 | 0x400000; // texture, complex, mipmap
+
+        std::string cachePath = PathFor(sourcePath);
+        std::string tempPath = cachePath + ".tmp";
+        FILE *file = std::fopen(tempPath.c_str(), "wb");
+        if (!file)
+        {
+            std::cout << "ERROR::TEXTURE_CACHE:: could not write " << cachePath << std::endl;
+            return false;
+        }
+        bool ok = std::fwrite("DDS ", 4, 1, file) == 1
+                && std::fwrite(&header, sizeof(header), 1, file) == 1
+                && std::fwrite(texture.data.data(), 1, texture.data.size(), file) == texture.data.size();
+        ok = std::fclose(file) == 0 && ok;
+        if (!ok || std::rename(tempPath.c_str(), cachePath.c_str()) != 0)
+        {
+            std::remove(tempPath.c_str());
+            std::cout << "ERROR::TEXTURE_CACHE:: could not write " << cachePath << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static uint64_t join(uint32_t low, uint32_t high) { return (uint64_t)low | ((uint64_t)high << 32); }
+
+    // opens the cache file of sourcePath positioned after a valid, up to date header; nullptr otherwise
+    static FILE *openFresh(const std::string &sourcePath, TextureRole role, DDSHeader &header)
+    {
+        struct stat sourceStat;
+        if (stat(sourcePath.c_str(), &sourceStat) != 0)
+            return nullptr;
+        FILE *file = std::fopen(PathFor(sourcePath).c_str(), "rb");
+        if (!file)
+            return nullptr;
+
+        char magic[4];
+        bool ok = std::fread(magic, 4, 1, file) == 1 && std::memcmp(magic, "DDS ", 4) == 0
+                && std::fread(&header, sizeof(header), 1, file) == 1
+                && header.size == sizeof(DDSHeader)
+                && header.reserved1[0] == TEXTURE_CACHE_TAG
+                && header.reserved1[1] == TEXTURE_CACHE_VERSION
+                && header.reserved1[2] == (uint32_t)role
+                && join(header.reserved1[3], header.reserved1[4]) == (uint64_t)sourceStat.st_size
+                && join(header.reserved1[5], header.reserved1[6]) == (uint64_t)sourceStat.st_mtime
+                && header.width > 0 && header.height > 0 && header.mipMapCount > 0
+                && formatFromFourCC(header.pixelFormat.fourCC) != BlockFormat::None;
+        if (!ok)
+        {
+            std::fclose(file);
+            return nullptr;
+        }
+        return file;
+    }
+
+    static uint32_t makeFourCC(const char *code)
+    {
+        return (uint32_t)(unsigned char)code[0] | ((uint32_t)(unsigned char)code[1] << 8)
+                | ((uint32_t)(unsigned char)code[2] << 16) | ((uint32_t)(unsigned char)code[3] << 24);
+    }
+
+    static uint32_t fourCC(BlockFormat format)
+    {
+        switch (format)
+        {
+        case BlockFormat::BC1: return makeFourCC("DXT1");
+        case BlockFormat::BC3: return makeFourCC("DXT5");
+        case BlockFormat::BC4: return makeFourCC("ATI1");
+        case BlockFormat::BC5: return makeFourCC("ATI2");
+        default: return 0;
+        }
+    }
+
+    static BlockFormat formatFromFourCC(uint32_t code)
+    {
+        const BlockFormat formats[] = {BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC4, BlockFormat::BC5};
+        for (BlockFormat format : formats)
+            if (fourCC(format) == code)
+                return format;
+        return BlockFormat::None;
+    }
+};
+#endif
@@ -0,0 +1,478 @@
+#ifndef TEXTURE_PIPELINE_H
+#define TEXTURE_PIPELINE_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/bounded_queue.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/image_kernels.h>
+#include <learnopengl/texture_compressor.h>
+#include <learnopengl/thread_pool.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// image decoded by stb_image, owned until it is uploaded. Decoding does not touch OpenGL,
+// so it can run on any thread.
+struct DecodedImage {
+    unsigned char *data;
+    int width, height, nrComponents;
+
+    DecodedImage() : data(nullptr), width(0), height(0), nrComponents(0) {}
+    explicit DecodedImage(const std::string &filename) : width(0), height(0), nrComponents(0)
+    {
+        data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    }
+    // decodes an image file that was already read into memory
+    DecodedImage(const unsigned char *encoded, size_t size) : width(0), height(0), nrComponents(0)
+    {
+        data = stbi_load_from_memory(encoded, (int)size, &width, &height, &nrComponents, 0);
+    }
+    ~DecodedImage()
+    {
+        if (data)
+            stbi_image_free(data);
+    }
+    DecodedImage(DecodedImage &&other) noexcept : data(other.data), width(other.width), height(other.height), nrComponents(other.nrComponents)
+    {
+        other.data = nullptr;
+    }
+    DecodedImage &operator=(DecodedImage &&other) noexcept
+    {
+        std::swap(data, other.data);
+        width = other.width;
+        height = other.height;
+        nrComponents = other.nrComponents;
+        return *this;
+    }
+    DecodedImage(const DecodedImage &) = delete;
+    DecodedImage &operator=(const DecodedImage &) = delete;
+
+    size_t Bytes() const { return (size_t)width * height * nrComponents; }
+
+    // whether any texel is less than fully opaque; only images with an alpha channel can be
+    bool HasAlpha() const
+    {
+        if (!data || (nrComponents != 2 && nrComponents != 4))
+            return false;
+        size_t count = (size_t)width * height;
+        for (size_t i = 0; i < count; i++)
+            if (data[i * nrComponents + nrComponents - 1] != 255)
+                return true;
+        return false;
+    }
+};
+
+// Texture job pipeline: the GL thread reserves the texture name up front (so callers get the same ids,
+// in the same order, as with synchronous loading), stb_image decodes on the thread pool and the decoded
+// images come back through a bounded lock-free queue. Pump()/Finish() upload them on the GL thread.
+// The texture object is empty until its image has been uploaded.
+// With compression enabled the workers also cook each image into a block compressed mip chain
+// (see TextureCompressor) or read it back from the TextureCache, and only that is uploaded.
+// Uncompressed textures get their mip chain from ImageKernels on the workers as well, so the GL thread
+// only copies finished levels and never calls glGenerateMipmap.
+class TexturePipeline
+{
+public:
+    explicit TexturePipeline(ThreadPool &pool = ThreadPool::Shared(), size_t queueCapacity = 32)
+        : pool(pool), decoded(queueCapacity), compression(true), s3tcChecked(false), s3tcSupported(false), outstanding(0),
+          decodeMicros(0), decodedBytes(0), cookMicros(0), mipMicros(0), uploadSeconds(0.0), uploadedBytes(0), uploadedCount(0),
+          compressedCount(0), cachedCount(0), compressedBytes(0), uncompressedBytes(0)
+    {
+    }
+
+    static TexturePipeline &Shared()
+    {
+        static TexturePipeline pipeline;
+        return pipeline;
+    }
+
+    // block compression of new textures; color textures need EXT_texture_compression_s3tc and stay
+    // uncompressed without it, normal maps and masks use the core RGTC formats.
+    void SetCompression(bool enabled) { compression = enabled; }
+    bool Compression() const { return compression; }
+
+    // GL thread: 2D texture with mipmaps and repeat wrapping. The role picks the compressed format.
+    // If the caller already read the file (see TextureRegistry) the workers decode those bytes instead of reading it again.
+    unsigned int Load2D(const std::string &filename, TextureRole role = TextureRole::Color,
+                        std::shared_ptr<const std::vector<unsigned char>> encoded = nullptr)
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        submit(textureID, GL_TEXTURE_2D, filename, role, encoded);
+        return textureID;
+    }
+
+    // GL thread: cubemap from 6 faces in +X, -X, +Y, -Y, +Z, -Z order
+    unsigned int LoadCubemap(const std::vector<std::string> &faces)
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        GLState::Shared().BindTexture(0, GL_TEXTURE_CUBE_MAP, textureID);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        for (unsigned int i = 0; i < faces.size(); i++)
+            submit(textureID, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, faces[i], TextureRole::Color);
+        return textureID;
+    }
+
+    // GL thread: uploads every image decoded so far without waiting for the rest
+    void Pump()
+    {
+        DecodedTexture *next;
+        bool popped = false;
+        while (decoded.TryPop(next))
+        {
+            popped = true;
+            std::unique_ptr<DecodedTexture> texture(next);
+            upload(*texture);
+            outstanding--;
+        }
+        // wakes the workers waiting for room in the queue; taking the lock orders this after their last TryPush
+        if (popped)
+        {
+            { std::lock_guard<std::mutex> lock(spaceMutex); }
+            space.notify_all();
+        }
+    }
+
+    // GL thread: blocks until every requested texture is uploaded and reports the throughput
+    void Finish()
+    {
+        while (outstanding > 0)
+        {
+            Pump();
+            if (outstanding > 0)
+            {
+                std::unique_lock<std::mutex> lock(signalMutex);
+                signal.wait_for(lock, std::chrono::milliseconds(1));
+            }
+        }
+        Report();
+    }
+
+    bool Idle() const { return outstanding == 0; }
+
+    // GL thread: video memory taken by an uploaded texture (mip chain included), 0 if it is not uploaded yet
+    size_t TextureBytes(unsigned int id) const
+    {
+        std::unordered_map<unsigned int, size_t>::const_iterator it = textureBytes.find(id);
+        return it != textureBytes.end() ? it->second : 0;
+    }
+
+    // GL thread: whether an uploaded 2D texture has texels that are not fully opaque, so a shader testing its
+    // alpha may discard fragments (see DepthPrepass). false until the texture is uploaded, like its texels read opaque
+    bool HasAlpha(unsigned int id) const
+    {
+        return alphaTextures.count(id) != 0;
+    }
+
+    // prints decode and upload throughput for everything uploaded since the last report
+    void Report()
+    {
+        if (uploadedCount == 0)
+            return;
+        double decodeSeconds = decodeMicros.load() / 1e6;
+        double megabytes = decodedBytes.load() / (1024.0 * 1024.0);
+        std::cout << "TEXTURE_PIPELINE:: " << uploadedCount << " images, " << std::fixed << std::setprecision(1)
+                  << megabytes << " MB decoded by " << pool.Size() << " workers in " << decodeSeconds * 1000.0
+                  << " ms of worker time (" << (decodeSeconds > 0.0 ? megabytes / decodeSeconds : 0.0) << " MB/s per worker)"
+                  << ", mipmapped with " << CpuFeatures::Name(ImageKernels::Active()) << " kernels in " << mipMicros.load() / 1000.0 << " ms"
+                  << ", uploaded in " << uploadSeconds * 1000.0 << " ms ("
+                  << (uploadSeconds > 0.0 ? uploadedBytes / (1024.0 * 1024.0) / uploadSeconds : 0.0) << " MB/s)" << std::endl;
+        if (compressedCount > 0)
+            std::cout << "TEXTURE_PIPELINE:: " << compressedCount << " block compressed (" << cachedCount << " from cache, "
+                      << compressedCount - cachedCount << " cooked in " << cookMicros.load() / 1000.0 << " ms of worker time), "
+                      << compressedBytes / (1024.0 * 1024.0) << " MB on the GPU instead of " << uncompressedBytes / (1024.0 * 1024.0)
+                      << " MB as RGBA8 (" << (compressedBytes > 0 ? (double)uncompressedBytes / compressedBytes : 0.0) << "x)" << std::endl;
+        decodeMicros = 0;
+        decodedBytes = 0;
+        cookMicros = 0;
+        mipMicros = 0;
+        uploadSeconds = 0.0;
+        uploadedBytes = 0;
+        uploadedCount = 0;
+        compressedCount = 0;
+        cachedCount = 0;
+        compressedBytes = 0;
+        uncompressedBytes = 0;
+    }
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    struct DecodedTexture {
+        unsigned int id;
+        GLenum target;
+        std::string filename;
+        // only alive on the worker, replaced by either of the two below
+        DecodedImage image;
+        // the block compressed mip chain
+        CompressedTexture compressed;
+        bool fromCache = false;
+        // any texel not fully opaque, found before the image is dropped
+        bool alpha = false;
+        // or the uncompressed one, repacked to the layout given by format
+        std::vector<ImageLevel> levels;
+        GLenum format = GL_RGBA;
+        GLenum internalFormat = GL_RGBA;
+        size_t bytesPerTexel = 4;
+    };
+
+    ThreadPool &pool;
+    BoundedQueue<DecodedTexture *> decoded;
+    std::mutex signalMutex;
+    std::condition_variable signal;
+    // signalled by Pump when it took images out of decoded
+    std::mutex spaceMutex;
+    std::condition_variable space;
+    // only touched on the GL thread
+    bool compression;
+    bool s3tcChecked;
+    bool s3tcSupported;
+    int outstanding;
+    // updated by the workers
+    std::atomic<long long> decodeMicros;
+    std::atomic<size_t> decodedBytes;
+    std::atomic<long long> cookMicros;
+    std::atomic<long long> mipMicros;
+    // GL thread statistics
+    double uploadSeconds;
+    size_t uploadedBytes;
+    unsigned int uploadedCount;
+    unsigned int compressedCount;
+    unsigned int cachedCount;
+    size_t compressedBytes;
+    size_t uncompressedBytes;
+    std::unordered_map<unsigned int, size_t> textureBytes;
+    std::unordered_set<unsigned int> alphaTextures;
+
+    // GL thread: S3TC is an extension, so ask the driver once before any color texture is cooked
+    bool s3tc()
+    {
+        if (!s3tcChecked)
+        {
+            s3tcChecked = true;
+            GLint count = 0;
+            glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+            for (GLint i = 0; i < count && !s3tcSupported; i++)
+            {
+                const char *name = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+                s3tcSupported = name && std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0;
+            }
+        }
+        return s3tcSupported;
+    }
+
+    void submit(unsigned int id, GLenum target, const std::string &filename, TextureRole role,
+                std::shared_ptr<const std::vector<unsigned char>> encoded = nullptr)
+    {
+        outstanding++;
+        bool compress = compression;
+        bool allowS3TC = compress && s3tc();
+        pool.Submit([this, id, target, filename, role, encoded, compress, allowS3TC]() {
+            clock::time_point start = clock::now();
+            DecodedTexture *texture = new DecodedTexture();
+            texture->id = id;
+            texture->target = target;
+            texture->filename = filename;
+            if (compress && TextureCache::Read(filename, role, texture->compressed)
+                    && (allowS3TC || !CompressedTexture::IsS3TC(texture->compressed.format)))
+            {
+                texture->fromCache = true;
+            }
+            else
+            {
+                texture->compressed = CompressedTexture();
+                if (encoded)
+                    texture->image = DecodedImage(encoded->data(), encoded->size());
+                else
+                    texture->image = DecodedImage(filename);
+            }
+            clock::time_point decodeEnd = clock::now();
+            decodeMicros += std::chrono::duration_cast<std::chrono::microseconds>(decodeEnd - start).count();
+            decodedBytes += texture->image.Bytes();
+            // the compressor keeps BC3 for images with alpha, everything else cached is opaque
+            texture->alpha = texture->fromCache ? texture->compressed.format == BlockFormat::BC3 : texture->image.HasAlpha();
+            if (compress && texture->image.data)
+                cook(*texture, role, allowS3TC, decodeEnd);
+            if (texture->image.data)
+                buildMipChain(*texture, role);
+            // the queue is bounded so decoded images cannot pile up faster than the GL thread uploads them;
+            // a worker that finds it full sleeps until Pump makes room
+            if (!decoded.TryPush(texture))
+            {
+                std::unique_lock<std::mutex> lock(spaceMutex);
+                space.wait(lock, [this, texture]() { return decoded.TryPush(texture); });
+            }
+            signal.notify_one();
+        });
+    }
+
+    // worker: compresses a freshly decoded image and stores it in the texture cache
+    void cook(DecodedTexture &texture, TextureRole role, bool allowS3TC, clock::time_point start)
+    {
+        const DecodedImage &image = texture.image;
+        BlockFormat format = TextureCompressor::ChooseFormat(role, image.data, image.width, image.height, image.nrComponents, allowS3TC);
+        // cubemap faces have to share one format, and the skybox ignores alpha anyway
+        if (format == BlockFormat::BC3 && texture.target != GL_TEXTURE_2D)
+            format = BlockFormat::BC1;
+        if (format == BlockFormat::None)
+            return;
+        texture.compressed = TextureCompressor::Compress(image.data, image.width, image.height, image.nrComponents, format, role);
+        TextureCache::Write(texture.filename, role, texture.compressed);
+        texture.image = DecodedImage();
+        cookMicros += std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count();
+    }
+
+    // worker: uncompressed mip chain, packed to as few channels as the texture needs
+    void buildMipChain(DecodedTexture &texture, TextureRole role)
+    {
+        clock::time_point start = clock::now();
+        const DecodedImage &image = texture.image;
+        MipSettings settings;
+        settings.filter = MipFilter::Box;
+        settings.srgb = role == TextureRole::Color;
+        settings.premultiplyAlpha = role == TextureRole::Color;
+        settings.normalMap = role == TextureRole::Normal;
+        texture.levels = ImageKernels::BuildMipChain(image.data, image.width, image.height, image.nrComponents, settings);
+
+        if (texture.target != GL_TEXTURE_2D)
+        {
+            // cubemap faces keep the RGB internal format, alpha is dropped by the driver
+            texture.internalFormat = GL_RGB;
+        }
+        else if (image.nrComponents == 1 || role == TextureRole::Mask)
+        {
+            texture.format = texture.internalFormat = GL_RED;
+            texture.bytesPerTexel = 1;
+        }
+        else if (image.nrComponents == 2)
+        {
+            texture.format = texture.internalFormat = GL_RG;
+            texture.bytesPerTexel = 2;
+        }
+        else
+        {
+            // 3 channel images are uploaded expanded to RGBA, which keeps every row aligned
+            texture.internalFormat = image.nrComponents == 3 ? GL_RGB : GL_RGBA;
+        }
+        for (ImageLevel &level : texture.levels)
+        {
+            if (texture.bytesPerTexel == 4)
+                continue;
+            size_t count = (size_t)level.width * level.height;
+            std::vector<unsigned char> packed(count * texture.bytesPerTexel);
+            if (texture.bytesPerTexel == 1)
+                ImageKernels::ExtractChannel(level.pixels.data(), 0, packed.data(), count);
+            else
+                ImageKernels::PackRG(level.pixels.data(), packed.data(), count);
+            level.pixels.swap(packed);
+        }
+        texture.image = DecodedImage();
+        mipMicros += std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count();
+    }
+
+    void uploadCompressed(const DecodedTexture &texture)
+    {
+        const CompressedTexture &compressed = texture.compressed;
+        GLenum internalFormat = compressed.InternalFormat();
+        if (texture.target == GL_TEXTURE_2D)
+        {
+            GLState::Shared().BindTexture(0, GL_TEXTURE_2D, texture.id);
+            // the whole mip chain was built when cooking, so there is nothing left for glGenerateMipmap to do
+            for (size_t level = 0; level < compressed.levels.size(); level++)
+            {
+                const CompressedTexture::Level &info = compressed.levels[level];
+                glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, internalFormat, info.width, info.height, 0,
+                                       (GLsizei)info.size, compressed.LevelData(level));
+            }
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)compressed.levels.size() - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            textureBytes[texture.id] = compressed.Bytes();
+            compressedBytes += compressed.Bytes();
+            for (const CompressedTexture::Level &info : compressed.levels)
+                uncompressedBytes += (size_t)info.width * info.height * 4;
+        }
+        else
+        {
+            GLState::Shared().BindTexture(0, GL_TEXTURE_CUBE_MAP, texture.id);
+            for (size_t level = 0; level < compressed.levels.size(); level++)
+            {
+                const CompressedTexture::Level &info = compressed.levels[level];
+                glCompressedTexImage2D(texture.target, (GLint)level, internalFormat, info.width, info.height, 0,
+                                       (GLsizei)info.size, compressed.LevelData(level));
+                uncompressedBytes += (size_t)info.width * info.height * 4;
+            }
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, (GLint)compressed.levels.size() - 1);
+            textureBytes[texture.id] += compressed.Bytes();
+            compressedBytes += compressed.Bytes();
+        }
+        compressedCount++;
+        cachedCount += texture.fromCache ? 1 : 0;
+        uploadedBytes += compressed.Bytes();
+    }
+
+    void upload(const DecodedTexture &texture)
+    {
+        if (texture.alpha && texture.target == GL_TEXTURE_2D)
+            alphaTextures.insert(texture.id);
+        if (texture.compressed.Valid())
+        {
+            clock::time_point start = clock::now();
+            uploadCompressed(texture);
+            uploadSeconds += std::chrono::duration<double>(clock::now() - start).count();
+            uploadedCount++;
+            return;
+        }
+        if (texture.levels.empty())
+        {
+            std::cout << "Texture failed to load at path: " << texture.filename << std::endl;
+            return;
+        }
+        clock::time_point start = clock::now();
+        GLenum bindTarget = texture.target == GL_TEXTURE_2D ? GL_TEXTURE_2D : GL_TEXTURE_CUBE_MAP;
+        GLState::Shared().BindTexture(0, bindTarget, texture.id);
+        // packed 1 and 2 channel rows are not 4 byte aligned
+        glPixelStorei(GL_UNPACK_ALIGNMENT, texture.bytesPerTexel == 4 ? 4 : 1);
+        size_t bytes = 0;
+        for (size_t level = 0; level < texture.levels.size(); level++)
+        {
+            const ImageLevel &image = texture.levels[level];
+            glTexImage2D(texture.target, (GLint)level, texture.internalFormat, image.width, image.height, 0,
+                         texture.format, GL_UNSIGNED_BYTE, image.pixels.data());
+            bytes += image.pixels.size();
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(bindTarget, GL_TEXTURE_MAX_LEVEL, (GLint)texture.levels.size() - 1);
+        if (texture.target == GL_TEXTURE_2D)
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        }
+        textureBytes[texture.id] += bytes;
+        uploadSeconds += std::chrono::duration<double>(clock::now() - start).count();
+        uploadedBytes += bytes;
+        uploadedCount++;
+    }
+};
+#endif
@@ -0,0 +1,195 @@
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include <learnopengl/texture_pipeline.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Process wide table of loaded 2D textures, shared by every Model and by the scene code.
+// Lookups are hashed on the canonical file path, so each file is decoded and uploaded once no matter
+// how many models reference it. With content deduplication on, images that have to be decoded (no up to date
+// TextureCache entry) are hashed as well, and byte-identical ones stored under different names share one texture
+// (after comparing the bytes). That reads the file on the GL thread, so it is off by default.
+// Only used from the GL thread.
+class TextureRegistry
+{
+public:
+    explicit TextureRegistry(TexturePipeline &pipeline = TexturePipeline::Shared())
+        : pipeline(pipeline), contentDeduplication(false), requests(0), ownerHits(0), pathHits(0), contentHits(0)
+    {
+    }
+
+    static TextureRegistry &Shared()
+    {
+        static TextureRegistry registry;
+        return registry;
+    }
+
+    // when enabled every new path without a cooked texture is read and hashed on the GL thread before it is queued
+    // for decoding; the bytes are handed to the decoder so the file is still read only once. Paths served from the
+    // TextureCache are never read here, which keeps warm starts free of synchronous file I/O.
+    void SetContentDeduplication(bool enabled) { contentDeduplication = enabled; }
+
+    // returns the texture for filename, queueing it on the TexturePipeline the first time it is seen.
+    // the same image used in another role is a separate texture since it is compressed differently.
+    // owner identifies the requester (Model passes itself, scene code nullptr): a model asking again for a texture
+    // it already uses is counted apart from the uploads the registry saves between models.
+    unsigned int Acquire(const std::string &filename, TextureRole role = TextureRole::Color, const void *owner = nullptr)
+    {
+        requests++;
+        std::string path = canonicalPath(filename);
+        std::string key = path + '#' + std::to_string((int)role);
+        std::unordered_map<std::string, unsigned int>::const_iterator known = byPath.find(key);
+        if (known != byPath.end())
+        {
+            if (addOwner(known->second, owner))
+            {
+                pathHits++;
+                shared.push_back(known->second);
+            }
+            else
+                ownerHits++;
+            return known->second;
+        }
+
+        std::shared_ptr<std::vector<unsigned char>> encoded;
+        uint64_t contentKey = 0;
+        if (contentDeduplication && !(pipeline.Compression() && TextureCache::Fresh(path, role)) && (encoded = readFile(path)))
+        {
+            contentKey = HashBytes(encoded->data(), encoded->size()) ^ ((uint64_t)role << 56);
+            // a matching hash is only a candidate; the texture is shared once the bytes compare equal
+            typedef std::unordered_multimap<uint64_t, ContentEntry>::const_iterator Iterator;
+            std::pair<Iterator, Iterator> candidates = byContent.equal_range(contentKey);
+            for (Iterator same = candidates.first; same != candidates.second; ++same)
+            {
+                if (!sameBytes(same->second, *encoded))
+                    continue;
+                unsigned int id = same->second.id;
+                if (addOwner(id, owner))
+                {
+                    contentHits++;
+                    shared.push_back(id);
+                }
+                else
+                    ownerHits++;
+                byPath[key] = id;
+                return id;
+            }
+        }
+
+        unsigned int id = pipeline.Load2D(path, role, encoded);
+        byPath[key] = id;
+        owners[id].push_back(owner);
+        if (encoded)
+            byContent.emplace(contentKey, ContentEntry{id, path, encoded->size()});
+        return id;
+    }
+
+    // prints how many uploads the registry avoided between models (and by content) and how much video memory that
+    // saved; repeats within one model are listed apart, a per model cache would have caught those as well.
+    // sizes are only known for uploaded textures, so call it after TexturePipeline::Finish().
+    void Report() const
+    {
+        size_t savedBytes = 0;
+        for (unsigned int id : shared)
+            savedBytes += pipeline.TextureBytes(id);
+        std::cout << "TEXTURE_REGISTRY:: " << requests << " requests, " << requests - ownerHits - pathHits - contentHits
+                  << " uploads, " << ownerHits << " reused within a model, " << pathHits << " shared across models by path, "
+                  << contentHits << " shared by content -> saved " << pathHits + contentHits << " uploads and "
+                  << std::fixed << std::setprecision(1) << savedBytes / (1024.0 * 1024.0) << " MB of GPU memory" << std::endl;
+    }
+
+    // 64-bit hash over whole words with a byte wise tail; used for content deduplication
+    static uint64_t HashBytes(const unsigned char *data, size_t size)
+    {
+        const uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+        uint64_t hash = 0xCBF29CE484222325ull ^ (size * multiplier);
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, data + i, sizeof(word));
+            hash = (hash ^ word) * multiplier;
+            hash ^= hash >> 29;
+        }
+        for (; i < size; i++)
+            hash = (hash ^ data[i]) * 0x100000001B3ull;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+private:
+    // a texture whose file was hashed, with what it takes to compare the bytes of a later candidate
+    struct ContentEntry {
+        unsigned int id;
+        std::string path;
+        size_t size;
+    };
+
+    TexturePipeline &pipeline;
+    bool contentDeduplication;
+    std::unordered_map<std::string, unsigned int> byPath;
+    std::unordered_multimap<uint64_t, ContentEntry> byContent;
+    // requesters of each texture (see Acquire)
+    std::unordered_map<unsigned int, std::vector<const void *>> owners;
+    // texture returned to another owner instead of being uploaded, once per avoided upload
+    std::vector<unsigned int> shared;
+    unsigned int requests;
+    unsigned int ownerHits;
+    unsigned int pathHits;
+    unsigned int contentHits;
+
+    // records owner as a user of texture id; false if it already was one
+    bool addOwner(unsigned int id, const void *owner)
+    {
+        std::vector<const void *> &users = owners[id];
+        if (std::find(users.begin(), users.end(), owner) != users.end())
+            return false;
+        users.push_back(owner);
+        return true;
+    }
+
+    // the file of entry is read again: hits are rare and keeping every image's bytes around is not worth it
+    static bool sameBytes(const ContentEntry &entry, const std::vector<unsigned char> &bytes)
+    {
+        if (entry.size != bytes.size())
+            return false;
+        std::shared_ptr<std::vector<unsigned char>> existing = readFile(entry.path);
+        return existing && existing->size() == bytes.size()
+               && (bytes.empty() || std::memcmp(existing->data(), bytes.data(), bytes.size()) == 0);
+    }
+
+    // resolves "..", "." and symlinks so different spellings of a path share one entry
+    static std::string canonicalPath(const std::string &filename)
+    {
+        char resolved[PATH_MAX];
+        if (realpath(filename.c_str(), resolved))
+            return std::string(resolved);
+        return filename;
+    }
+
+    static std::shared_ptr<std::vector<unsigned char>> readFile(const std::string &filename)
+    {
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+        if (!file)
+            return nullptr;
+        std::streamsize size = file.tellg();
+        file.seekg(0, std::ios::beg);
+        std::shared_ptr<std::vector<unsigned char>> bytes = std::make_shared<std::vector<unsigned char>>((size_t)size);
+        if (size > 0 && !file.read(reinterpret_cast<char *>(bytes->data()), size))
+            return nullptr;
+        return bytes;
+    }
+};
+#endif
@@ -0,0 +1,132 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed size pool of worker threads running queued jobs in FIFO order.
+// Workers never touch OpenGL; anything that needs the context has to be handed back to the GL thread.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned int threadCount = defaultThreadCount()) : stopping(false)
+    {
+        for (unsigned int i = 0; i < threadCount; i++)
+            workers.emplace_back([this]() { workerLoop(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // process wide pool shared by the loaders
+    static ThreadPool &Shared()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    unsigned int Size() const { return static_cast<unsigned int>(workers.size()); }
+
+    // queues job and returns a future for its result
+    template<typename F>
+    std::future<typename std::result_of<F()>::type> Submit(F job)
+    {
+        typedef typename std::result_of<F()>::type Result;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::move(job));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back([task]() { (*task)(); });
+        }
+        wakeUp.notify_one();
+        return result;
+    }
+
+    // runs body(0..count-1) on the pool with the calling thread taking part. Jobs that start after all items are
+    // claimed return immediately, so the caller never waits for a job that is still queued behind it.
+    template<typename F>
+    void ParallelFor(size_t count, const F &body)
+    {
+        if (count == 0)
+            return;
+        struct State {
+            std::atomic<size_t> next{0};
+            std::atomic<size_t> done{0};
+            std::mutex mutex;
+            std::condition_variable finished;
+        };
+        std::shared_ptr<State> state = std::make_shared<State>();
+        const size_t total = count;
+        auto work = [state, total, &body]() {
+            for (size_t i; (i = state->next.fetch_add(1)) < total;)
+            {
+                body(i);
+                if (state->done.fetch_add(1) + 1 == total)
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->finished.notify_all();
+                }
+            }
+        };
+        size_t helpers = std::min<size_t>(Size(), count - 1);
+        for (size_t i = 0; i < helpers; i++)
+            Submit([state, total, &body, work]() {
+                // body may be gone once every item is done; only claim an item while some are left
+                if (state->next.load() < total)
+                    work();
+            });
+        work();
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [&]() { return state->done.load() == total; });
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    bool stopping;
+
+    static unsigned int defaultThreadCount()
+    {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    void workerLoop()
+    {
+        for (;;)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeUp.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if (jobs.empty())
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+};
+#endif
@@ -0,0 +1,136 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// uniform blocks shared by all programs. Each has a fixed binding point that Shader assigns at link time,
+// so a new program picks the blocks up without any per-frame uniform calls of its own.
+namespace UniformBlock {
+    enum : GLuint {
+        FrameBinding = 0, // Frame, resources/shaders/frame.glsl
+        LightsBinding = 1 // Lights, resources/shaders/lights.glsl (see LightManager)
+    };
+
+    // binding point of the shared block called name, -1 if it is not one of them
+    inline int BindingOf(const char *name)
+    {
+        if (std::strcmp(name, "Frame") == 0)
+            return FrameBinding;
+        if (std::strcmp(name, "Lights") == 0)
+            return LightsBinding;
+        return -1;
+    }
+
+    // points every shared block the program uses at its binding
+    inline void Bind(GLuint program)
+    {
+        GLint count = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+        char name[256];
+        for (GLint i = 0; i < count; i++)
+        {
+            glGetActiveUniformBlockName(program, (GLuint)i, sizeof(name), nullptr, name);
+            int binding = BindingOf(name);
+            if (binding >= 0)
+                glUniformBlockBinding(program, (GLuint)i, (GLuint)binding);
+        }
+    }
+}
+
+// std140 image of the Frame block: camera and timing data written once per frame
+struct FrameUniforms {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::mat4 viewProjection;
+    glm::vec3 viewPos;
+    float time;
+    glm::vec4 viewport; // width, height, 1 / width, 1 / height
+    glm::mat4 inverseViewProjection;
+};
+static_assert(offsetof(FrameUniforms, viewPos) == 192 && offsetof(FrameUniforms, time) == 204
+              && offsetof(FrameUniforms, viewport) == 208
+              && offsetof(FrameUniforms, inverseViewProjection) == 224 && sizeof(FrameUniforms) == 288, "FrameUniforms does not match std140");
+
+// a uniform buffer holding frames copies of one block. Every Write fills the next copy through an
+// unsynchronized mapping and binds it to the block's binding point; a fence per copy keeps the CPU from
+// overwriting a copy the GPU may still read, so writing never stalls on draws of the previous frames.
+class UniformRingBuffer
+{
+public:
+    UniformRingBuffer(GLuint binding, size_t blockSize, unsigned int frames = 3)
+        : binding(binding), blockSize(blockSize), fences(frames, nullptr)
+    {
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        stride = (blockSize + alignment - 1) / alignment * alignment;
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, stride * frames, nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    UniformRingBuffer(const UniformRingBuffer &) = delete;
+    UniformRingBuffer &operator=(const UniformRingBuffer &) = delete;
+
+    // frees the GL objects; has to run while the context is still current
+    void Delete()
+    {
+        for (GLsync &fence : fences)
+            if (fence)
+                glDeleteSync(fence);
+        glDeleteBuffers(1, &UBO);
+    }
+
+    template <typename T>
+    void Write(const T &block)
+    {
+        Write(&block, sizeof(T));
+    }
+
+    void Write(const void *data, size_t size)
+    {
+        // everything drawn with the current copy has been issued by now
+        if (current >= 0)
+        {
+            if (fences[current])
+                glDeleteSync(fences[current]);
+            fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+        current = (current + 1) % (int)fences.size();
+        if (fences[current])
+        {
+            while (glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+                ;
+            glDeleteSync(fences[current]);
+            fences[current] = nullptr;
+        }
+
+        size = size < blockSize ? size : blockSize;
+        GLintptr offset = (GLintptr)(current * stride);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        void *target = glMapBufferRange(GL_UNIFORM_BUFFER, offset, (GLsizeiptr)size,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (target)
+        {
+            std::memcpy(target, data, size);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding, UBO, offset, (GLsizeiptr)blockSize);
+    }
+
+private:
+    GLuint binding;
+    size_t blockSize;
+    size_t stride;
+    unsigned int UBO;
+    std::vector<GLsync> fences;
+    int current = -1;
+};
+#endif
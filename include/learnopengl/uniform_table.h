@@ -0,0 +1,251 @@
+#ifndef UNIFORM_TABLE_H
+#define UNIFORM_TABLE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// typed handle of one active uniform, resolved once with Shader::uniform<T>(name) and set with Shader::set.
+// empty (and ignored by set) if the program has no active uniform of that name and type.
+template <typename T>
+struct Uniform {
+    typedef T Value;
+    int slot = -1;
+
+    explicit operator bool() const { return slot >= 0; }
+};
+
+// how a C++ value type is checked against the GL type of a uniform and uploaded
+template <typename T> struct UniformType;
+
+namespace UniformTypes {
+    // uniforms set with glUniform1i: ints, bools and samplers
+    inline bool IsInteger(GLenum type)
+    {
+        switch (type)
+        {
+        case GL_INT: case GL_BOOL:
+        case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_2D_ARRAY_SHADOW: case GL_SAMPLER_CUBE_SHADOW:
+        case GL_SAMPLER_2D_MULTISAMPLE: case GL_SAMPLER_BUFFER: case GL_INT_SAMPLER_BUFFER: case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+        case GL_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_2D:
+            return true;
+        default:
+            return false;
+        }
+    }
+}
+
+template <> struct UniformType<int> {
+    static bool Matches(GLenum type) { return UniformTypes::IsInteger(type); }
+    static void Upload(GLint location, const int &value) { glUniform1i(location, value); }
+};
+template <> struct UniformType<bool> {
+    static bool Matches(GLenum type) { return UniformTypes::IsInteger(type); }
+};
+template <> struct UniformType<float> {
+    static bool Matches(GLenum type) { return type == GL_FLOAT; }
+    static void Upload(GLint location, const float &value) { glUniform1f(location, value); }
+};
+template <> struct UniformType<glm::vec2> {
+    static bool Matches(GLenum type) { return type == GL_FLOAT_VEC2; }
+    static void Upload(GLint location, const glm::vec2 &value) { glUniform2fv(location, 1, &value[0]); }
+};
+template <> struct UniformType<glm::vec3> {
+    static bool Matches(GLenum type) { return type == GL_FLOAT_VEC3; }
+    static void Upload(GLint location, const glm::vec3 &value) { glUniform3fv(location, 1, &value[0]); }
+};
+template <> struct UniformType<glm::vec4> {
+    static bool Matches(GLenum type) { return type == GL_FLOAT_VEC4; }
+    static void Upload(GLint location, const glm::vec4 &value) { glUniform4fv(location, 1, &value[0]); }
+};
+template <> struct UniformType<glm::mat2> {
+    static bool Matches(GLenum type) { return type == GL_FLOAT_MAT2; }
+    static void Upload(GLint location, const glm::mat2 &value) { glUniformMatrix2fv(location, 1, GL_FALSE, &value[0][0]); }
+};
+template <> struct UniformType<glm::mat3> {
+    static bool Matches(GLenum type) { return type == GL_FLOAT_MAT3; }
+    static void Upload(GLint location, const glm::mat3 &value) { glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]); }
+};
+template <> struct UniformType<glm::mat4> {
+    static bool Matches(GLenum type) { return type == GL_FLOAT_MAT4; }
+    static void Upload(GLint location, const glm::mat4 &value) { glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]); }
+};
+
+// the active uniforms of a linked program, reflected once with glGetActiveUniform. Names are looked up in an
+// open addressing hash table, so setting a uniform by name neither allocates nor asks GL for its location.
+// Every entry keeps the last value sent to it and sets of an unchanged value are dropped. That relies on the
+// uniforms of the program only being changed through the table; a set that is sent makes the program current
+// through GLState first, so it can't land in another program.
+class UniformTable
+{
+public:
+    struct Entry {
+        std::string name;
+        GLint location = -1;
+        GLenum type = 0;
+        bool valid = false;
+        float value[16]; // last value set, as raw bytes of the largest type (mat4)
+    };
+
+    // reads all active uniforms of program outside of uniform blocks. Array elements get one entry
+    // each ("weights[2]"), and the bare array name refers to element 0 like in glGetUniformLocation.
+    void Reflect(GLuint program)
+    {
+        this->program = program;
+        entries.clear();
+        keys.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> name(maxLength + 1);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(program, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+            std::string uniformName(name.data(), length);
+            std::string base = uniformName;
+            if (base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0)
+                base.resize(base.size() - 3);
+            else if (size == 1)
+            {
+                add(program, uniformName, type);
+                continue;
+            }
+            int first = add(program, base + "[0]", type);
+            for (GLint element = 1; element < size; element++)
+                add(program, base + "[" + std::to_string(element) + "]", type);
+            // the bare name shares element 0's entry, so both names see the same last value
+            if (first >= 0)
+                keys.push_back(Key{base, Hash(base.c_str()), (uint32_t)first});
+        }
+        buildBuckets();
+    }
+
+    // index of the entry named name, -1 if the program has no such active uniform
+    int Find(const char *name) const
+    {
+        if (buckets.empty())
+            return -1;
+        uint32_t hash = Hash(name);
+        size_t mask = buckets.size() - 1;
+        for (size_t bucket = hash & mask; buckets[bucket] != 0; bucket = (bucket + 1) & mask)
+        {
+            const Key &key = keys[buckets[bucket] - 1];
+            if (key.hash == hash && key.name == name)
+                return (int)key.entry;
+        }
+        return -1;
+    }
+
+    // typed handle for name; reports a type mismatch and returns an empty handle for it
+    template <typename T>
+    Uniform<T> Resolve(const char *name) const
+    {
+        Uniform<T> uniform;
+        int slot = Find(name);
+        if (slot >= 0 && !UniformType<T>::Matches(entries[slot].type))
+            std::cout << "ERROR::SHADER::UNIFORM_TYPE_MISMATCH: " << name << std::endl;
+        else
+            uniform.slot = slot;
+        return uniform;
+    }
+
+    // sends value to the uniform in slot unless the program already holds it; binds the program (see GLState)
+    template <typename T>
+    void Set(int slot, const T &value)
+    {
+        static_assert(sizeof(T) <= sizeof(Entry::value), "uniform value too large");
+        if (slot < 0)
+            return;
+        Entry &entry = entries[slot];
+        if (entry.valid && std::memcmp(entry.value, &value, sizeof(T)) == 0)
+            return;
+        std::memcpy(entry.value, &value, sizeof(T));
+        entry.valid = true;
+        GLState::Shared().UseProgram(program);
+        UniformType<T>::Upload(entry.location, value);
+    }
+
+    // bools are uploaded and remembered as ints, like setBool always did
+    void Set(int slot, bool value)
+    {
+        Set(slot, (int)value);
+    }
+
+    // forgets the values sent so far, e.g. after the program's uniforms were set with raw glUniform calls
+    void Invalidate()
+    {
+        for (Entry &entry : entries)
+            entry.valid = false;
+    }
+
+    GLuint Program() const { return program; }
+    size_t Size() const { return entries.size(); }
+    const Entry &operator[](size_t i) const { return entries[i]; }
+
+    // 32-bit FNV-1a of a uniform name
+    static uint32_t Hash(const char *name)
+    {
+        uint32_t hash = 2166136261u;
+        for (; *name; name++)
+            hash = (hash ^ (unsigned char)*name) * 16777619u;
+        return hash;
+    }
+
+private:
+    // a name that refers to an entry
+    struct Key {
+        std::string name;
+        uint32_t hash;
+        uint32_t entry;
+    };
+
+    GLuint program = 0;
+    std::vector<Entry> entries;
+    std::vector<Key> keys;
+    // key index + 1 per bucket, 0 for empty buckets; at most half full
+    std::vector<uint32_t> buckets;
+
+    // index of the new entry, -1 for names without a location
+    int add(GLuint program, const std::string &name, GLenum type)
+    {
+        Entry entry;
+        entry.name = name;
+        entry.location = glGetUniformLocation(program, name.c_str());
+        // members of uniform blocks have no location and are not set through the table
+        if (entry.location < 0)
+            return -1;
+        entry.type = type;
+        keys.push_back(Key{name, Hash(name.c_str()), (uint32_t)entries.size()});
+        entries.push_back(entry);
+        return (int)entries.size() - 1;
+    }
+
+    void buildBuckets()
+    {
+        size_t capacity = 16;
+        while (capacity < keys.size() * 2)
+            capacity *= 2;
+        buckets.assign(capacity, 0);
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            size_t bucket = keys[i].hash & (capacity - 1);
+            while (buckets[bucket] != 0)
+                bucket = (bucket + 1) & (capacity - 1);
+            buckets[bucket] = (uint32_t)(i + 1);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,351 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct Vertex {
+    // position
+    glm::vec3 Position;
+    // normal
+    glm::vec3 Normal;
+    // texCoords
+    glm::vec2 TexCoords;
+    // tangent
+    glm::vec3 Tangent;
+    // bitangent
+    glm::vec3 Bitangent;
+};
+
+// vertex attributes by shader location, as bits of an attribute mask
+namespace VertexAttribute {
+    enum : unsigned int {
+        Position  = 1u << 0,
+        Normal    = 1u << 1,
+        TexCoords = 1u << 2,
+        Tangent   = 1u << 3,
+        Bitangent = 1u << 4,
+        All       = 0x1Fu
+    };
+}
+
+// 16 byte GPU vertex:
+//  - position as unsigned normalized shorts relative to the mesh bounds,
+//  - the tangent frame as the angle of the tangent around the normal (15 bits) and the sign of the bitangent
+//    (top bit), read as an integer attribute,
+//  - the normal octahedral encoded in two signed normalized shorts,
+//  - texture coordinates as unsigned normalized shorts relative to the mesh uv bounds.
+// the vertex shader undoes the bounds scaling with the VertexQuantization uniforms (see lightingShader.vs).
+// a shader that needs the tangent frame rebuilds it with the basis from VertexFormat::TangentBasis:
+//   T = cos(a) * b1 + sin(a) * b2, a = (float(t & 0x7FFFu) / 32767.0 - 0.5) * 2 * pi
+//   B = (t >= 0x8000u ? -1.0 : 1.0) * cross(N, T)
+struct PackedVertex {
+    uint16_t position[3];
+    uint16_t tangent;
+    int16_t  normal[2];
+    uint16_t texCoords[2];
+};
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex has to stay 16 bytes");
+
+// maps the normalized positions/uvs of a packed mesh back to object space: value = offset + packed * scale
+struct VertexQuantization {
+    glm::vec3 positionOffset = glm::vec3(0.0f);
+    glm::vec3 positionScale = glm::vec3(1.0f);
+    glm::vec2 uvOffset = glm::vec2(0.0f);
+    glm::vec2 uvScale = glm::vec2(1.0f);
+};
+
+// how the vertex and index buffers of a mesh are laid out on the GPU
+struct VertexLayout {
+    bool packed = false;
+    // attributes present in the vertex buffer (VertexAttribute bits)
+    unsigned int attributes = VertexAttribute::All;
+    unsigned int stride = sizeof(Vertex);
+    GLenum indexType = GL_UNSIGNED_INT;
+    VertexQuantization quantization;
+
+    size_t IndexSize() const { return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t); }
+
+    // sets the attribute pointers of the bound VAO for the bound GL_ARRAY_BUFFER
+    void Apply() const
+    {
+        if (packed)
+        {
+            if (attributes & VertexAttribute::Position)
+                pointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(PackedVertex, position));
+            if (attributes & VertexAttribute::Normal)
+                pointer(1, 2, GL_SHORT, GL_TRUE, offsetof(PackedVertex, normal));
+            if (attributes & VertexAttribute::TexCoords)
+                pointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(PackedVertex, texCoords));
+            // the bitangent is rebuilt from the tangent attribute, location 4 stays disabled
+            if (attributes & (VertexAttribute::Tangent | VertexAttribute::Bitangent))
+            {
+                glEnableVertexAttribArray(3);
+                glVertexAttribIPointer(3, 1, GL_UNSIGNED_SHORT, stride, (void*)offsetof(PackedVertex, tangent));
+            }
+            return;
+        }
+        // float attributes, interleaved in location order without the stripped ones
+        static const GLint components[5] = {3, 3, 2, 3, 3};
+        size_t offset = 0;
+        for (unsigned int location = 0; location < 5; location++)
+        {
+            if (!(attributes & (1u << location)))
+                continue;
+            pointer(location, components[location], GL_FLOAT, GL_FALSE, offset);
+            offset += components[location] * sizeof(float);
+        }
+    }
+
+    // the position-only stream of a depth pass (see VertexFormat::BuildPositions): the position attribute
+    // in the same format, packed ones padded to 8 bytes
+    unsigned int PositionStride() const { return packed ? (unsigned int)(4 * sizeof(uint16_t)) : (unsigned int)(3 * sizeof(float)); }
+
+    // sets location 0 of the bound VAO to the position-only stream in the bound GL_ARRAY_BUFFER
+    void ApplyPositions() const
+    {
+        glEnableVertexAttribArray(0);
+        if (packed)
+            glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, PositionStride(), (void*)0);
+        else
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, PositionStride(), (void*)0);
+    }
+
+private:
+    void pointer(GLuint location, GLint size, GLenum type, GLboolean normalized, size_t offset) const
+    {
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, size, type, normalized, stride, (void*)offset);
+    }
+};
+
+// what Model::Import builds the GPU vertex data as
+struct VertexFormatSettings {
+    bool packed = true;
+    // attributes to keep, everything else is stripped (see VertexFormat::ConsumedAttributes)
+    unsigned int attributes = VertexAttribute::All;
+
+    // part of the mesh cache key, which stores the converted buffers
+    uint32_t Hash() const
+    {
+        uint32_t values[3] = {packed ? 1u : 0u, attributes, (uint32_t)sizeof(PackedVertex)};
+        uint32_t hash = 2166136261u;
+        for (uint32_t value : values)
+            hash = (hash ^ value) * 16777619u;
+        return hash;
+    }
+};
+
+// conversion of imported Vertex data into the GPU layouts
+class VertexFormat
+{
+public:
+    // attributes the vertex stage of a linked program reads, as VertexAttribute bits of their locations
+    static unsigned int ConsumedAttributes(const Shader &shader)
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(shader.ID, GL_ACTIVE_ATTRIBUTES, &count);
+        glGetProgramiv(shader.ID, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> name((size_t)std::max(maxLength, 1));
+        unsigned int attributes = 0;
+        for (GLint i = 0; i < count; i++)
+        {
+            GLint size;
+            GLenum type;
+            glGetActiveAttrib(shader.ID, (GLuint)i, (GLsizei)name.size(), nullptr, &size, &type, name.data());
+            GLint location = glGetAttribLocation(shader.ID, name.data());
+            if (location >= 0 && location < 5)
+                attributes |= 1u << location;
+        }
+        return attributes;
+    }
+
+    // layout for a mesh with vertexCount vertices; the quantization is filled in by Build
+    static VertexLayout Layout(const VertexFormatSettings &settings, size_t vertexCount)
+    {
+        VertexLayout layout;
+        layout.packed = settings.packed;
+        layout.attributes = settings.attributes;
+        // the tangent frame is stored relative to the normal
+        if (layout.attributes & (VertexAttribute::Tangent | VertexAttribute::Bitangent))
+            layout.attributes |= VertexAttribute::Normal;
+        layout.stride = settings.packed ? (unsigned int)sizeof(PackedVertex) : floatStride(layout.attributes);
+        // every index fits in 16 bits
+        layout.indexType = vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        return layout;
+    }
+
+    // writes count vertices in the layout to out (count * layout.stride bytes) and fills in the quantization
+    static void Build(const Vertex *vertices, size_t count, VertexLayout &layout, unsigned char *out)
+    {
+        if (!layout.packed)
+        {
+            static const size_t sizes[5] = {sizeof(glm::vec3), sizeof(glm::vec3), sizeof(glm::vec2), sizeof(glm::vec3), sizeof(glm::vec3)};
+            static const size_t offsets[5] = {offsetof(Vertex, Position), offsetof(Vertex, Normal), offsetof(Vertex, TexCoords),
+                                              offsetof(Vertex, Tangent), offsetof(Vertex, Bitangent)};
+            for (size_t v = 0; v < count; v++)
+            {
+                const unsigned char *source = reinterpret_cast<const unsigned char *>(&vertices[v]);
+                unsigned char *target = out + v * layout.stride;
+                for (unsigned int location = 0; location < 5; location++)
+                    if (layout.attributes & (1u << location))
+                    {
+                        std::memcpy(target, source + offsets[location], sizes[location]);
+                        target += sizes[location];
+                    }
+            }
+            return;
+        }
+
+        VertexQuantization &q = layout.quantization;
+        glm::vec3 positionMin(0.0f), positionMax(0.0f);
+        glm::vec2 uvMin(0.0f), uvMax(0.0f);
+        for (size_t v = 0; v < count; v++)
+        {
+            positionMin = v == 0 ? vertices[v].Position : glm::min(positionMin, vertices[v].Position);
+            positionMax = v == 0 ? vertices[v].Position : glm::max(positionMax, vertices[v].Position);
+            for (int k = 0; k < 2; k++)
+            {
+                uvMin[k] = v == 0 ? vertices[v].TexCoords[k] : std::min(uvMin[k], vertices[v].TexCoords[k]);
+                uvMax[k] = v == 0 ? vertices[v].TexCoords[k] : std::max(uvMax[k], vertices[v].TexCoords[k]);
+            }
+        }
+        q.positionOffset = positionMin;
+        q.uvOffset = uvMin;
+        for (int k = 0; k < 3; k++)
+            q.positionScale[k] = positionMax[k] > positionMin[k] ? positionMax[k] - positionMin[k] : 1.0f;
+        for (int k = 0; k < 2; k++)
+            q.uvScale[k] = uvMax[k] > uvMin[k] ? uvMax[k] - uvMin[k] : 1.0f;
+
+        PackedVertex *packed = reinterpret_cast<PackedVertex *>(out);
+        for (size_t v = 0; v < count; v++)
+        {
+            const Vertex &vertex = vertices[v];
+            PackedVertex &p = packed[v];
+            std::memset(&p, 0, sizeof(p));
+            for (int k = 0; k < 3; k++)
+                p.position[k] = unorm16((vertex.Position[k] - q.positionOffset[k]) / q.positionScale[k]);
+            for (int k = 0; k < 2; k++)
+                p.texCoords[k] = unorm16((vertex.TexCoords[k] - q.uvOffset[k]) / q.uvScale[k]);
+            if (layout.attributes & VertexAttribute::Normal)
+                OctEncode(vertex.Normal, p.normal);
+            if (layout.attributes & (VertexAttribute::Tangent | VertexAttribute::Bitangent))
+            {
+                // encode against the normal the shader will decode
+                int16_t normal[2];
+                OctEncode(vertex.Normal, normal);
+                p.tangent = PackTangent(OctDecode(normal), vertex.Tangent, vertex.Bitangent);
+            }
+        }
+    }
+
+    // octahedral normal encoding into two snorm16 values
+    static void OctEncode(const glm::vec3 &n, int16_t out[2])
+    {
+        float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+        float x = l1 > 0.0f ? n.x / l1 : 0.0f, y = l1 > 0.0f ? n.y / l1 : 0.0f;
+        if (n.z < 0.0f)
+        {
+            float ox = x;
+            x = (1.0f - std::fabs(y)) * signNotZero(ox);
+            y = (1.0f - std::fabs(ox)) * signNotZero(y);
+        }
+        out[0] = snorm16(x);
+        out[1] = snorm16(y);
+    }
+
+    static glm::vec3 OctDecode(const int16_t in[2])
+    {
+        float x = std::max(in[0] / 32767.0f, -1.0f), y = std::max(in[1] / 32767.0f, -1.0f);
+        glm::vec3 n(x, y, 1.0f - std::fabs(x) - std::fabs(y));
+        if (n.z < 0.0f)
+        {
+            float ox = n.x;
+            n.x = (1.0f - std::fabs(n.y)) * signNotZero(ox);
+            n.y = (1.0f - std::fabs(ox)) * signNotZero(n.y);
+        }
+        return glm::normalize(n);
+    }
+
+    // orthonormal basis around the unit vector n (Duff et al. 2017), the reference frame of the packed tangent
+    static void TangentBasis(const glm::vec3 &n, glm::vec3 &b1, glm::vec3 &b2)
+    {
+        float s = n.z >= 0.0f ? 1.0f : -1.0f;
+        float a = -1.0f / (s + n.z);
+        float b = n.x * n.y * a;
+        b1 = glm::vec3(1.0f + s * n.x * n.x * a, s * b, -s * n.x);
+        b2 = glm::vec3(b, s + n.y * n.y * a, -n.y);
+    }
+
+    static uint16_t PackTangent(const glm::vec3 &normal, const glm::vec3 &tangent, const glm::vec3 &bitangent)
+    {
+        const float pi = 3.14159265358979f;
+        glm::vec3 b1, b2;
+        TangentBasis(normal, b1, b2);
+        float angle = std::atan2(glm::dot(tangent, b2), glm::dot(tangent, b1));
+        uint16_t bits = (uint16_t)std::lround((angle / (2.0f * pi) + 0.5f) * 32767.0f) & 0x7FFFu;
+        if (glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f)
+            bits |= 0x8000u;
+        return bits;
+    }
+
+    // copies the position attribute of count vertices in the layout to out (count * layout.PositionStride() bytes).
+    // The bytes are the same as in the full vertex buffer, so a depth pass reading them computes the same depths.
+    static void BuildPositions(const unsigned char *vertices, size_t count, const VertexLayout &layout, unsigned char *out)
+    {
+        // the position comes first in both layouts
+        size_t size = layout.packed ? sizeof(PackedVertex::position) : sizeof(glm::vec3);
+        size_t stride = layout.PositionStride();
+        std::memset(out, 0, count * stride);
+        for (size_t v = 0; v < count; v++)
+            std::memcpy(out + v * stride, vertices + v * layout.stride, size);
+    }
+
+    // copies indices into 16-bit ones when the layout asks for it
+    static void BuildIndices(const unsigned int *indices, size_t count, const VertexLayout &layout, unsigned char *out)
+    {
+        if (layout.indexType == GL_UNSIGNED_INT)
+        {
+            std::memcpy(out, indices, count * sizeof(unsigned int));
+            return;
+        }
+        uint16_t *shorts = reinterpret_cast<uint16_t *>(out);
+        for (size_t i = 0; i < count; i++)
+            shorts[i] = (uint16_t)indices[i];
+    }
+
+private:
+    static unsigned int floatStride(unsigned int attributes)
+    {
+        static const unsigned int sizes[5] = {12, 12, 8, 12, 12};
+        unsigned int stride = 0;
+        for (unsigned int location = 0; location < 5; location++)
+            if (attributes & (1u << location))
+                stride += sizes[location];
+        return stride;
+    }
+
+    static float signNotZero(float v) { return v >= 0.0f ? 1.0f : -1.0f; }
+
+    static uint16_t unorm16(float v)
+    {
+        return (uint16_t)std::lround(std::min(std::max(v, 0.0f), 1.0f) * 65535.0f);
+    }
+
+    static int16_t snorm16(float v)
+    {
+        return (int16_t)std::lround(std::min(std::max(v, -1.0f), 1.0f) * 32767.0f);
+    }
+};
+#endif
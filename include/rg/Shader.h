@@ -12,9 +12,13 @@
 #include <sstream>
 #include <rg/Error.h>
 #include <common.h>
+#include <learnopengl/shader_source.h>
+#include <learnopengl/uniform_buffer.h>
+#include <learnopengl/uniform_table.h>
 #include <glm/glm.hpp>
 class Shader {
     unsigned int m_Id;
+    mutable UniformTable uniforms;
 public:
     Shader(std::string vertexShaderPath, std::string fragmentShaderPath) {
         appendShaderFolderIfNotPresent(vertexShaderPath);
@@ -22,7 +26,7 @@ public:
         // build and compile our shader program
         // ------------------------------------
         // vertex shader
-        std::string vsString = readFileContents(vertexShaderPath);
+        std::string vsString = ShaderSource::ExpandIncludes(readFileContents(vertexShaderPath), vertexShaderPath);
         ASSERT(!vsString.empty(), "Vertex shader source is empty!");
         const char* vertexShaderSource = vsString.c_str();
         int vertexShader = glCreateShader(GL_VERTEX_SHADER);
@@ -39,7 +43,7 @@ public:
         }
         // fragment shader
         int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-        std::string fsString = readFileContents(fragmentShaderPath);
+        std::string fsString = ShaderSource::ExpandIncludes(readFileContents(fragmentShaderPath), fragmentShaderPath);
         ASSERT(!fsString.empty(), "Fragment shader empty!");
         const char* fragmentShaderSource = fsString.c_str();
         glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
@@ -65,6 +69,8 @@ public:
         glDeleteShader(vertexShader);
         glDeleteShader(fragmentShader);
         m_Id = shaderProgram;
+        uniforms.Reflect(m_Id);
+        UniformBlock::Bind(m_Id);
     }
 
     // activate the shader
@@ -74,63 +80,88 @@ public:
         glUseProgram(m_Id);
     }
     // utility uniform functions
+    // uniforms are looked up in the table reflected at link time (see UniformTable): no location queries,
+    // and values the program already holds are not sent again
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    template <typename T>
+    Uniform<T> uniform(const char *name) const
     {
-        glUniform1i(glGetUniformLocation(m_Id, name.c_str()), (int)value);
+        return uniforms.Resolve<T>(name);
     }
+    template <typename T>
+    void set(Uniform<T> uniform, const typename Uniform<T>::Value &value) const
+    {
+        uniforms.Set(uniform.slot, value);
+    }
+    // ------------------------------------------------------------------------
+    void setBool(const char *name, bool value) const
+    {
+        uniforms.Set(uniforms.Find(name), value);
+    }
+    void setBool(const std::string &name, bool value) const { setBool(name.c_str(), value); }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(const char *name, int value) const
     {
-        glUniform1i(glGetUniformLocation(m_Id, name.c_str()), value);
+        uniforms.Set(uniforms.Find(name), value);
     }
+    void setInt(const std::string &name, int value) const { setInt(name.c_str(), value); }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(const char *name, float value) const
     {
-        glUniform1f(glGetUniformLocation(m_Id, name.c_str()), value);
+        uniforms.Set(uniforms.Find(name), value);
     }
+    void setFloat(const std::string &name, float value) const { setFloat(name.c_str(), value); }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    void setVec2(const char *name, const glm::vec2 &value) const
     {
-        glUniform2fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        uniforms.Set(uniforms.Find(name), value);
     }
-    void setVec2(const std::string &name, float x, float y) const
+    void setVec2(const char *name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(m_Id, name.c_str()), x, y);
+        setVec2(name, glm::vec2(x, y));
     }
+    void setVec2(const std::string &name, const glm::vec2 &value) const { setVec2(name.c_str(), value); }
+    void setVec2(const std::string &name, float x, float y) const { setVec2(name.c_str(), glm::vec2(x, y)); }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    void setVec3(const char *name, const glm::vec3 &value) const
     {
-        glUniform3fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        uniforms.Set(uniforms.Find(name), value);
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(const char *name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(m_Id, name.c_str()), x, y, z);
+        setVec3(name, glm::vec3(x, y, z));
     }
+    void setVec3(const std::string &name, const glm::vec3 &value) const { setVec3(name.c_str(), value); }
+    void setVec3(const std::string &name, float x, float y, float z) const { setVec3(name.c_str(), glm::vec3(x, y, z)); }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    void setVec4(const char *name, const glm::vec4 &value) const
     {
-        glUniform4fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        uniforms.Set(uniforms.Find(name), value);
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w)
+    void setVec4(const char *name, float x, float y, float z, float w) const
     {
-        glUniform4f(glGetUniformLocation(m_Id, name.c_str()), x, y, z, w);
+        setVec4(name, glm::vec4(x, y, z, w));
     }
+    void setVec4(const std::string &name, const glm::vec4 &value) const { setVec4(name.c_str(), value); }
+    void setVec4(const std::string &name, float x, float y, float z, float w) const { setVec4(name.c_str(), glm::vec4(x, y, z, w)); }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(const char *name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        uniforms.Set(uniforms.Find(name), mat);
     }
+    void setMat2(const std::string &name, const glm::mat2 &mat) const { setMat2(name.c_str(), mat); }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(const char *name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        uniforms.Set(uniforms.Find(name), mat);
     }
+    void setMat3(const std::string &name, const glm::mat3 &mat) const { setMat3(name.c_str(), mat); }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(const char *name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        uniforms.Set(uniforms.Find(name), mat);
     }
+    void setMat4(const std::string &name, const glm::mat4 &mat) const { setMat4(name.c_str(), mat); }
     void deleteProgram() {
         glDeleteProgram(m_Id);
         m_Id = 0;
@@ -0,0 +1,17 @@
+#version 330 core
+// the bright parts of the lit scene for the bloom blur, as lightingShader.fs writes them on the forward path
+layout (location = 0) out vec4 BrightColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+
+void main()
+{
+    vec3 color = texture(scene, TexCoords).rgb;
+    float brightness = dot(color, vec3(0.2126, 0.7152, 0.0722));
+    if(brightness > 1.0)
+        BrightColor = vec4(color, 1.0);
+    else
+        BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,37 @@
+// the light lists of ClusteredLights (clustered_lights.h), rebuilt every frame. Needs frame.glsl and lights.glsl.
+// CLUSTER_TILES_X, CLUSTER_TILES_Y and CLUSTER_SLICES have to match clustered_lights.h.
+#define CLUSTER_TILES_X 16
+#define CLUSTER_TILES_Y 9
+#define CLUSTER_SLICES 24
+
+uniform usamplerBuffer clusterGrid;         // first index and count per cluster
+uniform usamplerBuffer clusterLightIndices; // the lists of all clusters one after the other
+uniform samplerBuffer clusterLightData;     // 7 texels per light, laid out like SpotLight
+
+// the cluster of the fragment at fragCoord (gl_FragCoord.xy) with world space position worldPos
+uvec2 clusterLights(vec2 fragCoord, vec3 worldPos)
+{
+    // near and far plane of the perspective projection; slices are spaced exponentially between them
+    float nearPlane = projection[3][2] / (projection[2][2] - 1.0);
+    float farPlane = projection[3][2] / (projection[2][2] + 1.0);
+    float depth = -(view * vec4(worldPos, 1.0)).z;
+    int slice = clamp(int(log(depth / nearPlane) / log(farPlane / nearPlane) * float(CLUSTER_SLICES)), 0, CLUSTER_SLICES - 1);
+    ivec2 tile = clamp(ivec2(fragCoord * viewport.zw * vec2(CLUSTER_TILES_X, CLUSTER_TILES_Y)),
+                       ivec2(0), ivec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+    return texelFetch(clusterGrid, (slice * CLUSTER_TILES_Y + tile.y) * CLUSTER_TILES_X + tile.x).xy;
+}
+
+// the index'th light of the lists; w of its position is 0 for point lights and 1 for spot lights
+SpotLight clusterLight(uint index)
+{
+    int base = int(texelFetch(clusterLightIndices, int(index)).r) * 7;
+    SpotLight light;
+    light.position = texelFetch(clusterLightData, base);
+    light.direction = texelFetch(clusterLightData, base + 1);
+    light.ambient = texelFetch(clusterLightData, base + 2);
+    light.diffuse = texelFetch(clusterLightData, base + 3);
+    light.specular = texelFetch(clusterLightData, base + 4);
+    light.attenuation = texelFetch(clusterLightData, base + 5);
+    light.cutOff = texelFetch(clusterLightData, base + 6);
+    return light;
+}
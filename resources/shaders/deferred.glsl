@@ -0,0 +1,31 @@
+// the G-buffer written by gBuffer.fs, read by the light passes of DeferredRenderer (deferred_renderer.h).
+// Needs frame.glsl for inverseViewProjection.
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gSpecular; // shininess / 255 in alpha
+uniform sampler2D gDepth;
+
+struct Surface {
+    vec3 position;
+    vec3 normal;
+    vec3 albedo;
+    vec3 specular;
+    float shininess;
+};
+
+// the surface seen at uv (0..1 over the screen); false where no mesh was drawn
+bool readSurface(vec2 uv, out Surface surface)
+{
+    float depth = texture(gDepth, uv).r;
+    if (depth == 1.0)
+        return false;
+    // back from window to world space
+    vec4 position = inverseViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    surface.position = position.xyz / position.w;
+    surface.normal = normalize(texture(gNormal, uv).xyz);
+    surface.albedo = texture(gAlbedo, uv).rgb;
+    vec4 specular = texture(gSpecular, uv);
+    surface.specular = specular.rgb;
+    surface.shininess = specular.a * 255.0;
+    return true;
+}
@@ -0,0 +1,27 @@
+#version 330 core
+#include "frame.glsl"
+#include "lights.glsl"
+#include "deferred.glsl"
+// the directional light of the Lights block over the whole G-buffer, as CalcDirLight in lightingShader.fs
+layout (location = 0) out vec4 FragColor;
+
+in vec2 TexCoords;
+
+void main()
+{
+    Surface surface;
+    if (!readSurface(TexCoords, surface))
+        discard;
+    vec3 viewDir = normalize(viewPos - surface.position);
+    vec3 lightDir = normalize(-dirLight.direction.xyz);
+    // diffuse shading
+    float diff = max(dot(surface.normal, lightDir), 0.0);
+    // specular shading Blinn
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(surface.normal, halfwayDir), 0.0), surface.shininess);
+    // combine results
+    vec3 ambient = dirLight.ambient.rgb * surface.albedo;
+    vec3 diffuse = dirLight.diffuse.rgb * diff * surface.albedo;
+    vec3 specular = dirLight.specular.rgb * spec * surface.specular;
+    FragColor = vec4(ambient + diffuse + specular, 1.0);
+}
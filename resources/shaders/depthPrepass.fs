@@ -0,0 +1,19 @@
+#version 330 core
+// writes depth only; built with ALPHA_TEST for materials with alpha, which discard like lightingShader.fs
+#ifdef ALPHA_TEST
+struct Material {
+    sampler2D diffuse;
+};
+
+in vec2 TexCoords;
+
+uniform Material material;
+#endif
+
+void main()
+{
+#ifdef ALPHA_TEST
+    if(texture(material.diffuse, TexCoords).a < 0.5)
+        discard;
+#endif
+}
@@ -0,0 +1,39 @@
+#version 330 core
+#include "frame.glsl"
+// depth only pass in front of the lit scene (see DepthPrepass). The lit pass tests GL_EQUAL against these
+// depths, so the position math is exactly that of lightingShader.vs and gl_Position is invariant in both.
+layout (location = 0) in vec3 aPos;
+#ifdef ALPHA_TEST
+layout (location = 2) in vec2 aTexCoords;
+
+out vec2 TexCoords;
+#endif
+
+#ifdef INSTANCED
+// per instance model matrix (InstanceData in mesh.h)
+layout (location = 6) in mat4 instanceModel;
+#else
+uniform mat4 model;
+#endif
+
+// packed vertex format, see lightingShader.vs
+uniform bool packedVertex;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+uniform vec2 uvOffset;
+uniform vec2 uvScale;
+
+invariant gl_Position;
+
+void main()
+{
+    vec3 position = packedVertex ? positionOffset + aPos * positionScale : aPos;
+#ifdef INSTANCED
+    mat4 model = instanceModel;
+#endif
+    vec3 FragPos = vec3(model * vec4(position, 1.0));
+#ifdef ALPHA_TEST
+    TexCoords = packedVertex ? uvOffset + aTexCoords * uvScale : aTexCoords;
+#endif
+    gl_Position = viewProjection * vec4(FragPos, 1.0);
+}
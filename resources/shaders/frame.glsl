@@ -0,0 +1,10 @@
+// camera and timing data shared by all programs, written once per frame (FrameUniforms in uniform_buffer.h)
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    mat4 viewProjection;
+    vec3 viewPos;
+    float time;
+    vec4 viewport; // width, height, 1 / width, 1 / height
+    mat4 inverseViewProjection; // clip space back to world space, e.g. to rebuild positions from depth
+};
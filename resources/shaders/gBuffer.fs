@@ -0,0 +1,27 @@
+#version 330 core
+// geometry pass of DeferredRenderer: what lightingShader.fs would light, stored per pixel
+layout (location = 0) out vec4 gAlbedo;
+layout (location = 1) out vec4 gNormal;
+layout (location = 2) out vec4 gSpecular;
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    float shininess;
+};
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+
+uniform Material material;
+
+void main()
+{
+    vec4 diffuse = texture(material.diffuse, TexCoords);
+    if(diffuse.a < 0.5)
+        discard;
+    gAlbedo = vec4(diffuse.rgb, 1.0);
+    gNormal = vec4(normalize(Normal), 0.0);
+    gSpecular = vec4(texture(material.specular, TexCoords).rgb, material.shininess / 255.0);
+}
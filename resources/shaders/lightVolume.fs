@@ -0,0 +1,44 @@
+#version 330 core
+#include "frame.glsl"
+#include "deferred.glsl"
+// adds one light to the G-buffer pixels its volume covers, as CalcPointLight (CalcSpotLight with SPOT) in
+// lightingShader.fs
+layout (location = 0) out vec4 FragColor;
+
+flat in vec4 lightPosition;
+flat in vec4 lightDirection;
+flat in vec3 lightAmbient;
+flat in vec3 lightDiffuse;
+flat in vec3 lightSpecular;
+flat in vec4 lightAttenuation;
+
+void main()
+{
+    Surface surface;
+    if (!readSurface(gl_FragCoord.xy * viewport.zw, surface))
+        discard;
+    float distance = length(lightPosition.xyz - surface.position);
+    // past the range the light adds less than the volume was sized for
+    if (distance > lightPosition.w)
+        discard;
+    vec3 lightDir = (lightPosition.xyz - surface.position) / distance;
+    vec3 viewDir = normalize(viewPos - surface.position);
+    // diffuse shading
+    float diff = max(dot(surface.normal, lightDir), 0.0);
+    // specular shading Blinn
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(surface.normal, halfwayDir), 0.0), surface.shininess);
+    // attenuation
+    float attenuation = 1.0 / (lightAttenuation.x + lightAttenuation.y * distance + lightAttenuation.z * (distance * distance));
+#ifdef SPOT
+    // spotlight intensity
+    float theta = dot(lightDir, normalize(-lightDirection.xyz));
+    float epsilon = lightAttenuation.w - lightDirection.w;
+    attenuation *= clamp((theta - lightDirection.w) / epsilon, 0.0, 1.0);
+#endif
+    // combine results
+    vec3 ambient = lightAmbient * surface.albedo;
+    vec3 diffuse = lightDiffuse * diff * surface.albedo;
+    vec3 specular = lightSpecular * spec * surface.specular;
+    FragColor = vec4((ambient + diffuse + specular) * attenuation, 1.0);
+}
@@ -0,0 +1,30 @@
+#version 330 core
+#include "frame.glsl"
+// one point light (or spot light with SPOT) per instance, drawn as the sphere (cone) its range covers
+layout (location = 0) in vec3 aPos;
+// LightVolume in deferred_renderer.h
+layout (location = 1) in mat4 aVolume;
+layout (location = 5) in vec4 aPosition;    // w: range
+layout (location = 6) in vec4 aDirection;   // w: cosine of the outer cone angle
+layout (location = 7) in vec4 aAmbient;
+layout (location = 8) in vec4 aDiffuse;
+layout (location = 9) in vec4 aSpecular;
+layout (location = 10) in vec4 aAttenuation; // constant, linear, quadratic; w: cosine of the inner cone angle
+
+flat out vec4 lightPosition;
+flat out vec4 lightDirection;
+flat out vec3 lightAmbient;
+flat out vec3 lightDiffuse;
+flat out vec3 lightSpecular;
+flat out vec4 lightAttenuation;
+
+void main()
+{
+    lightPosition = aPosition;
+    lightDirection = aDirection;
+    lightAmbient = aAmbient.rgb;
+    lightDiffuse = aDiffuse.rgb;
+    lightSpecular = aSpecular.rgb;
+    lightAttenuation = aAttenuation;
+    gl_Position = viewProjection * aVolume * vec4(aPos, 1.0);
+}
@@ -1,4 +1,5 @@
 #version 330 core
+#include "frame.glsl"
 layout (location = 0) out vec4 FragColor;
 layout (location = 1) out vec4 BrightColor;
 
@@ -8,52 +9,15 @@ struct Material {
     float shininess;
 };
 
-struct DirLight {
-    vec3 direction;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct PointLight {
-    vec3 position;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct SpotLight {
-    vec3 position;
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-#define NR_POINT_LIGHTS 4
+#include "lights.glsl"
+#ifdef CLUSTERED
+#include "clusters.glsl"
+#endif
 
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
 
-uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform PointLight pointLight[4];
-uniform SpotLight spotLight1;
-uniform SpotLight spotLight2;
 uniform Material material;
 
 // function prototypes
@@ -75,13 +39,26 @@ void main()
     // == =====================================================
     // phase 1: directional lighting
     vec3 result = CalcDirLight(dirLight, norm, viewDir);
-    // phase 2: point light
-    for(int i = 0; i < 4; i ++) {
-        result += CalcPointLight(pointLight[i], norm, FragPos, viewDir);
+#ifdef CLUSTERED
+    // phases 2 and 3: only the point and spot lights binned into this fragment's cluster
+    uvec2 cluster = clusterLights(gl_FragCoord.xy, FragPos);
+    for(uint i = cluster.x; i < cluster.x + cluster.y; i ++) {
+        SpotLight light = clusterLight(i);
+        if(light.position.w == 0.0)
+            result += CalcPointLight(PointLight(light.position, light.ambient, light.diffuse, light.specular, light.attenuation), norm, FragPos, viewDir);
+        else
+            result += CalcSpotLight(light, norm, FragPos, viewDir);
+    }
+#else
+    // phase 2: point lights
+    for(int i = 0; i < lightCounts.x; i ++) {
+        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
     }
     // phase 3: spot lights
-    result += CalcSpotLight(spotLight1, norm, FragPos, viewDir);
-    result += CalcSpotLight(spotLight2, norm, FragPos, viewDir);
+    for(int i = 0; i < lightCounts.y; i ++) {
+        result += CalcSpotLight(spotLights[i], norm, FragPos, viewDir);
+    }
+#endif
 
     FragColor = vec4(result, 1.0);
 
@@ -95,16 +72,16 @@ void main()
 // calculates the color when using a directional light.
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
 {
-    vec3 lightDir = normalize(-light.direction);
+    vec3 lightDir = normalize(-light.direction.xyz);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading Blinn
     vec3 halfwayDir = normalize(lightDir + viewDir);
     float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = light.ambient.rgb * vec3(texture(material.diffuse, TexCoords));
+    vec3 diffuse = light.diffuse.rgb * diff * vec3(texture(material.diffuse, TexCoords));
+    vec3 specular = light.specular.rgb * spec * vec3(texture(material.specular, TexCoords));
 
     if(texture(material.diffuse, TexCoords).a < 0.5)
             discard;
@@ -115,19 +92,19 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
 // calculates the color when using a point light.
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
-    vec3 lightDir = normalize(light.position - fragPos);
+    vec3 lightDir = normalize(light.position.xyz - fragPos);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading Blinn
     vec3 halfwayDir = normalize(lightDir + viewDir);
     float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
     // attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    float distance = length(light.position.xyz - fragPos);
+    float attenuation = 1.0 / (light.attenuation.x + light.attenuation.y * distance + light.attenuation.z * (distance * distance));
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = light.ambient.rgb * vec3(texture(material.diffuse, TexCoords));
+    vec3 diffuse = light.diffuse.rgb * diff * vec3(texture(material.diffuse, TexCoords));
+    vec3 specular = light.specular.rgb * spec * vec3(texture(material.specular, TexCoords));
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -141,23 +118,23 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 // calculates the color when using a spot light.
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
-    vec3 lightDir = normalize(light.position - fragPos);
+    vec3 lightDir = normalize(light.position.xyz - fragPos);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading Blinn
     vec3 halfwayDir = normalize(lightDir + viewDir);
     float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
     // attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    float distance = length(light.position.xyz - fragPos);
+    float attenuation = 1.0 / (light.attenuation.x + light.attenuation.y * distance + light.attenuation.z * (distance * distance));
     // spotlight intensity
-    float theta = dot(lightDir, normalize(-light.direction));
-    float epsilon = light.cutOff - light.outerCutOff;
-    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    float theta = dot(lightDir, normalize(-light.direction.xyz));
+    float epsilon = light.cutOff.x - light.cutOff.y;
+    float intensity = clamp((theta - light.cutOff.y) / epsilon, 0.0, 1.0);
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = light.ambient.rgb * vec3(texture(material.diffuse, TexCoords));
+    vec3 diffuse = light.diffuse.rgb * diff * vec3(texture(material.diffuse, TexCoords));
+    vec3 specular = light.specular.rgb * spec * vec3(texture(material.specular, TexCoords));
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
     specular *= attenuation * intensity;
@@ -1,4 +1,5 @@
 #version 330 core
+#include "frame.glsl"
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
@@ -7,14 +8,45 @@ out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
 
+#ifdef INSTANCED
+// per instance model matrix and its normal matrix, computed on the CPU (InstanceData in mesh.h)
+layout (location = 6) in mat4 instanceModel;
+layout (location = 10) in mat3 instanceNormalMatrix;
+#else
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#endif
+
+// set while drawing meshes in the packed vertex format (see PackedVertex in vertex_format.h):
+// positions and uvs are normalized to the mesh bounds, normals are octahedral encoded in xy
+uniform bool packedVertex;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+uniform vec2 uvOffset;
+uniform vec2 uvScale;
+
+// the depth pre-pass (depthPrepass.vs) has to produce the same depths for the GL_EQUAL test
+invariant gl_Position;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
-    TexCoords = aTexCoords;
-    gl_Position = projection * view * vec4(FragPos, 1.0);
+    vec3 position = packedVertex ? positionOffset + aPos * positionScale : aPos;
+    vec3 normal = packedVertex ? octDecode(aNormal.xy) : aNormal;
+#ifdef INSTANCED
+    mat4 model = instanceModel;
+    mat3 normalMatrix = instanceNormalMatrix;
+#else
+    mat3 normalMatrix = mat3(transpose(inverse(model)));
+#endif
+    FragPos = vec3(model * vec4(position, 1.0));
+    Normal = normalMatrix * normal;
+    TexCoords = packedVertex ? uvOffset + aTexCoords * uvScale : aTexCoords;
+    gl_Position = viewProjection * vec4(FragPos, 1.0);
 }
@@ -0,0 +1,46 @@
+#version 430 core
+#include "frame.glsl"
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+// index of this draw's record: the baseInstance of its indirect command (see GeometryArena in multi_draw.h)
+layout (location = 5) in uint aDrawId;
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+
+// per draw data of the multi-draw path (DrawData in multi_draw.h), the uniforms of lightingShader.vs
+struct Draw {
+    mat4 model;
+    vec4 normalMatrix[3]; // transpose(inverse(mat3(model))) by column, computed on the CPU
+    vec4 positionOffset; // w: 1 for meshes in the packed vertex format (see PackedVertex in vertex_format.h)
+    vec4 positionScale;
+    vec4 uvOffsetScale;  // uv offset in xy, scale in zw
+};
+layout (std430, binding = 0) readonly buffer Draws {
+    Draw draws[];
+};
+
+// the depth pre-pass (depthPrepass.vs) has to produce the same depths for the GL_EQUAL test
+invariant gl_Position;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+void main()
+{
+    Draw draw = draws[aDrawId];
+    bool packedVertex = draw.positionOffset.w != 0.0;
+    vec3 position = packedVertex ? draw.positionOffset.xyz + aPos * draw.positionScale.xyz : aPos;
+    vec3 normal = packedVertex ? octDecode(aNormal.xy) : aNormal;
+    FragPos = vec3(draw.model * vec4(position, 1.0));
+    Normal = mat3(draw.normalMatrix[0].xyz, draw.normalMatrix[1].xyz, draw.normalMatrix[2].xyz) * normal;
+    TexCoords = packedVertex ? draw.uvOffsetScale.xy + aTexCoords * draw.uvOffsetScale.zw : aTexCoords;
+    gl_Position = viewProjection * vec4(FragPos, 1.0);
+}
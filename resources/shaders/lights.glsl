@@ -0,0 +1,36 @@
+// every light of the scene, uploaded by LightManager (light_manager.h) whenever a light changes.
+// MAX_POINT_LIGHTS and MAX_SPOT_LIGHTS have to match light_manager.h.
+#define MAX_POINT_LIGHTS 64
+#define MAX_SPOT_LIGHTS 16
+
+struct DirLight {
+    vec4 direction;
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+};
+
+struct PointLight {
+    vec4 position;
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+    vec4 attenuation; // constant, linear, quadratic
+};
+
+struct SpotLight {
+    vec4 position;
+    vec4 direction;
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+    vec4 attenuation; // constant, linear, quadratic
+    vec4 cutOff;      // cosines of the inner and outer cone angles
+};
+
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    ivec4 lightCounts; // point lights, spot lights
+    PointLight pointLights[MAX_POINT_LIGHTS];
+    SpotLight spotLights[MAX_SPOT_LIGHTS];
+};
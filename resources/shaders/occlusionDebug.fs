@@ -0,0 +1,15 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// 1 / w of the nearest occluder per pixel, 0 where there is none (see OcclusionCuller)
+uniform sampler2D depthBuffer;
+uniform float farPlane;
+
+void main()
+{
+    float inverseW = texture(depthBuffer, TexCoords).r;
+    float distance = inverseW > 0.0 ? 1.0 / inverseW : farPlane;
+    FragColor = vec4(vec3(1.0 - min(distance / farPlane, 1.0)), 1.0);
+}
@@ -5,10 +5,24 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader_m.h>
+#include <learnopengl/clustered_lights.h>
+#include <learnopengl/deferred_renderer.h>
+#include <learnopengl/depth_prepass.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/uniform_buffer.h>
 #include <learnopengl/camera.h>
+#include <learnopengl/light_manager.h>
+#include <learnopengl/ground.h>
 #include <learnopengl/model.h>
+#include <learnopengl/model_loader.h>
+#include <learnopengl/multi_draw.h>
+#include <learnopengl/occlusion.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/scene.h>
 
 #include <iostream>
+#include <memory>
 #include <string>
 
 #include "learnopengl/filesystem.h"
@@ -30,6 +44,28 @@ const unsigned int SCR_HEIGHT = 900;
 bool bloom = true;
 bool bloomKeyPressed = false;
 float exposure = 1.0f;
+// draw the scene with glMultiDrawElementsIndirect when the context is GL 4.3+ (see MultiDrawRenderer)
+bool multiDrawIndirect = true;
+// check the GL state cache against the real GL state (slow, see GLState::SetVerify)
+bool verifyGLState = false;
+// skip meshes hidden behind the tanks, the watchtower and the forest (see OcclusionCuller); O shows its buffer
+bool occlusionCulling = true;
+bool showOcclusionBuffer = false;
+bool occlusionKeyPressed = false;
+// lay down the scene's depth first so the lit pass shades every pixel once (see DepthPrepass); P toggles it
+bool depthPrepass = true;
+bool prepassKeyPressed = false;
+// light the scene from a G-buffer with one volume per light instead of in the forward pass (see DeferredRenderer);
+// off by default, so the forward path with the depth pre-pass and clustered lights runs; G toggles it
+bool deferredShading = false;
+bool deferredKeyPressed = false;
+// without deferred shading, light each fragment only with the lights binned into its cluster (see ClusteredLights);
+// C toggles it
+bool clusteredShading = true;
+bool clusteredKeyPressed = false;
+// add 192 lamps along the base's fence. The forward Lights block only holds the first 64 point lights, so they
+// are meant for clustered or deferred shading, where each lamp only costs the pixels it reaches
+bool fenceLamps = false;
 
 // camera
 Camera camera(glm::vec3(0.0f, 0.0f, 0.0f));
@@ -46,7 +82,8 @@ int main()
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    // 4.3 for the multi-draw path if the driver has it, 3.3 otherwise
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
@@ -58,6 +95,12 @@ int main()
     // --------------------
     GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Military Base", NULL, NULL);
     if (window == NULL)
+    {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Military Base", NULL, NULL);
+    }
+    if (window == NULL)
     {
         std::cout << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -78,13 +121,18 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    multiDrawIndirect = multiDrawIndirect && MultiDraw::Load((GLADloadproc)glfwGetProcAddress);
+    std::cout << "multi-draw-indirect: " << (multiDrawIndirect ? "on" : "off") << std::endl;
 
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     // stbi_set_flip_vertically_on_load(true);
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
+    // every bind and state change goes through GLState, which drops the ones that change nothing
+    GLState &glState = GLState::Shared();
+    glState.SetVerify(verifyGLState);
+    glState.Enable(GL_DEPTH_TEST);
 
     //glEnable(GL_CULL_FACE);
 
@@ -94,19 +142,96 @@ int main()
     Shader lightCubeShader("resources/shaders/lightingShader.vs", "resources/shaders/lightCubeShader.fs");
     Shader blurShader("resources/shaders/blur.vs", "resources/shaders/blur.fs");
     Shader bloomShader("resources/shaders/bloom.vs", "resources/shaders/bloom.fs");
+    Shader occlusionDebugShader("resources/shaders/bloom.vs", "resources/shaders/occlusionDebug.fs");
+    // models placed more than once: per instance transforms and normal matrices from an instance buffer
+    Shader instancedLightingShader("resources/shaders/lightingShader.vs", "resources/shaders/lightingShader.fs", {"INSTANCED"});
+    // depth pre-pass: positions only, and the alpha tested variant for materials that discard texels
+    Shader depthShader("resources/shaders/depthPrepass.vs", "resources/shaders/depthPrepass.fs");
+    Shader alphaTestedDepthShader("resources/shaders/depthPrepass.vs", "resources/shaders/depthPrepass.fs", {"ALPHA_TEST"});
+    Shader instancedDepthShader("resources/shaders/depthPrepass.vs", "resources/shaders/depthPrepass.fs", {"INSTANCED"});
+    Shader instancedAlphaTestedDepthShader("resources/shaders/depthPrepass.vs", "resources/shaders/depthPrepass.fs", {"INSTANCED", "ALPHA_TEST"});
+    // the lit scene on the multi-draw path: per draw data from a shader storage buffer instead of uniforms
+    std::unique_ptr<Shader> multiDrawShader;
+    if (multiDrawIndirect)
+        multiDrawShader.reset(new Shader("resources/shaders/lightingShaderIndirect.vs", "resources/shaders/lightingShader.fs"));
+    // the lit scene's variants for clustered forward shading: every light, looked up per cluster
+    Shader clusteredLightingShader("resources/shaders/lightingShader.vs", "resources/shaders/lightingShader.fs", {"CLUSTERED"});
+    Shader instancedClusteredLightingShader("resources/shaders/lightingShader.vs", "resources/shaders/lightingShader.fs", {"INSTANCED", "CLUSTERED"});
+    std::unique_ptr<Shader> multiDrawClusteredShader;
+    if (multiDrawIndirect)
+        multiDrawClusteredShader.reset(new Shader("resources/shaders/lightingShaderIndirect.vs", "resources/shaders/lightingShader.fs", {"CLUSTERED"}));
+    // deferred shading: the geometry pass in the variants of the lit scene, the directional light, the light
+    // volumes and the bloom input
+    Shader gBufferShader("resources/shaders/lightingShader.vs", "resources/shaders/gBuffer.fs");
+    Shader instancedGBufferShader("resources/shaders/lightingShader.vs", "resources/shaders/gBuffer.fs", {"INSTANCED"});
+    std::unique_ptr<Shader> multiDrawGBufferShader;
+    if (multiDrawIndirect)
+        multiDrawGBufferShader.reset(new Shader("resources/shaders/lightingShaderIndirect.vs", "resources/shaders/gBuffer.fs"));
+    Shader deferredDirectionalShader("resources/shaders/bloom.vs", "resources/shaders/deferredDirectional.fs");
+    Shader pointLightVolumeShader("resources/shaders/lightVolume.vs", "resources/shaders/lightVolume.fs");
+    Shader spotLightVolumeShader("resources/shaders/lightVolume.vs", "resources/shaders/lightVolume.fs", {"SPOT"});
+    Shader brightPassShader("resources/shaders/bloom.vs", "resources/shaders/brightPass.fs");
+    // camera data of every program (the Frame block in resources/shaders/frame.glsl), written once per frame
+    UniformRingBuffer frameUniformBuffer(UniformBlock::FrameBinding, sizeof(FrameUniforms));
+
+    // load models
+    // importing and texture decoding run on worker threads while the rest of the scene is set up
+    // textures are shared between all models
+    // vertices are packed to 16 bytes and only carry what the model shader reads
+    Model::GpuVertexFormat().attributes = VertexFormat::ConsumedAttributes(lightingShader);
+    ModelLoader modelLoader;
+    Model t10mModel;
+    modelLoader.Load(t10mModel, FileSystem::getPath("resources/objects/tank_t10m/tank_t10m.obj"));
+    t10mModel.SetShaderTextureNamePrefix("material.");
+
+    Model ammoBoxModel;
+    modelLoader.Load(ammoBoxModel, FileSystem::getPath("resources/objects/ammo_box/ammo_box.obj"));
+    ammoBoxModel.SetShaderTextureNamePrefix("material.");
+
+    Model watchtowerModel;
+    modelLoader.Load(watchtowerModel, FileSystem::getPath("resources/objects/watchtower/watchtower.obj"));
+    watchtowerModel.SetShaderTextureNamePrefix("material.");
+
+    Model cratesAndBarrelsModel;
+    modelLoader.Load(cratesAndBarrelsModel, FileSystem::getPath("resources/objects/crates_and_barrels/crates_and_barrels.obj"));
+    cratesAndBarrelsModel.SetShaderTextureNamePrefix("material.");
+
+    Model kv2Model;
+    modelLoader.Load(kv2Model, FileSystem::getPath("resources/objects/kv2/kv2.obj"));
+    kv2Model.SetShaderTextureNamePrefix("material.");
+
+    Model oilDrumsModel;
+    modelLoader.Load(oilDrumsModel, FileSystem::getPath("resources/objects/oil_drums/oil_drums.obj"));
+    oilDrumsModel.SetShaderTextureNamePrefix("material.");
+
+    Model rustyOilBarrelsModel;
+    modelLoader.Load(rustyOilBarrelsModel, FileSystem::getPath("resources/objects/rusty_oil_barrels/rusty_oil_barrels.obj"));
+    rustyOilBarrelsModel.SetShaderTextureNamePrefix("material.");
+
+    Model reflectorModel;
+    modelLoader.Load(reflectorModel, FileSystem::getPath("resources/objects/reflector/reflector.obj"));
+    reflectorModel.SetShaderTextureNamePrefix("material.");
+
+    Model forestModel;
+    modelLoader.Load(forestModel, FileSystem::getPath("resources/objects/forest/forest.obj"));
+    forestModel.SetShaderTextureNamePrefix("material.");
+
+    Model challenger2Model;
+    modelLoader.Load(challenger2Model, FileSystem::getPath("resources/objects/challenger2_shooting_range/challenger2_shooting_range.obj"));
+    challenger2Model.SetShaderTextureNamePrefix("material.");
 
     // configure (floating point) framebuffers
     // ---------------------------------------
     unsigned int hdrFBO;
     glGenFramebuffers(1, &hdrFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+    glState.BindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
     std::cout << "Prosao" << std::endl;
     // create 2 floating point color buffers (1 for normal rendering, other for brightness threshold values)
     unsigned int colorBuffers[2];
     glGenTextures(2, colorBuffers);
     for (unsigned int i = 0; i < 2; i++)
     {
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
+        glState.BindTexture(0, GL_TEXTURE_2D, colorBuffers[i]);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -127,7 +252,7 @@ int main()
     // finally check if framebuffer is complete
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glState.BindFramebuffer(GL_FRAMEBUFFER, 0);
 
     // ping-pong-framebuffer for blurring
     unsigned int pingpongFBO[2];
@@ -136,8 +261,8 @@ int main()
     glGenTextures(2, pingpongColorbuffers);
     for (unsigned int i = 0; i < 2; i++)
     {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
+        glState.BindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
+        glState.BindTexture(0, GL_TEXTURE_2D, pingpongColorbuffers[i]);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -150,19 +275,6 @@ int main()
     }
 
     // ground vertices
-    float groundVertices[] = {
-            // positions          // normals        //texCoords
-            0.5f,  0.5f,  0.0f,   0.0f, 0.0f, -1.0f, 1.0f,  1.0f,     // top right
-            0.5f, -0.5f,  0.0f,   0.0f, 0.0f, -1.0f, 1.0f,  0.0f,     // bottom right
-            -0.5f, -0.5f,  0.0f,  0.0f, 0.0f, -1.0f, 0.0f,  0.0f,     // bottom left
-            -0.5f,  0.5f,  0.0f,  0.0f, 0.0f, -1.0f, 0.0f,  1.0f      // top left
-    };
-
-    unsigned int groundIndices[] = {
-            0, 1, 3,  // first Triangle
-            1, 2, 3   // second Triangle
-    };
-
     // skybox vertices
     float skyboxVertices[] = {
             // positions
@@ -211,29 +323,8 @@ int main()
 
 
 
-    // ground VAO
-    unsigned int groundVAO, groundVBO, groundEBO;
-    glGenVertexArrays(1, &groundVAO);
-    glGenBuffers(1, &groundVBO);
-    glGenBuffers(1, &groundEBO);
-
-    glBindVertexArray(groundVAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, groundVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(groundVertices), groundVertices, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, groundEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(groundIndices), groundIndices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    // ground: GROUND_DIMENSION x GROUND_DIMENSION tiles of 2 units, one static mesh drawn with a single call
+    Ground ground(GROUND_DIMENSION, 2.0f, -2.0f);
 
     unsigned int diffuseGround = loadTexture(FileSystem::getPath("resources/textures/tough_grass.jpg").c_str());
 
@@ -241,7 +332,7 @@ int main()
     unsigned int skyboxVAO, skyboxVBO;
     glGenVertexArrays(1, &skyboxVAO);
     glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
+    glState.BindVertexArray(skyboxVAO);
     glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
@@ -261,36 +352,10 @@ int main()
     skyboxShader.use();
     skyboxShader.setInt("skybox", 0);
 
-    // load models
-    Model t10mModel(FileSystem::getPath("resources/objects/tank_t10m/tank_t10m.obj"));
-    t10mModel.SetShaderTextureNamePrefix("material.");
-
-    Model ammoBoxModel(FileSystem::getPath("resources/objects/ammo_box/ammo_box.obj"));
-    ammoBoxModel.SetShaderTextureNamePrefix("material.");
-
-    Model watchtowerModel(FileSystem::getPath("resources/objects/watchtower/watchtower.obj"));
-    watchtowerModel.SetShaderTextureNamePrefix("material.");
-
-    Model cratesAndBarrelsModel(FileSystem::getPath("resources/objects/crates_and_barrels/crates_and_barrels.obj"));
-    cratesAndBarrelsModel.SetShaderTextureNamePrefix("material.");
-
-    Model kv2Model(FileSystem::getPath("resources/objects/kv2/kv2.obj"));
-    kv2Model.SetShaderTextureNamePrefix("material.");
-
-    Model oilDrumsModel(FileSystem::getPath("resources/objects/oil_drums/oil_drums.obj"));
-    oilDrumsModel.SetShaderTextureNamePrefix("material.");
-
-    Model rustyOilBarrelsModel(FileSystem::getPath("resources/objects/rusty_oil_barrels/rusty_oil_barrels.obj"));
-    rustyOilBarrelsModel.SetShaderTextureNamePrefix("material.");
-
-    Model reflectorModel(FileSystem::getPath("resources/objects/reflector/reflector.obj"));
-    reflectorModel.SetShaderTextureNamePrefix("material.");
-
-    Model forestModel(FileSystem::getPath("resources/objects/forest/forest.obj"));
-    forestModel.SetShaderTextureNamePrefix("material.");
-
-    Model challenger2Model(FileSystem::getPath("resources/objects/challenger2_shooting_range/challenger2_shooting_range.obj"));
-    challenger2Model.SetShaderTextureNamePrefix("material.");
+    // wait for the models queued right after startup; their meshes and textures are created here on the GL thread.
+    // this also finishes the ground and skybox textures requested above.
+    modelLoader.Finish();
+    TextureRegistry::Shared().Report();
 
     // draw in wireframe
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -314,14 +379,226 @@ int main()
     lightColor.push_back(glm::vec3(0.2f, 0.0f, 0.0f));
     lightColor.push_back(glm::vec3(0.0f, 0.2f, 0.0f));
 
-    lightingShader.use();
-    lightingShader.setInt("material.diffuse", 0);
-    lightingShader.setInt("material.specular", 1);
+    // the lights never move: they are uploaded once and the lighting shader loops over however many there are
+    LightManager lights;
+    DirectionalLight sun;
+    sun.direction = glm::vec3(-1.0f, -1.0f, -1.0f);
+    sun.ambient = glm::vec3(0.005f);
+    sun.diffuse = glm::vec3(0.005f);
+    sun.specular = glm::vec3(0.1f);
+    lights.SetDirectional(sun);
+    for (size_t i = 0; i < lightCubePositions.size(); i++)
+    {
+        PointLight pointLight;
+        pointLight.position = lightCubePositions[i];
+        pointLight.ambient = lightColor[i];
+        pointLight.diffuse = lightColor[i];
+        pointLight.specular = glm::vec3(0.1f);
+        pointLight.constant = 1.0f;
+        pointLight.linear = 0.7f;
+        pointLight.quadratic = 1.8f;
+        lights.AddPointLight(pointLight);
+    }
+    // reflector spotlights
+    for (float side : {-1.0f, 1.0f})
+    {
+        SpotLight reflector;
+        reflector.position = glm::vec3(10.0f * side, 5.5f, -3.0f);
+        reflector.direction = glm::vec3(-11.0f * side, -5.5f, -11.0f);
+        reflector.ambient = glm::vec3(0.1f);
+        reflector.diffuse = glm::vec3(0.5f);
+        reflector.specular = glm::vec3(1.0f);
+        reflector.constant = 1.0f;
+        reflector.linear = 0.045f;
+        reflector.quadratic = 0.0075f;
+        reflector.cutOff = glm::cos(glm::radians(28.0f));
+        reflector.outerCutOff = glm::cos(glm::radians(30.0f));
+        lights.AddSpotLight(reflector);
+    }
+    // lamps along the fence around the base (see fenceLamps)
+    const glm::vec3 fenceCorners[4] = {glm::vec3(-30.0f, -1.5f, 5.0f), glm::vec3(-30.0f, -1.5f, -55.0f),
+                                       glm::vec3(30.0f, -1.5f, -55.0f), glm::vec3(30.0f, -1.5f, 5.0f)};
+    const int lampsPerSide = fenceLamps ? 48 : 0;
+    for (int i = 0; i < 4 * lampsPerSide; i++)
+    {
+        int side = i / lampsPerSide;
+        PointLight lamp;
+        lamp.position = glm::mix(fenceCorners[side], fenceCorners[(side + 1) % 4], (float)(i % lampsPerSide) / lampsPerSide);
+        lamp.ambient = glm::vec3(0.0f);
+        lamp.diffuse = glm::vec3(1.0f, 0.6f, 0.25f);
+        lamp.specular = glm::vec3(0.2f);
+        lamp.constant = 1.0f;
+        lamp.linear = 0.7f;
+        lamp.quadratic = 1.8f;
+        lights.AddPointLight(lamp);
+    }
+
+    // the models placed in the world; their transforms never change
+    Scene scene;
+    // tank t10m
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(0.0f, -2.0f, -10.0f));
+    model = glm::rotate(model, glm::radians(135.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    scene.Add(t10mModel, model);
+
+    // tank kv2
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(-8.0f, -2.0f, -25.0f));
+    model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    model = glm::scale(model, glm::vec3(1.5f, 1.5f, 1.5f));
+    size_t kv2Object = scene.Add(kv2Model, model);
+
+    // tank challenger2
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(10.0f, -2.0f, -25.0f));
+    model = glm::scale(model, glm::vec3(1.4f, 1.4f, 1.4f));
+    scene.Add(challenger2Model, model);
+
+    // ammo boxes
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(10.0f, -2.0f, -16.0f));
+    model = glm::scale(model, glm::vec3(0.04f, 0.04f, 0.04f));
+    scene.Add(ammoBoxModel, model);
+
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(11.34f, -2.0f, -15.57f));
+    model = glm::rotate(model, glm::radians(-30.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    model = glm::scale(model, glm::vec3(0.04f, 0.04f, 0.04f));
+    scene.Add(ammoBoxModel, model);
+
+    // watchtower
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(-9.0f, -2.0f, -17.0f));
+    model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    model = glm::scale(model, glm::vec3(0.05f, 0.05f, 0.05f));
+    size_t watchtowerObject = scene.Add(watchtowerModel, model);
+
+    // crates and barrels
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(-9.0f, -2.0f, -10.0f));
+    model = glm::scale(model, glm::vec3(1.2f, 1.2f, 1.2f));
+    scene.Add(cratesAndBarrelsModel, model);
+
+    // oil drums
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(10.0f, -2.0f, -7.0f));
+    scene.Add(oilDrumsModel, model);
+
+    // rusty oil barrels
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(10.0f, -2.0f, -10.0f));
+    model = glm::scale(model, glm::vec3(0.004f, 0.004f, 0.004f));
+    scene.Add(rustyOilBarrelsModel, model);
+
+    // reflector
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(-10.0f, -2.0f, -3.0f));
+    model = glm::rotate(model, glm::radians(135.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    scene.Add(reflectorModel, model);
+
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(10.0f, -2.0f, -3.0f));
+    model = glm::rotate(model, glm::radians(-135.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    scene.Add(reflectorModel, model);
+
+    // forest
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(-38.0f, -2.0f, -10.0f));
+    scene.Add(forestModel, model);
+
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(-16.5f, -2.0f, -50.0f));
+    model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    scene.Add(forestModel, model);
+
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(30.5f, -2.0f, -50.0f));
+    model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    scene.Add(forestModel, model);
+
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(38.0f, -2.0f, 0.0f));
+    model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    scene.Add(forestModel, model);
+
+    std::cout << "frustum culling: " << CpuFeatures::Name(FrustumCuller::Active()) << std::endl;
+
+    // simplified occluders: one box inside each model that hides things, as fractions of the model's bounds.
+    // They are placed once the model has loaded, for every object showing it.
+    struct OccluderBox {
+        Model *model;
+        glm::vec3 from, to;
+        bool placed;
+    };
+    std::vector<OccluderBox> occluderBoxes = {
+        {&t10mModel, glm::vec3(0.2f, 0.1f, 0.2f), glm::vec3(0.8f, 0.45f, 0.8f), false},
+        {&kv2Model, glm::vec3(0.2f, 0.1f, 0.2f), glm::vec3(0.8f, 0.45f, 0.8f), false},
+        {&challenger2Model, glm::vec3(0.2f, 0.1f, 0.2f), glm::vec3(0.8f, 0.45f, 0.8f), false},
+        {&watchtowerModel, glm::vec3(0.3f, 0.65f, 0.3f), glm::vec3(0.7f, 0.85f, 0.7f), false}, // the cabin
+        {&forestModel, glm::vec3(0.35f, 0.0f, 0.05f), glm::vec3(0.65f, 0.3f, 0.95f), false}    // trunks along z
+    };
+    OcclusionCuller occlusion;
+    std::cout << "occlusion culling: " << (occlusionCulling ? CpuFeatures::Name(OcclusionCuller::Active()) : "off")
+              << ", " << OcclusionCuller::Width << "x" << OcclusionCuller::Height << std::endl;
+    // the occlusion buffer as shown by the debug view
+    unsigned int occlusionTexture;
+    glGenTextures(1, &occlusionTexture);
+    glState.BindTexture(0, GL_TEXTURE_2D, occlusionTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, OcclusionCuller::Width, OcclusionCuller::Height, 0, GL_RED, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    RenderQueue renderQueue;
+    RenderQueue depthQueue;
+    DepthPrepass prepass;
+    // materials lightingShader.fs may discard texels of go through the alpha tested pre-pass
+    auto cutout = [&prepass](const RenderMaterial &material) { return prepass.Cutout(material); };
+    // lights colorBuffers[0] and writes its bright parts to colorBuffers[1], like the forward pass
+    DeferredRenderer deferred(SCR_WIDTH, SCR_HEIGHT, colorBuffers[0], colorBuffers[1],
+                              {&deferredDirectionalShader, &pointLightVolumeShader, &spotLightVolumeShader, &brightPassShader});
+    // per cluster light lists for the forward pass, binned on the thread pool every frame
+    ClusteredLights clusteredLights;
+    // every mesh of the scene copied into one shared vertex/index arena per vertex format
+    MultiDrawRenderer multiDrawRenderer;
+    if (multiDrawIndirect)
+    {
+        multiDrawRenderer.Build(scene);
+        std::cout << "multi-draw arenas: " << multiDrawRenderer.ArenaBytes() / 1024 << " KB" << std::endl;
+    }
+
+    // the material samplers and shininess are the same for every draw, so they are set once here
+    for (Shader *shader : {&lightingShader, &instancedLightingShader, multiDrawShader.get(),
+                           &clusteredLightingShader, &instancedClusteredLightingShader, multiDrawClusteredShader.get(),
+                           &gBufferShader, &instancedGBufferShader, multiDrawGBufferShader.get()})
+    {
+        if (!shader)
+            continue;
+        shader->use();
+        shader->setInt("material.diffuse", 0);
+        shader->setInt("material.specular", 1);
+        shader->setFloat("material.shininess", 32.0f);
+    }
+    for (Shader *shader : {&clusteredLightingShader, &instancedClusteredLightingShader, multiDrawClusteredShader.get()})
+        if (shader)
+            ClusteredLights::Attach(*shader);
+    alphaTestedDepthShader.use();
+    alphaTestedDepthShader.setInt("material.diffuse", 0);
+    instancedAlphaTestedDepthShader.use();
+    instancedAlphaTestedDepthShader.setInt("material.diffuse", 0);
     blurShader.use();
     blurShader.setInt("image", 0);
     bloomShader.use();
     bloomShader.setInt("scene", 0);
     bloomShader.setInt("bloomBlur", 1);
+    occlusionDebugShader.use();
+    occlusionDebugShader.setInt("depthBuffer", 0);
+    occlusionDebugShader.setFloat("farPlane", 100.0f);
+    // uniforms set every frame, resolved once
+    Uniform<glm::mat4> lightCubeModel = lightCubeShader.uniform<glm::mat4>("model");
+    Uniform<glm::vec3> lightCubeColor = lightCubeShader.uniform<glm::vec3>("lightColor");
+    Uniform<bool> blurHorizontal = blurShader.uniform<bool>("horizontal");
+    Uniform<bool> bloomEnabled = bloomShader.uniform<bool>("bloom");
+    Uniform<float> bloomExposure = bloomShader.uniform<float>("exposure");
     // render loop
     // -----------
     while (!glfwWindowShouldClose(window))
@@ -334,6 +611,7 @@ int main()
         // input
         // -----
         processInput(window);
+        glState.ResetStats();
 
         // render
         // ------
@@ -341,219 +619,149 @@ int main()
         glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+        glState.BindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // don't forget to enable shader before setting uniforms
-        lightingShader.use();
-        lightingShader.setVec3("viewPosition", camera.Position);
-        lightingShader.setFloat("material.shininess", 32.0f);
-
-
-
-        // reflector spotlight
-        glm::vec3 reflector1LightPos = glm::vec3(-10.0f, 5.5f, -3.0f);
-        lightingShader.setVec3("spotLight1.position", reflector1LightPos);
-        lightingShader.setVec3("spotLight1.direction", 11.0f, -5.5f, -11.0f);
-        lightingShader.setVec3("spotLight1.ambient", 0.1f, 0.1f, 0.1f);
-        lightingShader.setVec3("spotLight1.diffuse", 0.5f, 0.5f, 0.5f);
-        lightingShader.setVec3("spotLight1.specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.setFloat("spotLight1.constant", 1.0f);
-        lightingShader.setFloat("spotLight1.linear", 0.045f);
-        lightingShader.setFloat("spotLight1.quadratic", 0.0075f);
-        lightingShader.setFloat("spotLight1.cutOff", glm::cos(glm::radians(28.0f)));
-        lightingShader.setFloat("spotLight1.outerCutOff", glm::cos(glm::radians(30.0f)));
-
-        glm::vec3 reflector2LightPos = glm::vec3(10.0f, 5.5f, -3.0f);
-        lightingShader.setVec3("spotLight2.position", reflector2LightPos);
-        lightingShader.setVec3("spotLight2.direction", -11.0f, -5.5f, -11.0f);
-        lightingShader.setVec3("spotLight2.ambient", 0.1f, 0.1f, 0.1f);
-        lightingShader.setVec3("spotLight2.diffuse", 0.5f, 0.5f, 0.5f);
-        lightingShader.setVec3("spotLight2.specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.setFloat("spotLight2.constant", 1.0f);
-        lightingShader.setFloat("spotLight2.linear", 0.045f);
-        lightingShader.setFloat("spotLight2.quadratic", 0.0075f);
-        lightingShader.setFloat("spotLight2.cutOff", glm::cos(glm::radians(28.0f)));
-        lightingShader.setFloat("spotLight2.outerCutOff", glm::cos(glm::radians(30.0f)));
-
-        // point Lights
-        int numOfPointLights = static_cast<int>(lightCubePositions.size());
-        for(int i = 0; i < numOfPointLights; i ++) {
-            std::string s = "pointLight[";
-            lightingShader.setVec3(s + std::to_string(i) + "].position", lightCubePositions[i]);
-            lightingShader.setVec3(s + std::to_string(i) + "].ambient", lightColor[i]);
-            lightingShader.setVec3(s + std::to_string(i) + "].diffuse", lightColor[i]);
-            lightingShader.setVec3(s + std::to_string(i) + "].specular", glm::vec3(0.1f));
-            lightingShader.setFloat(s + std::to_string(i) + "].constant", 1.0f);
-            lightingShader.setFloat(s + std::to_string(i) + "].linear", 0.7f);
-            lightingShader.setFloat(s + std::to_string(i) + "].quadratic", 1.8f);
-        }
-
-        // directional Light
-        lightingShader.setVec3("dirLight.direction", -1.0f, -1.0f, -1.0f);
-        lightingShader.setVec3("dirLight.ambient", 0.005f, 0.005f, 0.005f);
-        lightingShader.setVec3("dirLight.diffuse", 0.005f, 0.005f, 0.005f);
-        lightingShader.setVec3("dirLight.specular", 0.1f, 0.1f, 0.1f);
-
-        // view/projection transformations
+        // view/projection transformations, shared by all programs through the Frame block
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
         glm::mat4 view = camera.GetViewMatrix();
-        lightingShader.setMat4("projection", projection);
-        lightingShader.setMat4("view", view);
-
-        glm::mat4 model = glm::mat4(1.0f);
+        FrameUniforms frame;
+        frame.projection = projection;
+        frame.view = view;
+        frame.viewProjection = projection * view;
+        frame.viewPos = camera.Position;
+        frame.time = currentFrame;
+        frame.viewport = glm::vec4(SCR_WIDTH, SCR_HEIGHT, 1.0f / SCR_WIDTH, 1.0f / SCR_HEIGHT);
+        frame.inverseViewProjection = glm::inverse(frame.viewProjection);
+        frameUniformBuffer.Write(frame);
+
+        // sends the lights only if one changed
+        lights.Upload();
+
+        // meshes entirely outside the view or behind the occluders are neither submitted nor drawn instanced
+        for (OccluderBox &box : occluderBoxes)
+        {
+            if (box.placed || box.model->meshes.empty())
+                continue;
+            glm::vec3 boundsMin = box.model->meshes[0].boundsMin, boundsMax = box.model->meshes[0].boundsMax;
+            for (const Mesh &mesh : box.model->meshes)
+            {
+                boundsMin = glm::min(boundsMin, mesh.boundsMin);
+                boundsMax = glm::max(boundsMax, mesh.boundsMax);
+            }
+            for (const SceneObject &object : scene.objects)
+                if (object.model == box.model)
+                    occlusion.AddBox(glm::mix(boundsMin, boundsMax, box.from), glm::mix(boundsMin, boundsMax, box.to), object.transform);
+            box.placed = true;
+        }
+        if (occlusionCulling)
+            occlusion.Render(frame.viewProjection);
+        Frustum frustum(frame.viewProjection);
+        scene.Cull(frustum, occlusionCulling ? &occlusion : nullptr);
+
+        // what the crosshair points at, and whether the kv2 can be seen from the top of the watchtower
+        SceneBVH::Hit aim = scene.Index().Raycast(camera.Position, camera.Front, 100.0f);
+        BVHBounds watchtowerBounds = scene.Index().Bounds(watchtowerObject);
+        BVHBounds kv2Bounds = scene.Index().Bounds(kv2Object);
+        bool kv2InSight = false;
+        if (!watchtowerBounds.Empty() && !kv2Bounds.Empty())
+        {
+            glm::vec3 lookout = watchtowerBounds.Center();
+            lookout.y = glm::mix(watchtowerBounds.boundsMin.y, watchtowerBounds.boundsMax.y, 0.8f);
+            kv2InSight = scene.Index().LineOfSight(lookout, kv2Bounds.Center(), watchtowerObject, kv2Object);
+        }
 
-        lightingShader.use();
-        // render tank t10m
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, -2.0f, -10.0f));
-        model = glm::rotate(model, glm::radians(135.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        lightingShader.setMat4("model", model);
-        t10mModel.Draw(lightingShader);
-
-        // render tank kv2
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-8.0f, -2.0f, -25.0f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(1.5f, 1.5f, 1.5f));
-        lightingShader.setMat4("model", model);
-        kv2Model.Draw(lightingShader);
-
-        // render tank challenger2
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(10.0f, -2.0f, -25.0f));
-        model = glm::scale(model, glm::vec3(1.4f, 1.4f, 1.4f));
-        lightingShader.setMat4("model", model);
-        challenger2Model.Draw(lightingShader);
-
-        // render ammo boxes
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(10.0f, -2.0f, -16.0f));
-        model = glm::scale(model, glm::vec3(0.04f, 0.04f, 0.04f));
-        lightingShader.setMat4("model", model);
-        ammoBoxModel.Draw(lightingShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(11.34f, -2.0f, -15.57f));
-        model = glm::rotate(model, glm::radians(-30.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(0.04f, 0.04f, 0.04f));
-        lightingShader.setMat4("model", model);
-        ammoBoxModel.Draw(lightingShader);
-
-        // render watchtower
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-9.0f, -2.0f, -17.0f));
-        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(0.05f, 0.05f, 0.05f));
-        lightingShader.setMat4("model", model);
-        watchtowerModel.Draw(lightingShader);
-
-        // render crates and barrels
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-9.0f, -2.0f, -10.0f));
-        model = glm::scale(model, glm::vec3(1.2f, 1.2f, 1.2f));
-        lightingShader.setMat4("model", model);
-        cratesAndBarrelsModel.Draw(lightingShader);
-
-        // render oil drums
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(10.0f, -2.0f, -7.0f));
-        lightingShader.setMat4("model", model);
-        oilDrumsModel.Draw(lightingShader);
-
-        // render rusty oil barrels
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(10.0f, -2.0f, -10.0f));
-        model = glm::scale(model, glm::vec3(0.004f, 0.004f, 0.004f));
-        lightingShader.setMat4("model", model);
-        rustyOilBarrelsModel.Draw(lightingShader);
-
-        // render reflector
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-10.0f, -2.0f, -3.0f));
-        model = glm::rotate(model, glm::radians(135.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        lightingShader.setMat4("model", model);
-        reflectorModel.Draw(lightingShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(10.0f, -2.0f, -3.0f));
-        model = glm::rotate(model, glm::radians(-135.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        lightingShader.setMat4("model", model);
-        reflectorModel.Draw(lightingShader);
-
-        // render forest
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-38.0f, -2.0f, -10.0f));
-        lightingShader.setMat4("model", model);
-        forestModel.Draw(lightingShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-16.5f, -2.0f, -50.0f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        lightingShader.setMat4("model", model);
-        forestModel.Draw(lightingShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(30.5f, -2.0f, -50.0f));
-        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        lightingShader.setMat4("model", model);
-        forestModel.Draw(lightingShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(38.0f, -2.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        lightingShader.setMat4("model", model);
-        forestModel.Draw(lightingShader);
-
-
-        // render ground texture
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffuseGround);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, 0);
-
-        for(int i = 0; i < GROUND_DIMENSION; i ++) {
-            for(int j = 0; j < GROUND_DIMENSION; j ++) {
-                model = glm::mat4(1.0f);
-                model = glm::translate(model, glm::vec3(((float)i - GROUND_DIMENSION / 2.0f) * 2.0f, -2.0f, ((float)j - GROUND_DIMENSION / 2.0f) * (-2.0f)));
-                model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-                model = glm::scale(model, glm::vec3(2.0f));
-                lightingShader.setMat4("model", model);
-                lightingShader.setMat4("view", view);
-                lightingShader.setMat4("projection", projection);
-
-                glBindVertexArray(groundVAO);
-                glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
+        // depth pre-pass over everything the lit pass draws below; the multi-draw path has no depth variant
+        // and takes the render queue for all models, which computes the same depths. Deferred shading already
+        // shades every pixel once and needs none.
+        prepass.SetEnabled(depthPrepass && !deferredShading);
+        if (prepass.Enabled())
+        {
+            prepass.Begin();
+            depthQueue.Begin(view, 100.0f);
+            scene.SubmitDepth(depthQueue, depthShader, alphaTestedDepthShader, cutout, multiDrawIndirect ? Scene::All : Scene::PlacedOnce);
+            ground.SubmitDepth(depthQueue, depthShader);
+            depthQueue.Execute();
+            if (!multiDrawIndirect)
+                scene.DrawDepthInstanced(instancedDepthShader, instancedAlphaTestedDepthShader, cutout);
+        }
+        if (deferredShading)
+        {
+            // the same draws as the lit scene below with gBuffer.fs, then every light over the pixels it reaches;
+            // what follows draws into the lit color buffer with the scene depth
+            deferred.BeginGeometry();
+            renderQueue.Begin(view, 100.0f);
+            if (multiDrawIndirect)
+            {
+                multiDrawRenderer.Begin();
+                multiDrawRenderer.Submit(scene);
+                multiDrawRenderer.Execute(*multiDrawGBufferShader);
+            }
+            else
+                scene.Submit(renderQueue, gBufferShader, Scene::PlacedOnce);
+            ground.Submit(renderQueue, gBufferShader, diffuseGround);
+            renderQueue.Execute();
+            if (!multiDrawIndirect)
+                scene.DrawInstanced(instancedGBufferShader);
+            deferred.Light(lights, frustum);
+        }
+        else
+        {
+            // clustered: every light, but each fragment only evaluates the ones binned into its cluster
+            if (clusteredShading)
+            {
+                clusteredLights.Bin(lights, view, projection);
+                clusteredLights.Upload();
+                clusteredLights.Bind();
+            }
+            Shader &litShader = clusteredShading ? clusteredLightingShader : lightingShader;
+            Shader &instancedLitShader = clusteredShading ? instancedClusteredLightingShader : instancedLightingShader;
+            prepass.BeginShading();
+
+            // the lit scene, sorted by program, textures and VAO and drawn front to back
+            // (the models in a few multi-draw calls if available, the ground has its own mesh either way)
+            renderQueue.Begin(view, 100.0f);
+            if (multiDrawIndirect)
+            {
+                multiDrawRenderer.Begin();
+                multiDrawRenderer.Submit(scene);
+                multiDrawRenderer.Execute(clusteredShading ? *multiDrawClusteredShader : *multiDrawShader);
             }
+            else
+                scene.Submit(renderQueue, litShader, Scene::PlacedOnce);
+            ground.Submit(renderQueue, litShader, diffuseGround);
+            renderQueue.Execute();
+            // forest, reflectors and ammo boxes: one instanced draw per mesh for all their copies
+            if (!multiDrawIndirect)
+                scene.DrawInstanced(instancedLitShader);
+            prepass.End(SCR_WIDTH, SCR_HEIGHT);
         }
 
+        glm::mat4 model = glm::mat4(1.0f);
+
         lightCubeShader.use();
-        lightCubeShader.setMat4("projection", projection);
-        lightCubeShader.setMat4("view", view);
 
         for (unsigned int i = 0; i < lightCubePositions.size(); i ++) {
             model = glm::mat4(1.0f);
             model = glm::translate(model, lightCubePositions[i]);
             model = glm::scale(model, glm::vec3(0.15f));
-            lightCubeShader.setMat4("model", model);
-            lightCubeShader.setVec3("lightColor", lightCubeColors[i]);
+            lightCubeShader.set(lightCubeModel, model);
+            lightCubeShader.set(lightCubeColor, lightCubeColors[i]);
             renderCube();
         }
 
-        glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
+        glState.DepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
         skyboxShader.use();
-        view = glm::mat4(glm::mat3(camera.GetViewMatrix())); // remove translation from the view matrix
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
         // skybox cube
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+        glState.BindVertexArray(skyboxVAO);
+        glState.BindTexture(0, GL_TEXTURE_CUBE_MAP, cubemapTexture);
         glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS);
+        glState.DepthFunc(GL_LESS);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        // the forward pass wrote the bright parts along with the scene, the light passes can only sum them up
+        if (deferredShading)
+            deferred.ExtractBright();
+        glState.BindFramebuffer(GL_FRAMEBUFFER, 0);
 
         // 2. blur bright fragments with two-pass Gaussian Blur
         // --------------------------------------------------
@@ -562,29 +770,75 @@ int main()
         blurShader.use();
         for (unsigned int i = 0; i < amount; i++)
         {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-            blurShader.setInt("horizontal", horizontal);
-            glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
+            glState.BindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
+            blurShader.set(blurHorizontal, horizontal);
+            glState.BindTexture(0, GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
             renderQuad();
             horizontal = !horizontal;
             if (first_iteration)
                 first_iteration = false;
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glState.BindFramebuffer(GL_FRAMEBUFFER, 0);
 
         // 3. now render floating point color buffer to 2D quad and tonemap HDR colors to default framebuffer's (clamped) color range
         // --------------------------------------------------------------------------------------------------------------------------
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         bloomShader.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-        bloomShader.setInt("bloom", bloom);
-        bloomShader.setFloat("exposure", exposure);
+        glState.BindTexture(0, GL_TEXTURE_2D, colorBuffers[0]);
+        glState.BindTexture(1, GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
+        bloomShader.set(bloomEnabled, bloom);
+        bloomShader.set(bloomExposure, exposure);
         renderQuad();
 
-        std::cout << "bloom: " << (bloom ? "on" : "off") << "| exposure: " << exposure << std::endl;
+        // debug view: the occlusion buffer in the lower left corner, nearer occluders brighter
+        if (showOcclusionBuffer && occlusionCulling)
+        {
+            int framebufferWidth, framebufferHeight;
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+            glState.BindTexture(0, GL_TEXTURE_2D, occlusionTexture);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, OcclusionCuller::Width, OcclusionCuller::Height, GL_RED, GL_FLOAT, occlusion.Depth());
+            glState.Viewport(0, 0, OcclusionCuller::Width * 2, OcclusionCuller::Height * 2);
+            occlusionDebugShader.use();
+            renderQuad();
+            glState.Viewport(0, 0, framebufferWidth, framebufferHeight);
+        }
+
+        if (verifyGLState)
+            glState.Verify();
+        std::cout << "bloom: " << (bloom ? "on" : "off") << "| exposure: " << exposure
+                  << "| state changes avoided: " << renderQueue.LastFrame().Avoided()
+                  << "| gl calls elided: " << glState.FrameStats().Elided()
+                  << "| culled: " << scene.LastCull().culled << "/" << scene.LastCull().tested
+                  << "| occluded: " << scene.LastCull().occluded << " (" << (int)(occlusion.LastFrame().CullRate() * 100.0f)
+                  << "%, raster " << occlusion.LastFrame().rasterizeMs << " ms, test " << occlusion.LastFrame().testMs << " ms)"
+                  << "| ";
+        if (deferredShading)
+            std::cout << "deferred: geometry " << deferred.LastFrame().geometryMs << " ms, lights " << deferred.LastFrame().lightingMs
+                      << " ms for " << deferred.LastFrame().drawnPointLights << "/" << deferred.LastFrame().pointLights << " point, "
+                      << deferred.LastFrame().drawnSpotLights << "/" << deferred.LastFrame().spotLights << " spot";
+        else
+        {
+            std::cout << "prepass: ";
+            if (prepass.LastFrame().enabled)
+                std::cout << prepass.LastFrame().prepassMs << " ms";
+            else
+                std::cout << "off";
+            std::cout << ", shading " << prepass.LastFrame().shadingMs << " ms, overdraw " << prepass.LastFrame().overdraw;
+            if (clusteredShading)
+                std::cout << "| clusters: " << clusteredLights.LastFrame().lights << " lights, " << clusteredLights.LastFrame().references
+                          << " entries, at most " << clusteredLights.LastFrame().busiestCluster << ", binned in "
+                          << clusteredLights.LastFrame().binMs << " ms";
+        }
+        std::cout << "| aim: ";
+        if (aim.object != SceneBVH::None)
+            std::cout << "object " << aim.object << " at " << aim.distance;
+        else
+            std::cout << "-";
+        std::cout << "| watchtower sees kv2: " << (kv2InSight ? "yes" : "no");
+        if (multiDrawIndirect)
+            std::cout << "| multi-draws: " << multiDrawRenderer.LastFrame().multiDraws
+                      << " for " << multiDrawRenderer.LastFrame().draws << " draws";
+        std::cout << std::endl;
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
@@ -592,12 +846,19 @@ int main()
         glfwPollEvents();
     }
 
-    glDeleteVertexArrays(1, &skyboxVAO);
+    glState.DeleteVertexArrays(1, &skyboxVAO);
     glDeleteBuffers(1, &skyboxVBO);
-
-    glDeleteVertexArrays(1, &groundVAO);
-    glDeleteBuffers(1, &groundVBO);
-    glDeleteBuffers(1, &groundEBO);
+    glState.DeleteTextures(1, &occlusionTexture);
+    prepass.Delete();
+    deferred.Delete();
+    clusteredLights.Delete();
+
+    ground.Delete();
+    frameUniformBuffer.Delete();
+    for (const SceneInstances &group : scene.instances)
+        group.model->Delete();
+    multiDrawRenderer.Delete();
+    lights.Delete();
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
@@ -659,7 +920,7 @@ void renderCube()
         glGenVertexArrays(1, &cubeVAO);
         glGenBuffers(1, &cubeVBO);
 
-        glBindVertexArray(cubeVAO);
+        GLState::Shared().BindVertexArray(cubeVAO);
 
         // fill buffer
         glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
@@ -673,12 +934,10 @@ void renderCube()
         glEnableVertexAttribArray(2);
         glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
         glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
     }
     // render Cube
-    glBindVertexArray(cubeVAO);
+    GLState::Shared().BindVertexArray(cubeVAO);
     glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
 }
 
 unsigned int quadVAO = 0;
@@ -697,7 +956,7 @@ void renderQuad()
         // setup plane VAO
         glGenVertexArrays(1, &quadVAO);
         glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
+        GLState::Shared().BindVertexArray(quadVAO);
         glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
@@ -705,9 +964,8 @@ void renderQuad()
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
     }
-    glBindVertexArray(quadVAO);
+    GLState::Shared().BindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
@@ -736,6 +994,46 @@ void processInput(GLFWwindow *window)
         bloomKeyPressed = false;
     }
 
+    if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS && !occlusionKeyPressed)
+    {
+        showOcclusionBuffer = !showOcclusionBuffer;
+        occlusionKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_O) == GLFW_RELEASE)
+    {
+        occlusionKeyPressed = false;
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS && !prepassKeyPressed)
+    {
+        depthPrepass = !depthPrepass;
+        prepassKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_RELEASE)
+    {
+        prepassKeyPressed = false;
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS && !deferredKeyPressed)
+    {
+        deferredShading = !deferredShading;
+        deferredKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_G) == GLFW_RELEASE)
+    {
+        deferredKeyPressed = false;
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && !clusteredKeyPressed)
+    {
+        clusteredShading = !clusteredShading;
+        clusteredKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE)
+    {
+        clusteredKeyPressed = false;
+    }
+
     if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
     {
         if (exposure > 0.0f)
@@ -755,7 +1053,7 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+    GLState::Shared().Viewport(0, 0, width, height);
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -788,70 +1086,12 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
 
+// textures are decoded on the worker threads; the returned name is filled in by TexturePipeline::Pump/Finish
 unsigned int loadTexture(char const *path){
-    unsigned textureId;
-    glGenTextures(1, &textureId);
-
-    int width, height, nrChannels;
-    unsigned char *data = stbi_load(path, &width, &height, &nrChannels, 0);
-
-    if(data)
-    {
-        GLenum format = GL_RED;
-        if(nrChannels == 1)
-            format = GL_RED;
-        else if(nrChannels == 3)
-            format = GL_RGB;
-        else if(nrChannels == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureId);
-
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else{
-        cout << "Texture failed to load!" << path << "\n";
-        stbi_image_free(data);
-    }
-
-    return textureId;
+    return TextureRegistry::Shared().Acquire(path);
 }
 
 unsigned int loadCubemap(vector<std::string> faces)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
-}
\ No newline at end of file
+    return TexturePipeline::Shared().LoadCubemap(faces);
+}